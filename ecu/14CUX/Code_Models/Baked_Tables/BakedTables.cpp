@@ -0,0 +1,192 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Compile Time Table Check
+//
+//  Checks the tables the compiler builds from ../Common/BakedTables.h against the literal
+//  models they stand in for:
+//
+//      MAF         bakedMafTable and linearizeMAF_cx() (called at run time) against
+//                  linearizeMAF_6803() for every MAF sum
+//      Column      bakedColumnTable and getColumnIndex_cx() (called at run time) against
+//                  getColumnIndex() for every ignition period, X005C and the bracket
+//
+//  and times building a ColumnIndexTable at start up against attaching it to the baked one.
+//
+//  If an image is given with -tune, it is compared with the tune that was built in and
+//  a warning is printed if the MAF constants or the RPM table differ. -emit writes the
+//  BakedTune for the image as a header, for a build that bakes that tune instead:
+//
+//      BakedTables -tune R3652.bin -emit R3652_baked.h
+//      g++ -O2 -std=c++14 -DCUX_BAKED_TUNE_HEADER='"R3652_baked.h"' -I. BakedTables.cpp
+//
+//  Usage: BakedTables [-tune <image>] [-emit <header>]
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/Registers6803.h"
+#include "../Common/MafRowIndex.h"
+#include "../Common/RpmColumnIndex.h"
+#include "../Common/ColumnIndexTable.h"
+#include "../Common/BakedTables.h"
+
+
+#define BUILD_REPEAT        20          // for the timing
+
+
+static UINT32 checkMaf (UINT32 &cxMismatches)
+{
+    PromConstants prom = defaultPromConstants();
+    UINT32 mismatches = 0;
+
+    prom.XC1C3 = bakedTune.XC1C3;
+    prom.XC1C5 = bakedTune.XC1C5;
+    cxMismatches = 0;
+
+    for (UINT32 mafSum = 0; mafSum < BAKED_MAF_SUMS; mafSum++) {
+        UINT16 literal = linearizeMAF_6803((UINT16)mafSum, prom);
+
+        if (bakedMafTable[(UINT16)mafSum] != literal)
+            mismatches++;
+        if (linearizeMAF_cx((UINT16)mafSum, prom.XC1C3, prom.XC1C5) != literal)
+            cxMismatches++;
+    }
+
+    return mismatches;
+}
+
+static UINT32 checkColumns (UINT32 &cxMismatches)
+{
+    const UCHAR *table = bakedTune.rpmTable;
+    UINT32 mismatches = 0;
+
+    cxMismatches = 0;
+
+    for (UINT32 period = 0; period < PERIOD_COUNT_16BIT; period++) {
+        UCHAR bracket = 0, cxBracket = 0;
+        UCHAR colIndex = getColumnIndex((UINT16)period, &bracket, table);
+        UCHAR cxColIndex = getColumnIndex_cx((UINT16)period, cxBracket, table);
+
+        if (bakedColumnTable.colIndex((UINT16)period) != colIndex ||
+            bakedColumnTable.bracket((UINT16)period) != bracket)
+            mismatches++;
+        if (cxColIndex != colIndex || cxBracket != bracket)
+            cxMismatches++;
+    }
+
+    return mismatches;
+}
+
+// Write the image's MAF constants and RPM table as a BakedTune
+static bool emitHeader (const TuneImage &tune, const char *path)
+{
+    FILE *fptr = fopen(path, "w");
+
+    if (!fptr) {
+        printf("Could not open %s for writing\n", path);
+        return false;
+    }
+
+    const UCHAR *rpm = tune.rpmTable();
+
+    fprintf(fptr, "// Baked tune for %s, written by BakedTables -emit\n\n", tune.name());
+    fprintf(fptr, "constexpr BakedTune bakedTune = {\n");
+    fprintf(fptr, "    \"%s\", 0x%04X, 0x%04X,\n    {\n", tune.name(), tune.wordAt(ADDR_MAF_OFFSET),
+      tune.wordAt(ADDR_MAF_SUBTRACT));
+
+    for (int row = 0; row < RPM_TABLE_SIZE / 4; row++)
+        fprintf(fptr, "%s0x%02X, 0x%02X, 0x%02X, 0x%02X%s", (row % 4) ? "  " : "        ",
+          rpm[4 * row], rpm[4 * row + 1], rpm[4 * row + 2], rpm[4 * row + 3],
+          (row == RPM_TABLE_SIZE / 4 - 1) ? "\n" : ((row % 4) == 3 ? ",\n" : ","));
+
+    fprintf(fptr, "    }\n};\n");
+
+    bool ok = fclose(fptr) == 0;
+
+    if (!ok)
+        printf("Could not write %s\n", path);
+
+    return ok;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    const char *tunePath = 0;
+    const char *emitPath = 0;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-tune") == 0 && arg + 1 < argc)
+            tunePath = argv[++arg];
+        else if (strcmp(argv[arg], "-emit") == 0 && arg + 1 < argc)
+            emitPath = argv[++arg];
+        else {
+            printf("Usage: BakedTables [-tune <image>] [-emit <header>]\n");
+            return 1;
+        }
+    }
+
+    TuneImage tune;
+
+    if ((tunePath || emitPath) &&
+        !tune.open(tunePath ? tunePath : "../../OriginalCode/Reference_Bins/R3526.bin"))
+        return 1;
+
+    if (emitPath) {
+        if (!emitHeader(tune, emitPath))
+            return 1;
+        printf("Wrote the baked tune for %s to %s\n", tune.name(), emitPath);
+    }
+
+    printf("Built in: %s (XC1C3 $%04X, XC1C5 $%04X)\n", bakedTune.name, bakedTune.XC1C3, bakedTune.XC1C5);
+
+    if (tune.isOpen() && !bakedTuneMatches(tune))
+        printf("Warning: %s has different MAF constants or RPM table, the baked tables don't apply to it\n",
+          tune.name());
+
+    UINT32 mafCx, colCx;
+    UINT32 mafBaked = checkMaf(mafCx);
+    UINT32 colBaked = checkColumns(colCx);
+
+    printf("\n            Inputs   Baked table   Run time _cx\n");
+    printf("-----------------------------------------------\n");
+    printf("MAF         %6u   %11u   %12u\n", BAKED_MAF_SUMS, mafBaked, mafCx);
+    printf("Column      %6u   %11u   %12u\n", PERIOD_COUNT_16BIT, colBaked, colCx);
+
+    // Start up cost: build a ColumnIndexTable, or attach one to the baked entries
+    ColumnIndexTable built;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < BUILD_REPEAT; i++)
+        built.build(bakedTune.rpmTable);
+
+    double buildUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count()
+                     / BUILD_REPEAT;
+
+    ColumnIndexTable attached;
+    start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < BUILD_REPEAT; i++)
+        attached.attach(bakedColumnTable.entry);
+
+    double attachUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count()
+                      / BUILD_REPEAT;
+
+    UINT32 attachMismatches = attached.verify(bakedTune.rpmTable);
+
+    printf("\nColumnIndexTable: build %.1f us, attach %.3f us (%u mismatches)\n", buildUs, attachUs,
+      attachMismatches);
+
+    return (mafBaked || mafCx || colBaked || colCx || attachMismatches) ? 2 : 0;
+}
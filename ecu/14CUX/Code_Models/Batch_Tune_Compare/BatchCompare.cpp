@@ -0,0 +1,340 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Batch Tune Comparison
+//
+//  This runs the MAF linearization, load (row) index and RPM (column) index models against
+//  a set of PROM images in one go, so a regression check across the whole tune family is a
+//  single command instead of an edit and rebuild for each tune.
+//
+//  By default the ten reference images in OriginalCode/Reference_Bins are used (the same
+//  list and order as buildall.bat). Each tune is mapped and run by its own worker thread.
+//  The results are written as two tab delimited files with the tune name as the first
+//  column, so they can be filtered or pivoted by tune in Excel, Matlab, etc.
+//
+//      tuneCompareMaf.txt  - linearized MAF and row index at 900, 3100 and 5102 RPM for
+//                            every MAF count (0 to 1023)
+//      tuneCompareRpm.txt  - bracket and column index from 120 to 6490 RPM in 10 RPM steps
+//
+//  A summary of how many points differ from the reference tune is printed at the end. The
+//  column index comes from each tune's 64K entry lookup table (ColumnIndexTable.h), which is
+//  cross-checked against the literal model and reported in the "LUT" column.
+//
+//  When built with -DCUX_PATH_COUNTERS=1, a histogram of the branch paths the models took
+//  over these inputs is printed for each tune (see PathCounters.h). The column index paths
+//  are counted over the RPM scan with the literal model, not over the lookup table check.
+//
+//  Usage: BatchCompare [-dir <bin directory>] [-map <0-5>] [-ref <tune>] [image ...]
+//
+//      -dir    directory holding the reference images (default ../../OriginalCode/Reference_Bins)
+//      -map    fuel map 0 to 5 to use for every tune (default is each tune's own default map)
+//      -ref    tune to compare the others against (default is the first one)
+//      image   explicit list of PROM images to use instead of the reference set
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/ReferenceTunes.h"
+#include "../Common/MafRowIndex.h"
+#include "../Common/RpmColumnIndex.h"
+#include "../Common/ColumnIndexTable.h"
+#include "../Common/PathCounters.h"
+
+
+#define MAF_COUNTS          1024        // 10-bit MAF reading
+#define RPM_FIRST           120         // same RPM scan as RpmTable.cpp
+#define RPM_LAST            6500
+#define RPM_STEP            10
+#define RPM_POINTS          ((RPM_LAST - RPM_FIRST) / RPM_STEP)
+#define PERIOD_COUNT        3
+
+
+// Same three spark periods used by MafModel.cpp
+static const UINT16 comparePeriod[PERIOD_COUNT]    = { 0x208D, 0x0973, 0x0553 };
+static const UINT16 comparePeriodRpm[PERIOD_COUNT] = {    900,   3100,   5102 };
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Results for one tune. Each worker thread fills in one of these.
+//
+///////////////////////////////////////////////////////////////////////////////
+struct TuneResult
+{
+    std::string     path;
+    char            name[64];
+    bool            ok;
+    UINT16          tuneNumber;
+    int             mapNumber;
+    PromConstants   prom;
+
+    UINT16          linearMAF[MAF_COUNTS];
+    UINT8           rowIndex[MAF_COUNTS][PERIOD_COUNT];
+    UCHAR           bracket[RPM_POINTS];
+    UCHAR           colIndex[RPM_POINTS];
+    UINT32          lookupMismatches;
+    PathCounts      paths;                  // branch paths (CUX_PATH_COUNTERS builds only)
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  runTune
+//
+//  Worker thread. Maps the image and runs all three models over the same
+//  inputs used by MafModel.cpp and RpmTable.cpp.
+//
+//  The column index is read from the tune's lookup table, which is checked
+//  against the literal getColumnIndex() model for every period.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void runTune (TuneResult *result, int forcedMap)
+{
+    TuneImage tune;
+    Cpu6803 cpu;                            // this worker's registers
+
+    result->ok = tune.open(result->path.c_str());
+
+    if (!result->ok)
+        return;
+
+    strcpy(result->name, tune.name());
+    result->tuneNumber = tune.tuneNumber();
+    result->mapNumber = (forcedMap >= 0) ? forcedMap : tune.defaultFuelMap();
+    result->prom = tune.constants(result->mapNumber);
+
+    PathCounts &paths = pathCounters();     // this worker's counters
+    paths.clear();
+
+    for (UINT16 mafCounts = 0; mafCounts < MAF_COUNTS; mafCounts++) {
+
+        UINT16 linearMAF = linearizeMAF_6803 (cpu, 2 * mafCounts, result->prom);
+
+        result->linearMAF[mafCounts] = linearMAF;
+
+        for (int i = 0; i < PERIOD_COUNT; i++)
+            result->rowIndex[mafCounts][i] = Calculate_Row_Index (cpu, comparePeriod[i], linearMAF, result->prom);
+    }
+
+    result->paths = paths;
+
+    ColumnIndexTable lookupTable(tune.rpmTable());
+
+    result->lookupMismatches = lookupTable.verify(tune.rpmTable());
+
+    paths.clear();
+
+    for (int i = 0; i < RPM_POINTS; i++) {
+
+        UINT16 rpm = RPM_FIRST + i * RPM_STEP;
+        UINT16 period = (UINT16)(7500000.0/rpm);
+
+        result->bracket[i] = lookupTable.bracket(period);
+        result->colIndex[i] = lookupTable.colIndex(period);
+
+#if CUX_PATH_COUNTERS
+        UCHAR bracket;
+        getColumnIndex(cpu, period, &bracket, tune.rpmTable());
+#endif
+    }
+
+    result->paths.add(paths);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Output files
+//
+///////////////////////////////////////////////////////////////////////////////
+static void writeMafFile (const char *fileName, const std::vector<TuneResult *> &results)
+{
+    FILE *fptr = fopen(fileName, "w");
+
+    if (!fptr) {
+        printf("Could not open %s for writing\n", fileName);
+        return;
+    }
+
+    fprintf(fptr, "Tune          Map  MAF Counts   Linear     %u  %u  %u\n",
+      comparePeriodRpm[0], comparePeriodRpm[1], comparePeriodRpm[2]);
+    fprintf(fptr, "------------------------------------------------------------\n");
+
+    for (size_t t = 0; t < results.size(); t++) {
+
+        const TuneResult *r = results[t];
+
+        if (!r->ok)
+            continue;
+
+        for (UINT16 mafCounts = 0; mafCounts < MAF_COUNTS; mafCounts++)
+            fprintf(fptr, "%-12s \t %u \t %5u \t %5u    0x%02X  0x%02X  0x%02X\n",
+              r->name, r->mapNumber, mafCounts, r->linearMAF[mafCounts],
+              r->rowIndex[mafCounts][0], r->rowIndex[mafCounts][1], r->rowIndex[mafCounts][2]);
+    }
+
+    fclose(fptr);
+}
+
+
+static void writeRpmFile (const char *fileName, const std::vector<TuneResult *> &results)
+{
+    FILE *fptr = fopen(fileName, "w");
+
+    if (!fptr) {
+        printf("Could not open %s for writing\n", fileName);
+        return;
+    }
+
+    fprintf(fptr, "Tune           RPM   Bracket  X005C  Upper nibble\n");
+    fprintf(fptr, "------------------------------------------------------------\n");
+
+    for (size_t t = 0; t < results.size(); t++) {
+
+        const TuneResult *r = results[t];
+
+        if (!r->ok)
+            continue;
+
+        for (int i = 0; i < RPM_POINTS; i++)
+            fprintf(fptr, "%-12s \t %5u \t 0x%02X \t %3u \t %3u\n", r->name, RPM_FIRST + i * RPM_STEP,
+              r->bracket[i], r->colIndex[i], (r->colIndex[i] & 0xF0));
+    }
+
+    fclose(fptr);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  printSummary
+//
+//  Counts the points where each tune differs from the reference tune.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void printSummary (const std::vector<TuneResult *> &results, const TuneResult *ref)
+{
+    printf("\nDifferences from %s:\n\n", ref->name);
+    printf("Tune           Map  Linear MAF   Row Index   Col Index   C1C3  C1C5  C1C7  200A    LUT\n");
+    printf("---------------------------------------------------------------------------------------\n");
+
+    for (size_t t = 0; t < results.size(); t++) {
+
+        const TuneResult *r = results[t];
+        unsigned linDiffs = 0, rowDiffs = 0, colDiffs = 0;
+
+        if (!r->ok) {
+            printf("%-14s (could not be loaded)\n", r->path.c_str());
+            continue;
+        }
+
+        for (int i = 0; i < MAF_COUNTS; i++) {
+            if (r->linearMAF[i] != ref->linearMAF[i])
+                linDiffs++;
+            for (int j = 0; j < PERIOD_COUNT; j++)
+                if (r->rowIndex[i][j] != ref->rowIndex[i][j])
+                    rowDiffs++;
+        }
+
+        for (int i = 0; i < RPM_POINTS; i++)
+            if (r->colIndex[i] != ref->colIndex[i] || r->bracket[i] != ref->bracket[i])
+                colDiffs++;
+
+        printf("%-14s  %u   %6u      %6u      %6u      %04X  %04X  %04X  %02X  %5s\n",
+          r->name, r->mapNumber, linDiffs, rowDiffs, colDiffs,
+          r->prom.XC1C3, r->prom.XC1C5, r->prom.XC1C7, r->prom.X200A,
+          r->lookupMismatches ? "FAIL" : "ok");
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    std::string dir = REFERENCE_BIN_DIR;
+    std::vector<std::string> paths;
+    std::vector<TuneResult *> results;
+    std::vector<std::thread> workers;
+    const char *refName = 0;
+    const TuneResult *ref = 0;
+    int forcedMap = -1;
+    bool anyLoaded = false;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-dir") == 0 && arg + 1 < argc)
+            dir = argv[++arg];
+        else if (strcmp(argv[arg], "-map") == 0 && arg + 1 < argc) {
+            forcedMap = atoi(argv[++arg]);
+            if (forcedMap < 0 || forcedMap >= FUEL_MAP_COUNT) {
+                printf("Usage: BatchCompare [-dir <bin directory>] [-map <0-5>] [-ref <tune>] [image ...]\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "-ref") == 0 && arg + 1 < argc)
+            refName = argv[++arg];
+        else
+            paths.push_back(argv[arg]);
+    }
+
+    if (paths.empty())
+        for (int i = 0; i < REFERENCE_TUNE_COUNT; i++)
+            paths.push_back(dir + "/" + referenceTunes[i]);
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        TuneResult *r = new TuneResult;
+        r->path = paths[i];
+        r->ok = false;
+        r->name[0] = 0;
+        results.push_back(r);
+        workers.push_back(std::thread(runTune, r, forcedMap));
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    for (size_t i = 0; i < results.size() && !ref; i++) {
+        if (!results[i]->ok)
+            continue;
+        anyLoaded = true;
+        if (!refName || strstr(results[i]->name, refName))
+            ref = results[i];
+    }
+
+    if (!ref) {
+        if (anyLoaded)
+            printf("-ref %s is not one of the tunes\n", refName);
+        else
+            printf("No reference tune could be loaded\n");
+        return 1;
+    }
+
+    writeMafFile("tuneCompareMaf.txt", results);
+    writeRpmFile("tuneCompareRpm.txt", results);
+    printSummary(results, ref);
+
+#if CUX_PATH_COUNTERS
+    for (size_t i = 0; i < results.size(); i++) {
+        if (!results[i]->ok)
+            continue;
+        std::string title = std::string(results[i]->name) + ", MAF counts 0 to 1023 at 3 periods, " +
+                            "RPM scan";
+        printPathHistogram(stdout, results[i]->paths, title.c_str());
+    }
+#endif
+
+    for (size_t i = 0; i < results.size(); i++)
+        delete results[i];
+
+    return 0;
+}
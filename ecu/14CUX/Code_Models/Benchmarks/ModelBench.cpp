@@ -0,0 +1,361 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Code Model Benchmarks
+//
+//  Times each of the modeled routines (scalar, batched and lookup table versions where
+//  they exist) over realistic input sets:
+//
+//      idle        MAF sum around 600 (about 300 counts per MAF input) with some noise,
+//                  ignition period around 700 RPM
+//      wot         MAF sum ramping over the whole range, ignition period ramping from
+//                  1000 to 6000 RPM (a wide open throttle pull)
+//      cranking    low MAF and ignition periods around 0x927C (200 RPM)
+//
+//  For each benchmark the inputs are run repeatedly until at least the minimum time has
+//  passed, then ns/call, calls/sec and cycles/call are reported. Cycles come from the time
+//  stamp counter on x86 (so they are reference cycles, not core cycles if the CPU is turbo
+//  boosting) and are reported as zero elsewhere.
+//
+//  The results are printed and written as JSON in the same general layout as Google
+//  Benchmark's --benchmark_format=json, so the files can be compared between releases with
+//  the usual tools.
+//
+//  Usage: ModelBench [-tune <bin>] [-map <n>] [-json <file>] [-min_time <sec>] [-filter <text>]
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/MafRowIndex.h"
+#include "../Common/MafLinearizeBatch.h"
+#include "../Common/RpmColumnIndex.h"
+#include "../Common/ColumnIndexTable.h"
+#include "../Common/Random.h"
+
+
+#define INPUT_COUNT     4096        // inputs per pass (fits in L1 with the outputs)
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Input sets
+//
+///////////////////////////////////////////////////////////////////////////////
+struct InputSet
+{
+    const char *name;
+    UINT16      mafSum[INPUT_COUNT];
+    UINT16      linearMAF[INPUT_COUNT];
+    UINT16      period[INPUT_COUNT];
+};
+
+
+static UINT16 rpmToPeriod (double rpm)
+{
+    return (UINT16)(7500000.0 / rpm);
+}
+
+static void makeInputs (InputSet &set, const char *name, const PromConstants &prom)
+{
+    XorShift rng(0x14C0);
+    int i;
+
+    set.name = name;
+
+    for (i = 0; i < INPUT_COUNT; i++) {
+
+        int noise = (int)(rng.next() % 41) - 20;
+
+        if (strcmp(name, "idle") == 0) {
+            set.mafSum[i] = (UINT16)(600 + noise);
+            set.period[i] = rpmToPeriod(700.0 + noise);
+        }
+        else if (strcmp(name, "wot") == 0) {
+            set.mafSum[i] = (UINT16)((2046L * i) / (INPUT_COUNT - 1));
+            set.period[i] = rpmToPeriod(1000.0 + (5000.0 * i) / (INPUT_COUNT - 1));
+        }
+        else {                              // cranking
+            set.mafSum[i] = (UINT16)(200 + noise);
+            set.period[i] = (UINT16)(0x927C + 50 * noise);
+        }
+
+        set.linearMAF[i] = linearizeMAF_6803(set.mafSum[i], prom);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Timing
+//
+///////////////////////////////////////////////////////////////////////////////
+struct BenchResult
+{
+    std::string name;
+    double      iterations;                 // total calls
+    double      seconds;
+    double      cpuSeconds;                 // process CPU time (clock)
+    double      cycles;
+};
+
+static volatile UINT32 sink;                // keeps the optimizer from dropping the work
+
+
+static unsigned long long readTsc (void)
+{
+#if HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+
+// Calls pass() (one run over INPUT_COUNT inputs) until minTime has passed
+template <class Pass>
+static BenchResult runBench (const std::string &name, double minTime, Pass pass)
+{
+    BenchResult result;
+    UINT32 check = pass();                  // warm up the caches and branch predictors
+    long passes = 0;
+    double elapsed;
+
+    auto start = std::chrono::steady_clock::now();
+    clock_t cpuStart = clock();
+    unsigned long long tscStart = readTsc();
+
+    do {
+        for (int k = 0; k < 16; k++)
+            check += pass();
+        passes += 16;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < minTime);
+
+    unsigned long long tscEnd = readTsc();
+    clock_t cpuEnd = clock();
+
+    sink = check;
+
+    result.name = name;
+    result.iterations = (double)passes * INPUT_COUNT;
+    result.seconds = elapsed;
+    result.cpuSeconds = (double)(cpuEnd - cpuStart) / CLOCKS_PER_SEC;
+    result.cycles = (double)(tscEnd - tscStart);
+
+    printf("%-36s %10.2f ns %14.0f calls/s %8.1f cycles\n", name.c_str(),
+      1e9 * result.seconds / result.iterations, result.iterations / result.seconds,
+      result.cycles / result.iterations);
+
+    return result;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  JSON output
+//
+///////////////////////////////////////////////////////////////////////////////
+// text as a JSON string body (Windows paths have backslashes)
+static std::string jsonEscape (const char *text)
+{
+    std::string out;
+
+    for (; *text; text++) {
+        if (*text == '\\' || *text == '"')
+            out += '\\';
+        out += *text;
+    }
+
+    return out;
+}
+
+static void writeJson (const char *fileName, const char *program, const char *tuneName,
+                       double minTime, const std::vector<BenchResult> &results)
+{
+    FILE *fptr = fopen(fileName, "w");
+    char date[32];
+    time_t now = time(0);
+
+    if (!fptr) {
+        printf("Could not open %s for writing\n", fileName);
+        return;
+    }
+
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    fprintf(fptr, "{\n");
+    fprintf(fptr, "  \"context\": {\n");
+    fprintf(fptr, "    \"date\": \"%s\",\n", date);
+    fprintf(fptr, "    \"executable\": \"%s\",\n", jsonEscape(program).c_str());
+    fprintf(fptr, "    \"tune\": \"%s\",\n", jsonEscape(tuneName).c_str());
+    fprintf(fptr, "    \"batch_kernel\": \"%s\",\n", mafBatchKernelName());
+    fprintf(fptr, "    \"inputs_per_pass\": %d,\n", INPUT_COUNT);
+    fprintf(fptr, "    \"min_time\": %.3f,\n", minTime);
+    fprintf(fptr, "    \"cycle_counter\": \"%s\"\n", HAVE_TSC ? "tsc" : "none");
+    fprintf(fptr, "  },\n");
+    fprintf(fptr, "  \"benchmarks\": [\n");
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &r = results[i];
+        double ns = 1e9 * r.seconds / r.iterations;
+
+        fprintf(fptr, "    {\n");
+        fprintf(fptr, "      \"name\": \"%s\",\n", r.name.c_str());
+        fprintf(fptr, "      \"iterations\": %.0f,\n", r.iterations);
+        fprintf(fptr, "      \"real_time\": %.4f,\n", ns);
+        fprintf(fptr, "      \"cpu_time\": %.4f,\n", 1e9 * r.cpuSeconds / r.iterations);
+        fprintf(fptr, "      \"time_unit\": \"ns\",\n");
+        fprintf(fptr, "      \"items_per_second\": %.1f,\n", r.iterations / r.seconds);
+        fprintf(fptr, "      \"cycles_per_call\": %.3f\n", r.cycles / r.iterations);
+        fprintf(fptr, "    }%s\n", (i + 1 < results.size()) ? "," : "");
+    }
+
+    fprintf(fptr, "  ]\n");
+    fprintf(fptr, "}\n");
+    fclose(fptr);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    static const char *setNames[] = { "idle", "wot", "cranking" };
+
+    TuneImage tune;
+    PromConstants prom = defaultPromConstants();
+    const UCHAR *rpmTable = defaultRpmTable;
+    const char *jsonFile = "modelBench.json";
+    const char *filter = 0;
+    double minTime = 0.2;
+    int mapNumber = -1;
+    std::vector<BenchResult> results;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-tune") == 0 && arg + 1 < argc) {
+            if (!tune.open(argv[++arg]))
+                return 1;
+        }
+        else if (strcmp(argv[arg], "-map") == 0 && arg + 1 < argc)
+            mapNumber = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-json") == 0 && arg + 1 < argc)
+            jsonFile = argv[++arg];
+        else if (strcmp(argv[arg], "-min_time") == 0 && arg + 1 < argc)
+            minTime = atof(argv[++arg]);
+        else if (strcmp(argv[arg], "-filter") == 0 && arg + 1 < argc)
+            filter = argv[++arg];
+        else {
+            printf("Usage: ModelBench [-tune <bin>] [-map <n>] [-json <file>] [-min_time <sec>] [-filter <text>]\n");
+            return 1;
+        }
+    }
+
+    if (tune.isOpen()) {
+        prom = tune.constants((mapNumber < 0) ? tune.defaultFuelMap() : mapNumber);
+        rpmTable = tune.rpmTable();
+    }
+
+    ColumnIndexTable lookupTable(rpmTable);
+
+    printf("Tune: %s   batch kernel: %s\n\n", tune.isOpen() ? tune.name() : "default (R3526)",
+      mafBatchKernelName());
+
+    for (int s = 0; s < 3; s++) {
+
+        InputSet *set = new InputSet;
+        UINT16 *output = new UINT16[INPUT_COUNT];
+        std::string suffix = std::string("/") + setNames[s];
+
+        makeInputs(*set, setNames[s], prom);
+
+#define WANTED(n)   (!filter || strstr((std::string(n) + suffix).c_str(), filter))
+
+        if (WANTED("linearizeMAF_C"))
+            results.push_back(runBench("linearizeMAF_C" + suffix, minTime, [&]() {
+                UINT32 sum = 0;
+                for (int i = 0; i < INPUT_COUNT; i++)
+                    sum += linearizeMAF_C(set->mafSum[i], prom);
+                return sum;
+            }));
+
+        if (WANTED("linearizeMAF_6803"))
+            results.push_back(runBench("linearizeMAF_6803" + suffix, minTime, [&]() {
+                Cpu6803 cpu;
+                UINT32 sum = 0;
+                for (int i = 0; i < INPUT_COUNT; i++)
+                    sum += linearizeMAF_6803(cpu, set->mafSum[i], prom);
+                return sum;
+            }));
+
+        if (WANTED("linearizeMAF_Scalar"))
+            results.push_back(runBench("linearizeMAF_Scalar" + suffix, minTime, [&]() {
+                UINT32 sum = 0;
+                for (int i = 0; i < INPUT_COUNT; i++)
+                    sum += linearizeMAF_Scalar(set->mafSum[i], prom);
+                return sum;
+            }));
+
+        if (WANTED("linearizeMAF_Batch"))
+            results.push_back(runBench("linearizeMAF_Batch" + suffix, minTime, [&]() {
+                linearizeMAF_Batch(set->mafSum, output, INPUT_COUNT, prom);
+                return (UINT32)output[INPUT_COUNT / 2];
+            }));
+
+        if (WANTED("Calculate_Row_Index"))
+            results.push_back(runBench("Calculate_Row_Index" + suffix, minTime, [&]() {
+                Cpu6803 cpu;
+                UINT32 sum = 0;
+                for (int i = 0; i < INPUT_COUNT; i++)
+                    sum += Calculate_Row_Index(cpu, set->period[i], set->linearMAF[i], prom);
+                return sum;
+            }));
+
+        if (WANTED("getColumnIndex"))
+            results.push_back(runBench("getColumnIndex" + suffix, minTime, [&]() {
+                Cpu6803 cpu;
+                UCHAR bracket;
+                UINT32 sum = 0;
+                for (int i = 0; i < INPUT_COUNT; i++)
+                    sum += getColumnIndex(cpu, set->period[i], &bracket, rpmTable);
+                return sum;
+            }));
+
+        if (WANTED("ColumnIndexTable"))
+            results.push_back(runBench("ColumnIndexTable" + suffix, minTime, [&]() {
+                UINT32 sum = 0;
+                for (int i = 0; i < INPUT_COUNT; i++)
+                    sum += lookupTable.colIndex(set->period[i]);
+                return sum;
+            }));
+
+#undef WANTED
+
+        delete [] output;
+        delete set;
+    }
+
+    writeJson(jsonFile, argv[0], tune.isOpen() ? tune.name() : "default", minTime, results);
+
+    return 0;
+}
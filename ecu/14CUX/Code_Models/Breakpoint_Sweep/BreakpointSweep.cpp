@@ -0,0 +1,210 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Breakpoint Sweep
+//
+//  Lists every ignition period where the fuel map column index (X005C) or its bracket
+//  changes, using the interval search in ../Common/Breakpoints.h, and certifies the RPM
+//  table: over the RPM range the column index must never drop as RPM rises and its upper
+//  nibble must match the bracket (the "smooth monotonic function" that RpmTable.cpp
+//  graphs by stepping the RPM in 10 RPM steps).
+//
+//  Run with "-verify" to check the search against a brute force scan of all 65536 periods
+//  for the column index (this table plus a set of random tables with every control byte)
+//  and for the row index at every linearized MAF value the ECU can produce.
+//
+//  Usage: BreakpointSweep [-tune <bin>] [-map <n>] [-rpm <low> <high>] [-verify]
+//
+//      -tune   PROM image to take the RPM table and constants from (default is the
+//              R3526 table and constants)
+//      -rpm    range to certify (default 120 to 6500)
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/MafRowIndex.h"
+#include "../Common/RpmColumnIndex.h"
+#include "../Common/Breakpoints.h"
+#include "../Common/Random.h"
+
+
+#define RANDOM_TABLES       500
+#define TIMING_PASSES       1000
+
+
+static double periodToRpm (UINT32 period)
+{
+    return period ? 7500000.0 / period : 0.0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Brute force checks
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool checkColumnTable (const UCHAR *table)
+{
+    Cpu6803 cpu;
+    auto value = [table, &cpu](UINT32 p) { return columnIndexValue(cpu, (UINT16)p, table); };
+
+    return sameBreakpoints(columnIndexBreakpoints(table), scanBreakpoints(value, 0, INPUT_LAST_16BIT));
+}
+
+
+static int verify (const UCHAR *table, const PromConstants &prom)
+{
+    static const UCHAR controls[] = { 0x00, 0x40, 0x80, 0xC0 };
+    UINT32 failures = 0;
+    XorShift rng(0x14C0);
+    UCHAR random[RPM_TABLE_SIZE];
+
+    if (!checkColumnTable(table)) {
+        printf("Column index: search differs from the scan for this table\n");
+        failures++;
+    }
+
+    // random tables: mostly descending entries (like a real table) with some out of order
+    for (int t = 0; t < RANDOM_TABLES; t++) {
+
+        UINT32 entry = 0x0400 + rng.next() % 0x0400;
+
+        for (int row = 0; row < 16; row++) {
+            if (rng.next() % 8 == 0)
+                entry = rng.next() % 0x10000;
+            else
+                entry = (entry + rng.next() % 0x2000) & 0xFFFF;
+
+            random[4 * row] = (UCHAR)(entry >> 8);
+            random[4 * row + 1] = (UCHAR)entry;
+            random[4 * row + 2] = controls[rng.next() % 4];
+            random[4 * row + 3] = (UCHAR)rng.next();
+        }
+
+        if (!checkColumnTable(random)) {
+            printf("Column index: search differs from the scan for random table %d\n", t);
+            failures++;
+        }
+    }
+
+    printf("Column index: %u tables checked\n", RANDOM_TABLES + 1);
+
+    // row index along the period, for every linearized MAF value
+    std::vector<bool> seen(0x10000, false);
+    UINT32 rowChecks = 0;
+    Cpu6803 cpu;
+
+    for (UINT16 mafSum = 0; mafSum < 2047; mafSum++) {
+
+        UINT16 linearMAF = linearizeMAF_6803(cpu, mafSum, prom);
+
+        if (seen[linearMAF])
+            continue;
+        seen[linearMAF] = true;
+        rowChecks++;
+
+        auto value = [linearMAF, &prom, &cpu](UINT32 p) {
+            return (UINT32)Calculate_Row_Index(cpu, (UINT16)p, linearMAF, prom);
+        };
+
+        if (!sameBreakpoints(rowIndexBreakpoints(linearMAF, prom), scanBreakpoints(value, 0, INPUT_LAST_16BIT))) {
+            printf("Row index: search differs from the scan for linearMAF %u\n", linearMAF);
+            failures++;
+        }
+    }
+
+    printf("Row index: %u linearized MAF values checked\n", rowChecks);
+    printf("%u failures\n", failures);
+
+    return failures ? 1 : 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    TuneImage tune;
+    const UCHAR *table = defaultRpmTable;
+    PromConstants prom = defaultPromConstants();
+    int mapNumber = -1;
+    UINT32 rpmLow = 120, rpmHigh = 6500;
+    bool runVerify = false;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-tune") == 0 && arg + 1 < argc) {
+            if (!tune.open(argv[++arg]))
+                return 1;
+        }
+        else if (strcmp(argv[arg], "-map") == 0 && arg + 1 < argc)
+            mapNumber = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-rpm") == 0 && arg + 2 < argc) {
+            rpmLow = (UINT32)atoi(argv[++arg]);
+            rpmHigh = (UINT32)atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "-verify") == 0)
+            runVerify = true;
+        else {
+            printf("Usage: BreakpointSweep [-tune <bin>] [-map <n>] [-rpm <low> <high>] [-verify]\n");
+            return 1;
+        }
+    }
+
+    if (rpmLow < 115 || rpmHigh < rpmLow) {
+        printf("The RPM range must be at least 115 (a 16-bit period) and low to high\n");
+        return 1;
+    }
+
+    if (tune.isOpen()) {
+        table = tune.rpmTable();
+        prom = tune.constants((mapNumber < 0) ? tune.defaultFuelMap() : mapNumber);
+        printf("Using %s (tune %04X)\n", tune.name(), tune.tuneNumber());
+    }
+
+    if (runVerify)
+        return verify(table, prom);
+
+    std::vector<Breakpoint> edges;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < TIMING_PASSES; pass++)
+        edges = columnIndexBreakpoints(table);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("\n Period     RPM    Bracket   X005C\n");
+    printf("---------------------------------------\n");
+
+    for (size_t i = 0; i < edges.size(); i++)
+        printf(" 0x%04X  %7.1f    0x%02X->0x%02X  0x%02X->0x%02X\n", edges[i].input,
+          periodToRpm(edges[i].input), edges[i].before >> 8, edges[i].after >> 8,
+          edges[i].before & 0xFF, edges[i].after & 0xFF);
+
+    std::vector<Breakpoint> problems;
+    UINT16 firstPeriod = (UINT16)(7500000.0 / rpmHigh);
+    UINT16 lastPeriod = (UINT16)(7500000.0 / rpmLow);
+    UINT32 count = certifyColumnIndex(edges, firstPeriod, lastPeriod, table, &problems);
+
+    printf("\n%u edges found in %.1f us\n", (UINT32)edges.size(), seconds * 1e6 / TIMING_PASSES);
+
+    for (size_t i = 0; i < problems.size(); i++) {
+        if (problems[i].before == problems[i].after)
+            printf("  from %7.1f RPM down: X005C 0x%02X does not match bracket 0x%02X\n",
+              periodToRpm(problems[i].input), problems[i].after & 0xFF, problems[i].after >> 8);
+        else
+            printf("  at %7.1f RPM: X005C rises from 0x%02X to 0x%02X as RPM drops\n",
+              periodToRpm(problems[i].input), problems[i].before & 0xFF, problems[i].after & 0xFF);
+    }
+
+    printf("%u to %u RPM: %s\n", rpmLow, rpmHigh, count ? "NOT monotonic" : "monotonic, nibbles match brackets");
+
+    return count ? 2 : 0;
+}
@@ -0,0 +1,285 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Closed Loop Co-Simulation
+//
+//  Runs drive scripts through the ECU models and the engine plant together (see
+//  ../Common/CoSimulation.h), in place of the function generator rig in simulator.asm.
+//  Each script is an independent run; the runs are spread over the worker threads and
+//  each one writes its own tab delimited log (<script>.sim.txt, one line per -log ms).
+//
+//  A script is a text file with one point per line (time in s, throttle in %, load torque
+//  in Nm, coolant temperature in deg C) that is interpolated between points:
+//
+//      # time  throttle  load  coolant
+//      0       0         0     85
+//      5       35        90    85
+//
+//  With no scripts given, three built in ones are run: idle, tipIn and driveCycle.
+//  -repeat runs every script several times over (for throughput, and as a check that the
+//  runs are deterministic: the copies must match exactly).
+//
+//  Usage: CoSim [-tune <bin>] [-map <n>] [-threads <n>] [-step <us>] [-log <ms>]
+//               [-repeat <n>] [-nolog] [script ...]
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/FuelSurface.h"
+#include "../Common/CoolantFueling.h"
+#include "../Common/CoSimulation.h"
+
+
+#define MAF_LINEAR_PER_GS   88.0           // linearMAF counts per g/s of air
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Built in scripts
+//
+///////////////////////////////////////////////////////////////////////////////
+static void builtInScripts (std::vector<DriveScript> &scripts)
+{
+    DriveScript idle, tipIn, cycle;
+
+    idle.name = "idle";
+    idle.add(0.0, 0, 0, 85);
+    idle.add(20.0, 0, 0, 85);
+
+    tipIn.name = "tipIn";
+    tipIn.add(0.0, 0, 0, 85);
+    tipIn.add(2.0, 0, 0, 85);
+    tipIn.add(2.5, 40, 80, 85);
+    tipIn.add(10.0, 40, 80, 85);
+    tipIn.add(10.5, 0, 0, 85);
+    tipIn.add(15.0, 0, 0, 85);
+
+    // pull away, cruise, a hard acceleration, lift off and back to idle, warming up
+    cycle.name = "driveCycle";
+    cycle.add(0.0, 0, 0, 40);
+    cycle.add(5.0, 0, 0, 45);
+    cycle.add(7.0, 20, 60, 47);
+    cycle.add(20.0, 25, 90, 55);
+    cycle.add(40.0, 25, 95, 65);
+    cycle.add(42.0, 80, 200, 66);
+    cycle.add(50.0, 80, 230, 70);
+    cycle.add(51.0, 5, 40, 70);
+    cycle.add(70.0, 15, 70, 78);
+    cycle.add(90.0, 15, 70, 84);
+    cycle.add(92.0, 0, 0, 85);
+    cycle.add(120.0, 0, 0, 88);
+
+    scripts.push_back(idle);
+    scripts.push_back(tipIn);
+    scripts.push_back(cycle);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Worker threads take runs (script x repeat) in order from a shared counter
+//
+///////////////////////////////////////////////////////////////////////////////
+struct CoSimJobs
+{
+    const std::vector<DriveScript> *scripts;
+    const FuelModel    *model;
+    UINT16              mapMultiplier;
+    CoolantTables       coolant;
+    const MafSensor    *sensor;
+    PlantParams         plant;
+    CoSimConfig         config;
+    unsigned            repeat;
+    bool                writeLogs;
+
+    std::atomic<unsigned>       next;
+    std::vector<CoSimResult>    results;    // one per run
+};
+
+static std::string logName (const std::string &script)
+{
+    std::string name = script;
+    size_t slash = name.find_last_of("/\\");
+
+    if (slash != std::string::npos)
+        name = name.substr(slash + 1);
+
+    return name + ".sim.txt";
+}
+
+static void simWorker (CoSimJobs *jobs)
+{
+    CoSimulation sim(*jobs->model, jobs->mapMultiplier, jobs->coolant, *jobs->sensor, jobs->plant,
+                     jobs->config);
+    unsigned runs = (unsigned)jobs->results.size();
+
+    for (unsigned run = jobs->next++; run < runs; run = jobs->next++) {
+
+        const DriveScript &script = (*jobs->scripts)[run / jobs->repeat];
+        FILE *log = 0;
+
+        // only the first copy of a script writes the log
+        if (jobs->writeLogs && run % jobs->repeat == 0) {
+            std::string name = logName(script.name);
+            if (!(log = fopen(name.c_str(), "w")))
+                printf("Could not open %s for writing\n", name.c_str());
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        CoSimResult r = sim.run(script, log);
+
+        r.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        jobs->results[run] = r;
+
+        if (log)
+            fclose(log);
+    }
+}
+
+static bool sameResult (const CoSimResult &a, const CoSimResult &b)
+{
+    return a.events == b.events && a.sparks == b.sparks && a.injections == b.injections &&
+           a.fuelGrams == b.fuelGrams && a.minRpm == b.minRpm && a.maxRpm == b.maxRpm &&
+           a.meanLambda == b.meanLambda && a.stalled == b.stalled;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    TuneImage tune;
+    const char *tuneName = "../../OriginalCode/Reference_Bins/R3526.bin";
+    std::vector<DriveScript> scripts;
+    CoSimConfig config = defaultCoSimConfig();
+    int mapNumber = -1;
+    unsigned threads = 0, repeat = 1;
+    bool writeLogs = true;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-tune") == 0 && arg + 1 < argc)
+            tuneName = argv[++arg];
+        else if (strcmp(argv[arg], "-map") == 0 && arg + 1 < argc)
+            mapNumber = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-threads") == 0 && arg + 1 < argc)
+            threads = (unsigned)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-step") == 0 && arg + 1 < argc)
+            config.plantStepUs = (UINT32)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-log") == 0 && arg + 1 < argc)
+            config.logUs = (UINT32)(atof(argv[++arg]) * 1000.0);
+        else if (strcmp(argv[arg], "-repeat") == 0 && arg + 1 < argc)
+            repeat = (unsigned)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-nolog") == 0)
+            writeLogs = false;
+        else if (argv[arg][0] == '-') {
+            printf("Usage: CoSim [-tune <bin>] [-map <n>] [-threads <n>] [-step <us>] [-log <ms>]\n");
+            printf("             [-repeat <n>] [-nolog] [script ...]\n");
+            return 1;
+        }
+        else {
+            DriveScript script;
+            if (!script.load(argv[arg]))
+                return 1;
+            scripts.push_back(script);
+        }
+    }
+
+    if (!tune.open(tuneName))
+        return 1;
+
+    if (config.plantStepUs == 0 || repeat == 0) {
+        printf("The plant step and repeat count must be at least 1\n");
+        return 1;
+    }
+
+    if (mapNumber < 0)
+        mapNumber = tune.defaultFuelMap();
+
+    if (scripts.empty())
+        builtInScripts(scripts);
+
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+
+    FuelModel model(tune, mapNumber);
+    MafSensor sensor(model.constants(), MAF_LINEAR_PER_GS);
+    CoSimJobs jobs;
+
+    jobs.scripts = &scripts;
+    jobs.model = &model;
+    jobs.mapMultiplier = tune.mapMultiplier(mapNumber);
+    loadCoolantTables(tune, mapNumber, jobs.coolant);
+    jobs.sensor = &sensor;
+    jobs.plant = defaultPlantParams();
+    jobs.config = config;
+    jobs.repeat = repeat;
+    jobs.writeLogs = writeLogs;
+    jobs.next = 0;
+    jobs.results.resize(scripts.size() * repeat);
+
+    printf("Using %s (tune %04X), fuel map %d, multiplier $%04X, %u runs on %u threads\n\n",
+      tune.name(), tune.tuneNumber(), mapNumber, jobs.mapMultiplier, (unsigned)jobs.results.size(),
+      threads);
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+        workers.push_back(std::thread(simWorker, &jobs));
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double simSeconds = 0.0;
+    UINT64 events = 0;
+    bool deterministic = true;
+
+    printf("Script            Sim s   Events    Sparks  RPM min-max   Lambda min/mean/max  Rich s  Lean s  Fuel g  x Real time\n");
+    printf("-------------------------------------------------------------------------------------------------------------------\n");
+
+    for (size_t s = 0; s < scripts.size(); s++) {
+
+        const CoSimResult &r = jobs.results[s * repeat];
+
+        printf("%-16s %6.1f %8llu %9llu  %5.0f-%-5.0f   %5.2f /%5.2f /%5.2f  %6.1f  %6.1f  %6.1f  %10.0f",
+          logName(scripts[s].name).substr(0, logName(scripts[s].name).size() - 8).c_str(),
+          r.simSeconds, (unsigned long long)r.events, (unsigned long long)r.sparks,
+          r.minRpm, r.maxRpm, r.minLambda, r.meanLambda, r.maxLambda, r.richSeconds,
+          r.leanSeconds, r.fuelGrams, r.wallSeconds ? r.simSeconds / r.wallSeconds : 0.0);
+
+        if (r.stalled)
+            printf("  stalled at %.2f s", r.stallTime);
+        printf("\n");
+
+        for (unsigned c = 0; c < repeat; c++) {
+            const CoSimResult &copy = jobs.results[s * repeat + c];
+            simSeconds += copy.simSeconds;
+            events += copy.events;
+            if (!sameResult(r, copy))
+                deterministic = false;
+        }
+    }
+
+    printf("\n%.0f simulated seconds, %llu events in %.2f s (%.0f x real time overall)\n",
+      simSeconds, (unsigned long long)events, seconds, seconds ? simSeconds / seconds : 0.0);
+
+    if (repeat > 1)
+        printf("Repeated runs %s\n", deterministic ? "match" : "DIFFER");
+
+    return deterministic ? 0 : 2;
+}
@@ -0,0 +1,318 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Compile Time Tables
+//
+//  The MAF linearization and the RPM table column index only depend on the input (the MAF
+//  sum or the ignition period) and a few bytes of the tune. MafLinearizeBatch.h and
+//  ColumnIndexTable.h work them out for every input when a program starts. For a build
+//  that only ever looks at one tune, the same tables can be worked out by the compiler
+//  instead and end up in the program's read-only data.
+//
+//  linearizeMAF_cx() and getColumnIndex_cx() are the same 6803 code as linearizeMAF_6803()
+//  (MafRowIndex.h) and getColumnIndex() (RpmColumnIndex.h), one line per instruction, but
+//  written against the constexpr register model in Ops6803.h. Two things are different
+//  from the literal models:
+//
+//    - A constexpr function can't use goto, so the loops and branches are written as
+//      for/if blocks. The label each one stands for is in the comments.
+//
+//    - Running getColumnIndex_cx() for all 65536 periods is far more than the compilers
+//      will evaluate by default (-fconstexpr-ops-limit in GCC, -fconstexpr-steps in
+//      Clang). But X005C only depends on the row the loop stops on and the byte that ends
+//      up in B for the 'mul' at LEB15, so BakedColumnTable runs the code from LEB15 on for
+//      the 256 values of B in each row (4096 runs), and for each period just finds the
+//      row (the first one whose entry is >= the period, which only moves down the table
+//      as the period goes up) and picks B out of the remainder the way LEAF5 to LEB15 do.
+//      bakedColumnTable is checked against getColumnIndex_cx() at every row boundary by a
+//      static_assert, and against getColumnIndex() for every period by the Baked_Tables
+//      tool.
+//
+//  The tune is a BakedTune: the two MAF constants and the RPM table. bakedTune is R3526
+//  unless CUX_BAKED_TUNE_HEADER names a header that defines another one (BakedTables -emit
+//  writes one from an image):
+//
+//      g++ -std=c++14 -DCUX_BAKED_TUNE_HEADER='"R3652_baked.h"' ...
+//
+//  BakedColumnTable entries have the same layout as ColumnIndexTable (bracket in the upper
+//  byte, X005C in the lower byte) and are aligned the same way, so a ColumnIndexTable can
+//  attach() to them and be used by the existing code.
+//
+//  This needs C++14.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BAKED_TABLES_H
+#define BAKED_TABLES_H
+
+#include "CuxTypes.h"
+#include "Ops6803.h"
+#include "TuneImage.h"
+#include "ColumnIndexTable.h"
+
+
+#define BAKED_MAF_SUMS          2048        // 11 bits (the sum of two 10-bit readings is at most 2046)
+
+
+struct BakedTune
+{
+    const char *name;
+    UINT16      XC1C3;                      // added to 8 x MAF sum
+    UINT16      XC1C5;                      // subtracted after the 1st squaring
+    UCHAR       rpmTable[RPM_TABLE_SIZE];   // as at $C800
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  linearizeMAF_cx
+//
+//  .linearizeMaf, as in MafRowIndex.h. X00C8/C9 and X00CE are local bytes.
+//
+///////////////////////////////////////////////////////////////////////////////
+constexpr UINT16 linearizeMAF_cx (UINT16 mafSum, UINT16 XC1C3, UINT16 XC1C5)
+{
+    Acc6803 cpu;
+    UINT8   X00C8 = (UINT8)(mafSum >> 8);
+    UINT8   X00C9 = (UINT8)mafSum;
+    UINT8   X00CE = 0;                      // cleared at LDCEB
+
+    cpu.ldd((UINT16)((X00C8 << 8) | X00C9));        // ldd   $00C8
+    cpu.asld();                                     // asld
+    cpu.asld();                                     // asld
+    cpu.asld();                                     // asld
+    cpu.addd(XC1C3);                                // addd  $C1C3
+
+    for (;;) {                                      // .linMafLoop
+        X00C8 = cpu.a;                              // staa  $00C8
+        cpu.mul();                                  // mul
+        X00C9 = cpu.a;                              // staa  $00C9
+        cpu.ldaa(X00C8);                            // ldaa  $00C8
+        cpu.tab();                                  // tab
+        cpu.mul();                                  // mul
+        cpu.addb(X00C9);                            // addb  $00C9
+        cpu.adca(0x00);                             // adca  #$00
+        cpu.addb(X00C9);                            // addb  $00C9
+        cpu.adca(0x00);                             // adca  #$00
+
+        cpu.com(X00CE);                             // com   $00CE
+        if (cpu.beq())                              // beq   .LDF30
+            break;
+        cpu.asld();                                 // asld
+        cpu.subd(XC1C5);                            // subd  $C1C5
+        if (!cpu.bcc())                             // bcc   .LDF2D
+            cpu.ldd(0x0000);                        // ldd   #$0000
+        cpu.asld();                                 // .LDF2D  asld
+    }                                               // bra   .linMafLoop
+
+    return cpu.d();                                 // .LDF30  std $00CA, std mafLinear
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  getColumnIndex_cx
+//
+//  LEADB, as in RpmColumnIndex.h. The table is the 64 bytes at $C800 and X
+//  holds the 6803 address, so $02,x is table[x - $C800 + 2].
+//
+//  columnIndexFrom_LEAF5() is the part after the loop, entered with the table
+//  entry minus the period in D, X at the row and the row counter in X00CA.
+//  columnIndexFrom_LEB15() is the last few instructions, entered with the byte
+//  to multiply by in B and the row in the upper nibble of X00CA.
+//
+///////////////////////////////////////////////////////////////////////////////
+constexpr UCHAR columnIndexFrom_LEB15 (Acc6803 &cpu, UINT8 X00CA, const UCHAR *table)
+{
+    const UCHAR *row = table + (cpu.x - ADDR_RPM_TABLE);
+
+    cpu.ldaa(row[3]);                               // LEB15  ldaa $03,x
+    cpu.mul();                                      // mul
+    cpu.oraa(X00CA);                                // oraa  X00CA
+
+    return cpu.a;                                   // staa  X005C
+}
+
+constexpr UCHAR columnIndexFrom_LEAF5 (Acc6803 &cpu, UINT8 X00CA, UCHAR &bracket, const UCHAR *table)
+{
+    const UCHAR *row = table + (cpu.x - ADDR_RPM_TABLE);
+    UINT8 X00C8 = cpu.a;                            // std   X00C8
+    UINT8 X00C9 = cpu.b;
+
+    cpu.ldaa(X00CA);                                // ldaa  X00CA
+    cpu.asla();                                     // asla
+    cpu.asla();                                     // asla
+    cpu.asla();                                     // asla
+    cpu.asla();                                     // asla
+    X00CA = cpu.a;                                  // staa  X00CA
+    bracket = X00CA;                                // (returned as the bracket)
+
+    cpu.ldaa(row[2]);                               // ldaa  $02,x
+    if (cpu.bmi()) {                                // bpl   LEB0B
+        cpu.ldd((UINT16)((X00C8 << 8) | X00C9));    // ldd   X00C8
+        cpu.lsrd();                                 // lsrd
+        cpu.lsrd();                                 // lsrd
+        cpu.lsrd();                                 // lsrd
+        cpu.lsrd();                                 // lsrd
+    }                                               // bra   LEB15
+    else {
+        cpu.bita(0x40);                             // LEB0B  bita #$40
+        if (cpu.bne())                              // beq   LEB13
+            cpu.ldab(X00C8);                        // ldab  X00C8
+        else
+            cpu.ldab(X00C9);                        // LEB13  ldab X00C9
+    }
+
+    return columnIndexFrom_LEB15(cpu, X00CA, table);
+}
+
+constexpr UCHAR getColumnIndex_cx (UINT16 X007A, UCHAR &bracket, const UCHAR *table)
+{
+    Acc6803 cpu;
+    UINT8   X00CA = 0;
+
+    cpu.ldx(ADDR_RPM_TABLE);                        // ldx   #$C800
+    cpu.ldaa(0x0F);                                 // ldaa  #$0F
+    X00CA = cpu.a;                                  // staa  X00CA
+
+    do {                                            // LEAE2
+        const UCHAR *row = table + (cpu.x - ADDR_RPM_TABLE);
+        cpu.ldd((UINT16)((row[0] << 8) | row[1]));  // ldd   $00,x
+        cpu.subd(X007A);                            // subd  X007A
+        if (cpu.bcc())                              // bcc   LEAF5
+            return columnIndexFrom_LEAF5(cpu, X00CA, bracket, table);
+        cpu.ldab(0x04);                             // ldab  #$04
+        cpu.abx();                                  // abx
+        cpu.dec(X00CA);                             // dec   X00CA
+    } while (cpu.bpl());                            // bpl   LEAE2
+
+    return 0;                                       // clr   X005C (bracket not changed)
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  The tables
+//
+///////////////////////////////////////////////////////////////////////////////
+struct BakedMafTable
+{
+    UINT16 value[BAKED_MAF_SUMS];
+
+    constexpr explicit BakedMafTable (const BakedTune &tune) : value()
+    {
+        for (UINT32 mafSum = 0; mafSum < BAKED_MAF_SUMS; mafSum++)
+            value[mafSum] = linearizeMAF_cx((UINT16)mafSum, tune.XC1C3, tune.XC1C5);
+    }
+
+    constexpr UINT16 operator[] (UINT16 mafSum) const { return value[mafSum]; }
+};
+
+struct BakedColumnTable
+{
+    alignas(CACHE_LINE_SIZE) UINT16 entry[PERIOD_COUNT_16BIT];
+
+    constexpr explicit BakedColumnTable (const BakedTune &tune) : entry()
+    {
+        const UCHAR *table = tune.rpmTable;
+        UCHAR fromB[256] = {};
+        UINT32 row = 0, fromRow = RPM_TABLE_SIZE / 4;
+
+        for (UINT32 period = 0; period < PERIOD_COUNT_16BIT; period++) {
+
+            // first row with an entry >= period (the row the loop exits on)
+            while (row < RPM_TABLE_SIZE / 4 && (UINT32)((table[4 * row] << 8) | table[4 * row + 1]) < period)
+                row++;
+
+            if (row == RPM_TABLE_SIZE / 4) {
+                entry[period] = 0;                  // below the table, X005C cleared
+                continue;
+            }
+
+            const UCHAR *r = table + 4 * row;
+            UINT8 bracket = (UINT8)((0x0F - row) << 4);
+
+            // X005C for each value of B in this row
+            if (fromRow != row) {
+                for (UINT32 b = 0; b < 256; b++) {
+                    Acc6803 cpu;
+                    cpu.ldx((UINT16)(ADDR_RPM_TABLE + 4 * row));
+                    cpu.ldab((UINT8)b);
+                    fromB[b] = columnIndexFrom_LEB15(cpu, bracket, table);
+                }
+                fromRow = row;
+            }
+
+            // the remainder (X00C8/C9) and the byte of it LEAF5 to LEB15 leave in B
+            UINT16 remainder = (UINT16)(((r[0] << 8) | r[1]) - period);
+            UINT8 b = (r[2] & 0x80) ? (UINT8)(remainder >> 4) :     // lsrd x 4
+                      (r[2] & 0x40) ? (UINT8)(remainder >> 8) :     // ldab X00C8
+                                      (UINT8)remainder;             // ldab X00C9
+
+            entry[period] = (UINT16)((bracket << 8) | fromB[b]);
+        }
+    }
+
+    constexpr UCHAR colIndex (UINT16 period) const { return (UCHAR)entry[period]; }
+    constexpr UCHAR bracket (UINT16 period) const { return (UCHAR)(entry[period] >> 8); }
+    constexpr UINT16 lookup (UINT16 period) const { return entry[period]; }
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  The tune built in
+//
+///////////////////////////////////////////////////////////////////////////////
+#ifdef CUX_BAKED_TUNE_HEADER
+#include CUX_BAKED_TUNE_HEADER
+#else
+constexpr BakedTune bakedTune = {
+    "R3526.bin", 0x225D, 0x09C0,
+    {
+        0x05, 0x53, 0x40, 0x00,  0x06, 0x2A, 0x00, 0x13,  0x07, 0x25, 0x00, 0x10,  0x07, 0xD0, 0x00, 0x18,
+        0x09, 0x73, 0x80, 0x9C,  0x0A, 0xD9, 0x80, 0xB7,  0x0E, 0xA6, 0x80, 0x43,  0x10, 0xBD, 0x80, 0x7A,
+        0x14, 0xED, 0x80, 0x3D,  0x1A, 0xA2, 0x80, 0x2C,  0x20, 0x8D, 0x80, 0x2B,  0x25, 0x8F, 0x80, 0x33,
+        0x29, 0xDA, 0x80, 0x3B,  0x2F, 0x40, 0x80, 0x2F,  0x3D, 0x09, 0x80, 0x12,  0x92, 0x7C, 0x40, 0x2F
+    }
+};
+#endif
+
+constexpr BakedMafTable    bakedMafTable(bakedTune);
+constexpr BakedColumnTable bakedColumnTable(bakedTune);
+
+// bakedColumnTable against the whole routine at the periods either side of each row's entry
+constexpr bool bakedColumnsMatch (const BakedColumnTable &baked, const BakedTune &tune)
+{
+    for (int row = 0; row < RPM_TABLE_SIZE / 4; row++) {
+        UINT32 entry = (UINT32)((tune.rpmTable[4 * row] << 8) | tune.rpmTable[4 * row + 1]);
+
+        for (UINT32 period = (entry > 0) ? entry - 1 : 0; period <= entry + 1 && period < PERIOD_COUNT_16BIT; period++) {
+            UCHAR bracket = 0;
+            UCHAR colIndex = getColumnIndex_cx((UINT16)period, bracket, tune.rpmTable);
+
+            if (baked.lookup((UINT16)period) != (UINT16)((bracket << 8) | colIndex))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static_assert(bakedColumnsMatch(bakedColumnTable, bakedTune), "bakedColumnTable differs from getColumnIndex_cx()");
+
+// True if the image has the same MAF constants and RPM table as bakedTune
+inline bool bakedTuneMatches (const TuneImage &tune)
+{
+    const UCHAR *rpm = tune.rpmTable();
+
+    if (tune.wordAt(ADDR_MAF_OFFSET) != bakedTune.XC1C3 || tune.wordAt(ADDR_MAF_SUBTRACT) != bakedTune.XC1C5)
+        return false;
+
+    for (int i = 0; i < RPM_TABLE_SIZE; i++)
+        if (rpm[i] != bakedTune.rpmTable[i])
+            return false;
+
+    return true;
+}
+
+#endif // BAKED_TABLES_H
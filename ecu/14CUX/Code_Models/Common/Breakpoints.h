@@ -0,0 +1,317 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Code Models - Breakpoint Discovery
+//
+//  The row and column index models are piecewise constant over their 16-bit inputs, so
+//  everything about them (smoothness, monotonicity, where a table edit has an effect) is
+//  in the list of inputs where the output changes. This finds that list exactly without
+//  evaluating every input.
+//
+//  The search works on a "key" that is monotone over each piece of the input range and
+//  that the output is a function of. Within a piece, if the key is the same at both ends
+//  it is the same everywhere in between, so the piece can be skipped; otherwise it is
+//  split in half until the change is pinned to two adjacent inputs. The cost is about
+//  (number of edges x 16) evaluations instead of 65536.
+//
+//      Calculate_Row_Index     monotone in the ignition period (for a fixed linearized MAF)
+//                              over the whole range, so the key is the row index itself.
+//
+//      getColumnIndex          the period selects a table row (bracket) and the remainder
+//                              (row period - X007A) is scaled by the 4th column. The scaled
+//                              value is monotone until the byte it is taken from wraps, but
+//                              the final index is that value ORed with the bracket nibble,
+//                              which is not monotone. So the key is the scaled value and the
+//                              pieces are split at every bracket change and byte wrap.
+//                              columnIndexPieces() works these out from the table.
+//
+//  The edges are checked against a brute force scan by Breakpoint_Sweep/BreakpointSweep.cpp.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BREAKPOINTS_H
+#define BREAKPOINTS_H
+
+#include <algorithm>
+#include <vector>
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+#include "MafRowIndex.h"
+#include "RpmColumnIndex.h"
+
+
+#define INPUT_LAST_16BIT        0xFFFF
+
+
+struct Breakpoint
+{
+    UINT32  input;                          // first input with the new value
+    UINT32  before;                         // value at (input - 1)
+    UINT32  after;                          // value at input
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Generic search
+//
+///////////////////////////////////////////////////////////////////////////////
+template <class KeyFn, class ValueFn>
+void refinePiece (const KeyFn &key, const ValueFn &value, UINT32 lo, UINT32 hi,
+                  UINT32 keyLo, UINT32 keyHi, std::vector<Breakpoint> &edges)
+{
+    if (keyLo == keyHi)
+        return;                             // constant over [lo, hi]
+
+    if (hi - lo == 1) {
+        Breakpoint bp;
+        bp.input = hi;
+        bp.before = value(lo);
+        bp.after = value(hi);
+        if (bp.before != bp.after)
+            edges.push_back(bp);
+        return;
+    }
+
+    UINT32 mid = lo + (hi - lo) / 2;
+    UINT32 keyMid = key(mid);
+
+    refinePiece(key, value, lo, mid, keyLo, keyMid, edges);
+    refinePiece(key, value, mid, hi, keyMid, keyHi, edges);
+}
+
+// Finds every input in (first, last] where value() changes. key() must be monotone over
+// each piece; pieceStart holds the first input of each piece (in any order).
+template <class KeyFn, class ValueFn>
+std::vector<Breakpoint> findBreakpoints (const KeyFn &key, const ValueFn &value,
+                                         std::vector<UINT32> pieceStart, UINT32 first, UINT32 last)
+{
+    std::vector<Breakpoint> edges;
+
+    pieceStart.push_back(first);
+    std::sort(pieceStart.begin(), pieceStart.end());
+    pieceStart.erase(std::unique(pieceStart.begin(), pieceStart.end()), pieceStart.end());
+
+    for (size_t i = 0; i < pieceStart.size(); i++) {
+
+        UINT32 start = pieceStart[i];
+        UINT32 end = (i + 1 < pieceStart.size()) ? pieceStart[i + 1] - 1 : last;
+
+        if (start < first || start > last)
+            continue;
+        if (end > last)
+            end = last;
+
+        if (start > first) {                // the step into this piece
+            Breakpoint bp;
+            bp.input = start;
+            bp.before = value(start - 1);
+            bp.after = value(start);
+            if (bp.before != bp.after)
+                edges.push_back(bp);
+        }
+
+        if (end > start)
+            refinePiece(key, value, start, end, key(start), key(end), edges);
+    }
+
+    return edges;
+}
+
+// Reference version: evaluates every input
+template <class ValueFn>
+std::vector<Breakpoint> scanBreakpoints (const ValueFn &value, UINT32 first, UINT32 last)
+{
+    std::vector<Breakpoint> edges;
+    UINT32 previous = value(first);
+
+    for (UINT32 input = first + 1; input <= last && input > first; input++) {
+        UINT32 current = value(input);
+        if (current != previous) {
+            Breakpoint bp;
+            bp.input = input;
+            bp.before = previous;
+            bp.after = current;
+            edges.push_back(bp);
+        }
+        previous = current;
+    }
+
+    return edges;
+}
+
+inline bool sameBreakpoints (const std::vector<Breakpoint> &a, const std::vector<Breakpoint> &b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    for (size_t i = 0; i < a.size(); i++)
+        if (a[i].input != b[i].input || a[i].before != b[i].before || a[i].after != b[i].after)
+            return false;
+
+    return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Column index (getColumnIndex)
+//
+//  The value is (bracket << 8) | X005C, the same as ColumnIndexTable::lookup(),
+//  with the bracket taken as zero when the period is past the end of the table.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT16 rpmTableEntry (const UCHAR *table, int row)
+{
+    return (UINT16)((table[4 * row] << 8) | table[4 * row + 1]);
+}
+
+inline UINT32 columnIndexValue (Cpu6803 &cpu, UINT16 period, const UCHAR *table)
+{
+    UCHAR bracket = 0;
+    UCHAR colIndex = getColumnIndex(cpu, period, &bracket, table);
+
+    return (UINT32)((bracket << 8) | colIndex);
+}
+
+// The scaled remainder before it is ORed with the bracket nibble
+inline UINT32 columnIndexKey (UINT16 period, const UCHAR *table)
+{
+    for (int row = 0; row < 16; row++) {
+
+        UINT16 entry = rpmTableEntry(table, row);
+
+        if (entry >= period) {
+            UINT16 delta = (UINT16)(entry - period);
+            UCHAR control = table[4 * row + 2];
+            UINT16 scaled;
+
+            if (control & 0x80)
+                scaled = (delta >> 4) & 0xFF;
+            else if (control & 0x40)
+                scaled = delta >> 8;
+            else
+                scaled = delta & 0xFF;
+
+            return (table[4 * row + 3] * scaled) >> 8;
+        }
+    }
+
+    return 0;                               // past the end of the table
+}
+
+// First period of each range where columnIndexKey() is monotone
+inline std::vector<UINT32> columnIndexPieces (const UCHAR *table)
+{
+    std::vector<UINT32> starts;
+    long covered = -1;                      // highest period already taken by a row
+
+    for (int row = 0; row < 16; row++) {
+
+        long entry = rpmTableEntry(table, row);
+        UCHAR control = table[4 * row + 2];
+
+        if (entry <= covered)
+            continue;                       // shadowed by an earlier row
+
+        starts.push_back((UINT32)(covered + 1));
+
+        // the remainder byte wraps every 256 (or 4096 when shifted by 4)
+        if (!(control & 0x40) || (control & 0x80)) {
+            long wrap = (control & 0x80) ? 4096 : 256;
+            for (long p = entry - wrap + 1; p > covered + 1; p -= wrap)
+                starts.push_back((UINT32)p);
+        }
+
+        covered = entry;
+    }
+
+    if (covered < INPUT_LAST_16BIT)
+        starts.push_back((UINT32)(covered + 1));
+
+    return starts;
+}
+
+// Every change of the column index (and bracket) over the whole period range
+inline std::vector<Breakpoint> columnIndexBreakpoints (const UCHAR *table)
+{
+    Cpu6803 cpu;
+
+    return findBreakpoints(
+        [table](UINT32 p) { return columnIndexKey((UINT16)p, table); },
+        [table, &cpu](UINT32 p) { return columnIndexValue(cpu, (UINT16)p, table); },
+        columnIndexPieces(table), 0, INPUT_LAST_16BIT);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Row index (Calculate_Row_Index), along the period for one linearized MAF
+//
+///////////////////////////////////////////////////////////////////////////////
+inline std::vector<Breakpoint> rowIndexBreakpoints (UINT16 linearMAF, const PromConstants &prom)
+{
+    Cpu6803 cpu;
+    auto value = [linearMAF, &prom, &cpu](UINT32 p) {
+        return (UINT32)Calculate_Row_Index(cpu, (UINT16)p, linearMAF, prom);
+    };
+
+    return findBreakpoints(value, value, std::vector<UINT32>(), 0, INPUT_LAST_16BIT);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  certifyColumnIndex
+//
+//  Checks the "smooth monotonic function" goal from RpmTable.cpp between two
+//  periods: going up in RPM (down in period) the column index must never
+//  drop, and its upper nibble must match the bracket. Returns the number of
+//  problems and lists them in problems (each entry is the period where the
+//  problem starts).
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT32 certifyColumnIndex (const std::vector<Breakpoint> &edges, UINT16 firstPeriod,
+                                  UINT16 lastPeriod, const UCHAR *table,
+                                  std::vector<Breakpoint> *problems = 0)
+{
+    Cpu6803 cpu;
+    UINT32 count = 0;
+    UINT32 value = columnIndexValue(cpu, firstPeriod, table);
+    UINT32 segmentStart = firstPeriod;
+    size_t e = 0;
+
+    while (e < edges.size() && edges[e].input <= firstPeriod)
+        e++;
+
+    for (;;) {
+        bool pastTable = rpmTableEntry(table, 15) < segmentStart;
+
+        // nibble check for the segment starting at segmentStart
+        if (!pastTable && (value & 0xF0) != ((value >> 8) & 0xF0)) {
+            count++;
+            if (problems) {
+                Breakpoint bp = { segmentStart, value, value };
+                problems->push_back(bp);
+            }
+        }
+
+        if (e >= edges.size() || edges[e].input > lastPeriod)
+            break;
+
+        // higher period is lower RPM, so the column index must not go up
+        if ((edges[e].after & 0xFF) > (edges[e].before & 0xFF)) {
+            count++;
+            if (problems)
+                problems->push_back(edges[e]);
+        }
+
+        value = edges[e].after;
+        segmentStart = edges[e].input;
+        e++;
+    }
+
+    return count;
+}
+
+#endif // BREAKPOINTS_H
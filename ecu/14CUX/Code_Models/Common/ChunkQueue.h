@@ -0,0 +1,55 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Code Models - Chunk Queue
+//
+//  A small blocking FIFO for handing fixed-size work chunks between the stages of a
+//  pipeline. Each stage pops a chunk, does its part and pushes it on to the next stage's
+//  queue. The last stage pushes it back to a "free" queue that the first stage pops from,
+//  so a fixed pool of chunks circulates and memory use does not grow with the input.
+//
+//  push() never blocks, so the capacity is set by the number of chunks in the pool rather
+//  than by the queue. pop() waits until a chunk is available.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CHUNK_QUEUE_H
+#define CHUNK_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+
+template <class T>
+class ChunkQueue
+{
+public:
+    void push (T *chunk)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            items.push_back(chunk);
+        }
+        ready.notify_one();
+    }
+
+    T *pop (void)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (items.empty())
+            ready.wait(lock);
+
+        T *chunk = items.front();
+        items.pop_front();
+
+        return chunk;
+    }
+
+private:
+    std::mutex              mutex;
+    std::condition_variable ready;
+    std::deque<T *>         items;
+};
+
+#endif // CHUNK_QUEUE_H
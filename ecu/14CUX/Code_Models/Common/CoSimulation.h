@@ -0,0 +1,528 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Code Models - Closed Loop Co-Simulation
+//
+//  Software stand-in for the bench rig described in simulator.asm (a pulse generator for
+//  the spark, a second one for road speed and ADC values poked into $2060-$2072). The ECU
+//  models and the engine plant in EnginePlant.h are run together by the discrete event
+//  scheduler in EventScheduler.h, with a drive script setting throttle, load and coolant
+//  temperature over time. Four kinds of event are interleaved:
+//
+//      plant       every plantStepUs: the plant integrates with the script inputs
+//      spark       at every spark (the interval follows the plant's RPM): the spark
+//                  interrupt models run on the measured period and the MAF sum the
+//                  sensor gives for the plant's air flow, and every other spark fires
+//                  an injector bank (right, then left, as the four ICI states)
+//      main loop   every mainLoopUs: sensors are sampled and the fueling compensation
+//                  factor (X00CA/CB going into Phase 1) is worked out
+//      log         every logUs: one line of the run's log
+//
+//  The spark interrupt chain is
+//
+//      linearizeMAF_Scalar, rowIndex_Scalar, ColumnIndexTable, fuelMapValue_C
+//      -> Phase 1 (compensation factor x 4, fuel map multiplier x 2, limits)
+//      -> Phase 4 (mainVoltageAdj)                              ecuInjectorPulse()
+//
+//  with the 3:1 filter, long term trim and the Phase 3 1.25/0.75 adjustment left out (the
+//  trims at neutral). The compensation factor is startupCompensation() (CoolantFueling.h)
+//  with the short term trim at $8000 and the throttle rate at $0400. The script's coolant
+//  temperature goes through ectCountForTemp() and coolantTempAdjust_C(), and X009C is set
+//  by crankingInit_C() at the start of the run and counted down once a second (the bank
+//  startup counters X2020/21 are left at zero). Cranking isn't modelled; a run starts with
+//  the engine running.
+//
+//  Everything runs on one thread in simulated time, so a run is deterministic and many
+//  runs (scenarios) can go on separate threads at once. A FuelModel and a MafSensor can be
+//  shared by all of them.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CO_SIMULATION_H
+#define CO_SIMULATION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+#include "MafLinearizeBatch.h"
+#include "FuelSurface.h"
+#include "EventScheduler.h"
+#include "EnginePlant.h"
+#include "CoolantFueling.h"
+
+
+#define COSIM_MAF_SUM_MAX           2046    // two 10-bit readings
+#define COSIM_ICI_STATES            4       // right fueling, right, left fueling, left
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Fueling arithmetic after the fuel map value
+//
+///////////////////////////////////////////////////////////////////////////////
+// compedFuelingVal from .LE967 (Phase 1) and .LE9F4 (Phase 4), in microseconds
+inline UINT16 ecuInjectorPulse (UINT16 fuelValue, UINT16 compensation, UINT16 mapMultiplier,
+                                UINT16 voltageAdj)
+{
+    UINT32 v = mpy16_C(fuelValue, compensation);
+
+    v <<= 1;                                        // asld / bcs .LE972
+    if (v <= 0xFFFF)
+        v <<= 1;                                    // asld / bcc .LE975
+    if (v > 0xFFFF)
+        v = 0xFFFF;
+
+    v = (UINT32)mpy16_C((UINT16)v, mapMultiplier) << 1;
+    if (v > 0xFFFF)
+        v = 0xFF00;
+
+    v += voltageAdj;
+
+    return (UINT16)((v > 0xFFFF) ? 0xFFFF : v);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  MafSensor
+//
+//  Turns the plant's air flow into the MAF sum that linearizes to it (the
+//  smallest sum that reaches linearPerGs x g/s), so the sensor is always
+//  calibrated to the tune's own linearization.
+//
+///////////////////////////////////////////////////////////////////////////////
+class MafSensor
+{
+public:
+    MafSensor (const PromConstants &prom, double linearPerGs) : scale(linearPerGs),
+        reach(COSIM_MAF_SUM_MAX + 1)
+    {
+        UINT16 highest = 0;
+
+        for (UINT16 sum = 0; sum <= COSIM_MAF_SUM_MAX; sum++) {
+            UINT16 linear = linearizeMAF_Scalar(sum, prom);
+            if (linear > highest)
+                highest = linear;
+            reach[sum] = highest;
+        }
+    }
+
+    UINT16 mafSum (double airFlow) const
+    {
+        double target = airFlow * scale;
+        size_t low = 0, high = COSIM_MAF_SUM_MAX;
+
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (reach[mid] < target)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+
+        return (UINT16)low;
+    }
+
+private:
+    double              scale;
+    std::vector<UINT16> reach;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  DriveScript
+//
+//  Throttle (%), load torque (Nm) and coolant temperature (deg C) against
+//  time (s), interpolated linearly and held after the last point. Text,
+//  one point per line: time throttle load coolant ('#' starts a comment).
+//
+///////////////////////////////////////////////////////////////////////////////
+struct DrivePoint
+{
+    double  time;
+    PlantInputs in;
+};
+
+class DriveScript
+{
+public:
+    std::string             name;
+    std::vector<DrivePoint> points;
+
+    void add (double time, double throttlePercent, double load, double coolant)
+    {
+        DrivePoint p;
+
+        p.time = time;
+        p.in.throttle = throttlePercent / 100.0;
+        p.in.loadTorque = load;
+        p.in.coolantTemp = coolant;
+
+        points.push_back(p);
+    }
+
+    bool load (const char *path)
+    {
+        FILE *fptr = fopen(path, "r");
+        char line[256];
+
+        if (!fptr) {
+            printf("Could not open %s\n", path);
+            return false;
+        }
+
+        name = path;
+        points.clear();
+
+        while (fgets(line, sizeof(line), fptr)) {
+            double t, throttle, load, coolant;
+            if (line[0] != '#' && sscanf(line, "%lf %lf %lf %lf", &t, &throttle, &load, &coolant) == 4) {
+                if (!points.empty() && t < points.back().time) {
+                    printf("%s: times must not go backwards (%.3f)\n", path, t);
+                    fclose(fptr);
+                    return false;
+                }
+                add(t, throttle, load, coolant);
+            }
+        }
+
+        fclose(fptr);
+
+        if (points.empty())
+            printf("%s: no points\n", path);
+
+        return !points.empty();
+    }
+
+    double duration (void) const        { return points.empty() ? 0.0 : points.back().time; }
+
+    PlantInputs at (double t) const
+    {
+        size_t i = 0;
+
+        while (i + 1 < points.size() && points[i + 1].time <= t)
+            i++;
+
+        if (i + 1 >= points.size() || t <= points[i].time)
+            return points[i].in;
+
+        const PlantInputs &a = points[i].in, &b = points[i + 1].in;
+        double f = (t - points[i].time) / (points[i + 1].time - points[i].time);
+        PlantInputs in;
+
+        in.throttle = a.throttle + f * (b.throttle - a.throttle);
+        in.loadTorque = a.loadTorque + f * (b.loadTorque - a.loadTorque);
+        in.coolantTemp = a.coolantTemp + f * (b.coolantTemp - a.coolantTemp);
+
+        return in;
+    }
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  CoSimulation
+//
+///////////////////////////////////////////////////////////////////////////////
+struct CoSimConfig
+{
+    UINT32  plantStepUs;
+    UINT32  mainLoopUs;
+    UINT32  logUs;                          // 0 for no log
+    double  startRpm;
+    UINT16  voltageAdj;                     // mainVoltageAdj (us)
+};
+
+inline CoSimConfig defaultCoSimConfig (void)
+{
+    CoSimConfig c;
+
+    c.plantStepUs = 500;
+    c.mainLoopUs = 10000;
+    c.logUs = 100000;
+    c.startRpm = 750.0;
+    c.voltageAdj = 700;                     // the plant's injector dead time
+
+    return c;
+}
+
+// The ECU's side of the run: RAM the models read and write
+struct EcuState
+{
+    // main loop
+    double  throttle;                       // sampled sensors
+    double  coolantTemp;
+    UINT8   ectCount;                       // coolantTempCount
+    UINT8   coolantTempAdjust;
+    UINT8   X009C;                          // startup fuel, counted down at 1 Hz
+    UINT64  nextCountdown;                  // us
+    UINT16  compensation;                   // X00CA/CB into Phase 1
+
+    // spark interrupt
+    UINT64  lastSpark;                      // us
+    UINT16  ignPeriod;                      // X007A (2 us units)
+    UINT16  mafSum;
+    UINT16  linearMAF;
+    UINT8   rowIndex;                       // fuelMapLoadIdx
+    UCHAR   colIndex;                       // fuelMapSpeedIdx
+    UINT16  fuelValue;
+    UINT16  pulse;                          // compedFuelingVal (us)
+    int     iciState;
+};
+
+struct CoSimResult
+{
+    double  simSeconds;
+    double  wallSeconds;
+    UINT64  events;
+    UINT64  sparks;
+    UINT64  injections;
+    double  fuelGrams;
+    double  minRpm, maxRpm;
+    double  minLambda, maxLambda;
+    double  meanLambda;                     // time weighted, while running
+    double  richSeconds;                    // lambda < 0.85
+    double  leanSeconds;                    // lambda > 1.15
+    bool    stalled;
+    double  stallTime;
+};
+
+enum CoSimEvent
+{
+    COSIM_PLANT,
+    COSIM_SPARK,
+    COSIM_MAIN_LOOP,
+    COSIM_LOG
+};
+
+
+class CoSimulation
+{
+public:
+    CoSimulation (const FuelModel &fuel, UINT16 multiplier, const CoolantTables &tables,
+                  const MafSensor &maf, const PlantParams &plantParams, const CoSimConfig &config) :
+        model(fuel), mapMultiplier(multiplier), coolant(tables), sensor(maf), plant(plantParams),
+        cfg(config), drive(0), logFile(0), lambdaTime(0.0), logLines(0), end(0)
+    {
+        memset(&r, 0, sizeof(r));
+    }
+
+    // Run the script to its end. log may be null.
+    CoSimResult run (const DriveScript &script, FILE *log)
+    {
+        start(script, log);
+        advance(end);
+
+        return finish();
+    }
+
+    // The same run a slice at a time (for a caller that needs the ECU state as it goes,
+    // such as the serial stand-in): start(), then advance() as far as wanted (returns
+    // false once the end of the script is reached), then finish() for the results.
+    void start (const DriveScript &script, FILE *log)
+    {
+        drive = &script;
+        logFile = log;
+        lambdaTime = 0.0;
+        logLines = 0;
+        end = (UINT64)(script.duration() * 1e6 + 0.5);
+
+        memset(&r, 0, sizeof(r));
+        r.minRpm = r.minLambda = 1e9;
+
+        sched.reset();
+        plant.reset(cfg.startRpm, script.at(0.0).throttle);
+        memset(&ecu, 0, sizeof(ecu));
+        powerOn(script);
+        mainLoop(script);
+
+        sched.at(0, COSIM_PLANT);
+        sched.at(0, COSIM_MAIN_LOOP);
+        sched.at((UINT64)plant.sparkInterval(), COSIM_SPARK);
+        if (log && cfg.logUs) {
+            fprintf(log, "time\tthrottle\tload\tcoolant\tect\tcoolantAdj\tX009C\trpm\tairFlow\tlambda\t"
+                         "mafSum\tperiod\tlinearMAF\trowIdx\tcolIdx\tfuelValue\tcomp\tpulse\n");
+            sched.at(0, COSIM_LOG);
+        }
+    }
+
+    bool advance (UINT64 untilUs)
+    {
+        const DriveScript &script = *drive;
+        SimEvent ev;
+
+        if (untilUs > end)
+            untilUs = end;
+
+        while (sched.next(ev, untilUs)) {
+
+            switch (ev.type) {
+
+            case COSIM_PLANT: {
+                double dt = cfg.plantStepUs / 1e6;
+                plant.step(dt, script.at(sched.now() / 1e6));
+
+                if (plant.stalled()) {
+                    if (!r.stalled) {
+                        r.stalled = true;
+                        r.stallTime = sched.now() / 1e6;
+                    }
+                }
+                else {
+                    double l = plant.lambda();
+                    track(r.minRpm, r.maxRpm, plant.rpm());
+                    track(r.minLambda, r.maxLambda, l);
+                    r.meanLambda += l * dt;
+                    lambdaTime += dt;
+                    if (l < 0.85)
+                        r.richSeconds += dt;
+                    if (l > 1.15)
+                        r.leanSeconds += dt;
+                }
+
+                sched.after(cfg.plantStepUs, COSIM_PLANT);
+                break;
+            }
+
+            case COSIM_SPARK:
+                if (plant.stalled())
+                    break;                      // no more sparks
+                if (spark())
+                    r.injections++;
+                r.sparks++;
+                sched.after((UINT64)(plant.sparkInterval() + 0.5), COSIM_SPARK);
+                break;
+
+            case COSIM_MAIN_LOOP:
+                mainLoop(script);
+                sched.after(cfg.mainLoopUs, COSIM_MAIN_LOOP);
+                break;
+
+            case COSIM_LOG:
+                writeLog(logFile, script);
+                logLines++;
+                sched.after(cfg.logUs, COSIM_LOG);
+                break;
+            }
+        }
+
+        return untilUs < end;
+    }
+
+    CoSimResult finish (void)
+    {
+        r.simSeconds = end / 1e6;
+        r.events = sched.dispatchedCount() - logLines;     // the same with or without a log
+        r.fuelGrams = plant.fuelUsed();
+        r.meanLambda = lambdaTime ? r.meanLambda / lambdaTime : 0.0;
+
+        if (r.minRpm > r.maxRpm)
+            r.minRpm = r.maxRpm = 0.0;
+        if (r.minLambda > r.maxLambda)
+            r.minLambda = r.maxLambda = 0.0;
+
+        return r;
+    }
+
+    // simulated time (us) since start()
+    UINT64 now (void) const                     { return sched.now(); }
+
+    const EcuState &state (void) const          { return ecu; }
+    const EnginePlant &enginePlant (void) const { return plant; }
+
+private:
+    // X009C from the coolant temperature at power on (X009B, the cranking fuel, isn't used)
+    void powerOn (const DriveScript &script)
+    {
+        UINT8 X009B;
+
+        crankingInit_C(ectCountForTemp(script.at(0.0).coolantTemp), coolant, X009B, ecu.X009C);
+        ecu.nextCountdown = 1000000;
+    }
+
+    void mainLoop (const DriveScript &script)
+    {
+        PlantInputs in = script.at(sched.now() / 1e6);
+
+        if (sched.now() >= ecu.nextCountdown) {
+            if (ecu.X009C)
+                ecu.X009C--;
+            ecu.nextCountdown += 1000000;
+        }
+
+        ecu.throttle = in.throttle;
+        ecu.coolantTemp = in.coolantTemp;
+        ecu.ectCount = ectCountForTemp(in.coolantTemp);
+        ecu.coolantTempAdjust = coolantTempAdjust_C(ecu.ectCount, coolant);
+        ecu.compensation = startupCompensation(ecu.X009C, ecu.coolantTempAdjust, THROTTLE_RATE_NEUTRAL,
+                                               SHORT_TRIM_NEUTRAL);
+    }
+
+    // Returns true if this spark fired an injector bank
+    bool spark (void)
+    {
+        UINT64 now = sched.now();
+        UINT64 period = (now - ecu.lastSpark) / 2;
+
+        ecu.lastSpark = now;
+        ecu.ignPeriod = (UINT16)((period > 0xFFFF) ? 0xFFFF : period);
+        ecu.mafSum = sensor.mafSum(plant.airFlow());
+        ecu.linearMAF = linearizeMAF_Scalar(ecu.mafSum, model.constants());
+        ecu.rowIndex = rowIndex_Scalar(ecu.ignPeriod, ecu.linearMAF, model.constants());
+        ecu.colIndex = model.columnTable().colIndex(ecu.ignPeriod);
+        ecu.fuelValue = fuelMapValue_C(ecu.rowIndex, ecu.colIndex, model.fuelMap());
+        ecu.pulse = ecuInjectorPulse(ecu.fuelValue, ecu.compensation, mapMultiplier, cfg.voltageAdj);
+
+        bool fueling = (ecu.iciState == 0 || ecu.iciState == 2);
+
+        if (fueling)
+            plant.inject(ecu.pulse);
+
+        ecu.iciState = (ecu.iciState + 1) % COSIM_ICI_STATES;
+
+        return fueling;
+    }
+
+    void writeLog (FILE *log, const DriveScript &script)
+    {
+        PlantInputs in = script.at(sched.now() / 1e6);
+
+        fprintf(log, "%.3f\t%.1f\t%.1f\t%.1f\t0x%02X\t0x%02X\t%u\t%.0f\t%.2f\t%.3f\t%u\t0x%04X\t%u\t0x%02X\t0x%02X\t0x%04X\t0x%04X\t%u\n",
+          sched.now() / 1e6, in.throttle * 100.0, in.loadTorque, in.coolantTemp, ecu.ectCount,
+          ecu.coolantTempAdjust, ecu.X009C, plant.rpm(),
+          plant.airFlow(), plant.lambda(), ecu.mafSum, ecu.ignPeriod, ecu.linearMAF, ecu.rowIndex,
+          ecu.colIndex, ecu.fuelValue, ecu.compensation, ecu.pulse);
+    }
+
+    static void track (double &low, double &high, double v)
+    {
+        if (v < low)
+            low = v;
+        if (v > high)
+            high = v;
+    }
+
+    const FuelModel    &model;
+    UINT16              mapMultiplier;
+    const CoolantTables &coolant;
+    const MafSensor    &sensor;
+    EnginePlant         plant;
+    CoSimConfig         cfg;
+    EventScheduler      sched;
+    EcuState            ecu;
+
+    // the run in progress
+    const DriveScript  *drive;
+    FILE               *logFile;
+    CoSimResult         r;
+    double              lambdaTime;
+    UINT64              logLines;
+    UINT64              end;
+};
+
+#endif // CO_SIMULATION_H
@@ -0,0 +1,141 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Column Index Lookup Table
+//
+//  getColumnIndex() walks up to 16 rows of the RPM table on every call. The result only
+//  depends on the 16-bit ignition period and the table, so for sweeps it's much cheaper to
+//  run the literal model once for every possible period and keep the results. That is 65536
+//  entries of 2 bytes (column index and bracket) or 128K, which fits comfortably in L2.
+//
+//  Once build() has been called, the table is read-only and one instance can be shared by
+//  any number of threads. The storage is aligned to a 64 byte cache line.
+//
+//  attach() uses entries built somewhere else (such as the compile time table in
+//  BakedTables.h) in place of building them. They are copied the first time update() is
+//  called, so the table is never written through.
+//
+//  verify() runs the literal model again for every period and counts the entries that
+//  don't match. It should always return zero; it is there as a cross-check of the table
+//  against the 6803 translation in RpmColumnIndex.h.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef COLUMN_INDEX_TABLE_H
+#define COLUMN_INDEX_TABLE_H
+
+#include <stddef.h>
+#include <string.h>
+
+#include "CuxTypes.h"
+#include "RpmColumnIndex.h"
+
+
+#define PERIOD_COUNT_16BIT      65536
+#define CACHE_LINE_SIZE         64
+
+
+class ColumnIndexTable
+{
+public:
+    ColumnIndexTable () : storage(0), owned(0), entry(0)
+    {
+    }
+
+    explicit ColumnIndexTable (const UCHAR *rpmTable) : storage(0), owned(0), entry(0)
+    {
+        build(rpmTable);
+    }
+
+    ~ColumnIndexTable ()
+    {
+        delete [] storage;
+    }
+
+    // Expand an RPM table (64 bytes, as at $C800) into the lookup table
+    void build (const UCHAR *rpmTable)
+    {
+        allocate();
+        update(rpmTable, 0, PERIOD_COUNT_16BIT - 1);
+    }
+
+    // Use 65536 entries that are already built (not copied, and not freed)
+    void attach (const UINT16 *entries)
+    {
+        delete [] storage;
+        storage = 0;
+        owned = 0;
+        entry = entries;
+    }
+
+    // Recompute the entries for periods first to last (inclusive) after the RPM table
+    // has changed. Only the periods governed by the changed rows need to be redone.
+    void update (const UCHAR *rpmTable, UINT32 first, UINT32 last)
+    {
+        Cpu6803 cpu;
+
+        if (entry && entry != owned) {
+            const UINT16 *attached = entry;
+            allocate();
+            memcpy(owned, attached, PERIOD_COUNT_16BIT * sizeof(UINT16));
+        }
+        else if (!owned)
+            allocate();
+
+        for (UINT32 period = first; period <= last; period++) {
+            UCHAR bracket = 0;
+            UCHAR colIndex = getColumnIndex(cpu, (UINT16)period, &bracket, rpmTable);
+            owned[period] = (UINT16)((bracket << 8) | colIndex);
+        }
+    }
+
+    bool isBuilt (void) const               { return entry != 0; }
+
+    // X005C for this ignition period
+    UCHAR colIndex (UINT16 period) const    { return (UCHAR)entry[period]; }
+
+    // the bracket (table row in the upper nibble) for this ignition period
+    UCHAR bracket (UINT16 period) const     { return (UCHAR)(entry[period] >> 8); }
+
+    // both at once, bracket in the upper byte and X005C in the lower byte
+    UINT16 lookup (UINT16 period) const     { return entry[period]; }
+
+    // all 65536 entries, for saving them
+    const UINT16 *entries (void) const      { return entry; }
+
+    // Returns the number of periods where the table differs from getColumnIndex()
+    UINT32 verify (const UCHAR *rpmTable) const
+    {
+        UINT32 mismatches = 0;
+
+        for (UINT32 period = 0; period < PERIOD_COUNT_16BIT; period++) {
+            UCHAR bracket = 0;
+            UCHAR colIndex = getColumnIndex((UINT16)period, &bracket, rpmTable);
+            if (colIndex != this->colIndex((UINT16)period) || bracket != this->bracket((UINT16)period))
+                mismatches++;
+        }
+
+        return mismatches;
+    }
+
+private:
+    ColumnIndexTable (const ColumnIndexTable &);            // not copyable
+    ColumnIndexTable &operator= (const ColumnIndexTable &);
+
+    void allocate (void)
+    {
+        if (!storage) {
+            storage = new UINT16[PERIOD_COUNT_16BIT + CACHE_LINE_SIZE / sizeof(UINT16)];
+            size_t addr = (size_t)storage;
+            addr = (addr + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+            owned = (UINT16 *)addr;
+        }
+
+        entry = owned;
+    }
+
+    UINT16 *storage;                        // as allocated
+    UINT16 *owned;                          // storage aligned to a cache line
+    const UINT16 *entry;                    // owned, or the attached entries
+};
+
+#endif // COLUMN_INDEX_TABLE_H
@@ -0,0 +1,609 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Coolant Temperature and Cold Start Fueling Models
+//
+//  These are models of the coolant temperature based parts of the fueling. The MAF and RPM
+//  models cover the fuel map lookup; these cover what is added to it while the engine is
+//  cold or cranking:
+//
+//      coolantSensorCount      adcRoutine4 (coolant.asm), range check and default value
+//      coolantTempAdjust       .LD13A (coolant.asm), the 'choke' adjustment from the 3 row
+//                              by 8 column table at $C0B5 (fuel map + $E2)
+//      crankingInit            .LD212 (coolant.asm), X009B (cranking fuel) and X009C (the
+//                              1 Hz startup countdown) from the 3 x 12 table at $C0D0
+//                              (fuel map + $BE)
+//      crankingFuel            the cranking branch of the spark interrupt (.LE76F), both
+//                              'wicked cold' (RPM based, 11 micro-pulses) and normal
+//      accelPump               the extra pulse added when the throttle opens quickly
+//                              (throttlePot.asm, accelPumpTable at $C206)
+//      startupCompensation     .LE7CC to .LE828, the compensation factor (X00CA/CB) that
+//                              the running engine's fuel value is multiplied by
+//
+//  Each has a literal translation (_6803) in the style of MafRowIndex.h and a plain C
+//  version. The batched versions are in CoolantSweep.h.
+//
+//  A few values the routines use are assembler constants rather than data (ignPeriodEngStart,
+//  coldStartupFactor and the ECT range check, which differ for the cold weather chip R3652
+//  and for the builds before R3360). loadCoolantTables() reads them out of the code, so any
+//  image can be used without knowing which build it is.
+//
+//  The cold start chattering itself (LF04D in coldStart.asm) is timer hardware: the ICI
+//  sets X00A6 to 20 and the main loop toggles the injector output on each output compare
+//  until it counts down, giving X00A6 / 2 + 1 = 11 micro-pulses of the cranking pulse
+//  width. Only the count is modelled (COLD_START_MICRO_PULSES).
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+;--------------------------------------------------------------------
+;               Calculate 'coolantTempAdjust'  (coolant.asm)
+;--------------------------------------------------------------------
+                ldx         #$C0B5              ; load address of limp home data table
+                ldab        fuelMapNumber       ; load fuel map number
+                beq         .LD13A              ; branch ahead if it's zero
+                ldx         fuelMapPtr          ; else, load fuel map base pointer
+                ldab        #$E2                ; load $E2
+                abx                             ; add B to X to create table address
+.LD13A          ldab        #$08                ; this is the table width (columns)
+                jsr         indexIntoTable      ; index into table based on ECT counts (A is preserved)
+                suba        $00,x               ; subtract 1st row value
+                ldab        $10,x               ; load 3rd row value from table
+                mul                             ; multiply A * B
+                asld                            ; mpy by 2
+                asld                            ; mpy by 2
+                adda        $08,x               ; add 2nd row value
+                staa        coolantTempAdjust   ; and store the result
+
+;--------------------------------------------------------------------
+;               Cranking values at power on  (coolant.asm)
+;--------------------------------------------------------------------
+                ldx         #$C0D0              ; addr of default 3 x 12 data table
+                ldab        fuelMapNumber       ; load fuel map number
+                beq         .LD212              ; branch ahead if map num is zero
+                ldx         fuelMapPtr          ; load base ptr to fuel map
+                ldab        #$BE                ; load fuel map offset
+                abx                             ; add B to X (example: $C6AF + $BE = $C76D)
+.LD212          ldab        #$0C                ; 12 values per row in table
+                ldaa        coolantTempCount    ; ECT sensor count
+                jsr         indexIntoTable      ; using ECT count, index into table
+                ldab        $18,x               ; load B with 3rd row value
+                ldaa        $0C,x               ; load A with 2nd row value
+                std         $009B               ; store both bytes (B into X009B, A into X009C)
+
+;--------------------------------------------------------------------
+;               indexIntoTable  (misc2.asm)
+;--------------------------------------------------------------------
+indexIntoTable  cmpa        $01,x               ; subtract table value from coolant temp
+                bcs         .indexingRet        ; return if result is LT zero
+                decb                            ; decrement counter
+                beq         .indexingRet        ; return if counter is zero
+                inx                             ; increment index to next higher value in table
+                bra         indexIntoTable
+.indexingRet    rts
+
+;--------------------------------------------------------------------
+;               Cranking fuel  (ignitionInt.asm)
+;--------------------------------------------------------------------
+                ldaa        coolantTempCount    ; load ECT sensor counts
+                cmpa        $C0DB               ; last table value, $E8 to $EC ($EC= -18 C or zero F)
+                bcs         .LE7A4              ; branch ahead to normal startup if warmer than this
+                ldaa        #$14                ; (20 dec) controls number of micro-pulses
+                staa        $00A6               ; store it
+                ldaa        ignPeriodFiltered   ; load MSB of filtered ignition period
+                ldab        fuelMapNumber       ; load fuel map number
+                cmpb        #$02                ; compare with 2
+                bcc         .LE78C              ; branch if fuel map is 2, 3, 4 or 5
+.LE788          ldab        #coldStartupFactor  ; fuel maps 0, 1 and 5 use this value
+                bra         .LE792              ; (value is $12 for cold weather chip)
+.LE78C          cmpb        #$05                ; compare with 5
+                beq         .LE788              ; branch up if fuel map 5
+                ldab        #$07                ; fuel maps 2, 3 and 4 use this value
+.LE792          mul                             ; mpy ign. period by value in B
+                std         $00C8               ; store 16-bit result at X00C8/C9
+                subd        #$05DC              ; subtract 1500
+                bcc         .LE79F              ; branch ahead if value > 1500
+                ldd         #$05DC              ; otherwise, clip value at 1500
+                bra         .LE7A1
+.LE79F          ldd         $00C8               ; load fueling value into AB
+.LE7A1          jmp         .LE983              ; jump down to Phase II Compensation
+
+.LE7A4          ldaa        coolantTempCount    ; load ECT sensor count
+                cmpa        #$40                ; compare with $40 (about 60 C or 140 F)
+                bcc         .LE7C2              ; branch ahead cooler
+                ldd         throttlePot         ; ECT > 60 C, load 16-bit TPS value
+                subd        #$0070              ; subtract $70 from TP value
+                bcs         .LE7C2              ; branch ahead if TP is LT $0070
+                lsrd                            ; if here, warm engine and throttle depressed
+                lsrd                            ; 2 X lsrd gets the top 8 bits into 1 byte
+                ldaa        $C0F6               ; data value is $19 (25 dec)
+                mul                             ; mpy 1/4 TPS by 25
+                cmpa        $C0F7               ; compare result MSB with value $0A
+                bcs         .LE7C5              ; branch ahead if result < $0A00
+                ldaa        $C0F7               ; this limits result to $0Axx maximum
+                clrb                            ; clrb, result now $0A00
+                bra         .LE7C5              ; branch
+.LE7C2          ldd         #$0000              ; if here, cooler than 60 C or no throttle
+.LE7C5          addb        #$FF                ; add $FF to 16-bit value
+                adca        $009B               ; add both the carry bit (if any) and the 2nd
+                                                ; row table value to the final 16-bit value
+                jmp         .LE983              ; jump down to Phase II Compensation
+
+;--------------------------------------------------------------------
+;               Accelerator pump  (throttlePot.asm)
+;--------------------------------------------------------------------
+                ldaa        coolantTempCount
+                ldab        #$0C                ; length of table is 12d
+                ldx         #accelPumpTable
+                jsr         indexIntoTable
+                clrb
+                ldaa        $0C,x               ; load value fron 2nd row of table
+                cmpa        #$03                ; compare value with #03
+                bcs         .LCF8C              ; skip fueling adjustment if engine is cold
+                std         $00C8               ; store X00C8 = value from table, X00C9 = zero
+                                                ; (added to the open injector pulse)
+*/
+
+#ifndef COOLANT_FUELING_H
+#define COOLANT_FUELING_H
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+#include "Registers6803.h"
+#include "MafRowIndex.h"            // mpy16_C
+
+
+#define ADDR_COOLANT_ADJ_TABLE      0xC0B5      // 3 x 8, map 0 (limp home)
+#define ADDR_ECT_DEFAULT            0xC0CD      // $70, used while the sensor is faulty
+#define ADDR_CRANKING_TABLE         0xC0D0      // 3 x 12, map 0
+#define ADDR_COLD_START_LIMIT       0xC0DB      // last ECT count of the map 0 table ($EC)
+#define ADDR_CRANK_TP_MULT          0xC0F6      // $19
+#define ADDR_CRANK_TP_LIMIT         0xC0F7      // $0A
+#define ADDR_STARTUP_BANK_TIMER     0xC1FF      // $03, X2020 and X2021
+#define ADDR_ACCEL_PUMP_TABLE       0xC206      // 2 x 12, not map specific
+
+#define FUEL_MAP_CRANKING_OFFSET    0xBE
+#define FUEL_MAP_COOLANT_ADJ_OFFSET 0xE2
+
+#define COOLANT_ADJ_COLUMNS         8
+#define CRANKING_COLUMNS            12
+#define ACCEL_PUMP_COLUMNS          12
+
+#define ECT_COUNTS                  256
+#define CRANK_WARM_ECT              0x40        // about 60 C, throttle adds fuel when warmer
+#define CRANK_TP_OFFSET             0x0070
+#define COLD_START_MIN_FUEL         0x05DC      // 1500
+#define COLD_START_X00A6            0x14
+#define COLD_START_MICRO_PULSES     (COLD_START_X00A6 / 2 + 1)
+#define ACCEL_PUMP_MIN              0x03        // table values below this are not used
+#define THROTTLE_RATE_NEUTRAL       0x0400      // throttle direction and rate ($005D)
+#define SHORT_TRIM_NEUTRAL          0x8000
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  The tables and constants for one tune and fuel map. The table pointers point straight
+//  into the TuneImage (the literal models read past the end of a row just as the 6803 does,
+//  which is always inside the image).
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+struct CoolantTables
+{
+    int          mapNumber;
+    const UCHAR *coolantAdj;                    // 3 x 8: ECT count, base, slope
+    const UCHAR *cranking;                      // 3 x 12: ECT count, X009B, X009C
+    const UCHAR *accelPump;                     // 2 x 12: ECT count, pulse / 256 us
+    UINT8        ectDefault;                    // $C0CD
+    UINT8        coldStartLimit;                // $C0DB
+    UINT8        crankTpMult;                   // $C0F6
+    UINT8        crankTpLimit;                  // $C0F7
+    UINT8        startupBankTimer;              // $C1FF
+
+    // assembler constants, read from the code
+    UINT8        coldStartupFactor;             // $0A ($12 for R3652)
+    UINT8        engStartPeriodMsb;             // ignPeriodEngStart, $3A ($4E for R3652)
+    UINT8        ectCheckAdd;                   // $04 ($08 before R3360)
+    UINT8        ectCheckMin;                   // $08 ($10 before R3360)
+};
+
+// Returns false if the code the constants are read from isn't found (the R3526 values are
+// used for those)
+inline bool loadCoolantTables (const TuneImage &tune, int mapNumber, CoolantTables &t)
+{
+    static const int coldFactor[] = { 0xC6, SIG_ANY, 0x20, SIG_ANY, 0xC1, 0x05, 0x27, SIG_ANY, 0xC6, 0x07, 0x3D };
+    static const int engStart[]   = { 0x96, 0x7C, 0x81, SIG_ANY, 0x24 };    // ldaa ignPeriodFiltered
+    static const int ectCheck[]   = { 0x16, 0xCB, SIG_ANY, 0xC1, SIG_ANY, 0x22 };   // tab/addb/cmpb/bhi
+
+    if (mapNumber <= 0 || mapNumber >= FUEL_MAP_COUNT) {
+        t.mapNumber = 0;
+        t.coolantAdj = tune.ptr(ADDR_COOLANT_ADJ_TABLE);
+        t.cranking = tune.ptr(ADDR_CRANKING_TABLE);
+    }
+    else {
+        t.mapNumber = mapNumber;
+        t.coolantAdj = tune.fuelMap(mapNumber) + FUEL_MAP_COOLANT_ADJ_OFFSET;
+        t.cranking = tune.fuelMap(mapNumber) + FUEL_MAP_CRANKING_OFFSET;
+    }
+
+    t.accelPump = tune.ptr(ADDR_ACCEL_PUMP_TABLE);
+    t.ectDefault = tune.byteAt(ADDR_ECT_DEFAULT);
+    t.coldStartLimit = tune.byteAt(ADDR_COLD_START_LIMIT);
+    t.crankTpMult = tune.byteAt(ADDR_CRANK_TP_MULT);
+    t.crankTpLimit = tune.byteAt(ADDR_CRANK_TP_LIMIT);
+    t.startupBankTimer = tune.byteAt(ADDR_STARTUP_BANK_TIMER);
+
+    UINT16 f = findSignature(tune.data(), PROM_BASE, coldFactor, 11);
+    UINT16 e = findSignature(tune.data(), PROM_BASE, engStart, 5);
+    UINT16 c = findSignature(tune.data(), PROM_BASE, ectCheck, 6);
+
+    t.coldStartupFactor = f ? tune.byteAt((UINT16)(f + 1)) : 0x0A;
+    t.engStartPeriodMsb = e ? tune.byteAt((UINT16)(e + 3)) : 0x3A;
+    t.ectCheckAdd = c ? tune.byteAt((UINT16)(c + 2)) : 0x04;
+    t.ectCheckMin = c ? tune.byteAt((UINT16)(c + 4)) : 0x08;
+
+    return f && e && c;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Sensor count to temperature. There is no sensor curve in the firmware;
+//  this goes through the points given in the listings ($EC = -18 C, $70 =
+//  36 C (the default), $40 = 60 C, $28 = 82 C, $23 = 87 C) and is only
+//  meant for labelling sweeps and for the co-simulation.
+//
+///////////////////////////////////////////////////////////////////////////////
+static const double ectCurveCount[] = { 0xFF, 0xEC, 0x70, 0x40, 0x28, 0x23, 0x00 };
+static const double ectCurveTemp[]  = { -30.0, -18.0, 36.0, 60.0, 82.0, 87.0, 130.0 };
+#define ECT_CURVE_POINTS    7
+
+inline double ectTempForCount (UINT8 count)
+{
+    int i = 1;
+
+    while (i < ECT_CURVE_POINTS - 1 && count < ectCurveCount[i])
+        i++;
+
+    double f = (count - ectCurveCount[i - 1]) / (ectCurveCount[i] - ectCurveCount[i - 1]);
+
+    return ectCurveTemp[i - 1] + f * (ectCurveTemp[i] - ectCurveTemp[i - 1]);
+}
+
+inline UINT8 ectCountForTemp (double degC)
+{
+    if (degC <= ectCurveTemp[0])
+        return 0xFF;
+
+    int i = 1;
+
+    while (i < ECT_CURVE_POINTS - 1 && degC > ectCurveTemp[i])
+        i++;
+
+    double f = (degC - ectCurveTemp[i - 1]) / (ectCurveTemp[i] - ectCurveTemp[i - 1]);
+    double count = ectCurveCount[i - 1] + f * (ectCurveCount[i] - ectCurveCount[i - 1]);
+
+    return (count <= 0.0) ? 0 : (UINT8)(count + 0.5);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  indexIntoTable_6803
+//
+//  Returns X (a pointer to the selected column of the top row). A is
+//  preserved, as in the original.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline const UCHAR *indexIntoTable_6803 (Cpu6803 &cpu, const UCHAR *x)
+{
+    ABunion &reg = cpu.reg;
+
+indexIntoTable:
+    if (reg.r[A] < x[0x01])                 // cmpa  $01,x
+        goto indexingRet;                   // bcs   .indexingRet
+    reg.r[B]--;                             // decb
+    if (reg.r[B] == 0)
+        goto indexingRet;                   // beq   .indexingRet
+    x++;                                    // inx
+    goto indexIntoTable;                    // bra   indexIntoTable
+
+indexingRet:
+    return x;                               // rts
+}
+
+// The column index indexIntoTable() stops at
+inline int indexIntoTable_C (UINT8 value, const UCHAR *row, int columns)
+{
+    int i = 0;
+
+    while (i < columns - 1 && value >= row[i + 1])
+        i++;
+
+    return i;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  coolantSensorCount
+//
+//  adcRoutine4. Takes the 8-bit ADC reading and the ECT fault down counter
+//  (X2079, zero while the sensor is good) and returns the value stored in
+//  coolantTempCount. *fault is set when the reading is out of range (fault
+//  code 14). While the counter runs, the default count is used 19 times out
+//  of 20.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT8 coolantSensorCount_6803 (Cpu6803 &cpu, UINT8 adc, UINT8 &X2079, const CoolantTables &t,
+                                      bool *fault = 0)
+{
+    ABunion &reg = cpu.reg;
+
+    if (fault)
+        *fault = false;
+
+    reg.r[A] = adc;
+    reg.r[B] = reg.r[A];                    // tab
+    reg.r[B] += t.ectCheckAdd;              // addb  #$04
+    if (reg.r[B] > t.ectCheckMin)           // cmpb  #$08
+        goto LD116;                         // bhi   .LD116
+
+    reg.r[A] = t.ectDefault;                // ldaa  $C0CD
+    if (fault)                              // jsr   setTempTPFaults
+        *fault = true;
+    reg.r[B] = 0x14;                        // ldab  #$14
+    X2079 = reg.r[B];                       // stab  $2079
+
+LD116:
+    reg.r[B] = X2079;                       // ldab  $2079
+    if (reg.r[B] == 0)
+        goto LD122;                         // beq   .LD122
+    reg.r[B]--;                             // decb
+    X2079 = reg.r[B];                       // stab  $2079
+    reg.r[A] = t.ectDefault;                // ldaa  $C0CD
+
+LD122:
+    return reg.r[A];                        // staa  coolantTempCount
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  coolantTempAdjust
+//
+//  In C: row 2 value + (ECT - row 1 value) x row 3 value / 64, in 8 bits.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT8 coolantTempAdjust_6803 (Cpu6803 &cpu, UINT8 ectCount, const CoolantTables &t)
+{
+    ABunion &reg = cpu.reg;
+    const UCHAR *x = t.coolantAdj;
+
+    reg.r[A] = ectCount;
+
+//LD13A:
+    reg.r[B] = COOLANT_ADJ_COLUMNS;         // ldab  #$08
+    x = indexIntoTable_6803(cpu, x);        // jsr   indexIntoTable
+    reg.r[A] -= x[0x00];                    // suba  $00,x
+    reg.r[B] = x[0x10];                     // ldab  $10,x
+    reg.ab = reg.r[A] * reg.r[B];           // mul
+    reg.ab <<= 1;                           // asld
+    reg.ab <<= 1;                           // asld
+    reg.r[A] += x[0x08];                    // adda  $08,x
+
+    return reg.r[A];                        // staa  coolantTempAdjust
+}
+
+inline UINT8 coolantTempAdjust_C (UINT8 ectCount, const CoolantTables &t)
+{
+    const UCHAR *row = t.coolantAdj;
+    int i = indexIntoTable_C(ectCount, row, COOLANT_ADJ_COLUMNS);
+    UINT8 delta = (UINT8)(ectCount - row[i]);
+
+    return (UINT8)(row[i + 2 * COOLANT_ADJ_COLUMNS] * delta / 64 + row[i + COOLANT_ADJ_COLUMNS]);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  crankingInit
+//
+//  X009B (cranking fuel, the high byte of the cranking fuel value) and X009C
+//  (extra startup fuel, counted down to zero at about 1 Hz once running).
+//
+///////////////////////////////////////////////////////////////////////////////
+inline void crankingInit_6803 (Cpu6803 &cpu, UINT8 ectCount, const CoolantTables &t, UINT8 &X009B,
+                               UINT8 &X009C)
+{
+    ABunion &reg = cpu.reg;
+    const UCHAR *x = t.cranking;
+
+//LD212:
+    reg.r[B] = CRANKING_COLUMNS;            // ldab  #$0C
+    reg.r[A] = ectCount;                    // ldaa  coolantTempCount
+    x = indexIntoTable_6803(cpu, x);        // jsr   indexIntoTable
+    reg.r[B] = x[0x18];                     // ldab  $18,x
+    reg.r[A] = x[0x0C];                     // ldaa  $0C,x
+    X009B = reg.r[A];                       // std   $009B
+    X009C = reg.r[B];
+}
+
+inline void crankingInit_C (UINT8 ectCount, const CoolantTables &t, UINT8 &X009B, UINT8 &X009C)
+{
+    int i = indexIntoTable_C(ectCount, t.cranking, CRANKING_COLUMNS);
+
+    X009B = t.cranking[i + CRANKING_COLUMNS];
+    X009C = t.cranking[i + 2 * CRANKING_COLUMNS];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  crankingFuel
+//
+//  The 16-bit fuel value the cranking branch of the spark interrupt hands
+//  to Phase II, from the ECT count, the MSB of the filtered ignition period
+//  (X007C), the throttle pot reading and X009B. *X00A6 is set to the
+//  micro-pulse count when the 'wicked cold' branch is taken.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT16 crankingFuel_6803 (Cpu6803 &cpu, UINT8 ectCount, UINT8 periodMsb, UINT16 throttlePot,
+                                 UINT8 X009B, const CoolantTables &t, UINT8 *X00A6 = 0)
+{
+    ABunion  &reg = cpu.reg;
+    memUnion &mem = cpu.mem;
+    UINT16 carry;
+
+    reg.r[A] = ectCount;                    // ldaa  coolantTempCount
+    if (reg.r[A] < t.coldStartLimit)        // cmpa  $C0DB
+        goto LE7A4;                         // bcs   .LE7A4
+
+    reg.r[A] = COLD_START_X00A6;            // ldaa  #$14
+    if (X00A6)
+        *X00A6 = reg.r[A];                  // staa  $00A6
+    reg.r[A] = periodMsb;                   // ldaa  ignPeriodFiltered
+    reg.r[B] = (UCHAR)t.mapNumber;          // ldab  fuelMapNumber
+    if (reg.r[B] >= 0x02)                   // cmpb  #$02
+        goto LE78C;                         // bcc   .LE78C
+
+LE788:
+    reg.r[B] = t.coldStartupFactor;         // ldab  #coldStartupFactor
+    goto LE792;                             // bra   .LE792
+
+LE78C:
+    if (reg.r[B] == 0x05)                   // cmpb  #$05
+        goto LE788;                         // beq   .LE788
+    reg.r[B] = 0x07;                        // ldab  #$07
+
+LE792:
+    reg.ab = reg.r[A] * reg.r[B];           // mul
+    mem.c8c9 = reg.ab;                      // std   $00C8
+    if (reg.ab >= COLD_START_MIN_FUEL)      // subd  #$05DC
+        goto LE79F;                         // bcc   .LE79F
+    reg.ab = COLD_START_MIN_FUEL;           // ldd   #$05DC
+    goto LE7A1;                             // bra   .LE7A1
+
+LE79F:
+    reg.ab = mem.c8c9;                      // ldd   $00C8
+
+LE7A1:
+    return reg.ab;                          // jmp   .LE983
+
+LE7A4:
+    reg.r[A] = ectCount;                    // ldaa  coolantTempCount
+    if (reg.r[A] >= CRANK_WARM_ECT)         // cmpa  #$40
+        goto LE7C2;                         // bcc   .LE7C2
+    reg.ab = throttlePot;                   // ldd   throttlePot
+    if (reg.ab < CRANK_TP_OFFSET)           // subd  #$0070
+        goto LE7C2;                         // bcs   .LE7C2
+    reg.ab -= CRANK_TP_OFFSET;
+    reg.ab >>= 1;                           // lsrd
+    reg.ab >>= 1;                           // lsrd
+    reg.r[A] = t.crankTpMult;               // ldaa  $C0F6
+    reg.ab = reg.r[A] * reg.r[B];           // mul
+    if (reg.r[A] < t.crankTpLimit)          // cmpa  $C0F7
+        goto LE7C5;                         // bcs   .LE7C5
+    reg.r[A] = t.crankTpLimit;              // ldaa  $C0F7
+    reg.r[B] = 0;                           // clrb
+    goto LE7C5;                             // bra   .LE7C5
+
+LE7C2:
+    reg.ab = 0x0000;                        // ldd   #$0000
+
+LE7C5:
+    carry = (UINT16)(reg.r[B] + 0xFF) >> 8;
+    reg.r[B] += 0xFF;                       // addb  #$FF
+    reg.r[A] += X009B + carry;              // adca  $009B
+
+    return reg.ab;                          // jmp   .LE983
+}
+
+inline UINT16 crankingFuel_C (UINT8 ectCount, UINT8 periodMsb, UINT16 throttlePot, UINT8 X009B,
+                              const CoolantTables &t)
+{
+    if (ectCount >= t.coldStartLimit) {
+
+        int m = t.mapNumber;
+        UINT16 fuel = (UINT16)(periodMsb * ((m >= 2 && m <= 4) ? 0x07 : t.coldStartupFactor));
+
+        return (fuel < COLD_START_MIN_FUEL) ? COLD_START_MIN_FUEL : fuel;
+    }
+
+    UINT16 throttleFuel = 0;
+
+    if (ectCount < CRANK_WARM_ECT && throttlePot >= CRANK_TP_OFFSET) {
+        throttleFuel = (UINT16)(t.crankTpMult * (((throttlePot - CRANK_TP_OFFSET) >> 2) & 0xFF));
+        if ((throttleFuel >> 8) >= t.crankTpLimit)
+            throttleFuel = (UINT16)(t.crankTpLimit << 8);
+    }
+
+    return (UINT16)(throttleFuel + (X009B << 8) + 0xFF);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  accelPump
+//
+//  The time added to the injector pulse (in us, a multiple of 256) when the
+//  throttle opens quickly, or zero when the table value is too small to be
+//  used (cold engine).
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT16 accelPump_6803 (Cpu6803 &cpu, UINT8 ectCount, const CoolantTables &t)
+{
+    ABunion &reg = cpu.reg;
+    const UCHAR *x = t.accelPump;
+
+    reg.r[A] = ectCount;                    // ldaa  coolantTempCount
+    reg.r[B] = ACCEL_PUMP_COLUMNS;          // ldab  #$0C
+    x = indexIntoTable_6803(cpu, x);        // ldx   #accelPumpTable / jsr indexIntoTable
+    reg.r[B] = 0;                           // clrb
+    reg.r[A] = x[0x0C];                     // ldaa  $0C,x
+    if (reg.r[A] < ACCEL_PUMP_MIN)          // cmpa  #$03
+        return 0;                           // bcs   .LCF8C
+
+    return reg.ab;                          // std   $00C8
+}
+
+inline UINT16 accelPump_C (UINT8 ectCount, const CoolantTables &t)
+{
+    UINT8 v = t.accelPump[indexIntoTable_C(ectCount, t.accelPump, ACCEL_PUMP_COLUMNS) + ACCEL_PUMP_COLUMNS];
+
+    return (v < ACCEL_PUMP_MIN) ? 0 : (UINT16)(v << 8);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  startupCompensation
+//
+//  X00CA/CB as .LE7CC to .LE828 leave it (X008A.1 set, X008C.3 clear), the
+//  factor the running engine's fuel value is multiplied by in Phase 1.
+//  startupAdjust is X009C (while X008A.6 is set) plus the bank's startup
+//  counter (X2020 or X2021). The short term trim and the throttle direction
+//  and rate ($005D) are SHORT_TRIM_NEUTRAL and THROTTLE_RATE_NEUTRAL when
+//  neither is adding or taking away fuel.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT16 startupCompensation (UINT8 startupAdjust, UINT8 coolantTempAdjust, UINT16 throttleRate,
+                                   UINT16 shortTrim)
+{
+    UINT16 factor = (UINT16)(startupAdjust + coolantTempAdjust);
+    UINT8 trimMsb = (UINT8)(shortTrim >> 7);        // ldd / asld / staa $00CC
+    UINT16 d;
+
+    factor = (UINT16)(factor << 2);
+    factor = (UINT16)(factor + 0x0096);
+    factor = (UINT16)(factor << 5);
+
+    if (shortTrim & 0x8000)
+        d = (UINT16)(trimMsb + throttleRate);       // trim adds fuel
+    else
+        d = (UINT16)(throttleRate - (UINT8)~trimMsb);
+
+    d = (UINT16)((d + 0x0080) << 4);
+
+    return mpy16_C(d, factor);
+}
+
+#endif // COOLANT_FUELING_H
@@ -0,0 +1,290 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Batched Coolant and Cranking Fueling Sweep
+//
+//  Evaluates the models in CoolantFueling.h for every coolant sensor count (0 to 255) and,
+//  for the cranking fuel, every point of an RPM axis as well, in one call:
+//
+//      per count   coolantTempAdjust, X009B, X009C, the accelerator pump pulse, and the
+//                  compensation factor (X00CA/CB) just after the engine starts (X009C plus
+//                  the bank startup counter at $C1FF) and once they have counted down
+//      per count   the cranking fuel value handed to Phase II, at the filtered ignition
+//      and RPM     period for that RPM. Zero where the period is shorter than
+//                  ignPeriodEngStart, which is where the ECU takes the engine as running.
+//
+//  The results are bit-exact with the _C versions (and so with the literal _6803 ones and
+//  the firmware; see ../Coolant_Sweep/CoolantSweep.cpp). indexIntoTable is done without
+//  branches, as a running AND of the column compares, so that 16 counts go through at
+//  once in the SSE2 version:
+//
+//      index = number of leading columns 1 to n-1 with count >= table value
+//
+//  The cranking grid is done 8 RPM points at a time. The whole sweep is small (256 counts
+//  by a few dozen RPM points) so there is no AVX2 version; SSE2 is always there on x86-64.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef COOLANT_SWEEP_H
+#define COOLANT_SWEEP_H
+
+#include <vector>
+
+#include "CuxTypes.h"
+#include "CoolantFueling.h"
+#include "MafLinearizeBatch.h"          // MAF_BATCH_X86 and the intrinsics headers
+
+
+#define SWEEP_RPM_TO_PERIOD     7500000.0       // ignition period (2 us units) x RPM
+
+
+struct CoolantSweepAxes
+{
+    std::vector<UINT16> rpm;                    // cranking grid columns
+    UINT16              throttlePot;            // during cranking
+};
+
+struct CoolantSweep
+{
+    UINT8   coolantAdjust[ECT_COUNTS];
+    UINT8   X009B[ECT_COUNTS];
+    UINT8   X009C[ECT_COUNTS];
+    UINT16  accelPump[ECT_COUNTS];              // us
+    UINT16  startComp[ECT_COUNTS];              // X00CA/CB with the startup counters
+    UINT16  warmComp[ECT_COUNTS];               // and after they have counted down
+
+    std::vector<UINT8>  periodMsb;              // filtered ignition period MSB, per RPM
+    std::vector<UINT16> crankFuel;              // [count * rpm points + rpm], 0 if running
+
+    UINT16 cranking (int count, size_t rpmPoint) const
+    {
+        return crankFuel[count * periodMsb.size() + rpmPoint];
+    }
+};
+
+inline UINT8 periodMsbForRpm (UINT16 rpm)
+{
+    double period = rpm ? SWEEP_RPM_TO_PERIOD / rpm : 65535.0;
+
+    return (UINT8)(((period < 65535.0) ? (UINT16)period : 0xFFFF) >> 8);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Scalar version
+//
+///////////////////////////////////////////////////////////////////////////////
+inline void sweepCountsScalar (const CoolantTables &t, CoolantSweep &s)
+{
+    for (int count = 0; count < ECT_COUNTS; count++) {
+
+        UINT8 ect = (UINT8)count;
+        UINT8 adjust = coolantTempAdjust_C(ect, t);
+
+        crankingInit_C(ect, t, s.X009B[count], s.X009C[count]);
+
+        s.coolantAdjust[count] = adjust;
+        s.accelPump[count] = accelPump_C(ect, t);
+        s.startComp[count] = startupCompensation((UINT8)(s.X009C[count] + t.startupBankTimer), adjust,
+                                                 THROTTLE_RATE_NEUTRAL, SHORT_TRIM_NEUTRAL);
+        s.warmComp[count] = startupCompensation(0, adjust, THROTTLE_RATE_NEUTRAL, SHORT_TRIM_NEUTRAL);
+    }
+}
+
+inline void sweepCrankingScalar (const CoolantTables &t, UINT16 throttlePot, CoolantSweep &s)
+{
+    size_t points = s.periodMsb.size();
+
+    for (int count = 0; count < ECT_COUNTS; count++)
+        for (size_t r = 0; r < points; r++) {
+            UINT8 msb = s.periodMsb[r];
+            s.crankFuel[count * points + r] = (msb < t.engStartPeriodMsb) ? 0 :
+                crankingFuel_C((UINT8)count, msb, throttlePot, s.X009B[count], t);
+        }
+}
+
+
+#if MAF_BATCH_X86
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  SSE2 version
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// indexIntoTable for 16 counts (unsigned bytes)
+inline __m128i indexIntoTable_SSE2 (__m128i ect, const UCHAR *row, int columns)
+{
+    __m128i run = _mm_set1_epi8(-1);
+    __m128i index = _mm_setzero_si128();
+
+    for (int i = 1; i < columns; i++) {
+        __m128i ge = _mm_cmpeq_epi8(_mm_max_epu8(ect, _mm_set1_epi8((char)row[i])), ect);
+        run = _mm_and_si128(run, ge);
+        index = _mm_sub_epi8(index, run);                       // +1 while still running
+    }
+
+    return index;
+}
+
+// row[index] for 16 indexes
+inline __m128i selectColumn_SSE2 (__m128i index, const UCHAR *row, int columns)
+{
+    __m128i v = _mm_setzero_si128();
+
+    for (int i = 0; i < columns; i++) {
+        __m128i hit = _mm_cmpeq_epi8(index, _mm_set1_epi8((char)i));
+        v = _mm_or_si128(v, _mm_and_si128(hit, _mm_set1_epi8((char)row[i])));
+    }
+
+    return v;
+}
+
+// startupCompensation() with the trim and throttle rate neutral, 8 at a time
+inline __m128i startupCompensation_SSE2 (__m128i startup, __m128i adjust)
+{
+    UINT16 d = (UINT16)(((UINT8)(SHORT_TRIM_NEUTRAL >> 7) + THROTTLE_RATE_NEUTRAL + 0x0080) << 4);
+    __m128i factor = _mm_add_epi16(startup, adjust);
+
+    factor = _mm_slli_epi16(factor, 2);
+    factor = _mm_add_epi16(factor, _mm_set1_epi16(0x0096));
+    factor = _mm_slli_epi16(factor, 5);
+
+    return _mm_mulhi_epu16(factor, _mm_set1_epi16((short)d));
+}
+
+inline void sweepCountsSSE2 (const CoolantTables &t, CoolantSweep &s)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask8 = _mm_set1_epi16(0x00FF);
+    const __m128i bankTimer = _mm_set1_epi8((char)t.startupBankTimer);
+    const UCHAR *adj = t.coolantAdj;
+    const UCHAR *crank = t.cranking;
+    const UCHAR *pump = t.accelPump;
+
+    for (int count = 0; count < ECT_COUNTS; count += 16) {
+
+        __m128i ect = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        ect = _mm_add_epi8(ect, _mm_set1_epi8((char)count));
+
+        // coolantTempAdjust: base + ((ect - count) x slope) / 64, in 8 bits
+        __m128i i = indexIntoTable_SSE2(ect, adj, COOLANT_ADJ_COLUMNS);
+        __m128i delta = _mm_sub_epi8(ect, selectColumn_SSE2(i, adj, COOLANT_ADJ_COLUMNS));
+        __m128i base = selectColumn_SSE2(i, adj + COOLANT_ADJ_COLUMNS, COOLANT_ADJ_COLUMNS);
+        __m128i slope = selectColumn_SSE2(i, adj + 2 * COOLANT_ADJ_COLUMNS, COOLANT_ADJ_COLUMNS);
+
+        __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(delta, zero),
+                                                    _mm_unpacklo_epi8(slope, zero)), 6);
+        __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(delta, zero),
+                                                    _mm_unpackhi_epi8(slope, zero)), 6);
+        __m128i adjust = _mm_add_epi8(_mm_packus_epi16(_mm_and_si128(lo, mask8), _mm_and_si128(hi, mask8)),
+                                      base);
+
+        // X009B and X009C
+        i = indexIntoTable_SSE2(ect, crank, CRANKING_COLUMNS);
+        __m128i x9b = selectColumn_SSE2(i, crank + CRANKING_COLUMNS, CRANKING_COLUMNS);
+        __m128i x9c = selectColumn_SSE2(i, crank + 2 * CRANKING_COLUMNS, CRANKING_COLUMNS);
+
+        // accelerator pump, zero below ACCEL_PUMP_MIN
+        i = indexIntoTable_SSE2(ect, pump, ACCEL_PUMP_COLUMNS);
+        __m128i p = selectColumn_SSE2(i, pump + ACCEL_PUMP_COLUMNS, ACCEL_PUMP_COLUMNS);
+        __m128i use = _mm_cmpeq_epi8(_mm_max_epu8(p, _mm_set1_epi8(ACCEL_PUMP_MIN)), p);
+        p = _mm_and_si128(p, use);
+
+        _mm_storeu_si128((__m128i *)(s.coolantAdjust + count), adjust);
+        _mm_storeu_si128((__m128i *)(s.X009B + count), x9b);
+        _mm_storeu_si128((__m128i *)(s.X009C + count), x9c);
+        _mm_storeu_si128((__m128i *)(s.accelPump + count), _mm_unpacklo_epi8(zero, p));
+        _mm_storeu_si128((__m128i *)(s.accelPump + count + 8), _mm_unpackhi_epi8(zero, p));
+
+        // compensation, with X009C + X2020 added in 8 bits (addb)
+        __m128i startup = _mm_add_epi8(x9c, bankTimer);
+
+        _mm_storeu_si128((__m128i *)(s.startComp + count),
+          startupCompensation_SSE2(_mm_unpacklo_epi8(startup, zero), _mm_unpacklo_epi8(adjust, zero)));
+        _mm_storeu_si128((__m128i *)(s.startComp + count + 8),
+          startupCompensation_SSE2(_mm_unpackhi_epi8(startup, zero), _mm_unpackhi_epi8(adjust, zero)));
+        _mm_storeu_si128((__m128i *)(s.warmComp + count),
+          startupCompensation_SSE2(zero, _mm_unpacklo_epi8(adjust, zero)));
+        _mm_storeu_si128((__m128i *)(s.warmComp + count + 8),
+          startupCompensation_SSE2(zero, _mm_unpackhi_epi8(adjust, zero)));
+    }
+}
+
+inline void sweepCrankingSSE2 (const CoolantTables &t, UINT16 throttlePot, CoolantSweep &s)
+{
+    const __m128i sign = _mm_set1_epi16((short)0x8000);
+    const __m128i minFuel = _mm_set1_epi16((short)(COLD_START_MIN_FUEL ^ 0x8000));
+    const __m128i engStart = _mm_set1_epi16((short)(t.engStartPeriodMsb - 1));
+    int m = t.mapNumber;
+    UINT8 factor = (m >= 2 && m <= 4) ? 0x07 : t.coldStartupFactor;
+    size_t points = s.periodMsb.size();
+    std::vector<UINT16> msb(points);
+
+    for (size_t r = 0; r < points; r++)
+        msb[r] = s.periodMsb[r];
+
+    for (int count = 0; count < ECT_COUNTS; count++) {
+
+        UINT16 *out = &s.crankFuel[count * points];
+        bool cold = count >= t.coldStartLimit;
+        __m128i warmFuel = _mm_set1_epi16((short)crankingFuel_C((UINT8)count, 0, throttlePot,
+                                                                s.X009B[count], t));
+        size_t r = 0;
+
+        for (; r + 8 <= points; r += 8) {
+
+            __m128i period = _mm_loadu_si128((const __m128i *)&msb[r]);
+            __m128i fuel = warmFuel;
+
+            if (cold) {
+                // max(period x factor, 1500) unsigned, with the sign flipped for max_epi16
+                fuel = _mm_mullo_epi16(period, _mm_set1_epi16(factor));
+                fuel = _mm_xor_si128(_mm_max_epi16(_mm_xor_si128(fuel, sign), minFuel), sign);
+            }
+
+            fuel = _mm_and_si128(fuel, _mm_cmpgt_epi16(period, engStart));
+            _mm_storeu_si128((__m128i *)(out + r), fuel);
+        }
+
+        for (; r < points; r++)
+            out[r] = (s.periodMsb[r] < t.engStartPeriodMsb) ? 0 :
+                crankingFuel_C((UINT8)count, s.periodMsb[r], throttlePot, s.X009B[count], t);
+    }
+}
+
+#endif // MAF_BATCH_X86
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  sweepCoolant
+//
+//  The whole sweep for one tune and fuel map. useSimd = false forces the
+//  scalar version (for checking the two against each other).
+//
+///////////////////////////////////////////////////////////////////////////////
+inline void sweepCoolant (const CoolantTables &t, const CoolantSweepAxes &axes, CoolantSweep &s,
+                          bool useSimd = true)
+{
+    s.periodMsb.resize(axes.rpm.size());
+    s.crankFuel.assign(ECT_COUNTS * axes.rpm.size(), 0);
+
+    for (size_t r = 0; r < axes.rpm.size(); r++)
+        s.periodMsb[r] = periodMsbForRpm(axes.rpm[r]);
+
+#if MAF_BATCH_X86
+    if (useSimd) {
+        sweepCountsSSE2(t, s);
+        sweepCrankingSSE2(t, axes.throttlePot, s);
+        return;
+    }
+#else
+    (void)useSimd;
+#endif
+
+    sweepCountsScalar(t, s);
+    sweepCrankingScalar(t, axes.throttlePot, s);
+}
+
+#endif // COOLANT_SWEEP_H
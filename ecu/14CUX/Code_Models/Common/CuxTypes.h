@@ -0,0 +1,21 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Code Models - Common Types
+//
+//  Type names shared by the code models. These follow the names used in the original
+//  model programs so that the literal translations read the same in every file.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CUX_TYPES_H
+#define CUX_TYPES_H
+
+typedef   signed char  CHAR;
+typedef unsigned char  UCHAR;
+typedef unsigned char  UINT8;
+typedef unsigned short UINT16;
+typedef unsigned int   UINT32;
+typedef unsigned long  DWORD;
+typedef unsigned long long UINT64;
+
+#endif // CUX_TYPES_H
@@ -0,0 +1,574 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX 6803 Emulator
+//
+//  An instruction level emulator of the 6801/6803 CPU core (the 6803U4 in the 14CUX is the
+//  same core with the ROM disabled). It loads a 16K PROM image at $C000 and runs pieces of
+//  the real firmware from a given address with whatever RAM and registers the caller sets
+//  up, so the hand translations in the other headers can be checked against the code that
+//  actually runs in the ECU (see RomRoutines.h and ../Firmware_Check/FirmwareCheck.cpp).
+//
+//  Cycle counts are per instruction, from the MC6801 data sheet. The E clock in the 14CUX
+//  is 1 MHz (4 MHz crystal / 4), so a cycle is a microsecond.
+//
+//  Every address in the PROM is decoded once when the image is loaded (mode, length,
+//  cycles, effective address or branch target), so the run loop just switches on the
+//  opcode of the pre-decoded entry. Code outside the PROM is decoded as it is run.
+//
+//  The memory is flat 64K. The internal registers ($0000 to $001F), the internal RAM and
+//  the external RAM at $2000 are plain memory, so timers and ports read back whatever was
+//  last stored and interrupts never happen. Writes to the PROM are ignored.
+//
+//  A routine ends when the PC reaches an address marked with setStop() (these must be in
+//  the PROM), when a subroutine started with call() returns, when an illegal opcode or
+//  WAI is reached, or when the cycle limit runs out.
+//
+//  An Emulator6803 holds 64K of memory and the decoded PROM (about 200K in all). It is
+//  not shared; each thread should have its own.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef EMULATOR_6803_H
+#define EMULATOR_6803_H
+
+#include <string.h>
+#include <vector>
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+
+
+// condition code register
+#define CC_C            0x01
+#define CC_V            0x02
+#define CC_Z            0x04
+#define CC_N            0x08
+#define CC_I            0x10
+#define CC_H            0x20
+
+// addressing modes
+#define MODE_ILLEGAL    0
+#define MODE_INH        1
+#define MODE_IMM8       2
+#define MODE_IMM16      3
+#define MODE_DIR        4
+#define MODE_IDX        5
+#define MODE_EXT        6
+#define MODE_REL        7
+
+#define CALL_RETURN     0x0000      // return address pushed by call()
+#define EMU_STACK_TOP   0x00FF      // initial stack pointer (top of internal RAM)
+#define EMU_MEMORY_SIZE 0x10000
+
+
+enum EmuStatus
+{
+    EMU_STOPPED,                    // reached a stop address
+    EMU_RETURNED,                   // the routine started by call() returned
+    EMU_CYCLE_LIMIT,
+    EMU_ILLEGAL,                    // illegal opcode (pc() is its address)
+    EMU_WAIT                        // WAI
+};
+
+
+class Emulator6803
+{
+public:
+    Emulator6803 () : mem(EMU_MEMORY_SIZE, 0), decoded(PROM_SIZE)
+    {
+        a = b = 0;
+        x = progCounter = 0;
+        sp = EMU_STACK_TOP;
+        cc = 0xC0 | CC_I;
+        cycleCount = 0;
+    }
+
+    // Load a PROM image (16K, $C000 to $FFFF) and decode it. Stops are cleared.
+    void load (const UCHAR *image)
+    {
+        memcpy(&mem[PROM_BASE], image, PROM_SIZE);
+
+        for (UINT32 addr = PROM_BASE; addr < EMU_MEMORY_SIZE; addr++)
+            decode((UINT16)addr, decoded[addr - PROM_BASE]);
+    }
+
+    // Change a PROM byte (a constant, or a patched instruction) and decode the
+    // instructions that include it again. Stops are kept.
+    void patch8 (UINT16 addr, UCHAR v)
+    {
+        mem[addr] = v;
+
+        for (UINT32 at = (addr >= PROM_BASE + 2) ? addr - 2u : PROM_BASE; at <= addr; at++) {
+            if (at >= PROM_BASE) {
+                UCHAR stop = decoded[at - PROM_BASE].stop;
+                decode((UINT16)at, decoded[at - PROM_BASE]);
+                decoded[at - PROM_BASE].stop = stop;
+            }
+        }
+    }
+
+    void patch16 (UINT16 addr, UINT16 v)
+    {
+        patch8(addr, (UCHAR)(v >> 8));
+        patch8((UINT16)(addr + 1), (UCHAR)v);
+    }
+
+    void setStop (UINT16 addr, bool stop = true)
+    {
+        if (addr >= PROM_BASE)
+            decoded[addr - PROM_BASE].stop = stop;
+    }
+
+    // registers
+    UCHAR  regA (void) const            { return a; }
+    UCHAR  regB (void) const            { return b; }
+    UINT16 regD (void) const            { return (UINT16)((a << 8) | b); }
+    UINT16 regX (void) const            { return x; }
+    UINT16 regSP (void) const           { return sp; }
+    UINT16 pc (void) const              { return progCounter; }
+    UCHAR  regCC (void) const           { return cc; }
+
+    void setA (UCHAR v)                 { a = v; }
+    void setB (UCHAR v)                 { b = v; }
+    void setD (UINT16 v)                { a = (UCHAR)(v >> 8); b = (UCHAR)v; }
+    void setX (UINT16 v)                { x = v; }
+    void setSP (UINT16 v)               { sp = v; }
+    void setCC (UCHAR v)                { cc = (UCHAR)(v | 0xC0); }
+
+    // memory (big endian)
+    UCHAR  read8 (UINT16 addr) const    { return mem[addr]; }
+    UINT16 read16 (UINT16 addr) const   { return (UINT16)((mem[addr] << 8) | mem[(UINT16)(addr + 1)]); }
+
+    void write8 (UINT16 addr, UCHAR v)
+    {
+        if (addr < PROM_BASE)
+            mem[addr] = v;
+    }
+
+    void write16 (UINT16 addr, UINT16 v)
+    {
+        write8(addr, (UCHAR)(v >> 8));
+        write8((UINT16)(addr + 1), (UCHAR)v);
+    }
+
+    // cycles used by the last run() or call()
+    UINT32 cycles (void) const          { return cycleCount; }
+
+    // Run from start until a stop address (or one of the other conditions above)
+    EmuStatus run (UINT16 start, UINT32 maxCycles = 100000)
+    {
+        progCounter = start;
+        cycleCount = 0;
+        return execute(maxCycles);
+    }
+
+    // Call a subroutine (jsr) and run until it returns
+    EmuStatus call (UINT16 start, UINT32 maxCycles = 100000)
+    {
+        push16(CALL_RETURN);
+        progCounter = start;
+        cycleCount = 0;
+        return execute(maxCycles);
+    }
+
+private:
+    struct Decoded
+    {
+        UCHAR   opcode;
+        UCHAR   mode;
+        UCHAR   cycles;
+        UCHAR   stop;
+        UINT16  operand;            // address (imm, dir, ext), offset (idx) or branch target
+        UINT16  next;               // address of the next instruction
+    };
+
+    static UCHAR addressMode (UCHAR op)
+    {
+        static const UCHAR legalInh[64] = {     // $00 to $3F
+            0,1,0,0,1,1,1,1, 1,1,1,1,1,1,1,1,
+            1,1,0,0,0,0,1,1, 0,1,0,1,0,0,0,0,
+            7,7,7,7,7,7,7,7, 7,7,7,7,7,7,7,7,
+            1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1
+        };
+        UCHAR low = op & 0x0F;
+
+        if (op < 0x40)
+            return legalInh[op];
+
+        if (op < 0x80) {
+            // NEG, COM, LSR, ROR, ASR, ASL, ROL, DEC, INC, TST, JMP (not 4x/5x), CLR
+            if (low == 0x01 || low == 0x02 || low == 0x05 || low == 0x0B)
+                return MODE_ILLEGAL;
+            if (low == 0x0E && op < 0x60)
+                return MODE_ILLEGAL;
+            return (op < 0x60) ? MODE_INH : (op < 0x70) ? MODE_IDX : MODE_EXT;
+        }
+
+        switch (op & 0x30) {
+        case 0x00:
+            if (op == 0x87 || op == 0x8F || op == 0xC7 || op == 0xCD || op == 0xCF)
+                return MODE_ILLEGAL;
+            if (op == 0x8D)
+                return MODE_REL;                // BSR
+            return (low == 0x03 || low >= 0x0C) ? MODE_IMM16 : MODE_IMM8;
+        case 0x10:
+            return MODE_DIR;
+        case 0x20:
+            return MODE_IDX;
+        default:
+            return MODE_EXT;
+        }
+    }
+
+    static UCHAR cycleCount8 (UCHAR op)
+    {
+        static const UCHAR table[256] = {
+        //  0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+            0, 2, 0, 0, 3, 3, 2, 2, 3, 3, 2, 2, 2, 2, 2, 2,     // 0x
+            2, 2, 0, 0, 0, 0, 2, 2, 0, 2, 0, 2, 0, 0, 0, 0,     // 1x
+            3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,     // 2x
+            3, 3, 4, 4, 3, 3, 3, 3, 5, 5, 3,10, 4,10, 9,12,     // 3x
+            2, 0, 0, 2, 2, 0, 2, 2, 2, 2, 2, 0, 2, 2, 0, 2,     // 4x
+            2, 0, 0, 2, 2, 0, 2, 2, 2, 2, 2, 0, 2, 2, 0, 2,     // 5x
+            6, 0, 0, 6, 6, 0, 6, 6, 6, 6, 6, 0, 6, 6, 3, 6,     // 6x
+            6, 0, 0, 6, 6, 0, 6, 6, 6, 6, 6, 0, 6, 6, 3, 6,     // 7x
+            2, 2, 2, 4, 2, 2, 2, 0, 2, 2, 2, 2, 4, 6, 3, 0,     // 8x
+            3, 3, 3, 5, 3, 3, 3, 3, 3, 3, 3, 3, 5, 5, 4, 4,     // 9x
+            4, 4, 4, 6, 4, 4, 4, 4, 4, 4, 4, 4, 6, 6, 5, 5,     // Ax
+            4, 4, 4, 6, 4, 4, 4, 4, 4, 4, 4, 4, 6, 6, 5, 5,     // Bx
+            2, 2, 2, 4, 2, 2, 2, 0, 2, 2, 2, 2, 3, 0, 3, 0,     // Cx
+            3, 3, 3, 5, 3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4,     // Dx
+            4, 4, 4, 6, 4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5,     // Ex
+            4, 4, 4, 6, 4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5      // Fx
+        };
+
+        return table[op];
+    }
+
+    void decode (UINT16 addr, Decoded &d) const
+    {
+        d.opcode = mem[addr];
+        d.mode = addressMode(d.opcode);
+        d.cycles = cycleCount8(d.opcode);
+        d.stop = 0;
+        d.operand = 0;
+
+        switch (d.mode) {
+        case MODE_IMM8:
+        case MODE_IMM16:
+            d.operand = (UINT16)(addr + 1);
+            break;
+        case MODE_DIR:
+        case MODE_IDX:
+            d.operand = mem[(UINT16)(addr + 1)];
+            break;
+        case MODE_EXT:
+            d.operand = read16((UINT16)(addr + 1));
+            break;
+        case MODE_REL:
+            d.operand = (UINT16)(addr + 2 + (CHAR)mem[(UINT16)(addr + 1)]);
+            break;
+        }
+
+        static const UCHAR length[8] = { 1, 1, 2, 3, 2, 2, 3, 2 };
+        d.next = (UINT16)(addr + length[d.mode]);
+    }
+
+    // flags
+    void nz8 (UCHAR r)
+    {
+        cc = (UCHAR)((cc & ~(CC_N | CC_Z | CC_V)) | ((r & 0x80) ? CC_N : 0) | (r ? 0 : CC_Z));
+    }
+
+    void nz16 (UINT16 r)
+    {
+        cc = (UCHAR)((cc & ~(CC_N | CC_Z | CC_V)) | ((r & 0x8000) ? CC_N : 0) | (r ? 0 : CC_Z));
+    }
+
+    void flag (UCHAR bit, bool set)
+    {
+        cc = (UCHAR)(set ? (cc | bit) : (cc & ~bit));
+    }
+
+    UCHAR add8 (UCHAR m, UCHAR n, UCHAR carry)
+    {
+        UINT32 r = m + n + carry;
+        cc = (UCHAR)((cc & ~(CC_H | CC_N | CC_Z | CC_V | CC_C)) |
+                     (((m ^ n ^ r) & 0x10) ? CC_H : 0) | ((r & 0x80) ? CC_N : 0) |
+                     ((r & 0xFF) ? 0 : CC_Z) | (((m ^ r) & (n ^ r) & 0x80) ? CC_V : 0) |
+                     ((r >> 8) & CC_C));
+        return (UCHAR)r;
+    }
+
+    UCHAR sub8 (UCHAR m, UCHAR n, UCHAR borrow)
+    {
+        UINT32 r = (UINT32)m - n - borrow;
+        cc = (UCHAR)((cc & ~(CC_N | CC_Z | CC_V | CC_C)) | ((r & 0x80) ? CC_N : 0) |
+                     ((r & 0xFF) ? 0 : CC_Z) | (((m ^ n) & (m ^ r) & 0x80) ? CC_V : 0) |
+                     ((r >> 8) & CC_C));
+        return (UCHAR)r;
+    }
+
+    UINT16 add16 (UINT16 m, UINT16 n)
+    {
+        UINT32 r = (UINT32)m + n;
+        cc = (UCHAR)((cc & ~(CC_N | CC_Z | CC_V | CC_C)) | ((r & 0x8000) ? CC_N : 0) |
+                     ((r & 0xFFFF) ? 0 : CC_Z) | (((m ^ r) & (n ^ r) & 0x8000) ? CC_V : 0) |
+                     ((r >> 16) & CC_C));
+        return (UINT16)r;
+    }
+
+    UINT16 sub16 (UINT16 m, UINT16 n)
+    {
+        UINT32 r = (UINT32)m - n;
+        cc = (UCHAR)((cc & ~(CC_N | CC_Z | CC_V | CC_C)) | ((r & 0x8000) ? CC_N : 0) |
+                     ((r & 0xFFFF) ? 0 : CC_Z) | (((m ^ n) & (m ^ r) & 0x8000) ? CC_V : 0) |
+                     ((r >> 16) & CC_C));
+        return (UINT16)r;
+    }
+
+    // read-modify-write group ($40 to $7F), shared by the accumulator and memory forms
+    UCHAR modify (UCHAR op, UCHAR m)
+    {
+        UCHAR r = m;
+        bool carry = (cc & CC_C) != 0;
+
+        switch (op & 0x0F) {
+        case 0x00:  r = sub8(0, m, 0);                                  break;  // NEG
+        case 0x03:  r = (UCHAR)~m; nz8(r); flag(CC_C, true);            break;  // COM
+        case 0x04:  r = m >> 1; nz8(r); flag(CC_C, m & 1);                      // LSR
+                    flag(CC_V, (m & 1) != 0);                           break;
+        case 0x06:  r = (UCHAR)((m >> 1) | (carry ? 0x80 : 0)); nz8(r);         // ROR
+                    flag(CC_C, m & 1); flag(CC_V, ((r >> 7) ^ (m & 1)) != 0); break;
+        case 0x07:  r = (UCHAR)((m >> 1) | (m & 0x80)); nz8(r);                 // ASR
+                    flag(CC_C, m & 1); flag(CC_V, ((r >> 7) ^ (m & 1)) != 0); break;
+        case 0x08:  r = (UCHAR)(m << 1); nz8(r); flag(CC_C, (m & 0x80) != 0);  // ASL
+                    flag(CC_V, ((r >> 7) ^ (m >> 7)) != 0);             break;
+        case 0x09:  r = (UCHAR)((m << 1) | (carry ? 1 : 0)); nz8(r);            // ROL
+                    flag(CC_C, (m & 0x80) != 0); flag(CC_V, ((r >> 7) ^ (m >> 7)) != 0); break;
+        case 0x0A:  r = (UCHAR)(m - 1); nz8(r); flag(CC_V, m == 0x80);  break;  // DEC
+        case 0x0C:  r = (UCHAR)(m + 1); nz8(r); flag(CC_V, m == 0x7F);  break;  // INC
+        case 0x0D:  nz8(m); flag(CC_C, false);                          break;  // TST
+        case 0x0F:  r = 0; nz8(r); flag(CC_C, false);                   break;  // CLR
+        }
+
+        return r;
+    }
+
+    void push8 (UCHAR v)                { write8(sp, v); sp--; }
+    UCHAR pull8 (void)                  { sp++; return mem[sp]; }
+
+    void push16 (UINT16 v)              { push8((UCHAR)v); push8((UCHAR)(v >> 8)); }
+    UINT16 pull16 (void)                { UINT16 hi = pull8(); return (UINT16)((hi << 8) | pull8()); }
+
+    void interrupt (UINT16 vector)
+    {
+        push16(progCounter);
+        push16(x);
+        push8(a);
+        push8(b);
+        push8(cc);
+        cc |= CC_I;
+        progCounter = read16(vector);
+    }
+
+    bool condition (UCHAR op) const
+    {
+        bool c = (cc & CC_C) != 0, v = (cc & CC_V) != 0, z = (cc & CC_Z) != 0, n = (cc & CC_N) != 0;
+
+        switch (op & 0x0F) {
+        case 0x00:  return true;                // BRA
+        case 0x01:  return false;               // BRN
+        case 0x02:  return !(c || z);           // BHI
+        case 0x03:  return c || z;              // BLS
+        case 0x04:  return !c;                  // BCC
+        case 0x05:  return c;                   // BCS
+        case 0x06:  return !z;                  // BNE
+        case 0x07:  return z;                   // BEQ
+        case 0x08:  return !v;                  // BVC
+        case 0x09:  return v;                   // BVS
+        case 0x0A:  return !n;                  // BPL
+        case 0x0B:  return n;                   // BMI
+        case 0x0C:  return n == v;              // BGE
+        case 0x0D:  return n != v;              // BLT
+        case 0x0E:  return !z && (n == v);      // BGT
+        default:    return z || (n != v);       // BLE
+        }
+    }
+
+    EmuStatus execute (UINT32 maxCycles)
+    {
+        Decoded scratch;
+
+        for (;;) {
+            const Decoded *d;
+
+            if (progCounter >= PROM_BASE)
+                d = &decoded[progCounter - PROM_BASE];
+            else if (progCounter == CALL_RETURN)
+                return EMU_RETURNED;
+            else {
+                decode(progCounter, scratch);
+                d = &scratch;
+            }
+
+            if (d->stop)
+                return EMU_STOPPED;
+            if (d->mode == MODE_ILLEGAL)
+                return EMU_ILLEGAL;
+            if (cycleCount >= maxCycles)
+                return EMU_CYCLE_LIMIT;
+
+            UCHAR op = d->opcode;
+            UINT16 ea = d->operand;
+
+            if (d->mode == MODE_IDX)
+                ea = (UINT16)(x + ea);
+
+            progCounter = d->next;
+            cycleCount += d->cycles;
+
+            if (op >= 0x80) {
+                UCHAR &acc = (op & 0x40) ? b : a;
+
+                switch (op & 0x0F) {
+                case 0x00:  acc = sub8(acc, mem[ea], 0);                    continue;   // SUB
+                case 0x01:  sub8(acc, mem[ea], 0);                          continue;   // CMP
+                case 0x02:  acc = sub8(acc, mem[ea], cc & CC_C);            continue;   // SBC
+                case 0x03:                                                              // SUBD, ADDD
+                    setD((op & 0x40) ? add16(regD(), read16(ea)) : sub16(regD(), read16(ea)));
+                    continue;
+                case 0x04:  acc &= mem[ea]; nz8(acc);                       continue;   // AND
+                case 0x05:  nz8(acc & mem[ea]);                             continue;   // BIT
+                case 0x06:  acc = mem[ea]; nz8(acc);                        continue;   // LDA
+                case 0x07:  write8(ea, acc); nz8(acc);                      continue;   // STA
+                case 0x08:  acc ^= mem[ea]; nz8(acc);                       continue;   // EOR
+                case 0x09:  acc = add8(acc, mem[ea], cc & CC_C);            continue;   // ADC
+                case 0x0A:  acc |= mem[ea]; nz8(acc);                       continue;   // ORA
+                case 0x0B:  acc = add8(acc, mem[ea], 0);                    continue;   // ADD
+                case 0x0C:
+                    if (op & 0x40) {                                                    // LDD
+                        setD(read16(ea));
+                        nz16(regD());
+                    }
+                    else                                                                // CPX
+                        sub16(x, read16(ea));
+                    continue;
+                case 0x0D:
+                    if (op & 0x40) {                                                    // STD
+                        write16(ea, regD());
+                        nz16(regD());
+                    }
+                    else {                                                              // BSR, JSR
+                        push16(progCounter);
+                        progCounter = ea;
+                    }
+                    continue;
+                case 0x0E:
+                    if (op & 0x40)
+                        x = read16(ea);                                                 // LDX
+                    else
+                        sp = read16(ea);                                                // LDS
+                    nz16((op & 0x40) ? x : sp);
+                    continue;
+                default:
+                    write16(ea, (op & 0x40) ? x : sp);                                  // STX, STS
+                    nz16((op & 0x40) ? x : sp);
+                    continue;
+                }
+            }
+
+            if (op >= 0x40) {
+                if ((op & 0x0F) == 0x0E) {                                              // JMP
+                    progCounter = ea;
+                    continue;
+                }
+                if (op < 0x50)
+                    a = modify(op, a);
+                else if (op < 0x60)
+                    b = modify(op, b);
+                else if ((op & 0x0F) == 0x0D)
+                    modify(op, mem[ea]);                                                // TST
+                else
+                    write8(ea, modify(op, mem[ea]));
+                continue;
+            }
+
+            if (d->mode == MODE_REL) {
+                if (condition(op))
+                    progCounter = ea;
+                continue;
+            }
+
+            switch (op) {
+            case 0x01:                                                  break;  // NOP
+            case 0x04:  flag(CC_C, b & 1); setD((UINT16)(regD() >> 1));         // LSRD
+                        nz16(regD()); flag(CC_V, (cc & CC_C) != 0);     break;
+            case 0x05: {                                                        // ASLD
+                        UINT16 d16 = regD();
+                        setD((UINT16)(d16 << 1)); nz16(regD());
+                        flag(CC_C, (d16 & 0x8000) != 0);
+                        flag(CC_V, (((d16 >> 15) ^ (d16 >> 14)) & 1) != 0);
+                        break;
+            }
+            case 0x06:  setCC(a);                                       break;  // TAP
+            case 0x07:  a = (UCHAR)(cc | 0xC0);                         break;  // TPA
+            case 0x08:  x++; flag(CC_Z, x == 0);                        break;  // INX
+            case 0x09:  x--; flag(CC_Z, x == 0);                        break;  // DEX
+            case 0x0A:  flag(CC_V, false);                              break;  // CLV
+            case 0x0B:  flag(CC_V, true);                               break;  // SEV
+            case 0x0C:  flag(CC_C, false);                              break;  // CLC
+            case 0x0D:  flag(CC_C, true);                               break;  // SEC
+            case 0x0E:  flag(CC_I, false);                              break;  // CLI
+            case 0x0F:  flag(CC_I, true);                               break;  // SEI
+            case 0x10:  a = sub8(a, b, 0);                              break;  // SBA
+            case 0x11:  sub8(a, b, 0);                                  break;  // CBA
+            case 0x16:  b = a; nz8(b);                                  break;  // TAB
+            case 0x17:  a = b; nz8(a);                                  break;  // TBA
+            case 0x19: {                                                        // DAA
+                        UINT32 adjust = 0;
+                        bool carry = (cc & CC_C) != 0;
+                        if ((cc & CC_H) || (a & 0x0F) > 9)
+                            adjust |= 0x06;
+                        if (carry || a > 0x99 || ((a >> 4) >= 9 && (a & 0x0F) > 9))
+                            adjust |= 0x60;
+                        UINT32 r = a + adjust;
+                        a = (UCHAR)r;
+                        nz8(a);
+                        flag(CC_C, carry || r > 0xFF);
+                        break;
+            }
+            case 0x1B:  a = add8(a, b, 0);                              break;  // ABA
+            case 0x30:  x = (UINT16)(sp + 1);                           break;  // TSX
+            case 0x31:  sp++;                                           break;  // INS
+            case 0x32:  a = pull8();                                    break;  // PULA
+            case 0x33:  b = pull8();                                    break;  // PULB
+            case 0x34:  sp--;                                           break;  // DES
+            case 0x35:  sp = (UINT16)(x - 1);                           break;  // TXS
+            case 0x36:  push8(a);                                       break;  // PSHA
+            case 0x37:  push8(b);                                       break;  // PSHB
+            case 0x38:  x = pull16();                                   break;  // PULX
+            case 0x39:  progCounter = pull16();                         break;  // RTS
+            case 0x3A:  x = (UINT16)(x + b);                            break;  // ABX
+            case 0x3B:  cc = (UCHAR)(pull8() | 0xC0); b = pull8();              // RTI
+                        a = pull8(); x = pull16(); progCounter = pull16(); break;
+            case 0x3C:  push16(x);                                      break;  // PSHX
+            case 0x3D:  setD((UINT16)(a * b)); flag(CC_C, (b & 0x80) != 0); break;  // MUL
+            case 0x3E:  progCounter = (UINT16)(progCounter - 1);                // WAI
+                        return EMU_WAIT;
+            case 0x3F:  interrupt(0xFFFA);                              break;  // SWI
+            }
+        }
+    }
+
+    Emulator6803 (const Emulator6803 &);                    // not copyable
+    Emulator6803 &operator= (const Emulator6803 &);
+
+    UCHAR                   a, b, cc;
+    UINT16                  x, sp, progCounter;
+    UINT32                  cycleCount;
+    std::vector<UCHAR>      mem;
+    std::vector<Decoded>    decoded;        // one entry per PROM address
+};
+
+#endif // EMULATOR_6803_H
@@ -0,0 +1,241 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Code Models - Engine Plant
+//
+//  A deliberately simple mean value model of the Rover V8, enough to close the loop around
+//  the ECU models in the co-simulation: throttle and RPM set the air flow, the injector
+//  pulses from the ECU set the fuel flow, and the mixture, air flow and load torque set
+//  how the RPM changes.
+//
+//      fill        cylinder filling (0 to 1), 1 - exp(-area / (breathing x RPM / 6000)),
+//                  lagged by two revolutions (manifold filling)
+//      area        idle bypass plus throttle area (throttle squared, 0 to 1)
+//      air flow    fill x displacement x air density x RPM / 120 (g/s)
+//      fuel flow   injected fuel, 4 injectors per bank event, filtered over two
+//                  revolutions (g/s)
+//      lambda      air flow / (fuel flow x vaporized x 14.7)
+//      vaporized   fraction of the fuel that burns, 1 - coldFuelLoss x (warmTemp - coolant),
+//                  the rest wets the cold port walls (which is what the ECU's coolant
+//                  enrichment makes up for)
+//      torque      torquePerFill x fill x burn(lambda) - pumping x (1 - fill)
+//                  - friction - load
+//
+//  burn(lambda) peaks at lambda 0.9 and drops to zero below 0.6 and above 1.6 (misfire).
+//  The defaults idle at about 750 RPM with no load and the bypass at 2% of the throttle
+//  area, and give around 6 g/s of air at idle and 180 g/s at full throttle and 6000 RPM.
+//  The injector flow is set so that R3526 (map 5) runs close to lambda 1 at a warm idle
+//  with the MAF scale the co-simulation uses.
+//  Cranking isn't modeled: below PLANT_STALL_RPM the engine has stalled and stays stopped.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ENGINE_PLANT_H
+#define ENGINE_PLANT_H
+
+#include <math.h>
+
+#include "CuxTypes.h"
+
+
+#define PLANT_SPARKS_PER_REV        4       // V8
+#define PLANT_INJECTORS_PER_BANK    4
+#define PLANT_STOICH_AFR            14.7
+#define PLANT_MAX_RPM               7000.0
+#define PLANT_STALL_RPM             60.0
+#define PLANT_LEAN_LIMIT            9.99    // lambda reported with no fuel
+
+
+struct PlantParams
+{
+    double  displacement;                   // litres
+    double  airDensity;                     // g/litre
+    double  inertia;                        // kg m^2 (engine, flywheel and clutch)
+    double  torquePerFill;                  // Nm at full fill and best mixture
+    double  pumpingTorque;                  // Nm at closed throttle
+    double  frictionTorque;                 // Nm at 0 RPM
+    double  frictionPerRpm;                 // Nm per RPM
+    double  bypassArea;                     // idle air, fraction of the full throttle area
+    double  breathing;                      // see fill above
+    double  injectorFlow;                   // g/s per injector, fully open
+    double  injectorDeadTime;               // us before an injector starts to flow
+    double  warmTemp;                       // deg C, all of the fuel vaporizes
+    double  coldFuelLoss;                   // fraction lost per deg C below warmTemp
+};
+
+inline PlantParams defaultPlantParams (void)
+{
+    PlantParams p;
+
+    p.displacement = 3.95;
+    p.airDensity = 1.2;
+    p.inertia = 0.25;
+    p.torquePerFill = 355.0;
+    p.pumpingTorque = 60.0;
+    p.frictionTorque = 20.0;
+    p.frictionPerRpm = 0.0095;
+    p.bypassArea = 0.02;
+    p.breathing = 0.68;
+    p.injectorFlow = 2.4;
+    p.injectorDeadTime = 700.0;
+    p.warmTemp = 80.0;
+    p.coldFuelLoss = 0.005;
+
+    return p;
+}
+
+// What the drive script sets at any moment
+struct PlantInputs
+{
+    double  throttle;                       // 0 to 1
+    double  loadTorque;                     // Nm at the crank
+    double  coolantTemp;                    // deg C
+};
+
+
+class EnginePlant
+{
+public:
+    EnginePlant (const PlantParams &p) : params(p)
+    {
+        reset(750.0, 0.0);
+    }
+
+    // Start running at this RPM and throttle with the mixture at stoichiometric
+    void reset (double startRpm, double throttle)
+    {
+        speed = startRpm;
+        fillFraction = fillTarget(throttle);
+        airRate = airFlowFor(fillFraction);
+        fuelRate = airRate / PLANT_STOICH_AFR;
+        pendingFuel = 0.0;
+        totalFuel = 0.0;
+        netTorque = 0.0;
+        vaporized = 1.0;
+        stopped = false;
+    }
+
+    // One bank's injectors open for pulseUs (microseconds)
+    void inject (double pulseUs)
+    {
+        double open = pulseUs - params.injectorDeadTime;
+
+        if (open <= 0.0 || stopped)
+            return;
+
+        double grams = PLANT_INJECTORS_PER_BANK * params.injectorFlow * open / 1e6;
+
+        pendingFuel += grams;
+        totalFuel += grams;
+    }
+
+    // The idle bypass (IACV) area, fraction of the full throttle area
+    void setBypassArea (double area)
+    {
+        params.bypassArea = area;
+    }
+
+    // Advance dt seconds
+    void step (double dt, const PlantInputs &in)
+    {
+        if (stopped)
+            return;
+
+        double revTime = 120.0 / speed;     // two revolutions
+
+        fillFraction += (fillTarget(in.throttle) - fillFraction) * lag(dt, revTime);
+        airRate = airFlowFor(fillFraction);
+
+        fuelRate += (pendingFuel / dt - fuelRate) * lag(dt, revTime);
+        pendingFuel = 0.0;
+
+        vaporized = 1.0 - params.coldFuelLoss * (params.warmTemp - in.coolantTemp);
+        if (vaporized > 1.0)
+            vaporized = 1.0;
+        if (vaporized < 0.5)
+            vaporized = 0.5;
+
+        netTorque = params.torquePerFill * fillFraction * burn(lambda())
+                  - params.pumpingTorque * (1.0 - fillFraction)
+                  - params.frictionTorque - params.frictionPerRpm * speed
+                  - in.loadTorque;
+
+        speed += netTorque / params.inertia * dt * 60.0 / (2.0 * M_PI);
+
+        if (speed > PLANT_MAX_RPM)
+            speed = PLANT_MAX_RPM;
+
+        if (speed < PLANT_STALL_RPM) {
+            speed = 0.0;
+            airRate = fuelRate = 0.0;
+            stopped = true;
+        }
+    }
+
+    double rpm (void) const             { return speed; }
+    double fill (void) const            { return fillFraction; }
+    double airFlow (void) const         { return airRate; }
+    double fuelFlow (void) const        { return fuelRate; }
+    double torque (void) const          { return netTorque; }
+    double fuelUsed (void) const        { return totalFuel; }
+    double vaporizedFraction (void) const   { return vaporized; }
+    bool stalled (void) const           { return stopped; }
+
+    double lambda (void) const
+    {
+        if (fuelRate <= 0.0)
+            return PLANT_LEAN_LIMIT;
+
+        double l = airRate / (fuelRate * vaporized * PLANT_STOICH_AFR);
+
+        return (l < PLANT_LEAN_LIMIT) ? l : PLANT_LEAN_LIMIT;
+    }
+
+    // Time to the next spark at the present speed (microseconds)
+    double sparkInterval (void) const
+    {
+        return 60e6 / (speed * PLANT_SPARKS_PER_REV);
+    }
+
+private:
+    double fillTarget (double throttle) const
+    {
+        double area = params.bypassArea + (1.0 - params.bypassArea) * throttle * throttle;
+        double rpm = (speed > 100.0) ? speed : 100.0;
+
+        return 1.0 - exp(-area / (params.breathing * rpm / 6000.0));
+    }
+
+    double airFlowFor (double f) const
+    {
+        return f * params.displacement * params.airDensity * speed / 120.0;
+    }
+
+    static double lag (double dt, double tau)
+    {
+        return (dt < tau) ? dt / tau : 1.0;
+    }
+
+    static double burn (double l)
+    {
+        if (l < 0.6 || l > 1.6)
+            return 0.0;
+
+        double b = 1.0 - 1.2 * (l - 0.9) * (l - 0.9);
+
+        return (b > 0.0) ? b : 0.0;
+    }
+
+    PlantParams params;
+
+    double  speed;                          // RPM
+    double  fillFraction;
+    double  airRate;                        // g/s
+    double  fuelRate;                       // g/s, filtered
+    double  pendingFuel;                    // g injected since the last step
+    double  totalFuel;                      // g
+    double  netTorque;                      // Nm
+    double  vaporized;
+    bool    stopped;
+};
+
+#endif // ENGINE_PLANT_H
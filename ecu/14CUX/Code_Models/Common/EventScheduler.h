@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Code Models - Discrete Event Scheduler
+//
+//  A time ordered queue of events for the co-simulation (CoSimulation.h). Time is in
+//  microseconds from the start of the run, the same unit as the 6803's 1 MHz free running
+//  counter. Events are plain numbers that the owner dispatches on, so the scheduler knows
+//  nothing about the engine or the ECU.
+//
+//  Events due at the same microsecond come out in the order they were scheduled, so a run
+//  depends only on its inputs and not on how the heap happens to order equal keys.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef EVENT_SCHEDULER_H
+#define EVENT_SCHEDULER_H
+
+#include <queue>
+#include <vector>
+
+#include "CuxTypes.h"
+
+
+struct SimEvent
+{
+    UINT64  time;                           // microseconds
+    UINT64  seq;                            // order scheduled (ties)
+    int     type;
+};
+
+
+class EventScheduler
+{
+public:
+    EventScheduler ()                   { reset(); }
+
+    void reset (void)
+    {
+        queue = EventQueue();
+        current = 0;
+        nextSeq = 0;
+        dispatched = 0;
+    }
+
+    UINT64 now (void) const             { return current; }
+    UINT64 dispatchedCount (void) const { return dispatched; }
+    size_t pending (void) const         { return queue.size(); }
+
+    // Schedule at an absolute time (never earlier than now)
+    void at (UINT64 time, int type)
+    {
+        SimEvent ev;
+
+        ev.time = (time < current) ? current : time;
+        ev.seq = nextSeq++;
+        ev.type = type;
+
+        queue.push(ev);
+    }
+
+    void after (UINT64 delay, int type) { at(current + delay, type); }
+
+    // Take the next event due at or before endTime and move the clock to it.
+    // Returns false when there is none (the clock is then left at endTime).
+    bool next (SimEvent &ev, UINT64 endTime)
+    {
+        if (queue.empty() || queue.top().time > endTime) {
+            current = endTime;
+            return false;
+        }
+
+        ev = queue.top();
+        queue.pop();
+
+        current = ev.time;
+        dispatched++;
+
+        return true;
+    }
+
+private:
+    struct Later
+    {
+        bool operator() (const SimEvent &a, const SimEvent &b) const
+        {
+            return (a.time != b.time) ? a.time > b.time : a.seq > b.seq;
+        }
+    };
+
+    typedef std::priority_queue<SimEvent, std::vector<SimEvent>, Later> EventQueue;
+
+    EventQueue  queue;
+    UINT64      current;
+    UINT64      nextSeq;
+    UINT64      dispatched;
+};
+
+#endif // EVENT_SCHEDULER_H
@@ -0,0 +1,239 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Fuel Map Interpolation Model
+//
+//  This is the next step after the row and column index models. The spark interrupt takes
+//  the load based row index (fuelMapLoadIdx, $00 to $70) and the RPM based column index
+//  (fuelMapSpeedIdx or X005C, $00 to $F0+) and interpolates between the four fuel map
+//  values that surround the point. The upper nibble of each index selects the map cell and
+//  the lower nibble is the position within the cell in 1/16 steps, so each of the four map
+//  values is weighted by the area of the opposite corner:
+//
+//      UL * (16 - r) * (16 - c)  +  UR * (16 - r) * c  +  LL * r * (16 - c)  +  LR * r * c
+//
+//  with a total weight of 256. The result is the 16-bit uncompensated fueling value (a map
+//  value of $xx gives $xx00 when the point is exactly on it).
+//
+//  The translation keeps the quirks of the original:
+//
+//      - If the upper left cell is the first one in the map (offset zero) the code uses
+//        offset $60 instead (row 6, column 0). This looks like a guard against a bad map
+//        pointer but it means the top left cell is never read.
+//
+//      - The upper left weight (16 - r) * (16 - c) is formed with an 8-bit mul, so when
+//        both nibbles are zero it is $100 and the product is taken as zero. The code then
+//        falls back to returning the upper left map value in A, which happens to give the
+//        right answer. The same fall back is taken whenever the upper left contribution is
+//        zero, so a zero in the map there (never seen in a real tune) would zero the result
+//        regardless of the other three cells.
+//
+//      - At the bottom row or right column the code still reads the next row or column
+//        (with a zero weight), so the map pointer must have at least FUEL_MAP_INTERP_SIZE
+//        readable bytes. TuneImage::fuelMap() pointers always do.
+//
+//  The MAF fault substitution (TPS and coolant based) and the filtering that follow in
+//  ignitionInt.asm are not modelled here.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+;---------------------------------------------------------------------------------------------------
+;	         Use Row and Column Indexes to calculate 16-bit Fueling Value from Table
+;
+; This code section is executed only when the MAF fault bit is not set. The index register (X)
+; contains the fuel map address pointer. The value is calculated here by first calculating the
+; contribution of each of the 4 table values surrounding the actual fueling point and then adding
+; the four values.
+;
+;---------------------------------------------------------------------------------------------------
+.LE8C0          ldaa        fuelMapLoadIdx      ; load fuel map row index ($70 max)
+                anda        #$F0                ; mask upper nibble (4-bit row index)
+                ldab        fuelMapSpeedIdx     ; load fuel map column index ($F0 max)
+                lsrb                            ; shift upper nibble of column index into low position
+                lsrb
+                lsrb
+                lsrb
+                aba                             ; add B to A (offset of upper left corner of box)
+                tab                             ; xfr A to B (value range: 0x00 thru 0x7F)
+                bne         .LE8D0              ; branch if not zero
+
+                ldab        #$60                ; else, it was zero so load $60 as default
+
+.LE8D0          abx                             ; X = fuelMapPtr, add offset into map
+
+                ldaa        fuelMapSpeedIdx     ; load column index
+                anda        #$0F                ; mask lower nibble of the column index
+                staa        $00C9               ; and store it in X00C9
+                ldaa        fuelMapLoadIdx      ; load row index
+                anda        #$0F                ; mask lower nibble of the row index
+                staa        $00C8               ; and store it in X00C8
+                ldaa        #$10                ; load A with 16 decimal
+                tab                             ; transfer it to B
+                suba        $00C8               ; subtract X00C8 from $10
+                subb        $00C9               ; subtract X00C9 from $10
+                std         $00C8               ; store A at X00C8 and B at X00C9
+                mul                             ; mpy A and B (value should be <= $FF and contained in B only)
+                ldaa        $00,x               ; load upper left value from map into A
+                mul                             ; mpy A and B
+                std         $00CC               ; store 16-bits at X00CC/CD (upper left contribution value)
+
+                bne         .LE8F7              ; branch ahead if result is not zero
+                ldaa        $00,x               ; if zero, load value from map again
+                bra         .LE921              ; and branch to filtering section with this value
+
+.LE8F7          ldaa        fuelMapLoadIdx      ; load fuel map row index
+                anda        #$0F                ; mask to get low nibble
+                ldab        $00C9               ; X00C9 is $10 minus lower nibble of column index
+                mul                             ; multiply the two 4-bit values
+                ldaa        $10,x               ; get value from next row in table (same column)
+                mul                             ; multiply table value by B
+                std         $00CE               ; store 16-bits at X00CE/CF (lower left contribution value)
+
+                ldaa        $00C8               ; load high byte of previous multiply
+                ldab        fuelMapSpeedIdx     ; load fuel map column index
+                andb        #$0F                ; mask to get low nibble
+                mul                             ; multiply
+                ldaa        $01,x               ; get value from next column up in table
+                mul                             ; multiply
+                std         $00C8               ; store 16-bits at X00C8/C9 (upper right contribution value)
+
+                ldaa        fuelMapSpeedIdx     ; load fuel map column index
+                anda        #$0F                ; mask to get low nibble
+                ldab        fuelMapLoadIdx      ; load fuel map row index
+                andb        #$0F                ; mask to get low nibble
+                mul                             ; multiply (result < $FF so it's contained in B only))
+                ldaa        $11,x               ; load value from next row and column
+                mul                             ; multiply (AB = lower right contribution value)
+
+                addd        $00CC               ; add upper left  contribution
+                addd        $00C8               ; add upper right contribution
+                addd        $00CE               ; add lower left  contribution
+
+.LE921          std         $00CE               ; store the uncompensated fueling value
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef FUEL_MAP_VALUE_H
+#define FUEL_MAP_VALUE_H
+
+#include "CuxTypes.h"
+#include "Registers6803.h"
+#include "PathCounters.h"
+
+
+#define FUEL_MAP_INTERP_SIZE    0x91        // bytes read from the map (up to $7F + $11)
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  fuelMapValue_6803
+//
+//  Literal translation. fuelMap points to the start of the fuel map (the
+//  value in fuelMapPtr, see TuneImage::fuelMap()).
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT16 fuelMapValue_6803 (Cpu6803 &cpu, UINT8 fuelMapLoadIdx, UCHAR fuelMapSpeedIdx,
+                                 const UCHAR *fuelMap)
+{
+    ABunion &reg = cpu.reg;
+    memUnion &mem = cpu.mem;
+    const UCHAR *x;
+    UINT16 X00CC, X00CE;
+
+    PATH_ENTRY(PATH_LE8C0);
+    reg.r[A] = fuelMapLoadIdx;                      // ldaa        fuelMapLoadIdx
+    reg.r[A] &= 0xF0;                               // anda        #$F0
+    reg.r[B] = fuelMapSpeedIdx;                     // ldab        fuelMapSpeedIdx
+    reg.r[B] >>= 4;                                 // lsrb (x4)
+    reg.r[A] += reg.r[B];                           // aba
+    reg.r[B] = reg.r[A];                            // tab
+    if (reg.r[B] == 0) {                            // bne         .LE8D0
+        PATH_COUNT(PATH_LE8C0_CELL_60);
+        reg.r[B] = 0x60;                            // ldab        #$60
+    }
+
+    PATH_COUNT(PATH_LE8D0);
+
+    x = fuelMap + reg.r[B];                         // .LE8D0      abx
+
+    reg.r[A] = fuelMapSpeedIdx & 0x0F;              // ldaa/anda
+    mem.m[C9] = reg.r[A];                           // staa        $00C9
+    reg.r[A] = fuelMapLoadIdx & 0x0F;               // ldaa/anda
+    mem.m[C8] = reg.r[A];                           // staa        $00C8
+    reg.r[A] = 0x10;                                // ldaa        #$10
+    reg.r[B] = reg.r[A];                            // tab
+    reg.r[A] -= mem.m[C8];                          // suba        $00C8
+    reg.r[B] -= mem.m[C9];                          // subb        $00C9
+    mem.m[C8] = reg.r[A];                           // std         $00C8
+    mem.m[C9] = reg.r[B];
+    reg.ab = (UINT16)(reg.r[A] * reg.r[B]);         // mul
+    reg.r[A] = x[0x00];                             // ldaa        $00,x
+    reg.ab = (UINT16)(reg.r[A] * reg.r[B]);         // mul
+    X00CC = reg.ab;                                 // std         $00CC
+
+    if (reg.ab == 0) {                              // bne         .LE8F7
+        PATH_COUNT(PATH_LE8D0_CORNER);
+        reg.r[A] = x[0x00];                         // ldaa        $00,x
+        return (reg.ab);                            // bra         .LE921
+    }
+
+    PATH_COUNT(PATH_LE8F7);
+    reg.r[A] = fuelMapLoadIdx & 0x0F;               // .LE8F7      ldaa/anda
+    reg.r[B] = mem.m[C9];                           // ldab        $00C9
+    reg.ab = (UINT16)(reg.r[A] * reg.r[B]);         // mul
+    reg.r[A] = x[0x10];                             // ldaa        $10,x
+    reg.ab = (UINT16)(reg.r[A] * reg.r[B]);         // mul
+    X00CE = reg.ab;                                 // std         $00CE
+
+    reg.r[A] = mem.m[C8];                           // ldaa        $00C8
+    reg.r[B] = fuelMapSpeedIdx & 0x0F;              // ldab/andb
+    reg.ab = (UINT16)(reg.r[A] * reg.r[B]);         // mul
+    reg.r[A] = x[0x01];                             // ldaa        $01,x
+    reg.ab = (UINT16)(reg.r[A] * reg.r[B]);         // mul
+    mem.c8c9 = reg.ab;                              // std         $00C8
+
+    reg.r[A] = fuelMapSpeedIdx & 0x0F;              // ldaa/anda
+    reg.r[B] = fuelMapLoadIdx & 0x0F;               // ldab/andb
+    reg.ab = (UINT16)(reg.r[A] * reg.r[B]);         // mul
+    reg.r[A] = x[0x11];                             // ldaa        $11,x
+    reg.ab = (UINT16)(reg.r[A] * reg.r[B]);         // mul
+
+    reg.ab += X00CC;                                // addd        $00CC
+    reg.ab += mem.c8c9;                             // addd        $00C8
+    reg.ab += X00CE;                                // addd        $00CE
+
+    return (reg.ab);                                // .LE921      std         $00CE
+}
+
+// same, using a private set of registers
+inline UINT16 fuelMapValue_6803 (UINT8 fuelMapLoadIdx, UCHAR fuelMapSpeedIdx, const UCHAR *fuelMap)
+{
+    Cpu6803 cpu;
+
+    return fuelMapValue_6803 (cpu, fuelMapLoadIdx, fuelMapSpeedIdx, fuelMap);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  fuelMapValue_C
+//
+//  The same calculation written out directly. Bit-exact with the literal
+//  version, including the quirks listed at the top of this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT16 fuelMapValue_C (UINT8 fuelMapLoadIdx, UCHAR fuelMapSpeedIdx, const UCHAR *fuelMap)
+{
+    UINT8 offset = (UINT8)((fuelMapLoadIdx & 0xF0) + (fuelMapSpeedIdx >> 4));
+    const UCHAR *x = fuelMap + (offset ? offset : 0x60);
+    UINT16 r = fuelMapLoadIdx & 0x0F;
+    UINT16 c = fuelMapSpeedIdx & 0x0F;
+    UINT16 upperLeft = (UINT16)((((16 - r) * (16 - c)) & 0xFF) * x[0x00]);
+
+    if (upperLeft == 0)
+        return (UINT16)(x[0x00] << 8);
+
+    return (UINT16)(upperLeft + (16 - r) * c * x[0x01] + r * (16 - c) * x[0x10] + r * c * x[0x11]);
+}
+
+#endif // FUEL_MAP_VALUE_H
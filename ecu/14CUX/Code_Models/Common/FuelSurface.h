@@ -0,0 +1,251 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Fused Fueling Model
+//
+//  Goes from (mafSum, ignition period) to the uncompensated fuel map value in one step,
+//  chaining the MAF linearization, the row and column index models and the fuel map
+//  interpolation. Every stage is bit-exact with the literal models:
+//
+//      linearizeMAF_6803   ->  linearizeMAF_Scalar / linearizeMAF_Batch (MafLinearizeBatch.h)
+//      Calculate_Row_Index ->  rowIndex_Scalar and the SIMD kernels below
+//      getColumnIndex      ->  ColumnIndexTable
+//      fuelMapValue_6803   ->  fuelMapValue_C, or a per-column table (see below)
+//
+//  The row index works out to
+//
+//      t = mpy16(period, linearMAF)        (see mpy16_C in MafRowIndex.h)
+//      t < XC1C7                   ->  $00
+//      (t - XC1C7) >> 1 >= $100    ->  $70
+//      otherwise                   ->  min((X200A * ((t - XC1C7) >> 1)) >> 8, $70)
+//
+//  which maps onto 16-bit SIMD lanes. mpy16 is not a mulhi_epu16: it adds up three 8 x 8
+//  partial products (the low x low one is dropped), each of which fits in a lane.
+//
+//  For a whole surface the column index, and so the column part of the interpolation,
+//  only depends on the ignition period. buildSurface() therefore works one period at a
+//  time: it interpolates the 113 possible row indexes ($00 to $70) once for that column,
+//  runs the row index kernel over all the MAF sums and finishes with a table lookup.
+//
+//  A FuelModel copies the fuel map and expands the RPM table, so it doesn't depend on
+//  the TuneImage staying open and can be shared by any number of threads.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef FUEL_SURFACE_H
+#define FUEL_SURFACE_H
+
+#include <string.h>
+#include <vector>
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+#include "MafRowIndex.h"
+#include "MafLinearizeBatch.h"
+#include "ColumnIndexTable.h"
+#include "FuelMapValue.h"
+
+
+#define ROW_INDEX_MAX           0x70
+#define ROW_INDEX_COUNT         (ROW_INDEX_MAX + 1)
+
+
+typedef void (*RowIndexKernel)(UINT16 period, const UINT16 *linearMAF, UINT16 *rowIndex,
+                               size_t count, const PromConstants &prom);
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Row index kernels (one ignition period, many linearized MAF values)
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT8 rowIndex_Scalar (UINT16 period, UINT16 linearMAF, const PromConstants &prom)
+{
+    UINT16 t = mpy16_C(period, linearMAF);
+
+    if (t < prom.XC1C7)
+        return 0;
+
+    t = (UINT16)((t - prom.XC1C7) >> 1);
+
+    if (t >> 8)
+        return ROW_INDEX_MAX;
+
+    t = (UINT16)((prom.X200A * t) >> 8);
+
+    return (UINT8)((t < ROW_INDEX_MAX) ? t : ROW_INDEX_MAX);
+}
+
+inline void rowIndex_BatchScalar (UINT16 period, const UINT16 *linearMAF, UINT16 *rowIndex,
+                                  size_t count, const PromConstants &prom)
+{
+    for (size_t i = 0; i < count; i++)
+        rowIndex[i] = rowIndex_Scalar(period, linearMAF[i], prom);
+}
+
+
+#if MAF_BATCH_X86
+
+inline void rowIndex_BatchSSE2 (UINT16 period, const UINT16 *linearMAF, UINT16 *rowIndex,
+                                size_t count, const PromConstants &prom)
+{
+    const __m128i pHigh = _mm_set1_epi16(period >> 8);
+    const __m128i pLow = _mm_set1_epi16(period & 0xFF);
+    const __m128i c1c7 = _mm_set1_epi16((short)prom.XC1C7);
+    const __m128i x200a = _mm_set1_epi16(prom.X200A);
+    const __m128i lowByte = _mm_set1_epi16(0x00FF);
+    const __m128i rowMax = _mm_set1_epi16(ROW_INDEX_MAX);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i m = _mm_loadu_si128((const __m128i *)(linearMAF + i));
+        __m128i mHigh = _mm_srli_epi16(m, 8);
+        __m128i hiLo = _mm_mullo_epi16(pHigh, _mm_and_si128(m, lowByte));
+        __m128i loHi = _mm_add_epi16(_mm_mullo_epi16(pLow, mHigh), _mm_and_si128(hiLo, lowByte));
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(pHigh, mHigh),
+                                  _mm_add_epi16(_mm_srli_epi16(hiLo, 8), _mm_srli_epi16(loHi, 8)));
+
+        t = _mm_srli_epi16(_mm_subs_epu16(t, c1c7), 1);             // zero if t <= XC1C7
+        __m128i inRange = _mm_cmpeq_epi16(_mm_srli_epi16(t, 8), zero);
+        t = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(t, lowByte), x200a), 8);
+        t = _mm_or_si128(t, _mm_andnot_si128(inRange, lowByte));   // >= $100 -> $70 below
+        t = _mm_min_epi16(t, rowMax);
+
+        _mm_storeu_si128((__m128i *)(rowIndex + i), t);
+    }
+
+    rowIndex_BatchScalar(period, linearMAF + i, rowIndex + i, count - i, prom);
+}
+
+MAF_TARGET_AVX2 inline void rowIndex_BatchAVX2 (UINT16 period, const UINT16 *linearMAF,
+                                                UINT16 *rowIndex, size_t count,
+                                                const PromConstants &prom)
+{
+    const __m256i pHigh = _mm256_set1_epi16(period >> 8);
+    const __m256i pLow = _mm256_set1_epi16(period & 0xFF);
+    const __m256i c1c7 = _mm256_set1_epi16((short)prom.XC1C7);
+    const __m256i x200a = _mm256_set1_epi16(prom.X200A);
+    const __m256i lowByte = _mm256_set1_epi16(0x00FF);
+    const __m256i rowMax = _mm256_set1_epi16(ROW_INDEX_MAX);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m256i m = _mm256_loadu_si256((const __m256i *)(linearMAF + i));
+        __m256i mHigh = _mm256_srli_epi16(m, 8);
+        __m256i hiLo = _mm256_mullo_epi16(pHigh, _mm256_and_si256(m, lowByte));
+        __m256i loHi = _mm256_add_epi16(_mm256_mullo_epi16(pLow, mHigh), _mm256_and_si256(hiLo, lowByte));
+        __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(pHigh, mHigh),
+                                     _mm256_add_epi16(_mm256_srli_epi16(hiLo, 8), _mm256_srli_epi16(loHi, 8)));
+
+        t = _mm256_srli_epi16(_mm256_subs_epu16(t, c1c7), 1);
+        __m256i inRange = _mm256_cmpeq_epi16(_mm256_srli_epi16(t, 8), zero);
+        t = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(t, lowByte), x200a), 8);
+        t = _mm256_or_si256(t, _mm256_andnot_si256(inRange, lowByte));
+        t = _mm256_min_epi16(t, rowMax);
+
+        _mm256_storeu_si256((__m256i *)(rowIndex + i), t);
+    }
+
+    rowIndex_BatchScalar(period, linearMAF + i, rowIndex + i, count - i, prom);
+}
+
+#endif // MAF_BATCH_X86
+
+
+inline RowIndexKernel selectRowIndexKernel (void)
+{
+#if MAF_BATCH_X86
+    if (cpuHasAVX2())
+        return rowIndex_BatchAVX2;
+    return rowIndex_BatchSSE2;
+#else
+    return rowIndex_BatchScalar;
+#endif
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  FuelModel
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+class FuelModel
+{
+public:
+    FuelModel (const PromConstants &prom, const UCHAR *rpmTable, const UCHAR *fuelMap)
+    {
+        setup(prom, rpmTable, fuelMap);
+    }
+
+    FuelModel (const TuneImage &tune, int mapNumber)
+    {
+        setup(tune.constants(mapNumber), tune.rpmTable(), tune.fuelMap(mapNumber));
+    }
+
+    const PromConstants &constants (void) const         { return prom; }
+    const ColumnIndexTable &columnTable (void) const    { return columns; }
+    const UCHAR *fuelMap (void) const                   { return map; }
+
+    // The whole chain for one point
+    UINT16 fuelValue (UINT16 mafSum, UINT16 period) const
+    {
+        UINT16 linearMAF = linearizeMAF_Scalar(mafSum, prom);
+
+        return fuelMapValue_C(rowIndex_Scalar(period, linearMAF, prom), columns.colIndex(period), map);
+    }
+
+    // Fuel value for every row index at this period's column ($00 to $70)
+    void columnValues (UINT16 period, UINT16 *fuelByRow) const
+    {
+        UCHAR colIndex = columns.colIndex(period);
+
+        for (int row = 0; row < ROW_INDEX_COUNT; row++)
+            fuelByRow[row] = fuelMapValue_C((UINT8)row, colIndex, map);
+    }
+
+    // Evaluate every (period, mafSum) pair. The outputs are periodCount rows
+    // of mafCount values; rowIndex may be null.
+    void buildSurface (const UINT16 *period, size_t periodCount, const UINT16 *mafSum,
+                       size_t mafCount, UINT16 *fuel, UINT8 *rowIndex = 0) const
+    {
+        static const RowIndexKernel kernel = selectRowIndexKernel();
+        std::vector<UINT16> linearMAF(mafCount);
+        std::vector<UINT16> rows(mafCount);
+        UINT16 fuelByRow[ROW_INDEX_COUNT];
+
+        linearizeMAF_Batch(mafSum, linearMAF.data(), mafCount, prom);
+
+        for (size_t p = 0; p < periodCount; p++) {
+
+            UINT16 *fuelOut = fuel + p * mafCount;
+
+            columnValues(period[p], fuelByRow);
+            kernel(period[p], linearMAF.data(), rows.data(), mafCount, prom);
+
+            for (size_t m = 0; m < mafCount; m++)
+                fuelOut[m] = fuelByRow[rows[m]];
+
+            if (rowIndex)
+                for (size_t m = 0; m < mafCount; m++)
+                    rowIndex[p * mafCount + m] = (UINT8)rows[m];
+        }
+    }
+
+private:
+    void setup (const PromConstants &k, const UCHAR *rpmTable, const UCHAR *fuelMap)
+    {
+        prom = k;
+        memcpy(map, fuelMap, FUEL_MAP_INTERP_SIZE);
+        columns.build(rpmTable);
+    }
+
+    FuelModel (const FuelModel &);              // not copyable (owns the lookup table)
+    FuelModel &operator= (const FuelModel &);
+
+    PromConstants       prom;
+    UCHAR               map[FUEL_MAP_INTERP_SIZE];
+    ColumnIndexTable    columns;
+};
+
+#endif // FUEL_SURFACE_H
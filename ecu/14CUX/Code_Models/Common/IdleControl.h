@@ -0,0 +1,2060 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Idle Air Control (Stepper Motor) Models
+//
+//  Literal translations of the routines that set the idle speed target and drive the idle
+//  air control valve (IACV), from idleControl.asm, stepperMtr2.asm and the end of the main
+//  loop (mainLoop.asm):
+//
+//      idleCoolantDelta    LD609, the coolant temperature part of the idle target
+//                          (2 x (ECT - $27), zero when hotter than $27)
+//      addIdleTarget       .LD602, adds AB to the target (X00CE and targetIdleRPM) and
+//                          falls through into LD609
+//      idleControl         LD613, called at the end of each ADC mux list and (while X0087.2
+//                          is clear) every 81st main loop pass. The target from
+//                          baseIdleSetting, idleAdjForAC, idleAdjForNeutral,
+//                          idleAdjForHeatedScreen and LD609, the coolant based valve value
+//                          X006E, the power on positioning of the valve, the step counts
+//                          for A/C, heated screen and drive changes (X00AE), and the closed
+//                          loop: one step for every 14 RPM ($C173) of error, up to $14
+//                          ($C169), with X00B3 as the wait before the next correction
+//      driveIacMotor       one step of the valve when the step interval (6250 or 3125 us of
+//                          the free running counter) has passed: P1.5:4, iacPosition (1 to
+//                          180, 180 is closed), X2053/54 and the direction latch X2038.0
+//      idleLoopTail        the end of the main loop from 'inc $207E' to .LCCF2 (the
+//                          driveIacMotor call): LF5F0, LF831 (fault code 48), LF611 and LF63A
+//                          (close 30 steps after running above 1670 RPM), the X204F/50 MAF
+//                          reference and LF8B4 (Calculate_X2048)
+//
+//  with the subroutines they call (LEE12, LF0D5, LF658, LF7F0, LDAD3, absoluteValAB and the
+//  indexIntoTable in CoolantFueling.h).
+//
+//  These routines share a lot of RAM, mostly bit flags that the rest of the firmware sets
+//  and clears, so they work on an IdleRam: the register and internal RAM page ($0000 to
+//  $00FF) and the external RAM page ($2000 to $20FF), indexed by the 6803 address. That
+//  is all the RAM they touch, and it is what the firmware check compares with the real
+//  code running in the emulator (../Firmware_Check, ../Idle_Sweep).
+//
+//  The PROM data they read ($C14F to $C266 and $C7D8 to $C7E3) sits at the same addresses
+//  in every reference tune, so IdleTables reads it straight from the image. Three things
+//  differ between the builds before R3360 (R3383 and the R2967 family) and the later
+//  ones, and loadIdleTables() reads them out of the code:
+//
+//      X204F limit         the clip on the 2048 x $C25C term, $05AB ($0640 before R3360)
+//      .LD6B9              the early builds clear X201F.5 when the neutral switch reads
+//                          drive (below $4D) or the middle voltage
+//      LF831               the later builds also test the O2 sensor faults (X0049), the
+//                          startup down-counter X201D and the short term trims, and want
+//                          the engine above the idle target + 200 ($C7E1)
+//
+//  The interrupt mask (sei/cli, tpa/tap) is left out; interrupts aren't modelled. The
+//  timer overflow flag is read but not cleared (that is a side effect of reading the
+//  counter on the real chip, not something the code does) so that the models match the
+//  emulator; the caller clears it.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+;--------------------------------------------------------------------
+;               Idle target  (idleControl.asm)
+;--------------------------------------------------------------------
+.LD602          addd        $00CE
+                std         $00CE
+                std         targetIdleRPM
+
+LD609           ldab        coolantTempCount    ; load ECT sensor counts
+                subb        #$27                ; compare with $27
+                bcc         .LD610              ; branch ahead if ECT >= $27 (cooler than)
+                clrb                            ; return 0-0 (when ECT is hotter than $27)
+.LD610          clra                            ; clear A
+                asld                            ; return (2 * (ECT - $27))
+                rts
+
+idleControl     ldd         baseIdleSetting
+                std         $00CE               ; general purpose location
+                ldaa        $008A               ; bits
+                bita        #$08                ; test 008A.3 (A/C related, usually set in road tests)
+                bne         .LD623              ; branch ahead if bit is set (meaning A/C is off)
+                ldd         idleAdjForAC
+                bsr         .LD602              ; branch to subroutine above to write value
+.LD623          ldab        $008A
+                bitb        #$20                ; test 008A.5 (0 = neutral or D90, 1 = drive for RR))
+                bne         .LD62E              ; branch ahead if bit is set
+                ldd         idleAdjForNeutral
+                bsr         .LD602              ; branch to subroutine above to add value and write
+.LD62E          ldab        $00DD               ; bits value
+                bitb        #$04                ; test 00DD.2 (heated screen sense, 1=OFF, 0=ON)
+                bne         .LD639              ; branch ahead if bit is set
+                ldd         idleAdjForHeatedScreen
+                bsr         .LD602              ; branch to subroutine above to add value and write
+.LD639          bsr         LD609               ; rtns coolant temp based idle delta (range zero to ~300)
+                bsr         .LD602              ; branch to sub (above) to add value and write
+
+;--------------------------------------------------------------------
+;               Step the valve  (driveIacMotor, idleControl.asm)
+;--------------------------------------------------------------------
+.LDA86          stab        iacPosition
+                ldaa        $00AE               ; (4 of 5)
+                beq         .LDA93              ;
+                bmi         .LDA90              ;
+                DB          $4A,$81             ; deca / cmpa #$4C when X00AE is positive
+.LDA90          DB          $4C                 ; inca when X00AE is negative
+                staa        $00AE               ; (5 of 5)
+
+LDAD3           cmpb        #$1E                ; a valid drive value is returned as it is,
+                beq         .LDAF3              ; otherwise one is made up from P1.5:4
+                cmpb        #$78
+                beq         .LDAF3
+                cmpb        #$E1
+                beq         .LDAF3
+                cmpb        #$87
+                beq         .LDAF3
+                ldab        port1data           ; bits 5:4 are stepper motor state
+                andb        #$30
+                beq         .LDAF4
+                cmpb        #$10
+                beq         .LDAF7
+                cmpb        #$20
+                beq         .LDAFA
+                ldab        #$78
+.LDAF3          rts
+.LDAF4          ldab        #$87
+                rts
+.LDAF7          ldab        #$1E
+                rts
+.LDAFA          ldab        #$E1
+                rts
+*/
+
+#ifndef IDLE_CONTROL_H
+#define IDLE_CONTROL_H
+
+#include <string.h>
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+#include "CoolantFueling.h"
+#include "Registers6803.h"
+
+
+#define ADDR_IDLE_ADJ_NEUTRAL       0xC159      // idleAdjForNeutral ($0064)
+#define ADDR_IDLE_ADJ_AC            0xC15B      // idleAdjForAC ($0032)
+#define ADDR_BASE_IDLE              0xC176      // baseIdleSetting ($0258 for R3526)
+#define ADDR_IDLE_COOLANT_TABLE     0xC17B      // 3 x 9: ECT count, base, slope
+#define ADDR_IDLE_ADJ_HEATED_SCREEN 0xC1E9      // idleAdjForHeatedScreen ($0000)
+
+#define IDLE_COOLANT_COLUMNS        9
+#define IDLE_HOT_ECT                0x27        // LD609, no coolant delta when hotter
+#define IAC_CLOSED_POSITION         0xB4        // 180 steps
+#define IAC_STEP_LONG_US            0x186A      // 6250
+#define IAC_STEP_SHORT_US           0x0C35      // 3125 (X2038.6 or X0085.2)
+#define IAC_FAULT_PERIOD            0x3C67      // LF831, 485 RPM
+
+// RAM (the names are the ones in ramLocations.asm and registers.asm)
+#define RAM_PORT1_DATA              0x0002
+#define RAM_TIMER_CSR               0x0008
+#define RAM_COUNTER_HIGH            0x0009
+#define RAM_FAULT_BITS_49           0x0049
+#define RAM_FAULT_BITS_4B           0x004B
+#define RAM_FAULT_BITS_4C           0x004C
+#define RAM_FUEL_MAP_LOAD_IDX       0x005B
+#define RAM_SHORT_TRIM_R            0x0065
+#define RAM_SHORT_TRIM_L            0x0067
+#define RAM_COOLANT_TEMP_COUNT      0x006A
+#define RAM_IAC_POSITION            0x006D
+#define RAM_IAC_STEP_COUNT          0x0075
+#define RAM_IGN_PERIOD              0x007A
+#define RAM_ENGINE_RPM              0x007E
+#define RAM_NEUTRAL_SWITCH          0x2000
+#define RAM_FUEL_MAP_NUMBER         0x202C
+#define RAM_MAF_LINEAR              0x204D
+#define RAM_TARGET_IDLE_RPM         0x2051
+
+#define TIMER_CSR_TOF               0x20
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  IdleRam
+//
+//  The two RAM pages, addressed as the 6803 does ($00xx or $20xx). Words are big endian.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+struct IdleRam
+{
+    UCHAR   page00[0x100];                  // $0000-$00FF, registers and internal RAM
+    UCHAR   page20[0x100];                  // $2000-$20FF, external RAM
+
+    UCHAR &operator[] (UINT16 addr)         { return (addr & 0x2000) ? page20[addr & 0xFF] : page00[addr & 0xFF]; }
+    UCHAR operator[] (UINT16 addr) const    { return (addr & 0x2000) ? page20[addr & 0xFF] : page00[addr & 0xFF]; }
+
+    UINT16 word (UINT16 addr) const
+    {
+        return (UINT16)(((*this)[addr] << 8) | (*this)[(UINT16)(addr + 1)]);
+    }
+
+    void setWord (UINT16 addr, UINT16 value)
+    {
+        (*this)[addr] = (UCHAR)(value >> 8);
+        (*this)[(UINT16)(addr + 1)] = (UCHAR)value;
+    }
+
+    void clear (void)                       { memset(this, 0, sizeof(*this)); }
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  The PROM data for one tune. byte() and word() read any PROM address, for the constants
+//  the code loads directly (ldab $C158 is t.byte(0xC158)).
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+struct IdleTables
+{
+    const UCHAR *image;                     // the 16K PROM
+    UINT16       baseIdleSetting;           // $C176
+    UINT16       idleAdjForAC;              // $C15B
+    UINT16       idleAdjForNeutral;         // $C159
+    UINT16       idleAdjForHeatedScreen;    // $C1E9
+    const UCHAR *coolantTable;              // 3 x 9 at $C17B
+
+    // assembler constants and build differences, read from the code
+    UINT16       x204FLimit;                // $05AB ($0640 before R3360)
+    bool         clearX201F;                // .LD6B9 clears X201F.5 (before R3360)
+    bool         laterFaultTest;            // LF831 has the R3360 additions
+
+    UINT8  byte (UINT16 addr) const         { return image[addr - PROM_BASE]; }
+    UINT16 word (UINT16 addr) const         { return (UINT16)((byte(addr) << 8) | byte((UINT16)(addr + 1))); }
+    const UCHAR *ptr (UINT16 addr) const    { return image + (addr - PROM_BASE); }
+};
+
+// Returns false if the code the build differences are read from isn't found (the R3526
+// values are used for those)
+inline bool loadIdleTables (const TuneImage &tune, IdleTables &t)
+{
+    static const int limit[] = { 0xF6, 0xC2, 0x5C, 0x3D, 0xDD, 0xC8, 0x83, SIG_ANY, SIG_ANY, 0x25 };
+    static const int x201F[] = { 0xB6, 0x20, 0x1F, 0x84, 0xDF, 0xB7, 0x20, 0x1F };   // anda #$DF
+    static const int o2Test[] = { 0x96, 0x49, 0x85, 0x06, 0x26 };                   // ldaa faultBits_49
+
+    t.image = tune.data();
+    t.baseIdleSetting = tune.wordAt(ADDR_BASE_IDLE);
+    t.idleAdjForAC = tune.wordAt(ADDR_IDLE_ADJ_AC);
+    t.idleAdjForNeutral = tune.wordAt(ADDR_IDLE_ADJ_NEUTRAL);
+    t.idleAdjForHeatedScreen = tune.wordAt(ADDR_IDLE_ADJ_HEATED_SCREEN);
+    t.coolantTable = tune.ptr(ADDR_IDLE_COOLANT_TABLE);
+
+    UINT16 l = findSignature(tune.data(), PROM_BASE, limit, 10);
+    UINT16 x = findSignature(tune.data(), PROM_BASE, x201F, 8);
+    UINT16 o = findSignature(tune.data(), PROM_BASE, o2Test, 5);
+
+    t.x204FLimit = l ? tune.wordAt((UINT16)(l + 7)) : 0x05AB;
+    t.clearX201F = x != 0;
+    t.laterFaultTest = o != 0;
+
+    return l && (x || o);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  idleCoolantDelta (LD609)
+//
+//  Returns AB, 2 x (ECT - $27), or zero when hotter than $27 (about 83 C).
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT16 idleCoolantDelta_6803 (Cpu6803 &cpu, const IdleRam &ram)
+{
+    ABunion &reg = cpu.reg;
+    bool carry;
+
+//LD609:
+    reg.r[B] = ram[RAM_COOLANT_TEMP_COUNT]; // ldab  coolantTempCount
+    carry = reg.r[B] < IDLE_HOT_ECT;
+    reg.r[B] -= IDLE_HOT_ECT;               // subb  #$27
+    if (!carry)
+        goto LD610;                         // bcc   .LD610
+    reg.r[B] = 0;                           // clrb
+
+LD610:
+    reg.r[A] = 0;                           // clra
+    reg.ab <<= 1;                           // asld
+
+    return reg.ab;                          // rts
+}
+
+inline UINT16 idleCoolantDelta_C (UINT8 ectCount)
+{
+    return (UINT16)((ectCount >= IDLE_HOT_ECT) ? 2 * (ectCount - IDLE_HOT_ECT) : 0);
+}
+
+// The target idleControl works out (targetIdleRPM) for the A/C, the gearbox (drive or
+// not) and the heated screen
+inline UINT16 idleTarget_C (const IdleTables &t, UINT8 ectCount, bool acOn, bool inDrive, bool heatedScreen)
+{
+    UINT16 target = t.baseIdleSetting;
+
+    if (acOn)
+        target = (UINT16)(target + t.idleAdjForAC);
+    if (!inDrive)
+        target = (UINT16)(target + t.idleAdjForNeutral);
+    if (heatedScreen)
+        target = (UINT16)(target + t.idleAdjForHeatedScreen);
+
+    return (UINT16)(target + idleCoolantDelta_C(ectCount));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  addIdleTarget (.LD602)
+//
+//  Adds AB to X00CE, stores the sum as the target too, then falls through
+//  into LD609 (so AB is the coolant delta afterwards).
+//
+///////////////////////////////////////////////////////////////////////////////
+inline void addIdleTarget_6803 (Cpu6803 &cpu, IdleRam &ram)
+{
+    ABunion &reg = cpu.reg;
+
+    reg.ab += ram.word(0x00CE);             // addd  $00CE
+    ram.setWord(0x00CE, reg.ab);            // std   $00CE
+    ram.setWord(RAM_TARGET_IDLE_RPM, reg.ab);   // std   targetIdleRPM
+
+    idleCoolantDelta_6803(cpu, ram);        // (falls through)
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Small subroutines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// absoluteValAB (misc2.asm)
+inline void absoluteValAB_6803 (Cpu6803 &cpu)
+{
+    ABunion &reg = cpu.reg;
+
+    reg.r[A] = (UCHAR)~reg.r[A];            // coma
+    reg.r[B] = (UCHAR)~reg.r[B];            // comb
+    reg.ab += 1;                            // addd  #$0001
+}
+
+// LEE12 (miscRoutines.asm), loads the step count from X0073 if the valve is idle
+inline void loadStepCount_6803 (Cpu6803 &cpu, IdleRam &ram)
+{
+    ABunion &reg = cpu.reg;
+
+    reg.r[B] = ram[RAM_IAC_STEP_COUNT];     // ldab  iacMotorStepCount
+    if (reg.r[B] != 0)
+        goto LEE28;                         // bne   .LEE28
+    reg.r[B] = ram[0x0073];                 // ldab  $0073
+    if (reg.r[B] == 0)
+        goto LEE28;                         // beq   .LEE28
+    ram[RAM_IAC_STEP_COUNT] = reg.r[B];     // stab  iacMotorStepCount
+    reg.r[B] = ram[0x008A];                 // ldab  $008A
+    reg.r[B] |= 0x01;                       // orab  #$01
+    ram[0x008A] = reg.r[B];                 // stab  $008A
+    ram[0x0073] = 0;                        // clr   $0073
+    ram[0x00B3]++;                          // inc   $00B3
+
+LEE28:
+    return;                                 // rts
+}
+
+// LF0D5 (misc2.asm), counts timer overflows and returns the free running counter in AB
+inline UINT16 updateTimers_6803 (Cpu6803 &cpu, IdleRam &ram)
+{
+    ABunion &reg = cpu.reg;
+
+    reg.r[A] = ram[RAM_TIMER_CSR];          // ldaa  timerCSR
+    if (!(reg.r[A] & TIMER_CSR_TOF))
+        goto LF0EE;                         // bita  #$20 / beq .LF0EE
+    ram[0x2001]++;                          // inc   $2001
+    if (ram[0x2001] != 0)
+        goto LF0E7;                         // bne   .LF0E7
+    ram[0x2001]--;                          // dec   $2001
+
+LF0E7:
+    reg.r[A] = ram[0x00B2];                 // ldaa  $00B2
+    reg.r[A]++;                             // inca
+    if (reg.r[A] == 0)
+        goto LF0EE;                         // beq   .LF0EE
+    ram[0x00B2] = reg.r[A];                 // staa  $00B2
+
+LF0EE:
+    reg.ab = ram.word(RAM_COUNTER_HIGH);    // ldd   counterHigh
+    return reg.ab;                          // rts
+}
+
+// LDAD3, the stepper drive value for the next step (in B)
+inline void stepperDriveValue_6803 (Cpu6803 &cpu, const IdleRam &ram)
+{
+    ABunion &reg = cpu.reg;
+
+    if (reg.r[B] == 0x1E)                   // cmpb  #$1E
+        goto LDAF3;                         // beq   .LDAF3
+    if (reg.r[B] == 0x78)                   // cmpb  #$78
+        goto LDAF3;                         // beq   .LDAF3
+    if (reg.r[B] == 0xE1)                   // cmpb  #$E1
+        goto LDAF3;                         // beq   .LDAF3
+    if (reg.r[B] == 0x87)                   // cmpb  #$87
+        goto LDAF3;                         // beq   .LDAF3
+    reg.r[B] = ram[RAM_PORT1_DATA];         // ldab  port1data
+    reg.r[B] &= 0x30;                       // andb  #$30
+    if (reg.r[B] == 0)
+        goto LDAF4;                         // beq   .LDAF4
+    if (reg.r[B] == 0x10)                   // cmpb  #$10
+        goto LDAF7;                         // beq   .LDAF7
+    if (reg.r[B] == 0x20)                   // cmpb  #$20
+        goto LDAFA;                         // beq   .LDAFA
+    reg.r[B] = 0x78;                        // ldab  #$78
+
+LDAF3:
+    return;                                 // rts
+
+LDAF4:
+    reg.r[B] = 0x87;                        // ldab  #$87
+    return;                                 // rts
+
+LDAF7:
+    reg.r[B] = 0x1E;                        // ldab  #$1E
+    return;                                 // rts
+
+LDAFA:
+    reg.r[B] = 0xE1;                        // ldab  #$E1
+}                                           // rts
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  idleMafReference
+//
+//  X204F/50, the linear MAF the valve should give, from mafLinear and the
+//  X2048 offset. The same block is at .LD8B0 in idleControl and .LCC9C in
+//  the main loop.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline void idleMafReference_6803 (Cpu6803 &cpu, IdleRam &ram, const IdleTables &t)
+{
+    ABunion &reg = cpu.reg;
+    bool carry;
+
+    reg.r[A] = ram[0x2048];                 // ldaa  $2048
+    if (reg.r[A] >= 0x80)                   // cmpa  #$80
+        goto LD8DD;                         // bcc   .LD8DD
+
+    reg.r[A] = 0x80;                        // ldaa  #$80
+    reg.r[A] -= ram[0x2048];                // suba  $2048
+    reg.r[B] = t.byte(0xC25C);              // ldab  $C25C
+    reg.ab = reg.r[A] * reg.r[B];           // mul
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+    if (reg.ab < t.x204FLimit)              // subd  #$05AB
+        goto LD8CE;                         // bcs   .LD8CE
+    reg.ab = t.x204FLimit;                  // ldd   #$05AB
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+
+LD8CE:
+    reg.ab = ram.word(RAM_MAF_LINEAR);      // ldd   mafLinear
+    carry = reg.ab < ram.word(0x00C8);
+    reg.ab -= ram.word(0x00C8);             // subd  $00C8
+    if (!carry)
+        goto LD8D8;                         // bcc   .LD8D8
+    reg.ab = 0x0000;                        // ldd   #$0000
+
+LD8D8:
+    ram.setWord(0x204F, reg.ab);            // std   $204F
+    return;                                 // bra   .LD8FC
+
+LD8DD:
+    reg.r[A] -= 0x80;                       // suba  #$80
+    reg.r[B] = t.byte(0xC25C);              // ldab  $C25C
+    reg.ab = reg.r[A] * reg.r[B];           // mul
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+    if (reg.ab < t.x204FLimit)              // subd  #$05AB
+        goto LD8EF;                         // bcs   .LD8EF
+    reg.ab = t.x204FLimit;                  // ldd   #$05AB
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+
+LD8EF:
+    reg.ab = ram.word(RAM_MAF_LINEAR);      // ldd   mafLinear
+    carry = reg.ab + ram.word(0x00C8) > 0xFFFF;
+    reg.ab += ram.word(0x00C8);             // addd  $00C8
+    if (!carry)
+        goto LD8F9;                         // bcc   .LD8F9
+    reg.ab = 0xFFFF;                        // ldd   #$FFFF
+
+LD8F9:
+    ram.setWord(0x204F, reg.ab);            // std   $204F
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  leanFaultIdle (LF7F0)
+//
+//  Clears the (unused) very lean fault, code 26, opening the valve 15
+//  steps ($C257) and moving X004F and X0072 if the engine is well below
+//  the target.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline void leanFaultIdle_6803 (Cpu6803 &cpu, IdleRam &ram, const IdleTables &t)
+{
+    ABunion &reg = cpu.reg;
+    bool carry;
+
+    reg.r[A] = ram[RAM_FAULT_BITS_4B];      // ldaa  faultBits_4B
+    if (!(reg.r[A] & 0x02))
+        goto LF830;                         // bita  #$02 / beq .LF830
+
+    reg.ab = ram.word(RAM_TARGET_IDLE_RPM); // ldd   targetIdleRPM
+    reg.ab -= t.word(0xC255);               // subd  $C255
+    carry = reg.ab < ram.word(RAM_ENGINE_RPM);
+    reg.ab -= ram.word(RAM_ENGINE_RPM);     // subd  engineRPM
+    if (carry)
+        goto LF829;                         // bcs   .LF829
+
+    reg.r[A] = ram[RAM_IAC_STEP_COUNT];     // ldaa  iacMotorStepCount
+    if (reg.r[A] != 0)
+        goto LF830;                         // bne   .LF830
+    reg.r[A] = ram[0x008A];                 // ldaa  $008A
+    reg.r[A] &= 0xFE;                       // anda  #$FE
+    ram[0x008A] = reg.r[A];                 // staa  $008A
+    reg.r[A] = t.byte(0xC257);              // ldaa  $C257
+    ram[RAM_IAC_STEP_COUNT] = reg.r[A];     // staa  iacMotorStepCount
+    reg.r[A] = ram[0x004F];                 // ldaa  $004F
+    carry = reg.r[A] < 0x49;
+    reg.r[A] -= 0x49;                       // suba  #$49
+    if (carry)
+        goto LF81F;                         // bcs   .LF81F
+    carry = reg.r[A] < t.byte(0xC257);
+    reg.r[A] -= t.byte(0xC257);             // suba  $C257
+    if (!carry)
+        goto LF825;                         // bcc   .LF825
+    reg.r[A] += ram[0x0072];                // adda  $0072
+    ram[0x0072] = reg.r[A];                 // staa  $0072
+
+LF81F:
+    reg.r[A] = 0x49;                        // ldaa  #$49
+    ram[0x004F] = reg.r[A];                 // staa  $004F
+    goto LF829;                             // bra   .LF829
+
+LF825:
+    reg.r[A] += 0x49;                       // adda  #$49
+    ram[0x004F] = reg.r[A];                 // staa  $004F
+
+LF829:
+    reg.r[A] = ram[RAM_FAULT_BITS_4B];      // ldaa  faultBits_4B
+    reg.r[A] &= 0xFD;                       // anda  #$FD
+    ram[RAM_FAULT_BITS_4B] = reg.r[A];      // staa  faultBits_4B
+
+LF830:
+    return;                                 // rts
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  idleAirAdapt (LF658)
+//
+//  Called by idleControl once the idle has been steady for $AF passes.
+//  Adapts X0072 (with X2048, the valve's MAF error) and works the valve
+//  position and X2053/54 out again from X006E, X00AD, X004F and X0072.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline void idleAirAdapt_6803 (Cpu6803 &cpu, IdleRam &ram, const IdleTables &t)
+{
+    ABunion &reg = cpu.reg;
+    bool carry;
+
+    reg.r[A] = ram[RAM_COOLANT_TEMP_COUNT]; // ldaa  coolantTempCount
+    if (reg.r[A] < t.byte(0xC247))          // cmpa  $C247
+        goto LF6EA;                         // bcs   .LF677 (bra .LF6EA)
+    reg.r[B] = ram[0x2048];                 // ldab  $2048
+    if (reg.r[B] & 0x80)
+        goto LF679;                         // bmi   .LF679
+
+    reg.r[A] = 0x80;                        // ldaa  #$80
+    reg.r[A] -= reg.r[B];                   // sba
+    reg.r[B] = reg.r[A];                    // tab
+    reg.r[A] = ram[0x0072];                 // ldaa  $0072
+    carry = reg.r[A] < reg.r[B];
+    reg.r[A] -= reg.r[B];                   // sba
+    if (carry)
+        goto LF6E9;                         // bcs   .LF6E9
+    if (reg.r[A] >= 0x80)                   // cmpa  #$80
+        goto LF6E9;                         // bcc   .LF6E9
+    if (reg.r[A] >= t.byte(0xC261))         // cmpa  $C261
+        goto LF689;                         // bcc   .LF689
+    return;                                 // rts
+
+LF679:
+    reg.r[B] -= 0x80;                       // subb  #$80
+    reg.r[A] = ram[0x0072];                 // ldaa  $0072
+    carry = reg.r[A] + reg.r[B] > 0xFF;
+    reg.r[A] += reg.r[B];                   // aba
+    if (carry)
+        goto LF6E9;                         // bcs   .LF6E9
+    if (reg.r[A] > 0x80)                    // cmpa  #$80
+        goto LF6E9;                         // bhi   .LF6E9
+    if (reg.r[A] < t.byte(0xC261))          // cmpa  $C261
+        goto LF6E9;                         // bcs   .LF6E9
+
+LF689:
+    reg.r[A] = 0;                           // clra
+    reg.r[B] = ram[0x00AD];                 // ldab  $00AD
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+    reg.r[B] = ram[0x006E];                 // ldab  $006E
+    ram.setWord(0x00CA, reg.ab);            // std   $00CA
+    reg.ab = ram.word(0x2053);              // ldd   $2053
+    carry = reg.ab + ram.word(0x00C8) > 0xFFFF;
+    reg.ab += ram.word(0x00C8);             // addd  $00C8
+    if (carry)
+        goto LF6CD;                         // bcs   .LF6CD
+    carry = reg.ab < ram.word(0x00CA);
+    reg.ab -= ram.word(0x00CA);             // subd  $00CA
+    if (carry)
+        goto LF6C9;                         // bcs   .LF6C9
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+    reg.r[A] = ram[0x004F];                 // ldaa  $004F
+    if (!(reg.r[A] & 0x80))
+        goto LF6AF;                         // bpl   .LF6AF
+    reg.r[A] &= 0x7F;                       // anda  #$7F
+    ram[0x00CB] = reg.r[A];                 // staa  $00CB
+    reg.ab = ram.word(0x00C8);              // ldd   $00C8
+    carry = reg.ab < ram.word(0x00CA);
+    reg.ab -= ram.word(0x00CA);             // subd  $00CA
+    if (carry)
+        goto LF6C9;                         // bcs   .LF6C9
+    goto LF6BB;                             // bra   .LF6BB
+
+LF6AF:
+    reg.r[A] = 0x80;                        // ldaa  #$80
+    reg.r[A] -= ram[0x004F];                // suba  $004F
+    ram[0x00CB] = reg.r[A];                 // staa  $00CB
+    reg.ab = ram.word(0x00C8);              // ldd   $00C8
+    carry = reg.ab + ram.word(0x00CA) > 0xFFFF;
+    reg.ab += ram.word(0x00CA);             // addd  $00CA
+    if (carry)
+        goto LF6CD;                         // bcs   .LF6CD
+
+LF6BB:
+    if (reg.ab & 0x8000)
+        goto LF6C9;                         // bmi   .LF6C9
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+    reg.ab = 0x8000;                        // ldd   #$8000
+    reg.ab -= ram.word(0x00C8);             // subd  $00C8
+    if (reg.r[A] != 0)                      // tsta
+        goto LF6CD;                         // bne   .LF6CD
+    goto LF6CF;                             // bra   .LF6CF
+
+LF6C9:
+    reg.r[B] = 0x00;                        // ldab  #$00
+    goto LF6CF;                             // bra   .LF6CF
+
+LF6CD:
+    reg.r[B] = 0xFF;                        // ldab  #$FF
+
+LF6CF:
+    reg.r[A] = 0x80;                        // ldaa  #$80
+    carry = reg.r[A] < reg.r[B];
+    reg.r[A] -= reg.r[B];                   // sba
+    if (!carry)
+        goto LF6D5;                         // bcc   .LF6D5
+    reg.r[A] = 0;                           // clra
+
+LF6D5:
+    if (reg.r[A] >= t.byte(0xC261))         // cmpa  $C261
+        goto LF6DD;                         // bcc   .LF6DD
+    reg.r[A] = t.byte(0xC261);              // ldaa  $C261
+
+LF6DD:
+    ram[0x0072] = reg.r[A];                 // staa  $0072
+    reg.r[A] = ram[0x2047];                 // ldaa  $2047
+    reg.r[A] &= 0xBF;                       // anda  #$BF
+    ram[0x2047] = reg.r[A];                 // staa  $2047
+    goto LF742;                             // bra   .LF742
+
+LF6E9:
+    return;                                 // rts
+
+LF6EA:
+    reg.r[A] = ram[0x0087];                 // ldaa  $0087
+    if (reg.r[A] & 0x02)
+        goto LF6F7;                         // bita  #$02 / bne .LF6F7
+    reg.r[A] = ram[RAM_FUEL_MAP_LOAD_IDX];  // ldaa  fuelMapLoadIdx
+    if (reg.r[A] >= t.byte(0xC243))         // cmpa  $C243
+        goto LF6E9;                         // bcc   .LF6E9
+
+LF6F7:
+    reg.r[A] = ram[RAM_COOLANT_TEMP_COUNT]; // ldaa  coolantTempCount
+    if (reg.r[A] < t.byte(0xC246))          // cmpa  $C246
+        goto LF6E9;                         // bcs   .LF6E9
+    if (reg.r[A] >= t.byte(0xC247))         // cmpa  $C247
+        goto LF6E9;                         // bcc   .LF6E9
+    reg.r[A] = ram[0x008D];                 // ldaa  $008D
+    if (reg.r[A] & 0x80)
+        goto LF720;                         // bita  #$80 / bne .LF720
+    reg.r[A] = ram[RAM_FUEL_MAP_NUMBER];    // ldaa  fuelMapNumber
+    if (reg.r[A] == 0)
+        goto LF712;                         // beq   .LF712
+    if (reg.r[A] < 0x04)                    // cmpa  #$04
+        goto LF6E9;                         // bcs   .LF6E9
+
+LF712:
+    reg.ab = ram.word(RAM_SHORT_TRIM_R);    // ldd   shortLambdaTrimR
+    if (reg.ab < t.word(0xC244))            // subd  $C244
+        goto LF6E9;                         // bcs   .LF6E9
+    reg.ab -= t.word(0xC244);
+    reg.ab = ram.word(RAM_SHORT_TRIM_L);    // ldd   shortLambdaTrimL
+    if (reg.ab < t.word(0xC244))            // subd  $C244
+        goto LF6E9;                         // bcs   .LF6E9
+    reg.ab -= t.word(0xC244);
+
+LF720:
+    reg.r[A] = ram[0x0072];                 // ldaa  $0072
+    reg.r[B] = ram[0x2048];                 // ldab  $2048
+    reg.r[B] -= 0x80;                       // subb  #$80
+    carry = reg.r[A] + reg.r[B] > 0xFF;
+    reg.r[A] += reg.r[B];                   // aba
+    if (!carry)
+        goto LF731;                         // bcc   .LF731
+    reg.r[B] = ram[0x2048];                 // ldab  $2048
+    if (!(reg.r[B] & 0x80))
+        goto LF738;                         // bpl   .LF738
+    reg.r[A] = 0xFF;                        // ldaa  #$FF
+
+LF731:
+    reg.r[B] = ram[0x2048];                 // ldab  $2048
+    if (reg.r[B] & 0x80)
+        goto LF738;                         // bmi   .LF738
+    reg.r[A] = 0x00;                        // ldaa  #$00
+
+LF738:
+    ram[0x0072] = reg.r[A];                 // staa  $0072
+    reg.r[A] = ram[0x2047];                 // ldaa  $2047
+    reg.r[A] |= 0x40;                       // oraa  #$40
+    ram[0x2047] = reg.r[A];                 // staa  $2047
+
+LF742:
+    reg.ab = ram.word(RAM_MAF_LINEAR);      // ldd   mafLinear
+    ram.setWord(0x204F, reg.ab);            // std   $204F
+    reg.r[A] = 0x80;                        // ldaa  #$80
+    ram[0x2048] = reg.r[A];                 // staa  $2048
+    reg.r[A] = 0;                           // clra
+    reg.r[B] = ram[0x00AD];                 // ldab  $00AD
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+    reg.r[A] = 0x80;                        // ldaa  #$80
+    reg.r[B] = ram[0x006E];                 // ldab  $006E
+    reg.ab -= ram.word(0x00C8);             // subd  $00C8
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+    reg.r[A] = 0;                           // clra
+    reg.r[B] = ram[0x004F];                 // ldab  $004F
+    if (reg.r[B] & 0x80)
+        goto LF76B;                         // bmi   .LF76B
+    reg.r[B] = 0x80;                        // ldab  #$80
+    reg.r[B] -= ram[0x004F];                // subb  $004F
+    ram.setWord(0x00CA, reg.ab);            // std   $00CA
+    reg.ab = ram.word(0x00C8);              // ldd   $00C8
+    reg.ab -= ram.word(0x00CA);             // subd  $00CA
+    goto LF76F;                             // bra   .LF76F
+
+LF76B:
+    reg.r[B] &= 0x7F;                       // andb  #$7F
+    reg.ab += ram.word(0x00C8);             // addd  $00C8
+
+LF76F:
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+    reg.r[A] = 0;                           // clra
+    reg.r[B] = ram[0x0072];                 // ldab  $0072
+    if (!(reg.r[B] & 0x80))
+        goto LF77C;                         // bpl   .LF77C
+    reg.r[B] &= 0x7F;                       // andb  #$7F
+    reg.ab += ram.word(0x00C8);             // addd  $00C8
+    goto LF78B;                             // bra   .LF78B
+
+LF77C:
+    reg.r[B] = 0x80;                        // ldab  #$80
+    reg.r[B] -= ram[0x0072];                // subb  $0072
+    ram.setWord(0x00CA, reg.ab);            // std   $00CA
+    reg.ab = ram.word(0x00C8);              // ldd   $00C8
+    carry = reg.ab < ram.word(0x00CA);
+    reg.ab -= ram.word(0x00CA);             // subd  $00CA
+    if (!carry)
+        goto LF78B;                         // bcc   .LF78B
+    reg.ab = 0x0000;                        // ldd   #$0000
+
+LF78B:
+    ram.setWord(0x2053, reg.ab);            // std   $2053
+    if (reg.r[A] >= 0x80)                   // cmpa  #$80
+        goto LF796;                         // bcc   .LF796
+    reg.r[A] = 0x01;                        // ldaa  #$01
+    goto LF7A2;                             // bra   .LF7A2
+
+LF796:
+    carry = reg.ab < 0x80B4;
+    reg.ab -= 0x80B4;                       // subd  #$80B4
+    if (carry)
+        goto LF79F;                         // bcs   .LF79F
+    reg.r[A] = IAC_CLOSED_POSITION;         // ldaa  #$B4
+    goto LF7A2;                             // bra   .LF7A2
+
+LF79F:
+    reg.r[A] = ram[0x2054];                 // ldaa  $2054
+
+LF7A2:
+    ram[RAM_IAC_POSITION] = reg.r[A];       // staa  iacPosition
+}                                           // rts
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  idleControl (LD613)
+//
+//  See the listing (idleControl.asm) for what each part is thought to do.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline void idleControl_6803 (Cpu6803 &cpu, IdleRam &ram, const IdleTables &t)
+{
+    ABunion &reg = cpu.reg;
+    const UCHAR *x;
+    UINT16 count;
+    UCHAR stacked;
+    bool carry;
+
+//idleControl:
+    reg.ab = t.baseIdleSetting;             // ldd   baseIdleSetting
+    ram.setWord(0x00CE, reg.ab);            // std   $00CE
+    reg.r[A] = ram[0x008A];                 // ldaa  $008A
+    if (reg.r[A] & 0x08)
+        goto LD623;                         // bita  #$08 / bne .LD623
+    reg.ab = t.idleAdjForAC;                // ldd   idleAdjForAC
+    addIdleTarget_6803(cpu, ram);           // bsr   .LD602
+
+LD623:
+    reg.r[B] = ram[0x008A];                 // ldab  $008A
+    if (reg.r[B] & 0x20)
+        goto LD62E;                         // bitb  #$20 / bne .LD62E
+    reg.ab = t.idleAdjForNeutral;           // ldd   idleAdjForNeutral
+    addIdleTarget_6803(cpu, ram);           // bsr   .LD602
+
+LD62E:
+    reg.r[B] = ram[0x00DD];                 // ldab  $00DD
+    if (reg.r[B] & 0x04)
+        goto LD639;                         // bitb  #$04 / bne .LD639
+    reg.ab = t.idleAdjForHeatedScreen;      // ldd   idleAdjForHeatedScreen
+    addIdleTarget_6803(cpu, ram);           // bsr   .LD602
+
+LD639:
+    idleCoolantDelta_6803(cpu, ram);        // bsr   LD609
+    addIdleTarget_6803(cpu, ram);           // bsr   .LD602
+    reg.r[B] = t.byte(0xC158);              // ldab  $C158
+    ram[0x00C9] = reg.r[B];                 // stab  $00C9
+
+    // compare the target with the engine speed
+    reg.r[A] = ram[0x2059];                 // ldaa  $2059
+    if (!(reg.r[A] & 0x10))
+        goto LD657;                         // bita  #$10 / beq .LD657
+    reg.ab = ram.word(0x00CE);              // ldd   $00CE
+    carry = reg.ab < ram.word(RAM_ENGINE_RPM);
+    reg.ab -= ram.word(RAM_ENGINE_RPM);     // subd  engineRPM
+    if (carry)
+        goto LD657;                         // bcs   .LD657
+    carry = reg.ab < t.word(0xC7D8);
+    reg.ab -= t.word(0xC7D8);               // subd  $C7D8
+    if (carry)
+        goto LD657;                         // bcs   .LD657
+    ram[0x00B3] = 0;                        // clr   $00B3
+
+    // X006E, the coolant based valve value (as LF9A1)
+LD657:
+    x = t.coolantTable;                     // ldx   #$C17B
+    reg.r[A] = ram[RAM_COOLANT_TEMP_COUNT]; // ldaa  coolantTempCount
+    reg.r[B] = IDLE_COOLANT_COLUMNS;        // ldab  #$09
+    x = indexIntoTable_6803(cpu, x);        // jsr   indexIntoTable
+    reg.r[A] -= x[0x00];                    // suba  $00,x
+    stacked = reg.r[B];                     // pshb
+    reg.r[B] = x[0x12];                     // ldab  $12,x
+    reg.ab = reg.r[A] * reg.r[B];           // mul
+    reg.ab <<= 1;                           // asld
+    reg.ab <<= 1;                           // asld
+    reg.r[B] = stacked;                     // pulb
+    if (reg.r[B] < 0x08)                    // cmpb  #$08
+        goto LD672;                         // bcs   .LD672
+    reg.r[A] += x[0x09];                    // adda  $09,x
+    goto LD675;                             // bra   .LD675
+
+LD672:
+    reg.r[A] -= x[0x09];                    // suba  $09,x
+    reg.r[A] = (UCHAR)(0 - reg.r[A]);       // nega
+
+LD675:
+    reg.r[B] = reg.r[A];                    // tab
+    ram[0x006E] = reg.r[B];                 // stab  $006E
+
+    // is idle control needed?
+    reg.r[A] = ram[0x0085];                 // ldaa  $0085
+    if (reg.r[A] & 0x04)
+        goto LD690;                         // bita  #$04 / bne .LD690
+    if (!(reg.r[A] & 0x80))
+        goto LD691;                         // bita  #$80 / beq .LD691
+    reg.r[B] = ram[RAM_IGN_PERIOD];         // ldab  ignPeriod
+    if (reg.r[B] < t.byte(0xC16F))          // cmpb  $C16F
+        goto LD691;                         // bcs   .LD691
+    reg.r[B] = ram[RAM_COOLANT_TEMP_COUNT]; // ldab  coolantTempCount
+    if (reg.r[B] < t.byte(0xC17E))          // cmpb  $C17E
+        goto LD691;                         // bcs   .LD691
+
+LD690:
+    return;                                 // rts
+
+LD691:
+    reg.r[B] = ram[0x0087];                 // ldab  $0087
+    if (!(reg.r[B] & 0x04))
+        goto LD6BD;                         // bitb  #$04 / beq .LD6BD
+    if (reg.r[A] & 0x02)
+        goto LD73D;                         // bita  #$02 / bne .LD6BA (jmp .LD73D)
+    reg.r[B] = ram[RAM_IGN_PERIOD];         // ldab  ignPeriod
+    if (reg.r[B] >= t.byte(0xC16F))         // cmpb  $C16F
+        goto LD690;                         // bcc   .LD690
+    reg.r[A] |= 0x02;                       // oraa  #$02
+    ram[0x0085] = reg.r[A];                 // staa  $0085
+    reg.r[B] = ram[RAM_NEUTRAL_SWITCH];     // ldab  neutralSwitchVal
+    if (reg.r[B] < 0x4D)                    // cmpb  #$4D
+        goto LD6B9;                         // bcs   .LD6B9
+    if (reg.r[B] >= 0xB3)                   // cmpb  #$B3
+        goto LD6B9A;                        // bcc   .LD6B9 (.LD6B9A before R3360)
+    reg.r[B] = ram[0x2004];                 // ldab  $2004
+    reg.r[B] |= 0x02;                       // orab  #$02
+    ram[0x2004] = reg.r[B];                 // stab  $2004
+
+LD6B9:
+    if (!t.clearX201F)
+        goto LD6B9A;                        // rts
+    reg.r[A] = ram[0x201F];                 // ldaa  $201F
+    reg.r[A] &= 0xDF;                       // anda  #$DF
+    ram[0x201F] = reg.r[A];                 // staa  $201F
+
+LD6B9A:
+    return;                                 // rts
+
+    // power on: position the valve
+LD6BD:
+    reg.r[A] = ram[0x008A];                 // ldaa  $008A
+    if (reg.r[A] & 0x02)
+        goto LD6D9;                         // bita  #$02 / bne .LD6D9
+    if (reg.r[A] & 0x08)
+        goto LD6CE;                         // bita  #$08 / bne .LD6CE
+    reg.r[A] = ram[RAM_COOLANT_TEMP_COUNT]; // ldaa  coolantTempCount
+    if (reg.r[A] >= t.byte(0xC17E))         // cmpa  $C17E
+        goto LD6D9;                         // bcc   .LD6D9
+
+LD6CE:
+    count = t.word(0xC0B0);                 // ldx   $C0B0
+    reg.ab = ram.word(0x009F);              // ldd   $009F
+
+LD6D3:
+    count--;                                // dex
+    if (count == 0)
+        goto LD6DA;                         // beq   .LD6DA
+    reg.ab <<= 1;                           // asld
+    goto LD6D3;                             // bra   .LD6D3
+
+LD6D9:
+    reg.r[A] = 0;                           // clra
+
+LD6DA:
+    reg.r[B] = ram[0x008A];                 // ldab  $008A
+    if (!(reg.r[B] & 0x08))
+        goto LD6ED;                         // bitb  #$08 / beq .LD6ED
+    reg.r[B] = ram[RAM_COOLANT_TEMP_COUNT]; // ldab  coolantTempCount
+    if (reg.r[B] < t.byte(0xC17D))          // cmpb  $C17D
+        goto LD6ED;                         // bcs   .LD6ED
+    if (reg.r[A] < 0x0C)                    // cmpa  #$0C
+        goto LD6ED;                         // bcs   .LD6ED
+    reg.r[A] = 0x0C;                        // ldaa  #$0C
+
+LD6ED:
+    reg.r[A] += t.byte(0xC15D);             // adda  $C15D
+    ram[0x00C8] = reg.r[A];                 // staa  $00C8
+    reg.r[A] = ram[0x006E];                 // ldaa  $006E
+    reg.r[B] = ram[0x004F];                 // ldab  $004F
+    if (!(reg.r[B] & 0x80))
+        goto LD701;                         // bpl   .LD701
+    reg.r[B] &= 0x7F;                       // andb  #$7F
+    carry = reg.r[A] + reg.r[B] > 0xFF;
+    reg.r[A] += reg.r[B];                   // aba
+    if (!carry)
+        goto LD70A;                         // bcc   .LD70A
+    reg.r[A] = 0xFF;                        // ldaa  #$FF
+    goto LD70A;                             // bra   .LD70A
+
+LD701:
+    reg.r[B] = 0x80;                        // ldab  #$80
+    reg.r[B] -= ram[0x004F];                // subb  $004F
+    carry = reg.r[A] < reg.r[B];
+    reg.r[A] -= reg.r[B];                   // sba
+    if (!carry)
+        goto LD70A;                         // bcc   .LD70A
+    reg.r[A] = 0x00;                        // ldaa  #$00
+
+LD70A:
+    reg.r[B] = reg.r[A];                    // tab
+    carry = reg.r[B] < ram[0x00C8];
+    reg.r[B] -= ram[0x00C8];                // subb  $00C8
+    if (!carry)
+        goto LD711;                         // bcc   .LD711
+    reg.r[B] = 0x01;                        // ldab  #$01
+
+LD711:
+    reg.r[A] = ram[0x008A];                 // ldaa  $008A
+    if (!(reg.r[A] & 0x20))
+        goto LD71D;                         // bita  #$20 / beq .LD71D
+    carry = reg.r[B] < ram[0x00C9];
+    reg.r[B] -= ram[0x00C9];                // subb  $00C9
+    if (!carry)
+        goto LD71D;                         // bcc   .LD71D
+    reg.r[B] = 0x01;                        // ldab  #$01
+
+LD71D:
+    carry = reg.r[B] < ram[RAM_IAC_POSITION];
+    reg.r[B] -= ram[RAM_IAC_POSITION];      // subb  iacPosition
+    reg.r[A] = ram[0x008A];                 // ldaa  $008A
+    if (!carry)
+        goto LD728;                         // bcc   .LD728
+    reg.r[B] = (UCHAR)(0 - reg.r[B]);       // negb
+    reg.r[A] &= 0xFE;                       // anda  #$FE (open)
+    goto LD72A;                             // bra   .LD72A
+
+LD728:
+    reg.r[A] |= 0x01;                       // oraa  #$01 (close)
+
+LD72A:
+    ram[0x008A] = reg.r[A];                 // staa  $008A
+    ram[RAM_IAC_STEP_COUNT] = reg.r[B];     // stab  iacMotorStepCount
+    reg.r[A] = ram[0x0087];                 // ldaa  $0087
+    reg.r[A] |= 0x04;                       // oraa  #$04
+    ram[0x0087] = reg.r[A];                 // staa  $0087
+    reg.r[A] = ram[0x2059];                 // ldaa  $2059
+    reg.r[A] |= 0x08;                       // oraa  #$08
+    ram[0x2059] = reg.r[A];                 // staa  $2059
+
+LD73C:
+    return;                                 // rts
+
+    // running: steps for A/C, heated screen and gearbox changes
+LD73D:
+    reg.r[A] = ram[RAM_IAC_STEP_COUNT];     // ldaa  iacMotorStepCount
+    if (reg.r[A] != 0)
+        goto LD73C;                         // bne   .LD73C
+    reg.r[B] = ram[0x00AE];                 // ldab  $00AE
+    reg.r[A] = ram[0x00DD];                 // ldaa  $00DD
+    if (reg.r[A] & 0x04)
+        goto LD756;                         // bita  #$04 / bne .LD756
+    if (reg.r[A] & 0x02)
+        goto LD761;                         // bita  #$02 / bne .LD761
+    reg.r[A] |= 0x02;                       // oraa  #$02
+    ram[0x00DD] = reg.r[A];                 // staa  $00DD
+    reg.r[B] += t.byte(0xC1EB);             // addb  $C1EB
+    goto LD761;                             // bra   .LD761
+
+LD756:
+    if (reg.r[A] & 0x02)
+        goto LD761;                         // bita  #$02 / bne .LD761
+    reg.r[A] |= 0x02;                       // oraa  #$02
+    ram[0x00DD] = reg.r[A];                 // staa  $00DD
+    reg.r[B] -= t.byte(0xC1EB);             // subb  $C1EB
+
+LD761:
+    reg.r[A] = ram[0x008A];                 // ldaa  $008A
+    if (reg.r[A] & 0x08)
+        goto LD774;                         // bita  #$08 / bne .LD774
+    if (reg.r[A] & 0x04)
+        goto LD772;                         // bita  #$04 / bne .LD772
+    reg.r[A] |= 0x04;                       // oraa  #$04
+    ram[0x008A] = reg.r[A];                 // staa  $008A
+    reg.r[B] -= t.byte(0xC157);             // subb  $C157
+
+LD772:
+    goto LD77F;                             // bra   .LD77F
+
+LD774:
+    if (reg.r[A] & 0x04)
+        goto LD77F;                         // bita  #$04 / bne .LD77F
+    reg.r[A] |= 0x04;                       // oraa  #$04
+    ram[0x008A] = reg.r[A];                 // staa  $008A
+    reg.r[B] += t.byte(0xC157);             // addb  $C157
+
+LD77F:
+    if (reg.r[A] & 0x20)
+        goto LD78F;                         // bita  #$20 / bne .LD78F
+    if (reg.r[A] & 0x10)
+        goto LD78D;                         // bita  #$10 / bne .LD78D
+    reg.r[A] |= 0x10;                       // oraa  #$10
+    ram[0x008A] = reg.r[A];                 // staa  $008A
+    reg.r[B] += ram[0x00C9];                // addb  $00C9
+
+LD78D:
+    goto LD7A8;                             // bra   .LD7A8
+
+LD78F:
+    if (reg.r[A] & 0x10)
+        goto LD7A8;                         // bita  #$10 / bne .LD7A8
+    reg.r[A] |= 0x10;                       // oraa  #$10
+    ram[0x008A] = reg.r[A];                 // staa  $008A
+    reg.r[B] -= ram[0x00C9];                // subb  $00C9
+    stacked = reg.r[A];                     // psha
+    reg.r[A] = t.byte(0xC7DA);              // ldaa  $C7DA
+    ram[0x00B3] = reg.r[A];                 // staa  $00B3
+    reg.r[A] = ram[0x2059];                 // ldaa  $2059
+    reg.r[A] &= 0xEF;                       // anda  #$EF
+    ram[0x2059] = reg.r[A];                 // staa  $2059
+    reg.r[A] = stacked;                     // pula
+
+LD7A8:
+    ram[0x00AE] = reg.r[B];                 // stab  $00AE
+    reg.r[B] = 0;                           // clrb
+    if (reg.r[A] & 0x08)
+        goto LD7B2;                         // bita  #$08 / bne .LD7B2
+    reg.r[B] += t.byte(0xC157);             // addb  $C157
+
+LD7B2:
+    if (!(reg.r[A] & 0x20))
+        goto LD7B8;                         // bita  #$20 / beq .LD7B8
+    reg.r[B] += ram[0x00C9];                // addb  $00C9
+
+LD7B8:
+    reg.r[A] = ram[0x00DD];                 // ldaa  $00DD
+    if (!(reg.r[A] & 0x04))
+        goto LD7C1;                         // bita  #$04 / beq .LD7C1
+    reg.r[B] += t.byte(0xC1EB);             // addb  $C1EB
+
+LD7C1:
+    ram[0x00AD] = reg.r[B];                 // stab  $00AD
+    reg.r[B] = ram[0x2047];                 // ldab  $2047
+    reg.r[A] = ram[RAM_IGN_PERIOD];         // ldaa  ignPeriod
+    if (reg.r[A] >= t.byte(0xC16F))         // cmpa  $C16F
+        goto LD7D2;                         // bcc   .LD7D2
+    reg.r[B] |= 0x20;                       // orab  #$20
+    ram[0x2047] = reg.r[B];                 // stab  $2047
+
+LD7D2:
+    reg.r[A] = ram[0x0085];                 // ldaa  $0085
+    if (!(reg.r[B] & 0x20))
+        goto LD805;                         // bitb  #$20 / beq .LD805
+    if (reg.r[A] & 0x20)
+        goto LD7F0;                         // bita  #$20 / bne .LD7F0
+    reg.r[A] |= 0x20;                       // oraa  #$20
+    ram[0x0085] = reg.r[A];                 // staa  $0085
+    reg.r[A] = ram[0x0054];                 // ldaa  $0054
+    ram[0x0052] = reg.r[A];                 // staa  $0052
+    reg.r[A] = ram[0x0088];                 // ldaa  $0088
+    reg.r[A] |= 0x04;                       // oraa  #$04
+    ram[0x0088] = reg.r[A];                 // staa  $0088
+    reg.r[A] = t.byte(0xC151);              // ldaa  $C151
+    ram[0x00B3] = reg.r[A];                 // staa  $00B3
+    return;                                 // rts
+
+LD7F0:
+    reg.r[B] = ram[0x00B4];                 // ldab  $00B4
+    if (reg.r[B] == 0)
+        goto LD7F9;                         // beq   .LD7F9
+    ram[0x00B4]--;                          // dec   $00B4
+    goto LD805;                             // bra   .LD805
+
+LD7F9:
+    reg.r[B] = ram[0x00B3];                 // ldab  $00B3
+    if (reg.r[B] == 0)
+        goto LD805;                         // beq   .LD805
+    reg.r[B]--;                             // decb
+    ram[0x00B3] = reg.r[B];                 // stab  $00B3
+    reg.r[B] = t.byte(0xC14F);              // ldab  $C14F
+    ram[0x00B4] = reg.r[B];                 // stab  $00B4
+
+LD805:
+    stacked = reg.r[A];                     // psha
+    reg.r[A] = ram[0x008A];                 // ldaa  $008A
+    reg.r[B] = ram[0x00AE];                 // ldab  $00AE
+    if (reg.r[B] == 0)
+        goto LD81B;                         // beq   .LD81B
+    if (!(reg.r[B] & 0x80))
+        goto LD813;                         // bpl   .LD813
+    reg.r[B] = (UCHAR)(0 - reg.r[B]);       // negb
+    reg.r[A] &= 0xFE;                       // anda  #$FE (open)
+    goto LD815;                             // bra   .LD815
+
+LD813:
+    reg.r[A] |= 0x01;                       // oraa  #$01 (close)
+
+LD815:
+    ram[0x008A] = reg.r[A];                 // staa  $008A
+    ram[RAM_IAC_STEP_COUNT] = reg.r[B];     // stab  iacMotorStepCount
+    reg.r[A] = stacked;                     // pula
+    return;                                 // rts
+
+    // closed loop on the engine speed
+LD81B:
+    reg.r[A] = stacked;                     // pula
+    if (!(reg.r[A] & 0x20))
+        goto LD827;                         // bita  #$20 / beq .LD827
+    reg.r[B] = ram[0x0086];                 // ldab  $0086
+    if (reg.r[B] & 0x80)
+        goto LD828;                         // bmi   .LD828
+    ram[0x00C0] = 0;                        // clr   $00C0
+
+LD827:
+    return;                                 // rts
+
+LD828:
+    ram[0x00CC] = 0;                        // clr   $00CC
+    reg.r[A] = ram[0x0087];                 // ldaa  $0087
+    if (!(reg.r[A] & 0x40))
+        goto LD83F;                         // bita  #$40 / beq .LD83F
+    reg.r[A] = ram[0x008B];                 // ldaa  $008B
+    reg.r[A] &= 0x01;                       // anda  #$01
+    if (reg.r[A] != 0)
+        goto LD827;                         // bne   .LD827
+    count = ram.word(0x00B5);               // ldx   $00B5
+    if (count == 0)
+        goto LD83F;                         // beq   .LD83F
+    count++;                                // inx
+    ram.setWord(0x00B5, count);             // stx   $00B5
+    return;                                 // rts
+
+LD83F:
+    if (ram[0x00B3] != 0)                   // tst   $00B3
+        goto LD827;                         // bne   .LD827
+    reg.ab = ram.word(0x00CE);              // ldd   $00CE
+    carry = reg.ab < ram.word(RAM_ENGINE_RPM);
+    reg.ab -= ram.word(RAM_ENGINE_RPM);     // subd  engineRPM
+    if (!carry)
+        goto LD88E;                         // bcc   .LD88E
+    reg.r[A] = ram[0x0073];                 // ldaa  $0073
+    if (reg.r[A] == 0)
+        goto LD866;                         // beq   .LD866
+    reg.r[A] = t.byte(0xC161);              // ldaa  $C161
+    reg.r[A] -= t.byte(0xC164);             // suba  $C164
+    ram[0x0073] = reg.r[A];                 // staa  $0073
+    loadStepCount_6803(cpu, ram);           // jsr   LEE12
+    ram[0x0073] = 0;                        // clr   $0073
+    reg.r[A] = t.byte(0xC164);              // ldaa  $C164
+    ram[0x0071] = reg.r[A];                 // staa  $0071
+    reg.r[B] = t.byte(0xC165);              // ldab  $C165
+    goto LD880;                             // bra   .LD880
+
+LD866:
+    reg.r[A] = ram[0x0071];                 // ldaa  $0071
+    if (reg.r[A] == 0)
+        goto LD88E;                         // beq   .LD88E
+    reg.r[B] = ram[0x0087];                 // ldab  $0087
+    if (reg.r[B] & 0x40)
+        goto LD883;                         // bitb  #$40 / bne .LD883
+    reg.r[A]--;                             // deca
+    ram[0x0071] = reg.r[A];                 // staa  $0071
+    reg.r[A] = ram[0x008A];                 // ldaa  $008A
+    reg.r[A] |= 0x01;                       // oraa  #$01
+    ram[0x008A] = reg.r[A];                 // staa  $008A
+    reg.r[A] = 0x01;                        // ldaa  #$01
+    ram[RAM_IAC_STEP_COUNT] = reg.r[A];     // staa  iacMotorStepCount
+    reg.r[B] = t.byte(0xC166);              // ldab  $C166
+
+LD880:
+    ram[0x00B3] = reg.r[B];                 // stab  $00B3
+
+LD882:
+    return;                                 // rts
+
+LD883:
+    ram[0x0073] = reg.r[A];                 // staa  $0073
+    loadStepCount_6803(cpu, ram);           // jsr   LEE12
+    ram[0x0071] = 0;                        // clr   $0071
+    goto LD9D7;                             // jmp   .LD9D7
+
+LD88E:
+    reg.r[A] = ram[0x008B];                 // ldaa  $008B
+    reg.r[A] &= 0x01;                       // anda  #$01
+    if (reg.r[A] != 0)
+        goto LD882;                         // bne   .LD882
+    reg.r[A] = ram[0x0089];                 // ldaa  $0089
+    if (reg.r[A] & 0x80)
+        goto LD882;                         // bmi   .LD882
+    reg.ab = ram.word(RAM_IGN_PERIOD);      // ldd   ignPeriod
+    if (reg.ab < t.word(0xC253))            // subd  $C253
+        goto LD882;                         // bcs   .LD882
+    reg.ab -= t.word(0xC253);
+    leanFaultIdle_6803(cpu, ram, t);        // jsr   LF7F0
+    reg.r[A] = ram[RAM_IAC_STEP_COUNT];     // ldaa  iacMotorStepCount
+    if (reg.r[A] != 0)
+        goto LD882;                         // bne   .LD882
+    reg.r[A] = ram[0x2047];                 // ldaa  $2047
+    if (reg.r[A] & 0x01)
+        goto LD8FC;                         // bita  #$01 / bne .LD8FC
+    reg.r[A] |= 0x01;                       // oraa  #$01
+    ram[0x2047] = reg.r[A];                 // staa  $2047
+    idleMafReference_6803(cpu, ram, t);     // X204F/50
+
+LD8FC:
+    reg.r[A] = ram[0x2059];                 // ldaa  $2059
+    if (!(reg.r[A] & 0x01))
+        goto LD904;                         // bita  #$01 / beq .LD904
+    return;                                 // rts
+
+LD904:
+    reg.r[A] = ram[0x0088];                 // ldaa  $0088
+    reg.r[A] |= 0x01;                       // oraa  #$01
+    ram[0x0088] = reg.r[A];                 // staa  $0088
+    reg.r[A] = 0;                           // clra
+    ram[0x0073] = reg.r[A];                 // staa  $0073
+    ram[0x0071] = reg.r[A];                 // staa  $0071
+    reg.ab = ram.word(0x00CE);              // ldd   $00CE
+    carry = reg.ab < ram.word(RAM_ENGINE_RPM);
+    reg.ab -= ram.word(RAM_ENGINE_RPM);     // subd  engineRPM
+    if (!carry)
+        goto LD91B;                         // bcc   .LD91B
+    ram[0x00CC]++;                          // inc   $00CC
+    absoluteValAB_6803(cpu);                // jsr   absoluteValAB
+
+LD91B:
+    ram[0x00CD] = 0;                        // clr   $00CD
+
+LD91E:
+    carry = reg.ab < t.word(0xC173);
+    reg.ab -= t.word(0xC173);               // subd  $C173
+    if (carry)
+        goto LD928;                         // bcs   .LD928
+    ram[0x00CD]++;                          // inc   $00CD
+    goto LD91E;                             // bra   .LD91E
+
+LD928:
+    reg.r[B] = ram[0x00CD];                 // ldab  $00CD
+    carry = reg.r[B] < t.byte(0xC175);
+    reg.r[B] -= t.byte(0xC175);             // subb  $C175
+    if (!carry)
+        goto LD930;                         // bcc   .LD930
+    reg.r[B] = 0;                           // clrb
+
+LD930:
+    if (reg.r[B] < t.byte(0xC169))          // cmpb  $C169
+        goto LD938;                         // bcs   .LD938
+    reg.r[B] = t.byte(0xC169);              // ldab  $C169
+
+LD938:
+    ram[0x00CD] = reg.r[B];                 // stab  $00CD
+    ram[RAM_IAC_STEP_COUNT] = reg.r[B];     // stab  iacMotorStepCount
+    if (reg.r[B] == 0)
+        goto LD94B;                         // beq   .LD94B
+    ram[0x00C0] = 0;                        // clr   $00C0
+    reg.r[A] = ram[0x2059];                 // ldaa  $2059
+    reg.r[A] &= 0xEF;                       // anda  #$EF
+    ram[0x2059] = reg.r[A];                 // staa  $2059
+    goto LD999;                             // bra   .LD999
+
+LD94B:
+    reg.r[B] = ram[0x00C0];                 // ldab  $00C0
+    if (reg.r[B] < t.byte(0xC155))          // cmpb  $C155
+        goto LD996;                         // bcs   .LD996
+    reg.r[A] = t.byte(0xC156);              // ldaa  $C156
+    ram[0x00B3] = reg.r[A];                 // staa  $00B3
+    reg.r[A] = ram[0x2059];                 // ldaa  $2059
+    reg.r[A] |= 0x10;                       // oraa  #$10
+    ram[0x2059] = reg.r[A];                 // staa  $2059
+    reg.r[A] = ram[0x0089];                 // ldaa  $0089
+    reg.r[A] &= 0x03;                       // anda  #$03
+    if (reg.r[A] != 0)
+        goto LD97C;                         // bne   .LD97C
+    idleAirAdapt_6803(cpu, ram, t);         // jsr   LF658
+    reg.r[B] = ram[0x2047];                 // ldab  $2047
+    reg.r[A] = ram[RAM_COOLANT_TEMP_COUNT]; // ldaa  coolantTempCount
+    if (reg.r[A] < t.byte(0xC17D))          // cmpa  $C17D
+        goto LD977;                         // bcs   .LD977
+    if (reg.r[A] < t.byte(0xC17E))          // cmpa  $C17E
+        goto LD97C;                         // bcs   .LD97C
+
+LD977:
+    reg.r[B] &= 0xBF;                       // andb  #$BF
+    ram[0x2047] = reg.r[B];                 // stab  $2047
+
+LD97C:
+    reg.r[B] = ram[0x00DC];                 // ldab  $00DC
+    if (reg.r[B] & 0x08)
+        goto LD995;                         // bitb  #$08 / bne .LD995
+    reg.r[B] |= 0x08;                       // orab  #$08
+    ram[0x00DC] = reg.r[B];                 // stab  $00DC
+    reg.ab = ram.word(0x0098);              // ldd   $0098
+    if (reg.ab != 0)
+        goto LD995;                         // bne   .LD995
+    reg.ab = 0x0020;                        // ldd   #$0020
+    ram.setWord(0x0098, reg.ab);            // std   $0098
+    reg.r[A] = ram[0x008D];                 // ldaa  $008D
+    reg.r[A] |= 0x80;                       // oraa  #$80
+    ram[0x008D] = reg.r[A];                 // staa  $008D
+
+LD995:
+    return;                                 // rts
+
+LD996:
+    ram[0x00C0]++;                          // inc   $00C0
+
+LD999:
+    reg.r[A] = ram[0x00CC];                 // ldaa  $00CC
+    if (reg.r[A] == 0)
+        goto LD9D1;                         // beq   .LD9D1
+    reg.r[A] = ram[0x2047];                 // ldaa  $2047
+    if (!(reg.r[A] & 0x04))
+        goto LD9CB;                         // bita  #$04 / beq .LD9CB
+    reg.r[A] = ram[0x006E];                 // ldaa  $006E
+    reg.r[A] += ram[0x006F];                // adda  $006F
+    if (reg.r[A] >= IAC_CLOSED_POSITION)    // cmpa  #$B4
+        goto LD9B2;                         // bcc   .LD9B2
+    reg.r[A] += 0x4B;                       // adda  #$4B
+    if (reg.r[A] < IAC_CLOSED_POSITION + 1) // cmpa  #$B5
+        goto LD9B4;                         // bcs   .LD9B4
+
+LD9B2:
+    reg.r[A] = IAC_CLOSED_POSITION;         // ldaa  #$B4
+
+LD9B4:
+    carry = reg.r[A] < ram[RAM_IAC_POSITION];
+    reg.r[A] -= ram[RAM_IAC_POSITION];      // suba  iacPosition
+    if (reg.r[A] == 0)
+        goto LD9C7;                         // beq   .LD9C7
+    if (!carry)
+        goto LD9C2;                         // bcc   .LD9C2
+    reg.r[A] = 0x01;                        // ldaa  #$01
+    ram[0x00CD] = reg.r[A];                 // staa  $00CD
+    ram[RAM_IAC_STEP_COUNT] = reg.r[A];     // staa  iacMotorStepCount
+    goto LD9D1;                             // bra   .LD9D1
+
+LD9C2:
+    reg.r[B] = ram[0x00CD];                 // ldab  $00CD
+    if (reg.r[A] >= reg.r[B])               // cba
+        goto LD9CB;                         // bcc   .LD9CB
+
+LD9C7:
+    ram[0x00CD] = reg.r[A];                 // staa  $00CD
+    ram[RAM_IAC_STEP_COUNT] = reg.r[A];     // staa  iacMotorStepCount
+
+LD9CB:
+    reg.r[A] = ram[0x008A];                 // ldaa  $008A
+    reg.r[A] |= 0x01;                       // oraa  #$01 (close)
+    goto LD9D5;                             // bra   .LD9D5
+
+LD9D1:
+    reg.r[A] = ram[0x008A];                 // ldaa  $008A
+    reg.r[A] &= 0xFE;                       // anda  #$FE (open)
+
+LD9D5:
+    ram[0x008A] = reg.r[A];                 // staa  $008A
+
+LD9D7:
+    reg.r[B] = t.byte(0xC150);              // ldab  $C150
+    reg.r[A] = ram[RAM_IAC_STEP_COUNT];     // ldaa  iacMotorStepCount
+    reg.ab = reg.r[A] * reg.r[B];           // mul
+    if (reg.r[A] != 0)                      // tsta
+        goto LD9E5;                         // bne   .LD9E5
+    if (reg.r[B] < t.byte(0xC153))          // cmpb  $C153
+        goto LD9E8;                         // bcs   .LD9E8
+
+LD9E5:
+    reg.r[B] = t.byte(0xC153);              // ldab  $C153
+
+LD9E8:
+    ram[0x00B3] = reg.r[B];                 // stab  $00B3
+}                                           // rts
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  driveIacMotor
+//
+//  Makes one step if the step interval has passed since the last one
+//  (X00C6/C7, the counter at the last step).
+//
+///////////////////////////////////////////////////////////////////////////////
+inline void driveIacMotor_6803 (Cpu6803 &cpu, IdleRam &ram, const IdleTables &t)
+{
+    ABunion &reg = cpu.reg;
+    bool carry;
+
+//driveIacMotor:
+    reg.r[A] = ram[RAM_IAC_STEP_COUNT];     // ldaa  iacMotorStepCount
+    if (reg.r[A] == 0)
+        goto LDAD0;                         // beq   .LDA1D (beq .LDA31, jmp .LDAD0)
+    reg.r[A] = ram[0x2047];                 // ldaa  $2047
+    if (!(reg.r[A] & 0x80))
+        goto LD9FC;                         // bita  #$80 / beq .LD9FC
+    reg.ab = ram.word(RAM_COUNTER_HIGH);    // ldd   counterHigh
+    goto LD9FF;                             // bra   .LD9FF
+
+LD9FC:
+    updateTimers_6803(cpu, ram);            // jsr   LF0D5
+
+LD9FF:
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+    reg.r[A] = ram[0x0085];                 // ldaa  $0085
+    if (!(reg.r[A] & 0x04))
+        goto LDA12;                         // bita  #$04 / beq .LDA12
+    reg.ab = ram.word(0x00C8);              // ldd   $00C8
+    reg.ab -= ram.word(0x00C6);             // subd  $00C6
+    if (reg.ab < IAC_STEP_SHORT_US)         // subd  #$0C35
+        goto LDAD0;                         // bcs   .LDA2D (bcs .LDA31)
+    goto LDA3D;                             // bra   .LDA3D
+
+LDA12:
+    reg.ab = ram.word(RAM_IGN_PERIOD);      // ldd   ignPeriod
+    carry = reg.ab < t.word(0xC253);
+    reg.ab -= t.word(0xC253);               // subd  $C253
+    if (carry)
+        goto LDA1F;                         // bcs   .LDA1F
+    reg.r[A] = ram[0x008B];                 // ldaa  $008B
+    if (!(reg.r[A] & 0x40))
+        goto LDAD0;                         // bita  #$40 / beq .LDA31
+
+LDA1F:
+    reg.r[A] = ram[0x2038];                 // ldaa  $2038
+    if (reg.r[A] & 0x40)
+        goto LDA34;                         // bita  #$40 / bne .LDA34
+    reg.ab = ram.word(0x00C8);              // ldd   $00C8
+    reg.ab -= ram.word(0x00C6);             // subd  $00C6
+    if (reg.ab < IAC_STEP_LONG_US)          // subd  #$186A
+        goto LDAD0;                         // bcs   .LDA31
+    goto LDA3D;                             // bra   .LDA3D
+
+LDA34:
+    reg.ab = ram.word(0x00C8);              // ldd   $00C8
+    reg.ab -= ram.word(0x00C6);             // subd  $00C6
+    if (reg.ab < IAC_STEP_SHORT_US)         // subd  #$0C35
+        goto LDAD0;                         // bcs   .LDA31
+
+LDA3D:
+    reg.r[A] = ram[0x008A];                 // ldaa  $008A
+    reg.r[A] ^= ram[0x2038];                // eora  $2038
+    if (reg.r[A] & 0x01)
+        goto LDAAF;                         // bita  #$01 / bne .LDAAF
+    ram[RAM_IAC_STEP_COUNT]--;              // dec   iacMotorStepCount
+    reg.r[B] = ram[0x0074];                 // ldab  $0074
+    stepperDriveValue_6803(cpu, ram);       // jsr   LDAD3
+    reg.r[A] = ram[0x008A];                 // ldaa  $008A
+    if (!(reg.r[A] & 0x01))
+        goto LDA5F;                         // bita  #$01 / beq .LDA5F
+
+    reg.r[A] = reg.r[B];                    // tba (close)
+    reg.ab <<= 1;                           // asld
+    reg.ab <<= 1;                           // asld
+    ram[0x00CE] = 0;                        // clr   $00CE
+    reg.r[B] = ram[RAM_IAC_POSITION];       // ldab  iacPosition
+    reg.r[B]++;                             // incb
+    goto LDA6C;                             // bra   .LDA6C
+
+LDA5F:
+    reg.r[A] = reg.r[B];                    // tba (open)
+    reg.ab >>= 1;                           // lsrd
+    reg.ab >>= 1;                           // lsrd
+    reg.r[A] = reg.r[B];                    // tba
+    reg.r[B] = 0xFF;                        // ldab  #$FF
+    ram[0x00CE] = reg.r[B];                 // stab  $00CE
+    reg.r[B] = ram[RAM_IAC_POSITION];       // ldab  iacPosition
+    if (reg.r[B] == 0)
+        goto LDA6C;                         // beq   .LDA6C
+    reg.r[B]--;                             // decb
+
+LDA6C:
+    ram[0x0074] = reg.r[A];                 // staa  $0074
+    reg.r[A] &= 0x30;                       // anda  #$30
+    ram[0x00CA] = reg.r[A];                 // staa  $00CA
+    reg.r[A] = ram[RAM_PORT1_DATA];         // ldaa  port1data
+    reg.r[A] &= 0xCF;                       // anda  #$CF
+    reg.r[A] |= ram[0x00CA];                // oraa  $00CA
+    ram[RAM_PORT1_DATA] = reg.r[A];         // staa  port1data
+    if (reg.r[B] < IAC_CLOSED_POSITION)     // cmpb  #$B4
+        goto LDA80;                         // bcs   .LDA80
+    reg.r[B] = IAC_CLOSED_POSITION;         // ldab  #$B4
+
+LDA80:
+    if (reg.r[B] != 0)                      // cmpb  #$00
+        goto LDA86;                         // bne   .LDA86
+    reg.r[B] = 0x01;                        // ldab  #$01
+
+LDA86:
+    ram[RAM_IAC_POSITION] = reg.r[B];       // stab  iacPosition
+    reg.r[A] = ram[0x00AE];                 // ldaa  $00AE
+    if (reg.r[A] == 0)
+        goto LDA93;                         // beq   .LDA93
+    if (reg.r[A] & 0x80)
+        goto LDA90;                         // bmi   .LDA90
+    reg.r[A]--;                             // DB $4A (deca)
+    goto LDA91;                             // DB $81,$4C (cmpa #$4C)
+
+LDA90:
+    reg.r[A]++;                             // DB $4C (inca)
+
+LDA91:
+    ram[0x00AE] = reg.r[A];                 // staa  $00AE
+
+LDA93:
+    ram[0x203A] = 0;                        // clr   $203A
+    reg.r[A] = ram[0x00CE];                 // ldaa  $00CE
+    if (reg.r[A] == 0)
+        goto LDAA4;                         // beq   .LDAA4
+    reg.ab = ram.word(0x2053);              // ldd   $2053
+    carry = reg.ab < 0x0001;
+    reg.ab -= 0x0001;                       // subd  #$0001
+    if (!carry)
+        goto LDAAC;                         // bcc   .LDAAC
+    goto LDAAF;                             // bra   .LDAAF
+
+LDAA4:
+    reg.ab = ram.word(0x2053);              // ldd   $2053
+    carry = reg.ab == 0xFFFF;
+    reg.ab += 0x0001;                       // addd  #$0001
+    if (carry)
+        goto LDAAF;                         // bcs   .LDAAF
+
+LDAAC:
+    ram.setWord(0x2053, reg.ab);            // std   $2053
+
+LDAAF:
+    reg.ab = ram.word(0x00C8);              // ldd   $00C8
+    ram.setWord(0x00C6, reg.ab);            // std   $00C6
+    reg.r[B] = ram[0x203A];                 // ldab  $203A
+    reg.r[B]++;                             // incb
+    ram[0x203A] = reg.r[B];                 // stab  $203A
+    if (reg.r[B] != 0x04)                   // cmpb  #$04
+        goto LDAD0;                         // bne   .LDAD0
+    reg.r[B] = ram[0x2038];                 // ldab  $2038
+    reg.r[A] = ram[0x008A];                 // ldaa  $008A
+    if (reg.r[A] & 0x01)
+        goto LDACB;                         // bita  #$01 / bne .LDACB
+    reg.r[B] &= 0xFE;                       // andb  #$FE
+    goto LDACD;                             // bra   .LDACD
+
+LDACB:
+    reg.r[B] |= 0x01;                       // orab  #$01
+
+LDACD:
+    ram[0x2038] = reg.r[B];                 // stab  $2038
+
+LDAD0:
+    return;                                 // pula / tap / rts
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main loop routines (stepperMtr2.asm)
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// LF5F0, returns $FF with the throttle closed and the car stopped, otherwise clears
+// X2047.0, resets X204B/4C and returns zero
+inline UINT8 idleModeCheck_6803 (Cpu6803 &cpu, IdleRam &ram, const IdleTables &t)
+{
+    ABunion &reg = cpu.reg;
+
+    reg.r[A] = ram[0x0086];                 // ldaa  $0086
+    if (!(reg.r[A] & 0x80))
+        goto LF600;                         // bita  #$80 / beq .LF600
+    reg.r[A] = ram[0x008B];                 // ldaa  $008B
+    if (reg.r[A] & 0x01)
+        goto LF600;                         // bita  #$01 / bne .LF600
+    reg.r[A] = 0xFF;                        // ldaa  #$FF
+    goto LF610;                             // bra   .LF610
+
+LF600:
+    reg.r[A] = ram[0x2047];                 // ldaa  $2047
+    reg.r[A] &= 0xFE;                       // anda  #$FE
+    ram[0x2047] = reg.r[A];                 // staa  $2047
+    reg.ab = t.word(0xC240);                // ldd   $C240
+    ram.setWord(0x204B, reg.ab);            // std   $204B
+    reg.r[A] = 0x00;                        // ldaa  #$00
+
+LF610:
+    return reg.r[A];                        // rts
+}
+
+// LF611, sets X2047.3 after 50 ($C240) passes above 1670 RPM
+inline void highRpmCounter_6803 (Cpu6803 &cpu, IdleRam &ram, const IdleTables &t)
+{
+    ABunion &reg = cpu.reg;
+
+    reg.ab = ram.word(RAM_IGN_PERIOD);      // ldd   ignPeriod
+    if (reg.ab < t.word(0xC253))            // subd  $C253
+        goto LF620;                         // bcs   .LF620
+    reg.ab = t.word(0xC240);                // ldd   $C240
+    ram.setWord(0x204B, reg.ab);            // std   $204B
+    goto LF639;                             // bra   .LF639
+
+LF620:
+    reg.ab = ram.word(0x204B);              // ldd   $204B
+    reg.ab -= 0x0001;                       // subd  #$0001
+    ram.setWord(0x204B, reg.ab);            // std   $204B
+    if (reg.ab != 0)
+        goto LF639;                         // bne   .LF639
+    reg.ab = t.word(0xC240);                // ldd   $C240
+    ram.setWord(0x204B, reg.ab);            // std   $204B
+    reg.r[A] = ram[0x2047];                 // ldaa  $2047
+    reg.r[A] |= 0x08;                       // oraa  #$08
+    ram[0x2047] = reg.r[A];                 // staa  $2047
+
+LF639:
+    return;                                 // rts
+}
+
+// LF63A, closes the valve 30 steps ($C23F) once X2047.3 is set
+inline void closeIacValve_6803 (Cpu6803 &cpu, IdleRam &ram, const IdleTables &t)
+{
+    ABunion &reg = cpu.reg;
+
+    reg.r[B] = ram[0x2047];                 // ldab  $2047
+    if (!(reg.r[B] & 0x08))
+        goto LF657;                         // bitb  #$08 / beq .LF657
+    reg.r[A] = ram[RAM_IAC_STEP_COUNT];     // ldaa  iacMotorStepCount
+    if (reg.r[A] != 0)
+        goto LF657;                         // bne   .LF657
+    reg.r[A] = ram[0x008A];                 // ldaa  $008A
+    reg.r[A] |= 0x01;                       // oraa  #$01
+    ram[0x008A] = reg.r[A];                 // staa  $008A
+    reg.r[A] = t.byte(0xC23F);              // ldaa  $C23F
+    ram[RAM_IAC_STEP_COUNT] = reg.r[A];     // staa  iacMotorStepCount
+    reg.r[B] &= 0xF7;                       // andb  #$F7
+    ram[0x2047] = reg.r[B];                 // stab  $2047
+
+LF657:
+    return;                                 // rts
+}
+
+// LF831, the idle air control fault test (fault code 48, X004C.4)
+inline void iacFaultTest_6803 (Cpu6803 &cpu, IdleRam &ram, const IdleTables &t)
+{
+    ABunion &reg = cpu.reg;
+    bool carry;
+
+    reg.r[A] = ram[0x0087];                 // ldaa  $0087
+    if (reg.r[A] & 0x02)
+        goto LF8B3;                         // bita  #$02 / bne .LF8B3
+    reg.r[A] = ram[RAM_COOLANT_TEMP_COUNT]; // ldaa  coolantTempCount
+    if (reg.r[A] >= t.byte(0xC248))         // cmpa  $C248
+        goto LF8B3;                         // bcc   .LF8B3
+    reg.r[A] = ram[0x2047];                 // ldaa  $2047
+    if (!(reg.r[A] & 0x01))
+        goto LF8B3;                         // bita  #$01 / beq .LF8B3
+    reg.ab = ram.word(RAM_IGN_PERIOD);      // ldd   ignPeriod
+    if (reg.ab >= IAC_FAULT_PERIOD)         // subd  #$3C67
+        goto LF8B3;                         // bcc   .LF8B3
+    reg.ab -= IAC_FAULT_PERIOD;
+    reg.r[A] = ram[RAM_FUEL_MAP_LOAD_IDX];  // ldaa  fuelMapLoadIdx
+    if (reg.r[A] >= t.byte(0xC266))         // cmpa  $C266
+        goto LF8B3;                         // bcc   .LF8B3
+    if (!t.laterFaultTest)
+        goto LF857;
+    reg.r[A] = ram[RAM_FAULT_BITS_49];      // ldaa  faultBits_49
+    if (reg.r[A] & 0x06)
+        goto LF8B3;                         // bita  #$06 / bne .LF8B3
+
+LF857:
+    reg.r[A] = ram[0x2048];                 // ldaa  $2048
+    if (!(reg.r[A] & 0x80))
+        goto LF87C;                         // bpl   .LF87C
+    if (reg.r[A] < t.byte(0xC24E))          // cmpa  $C24E
+        goto LF8B3;                         // bcs   .LF8B3
+    if (!t.laterFaultTest)
+        goto LF86C;
+    reg.ab = ram.word(RAM_TARGET_IDLE_RPM); // ldd   targetIdleRPM
+    reg.ab += t.word(0xC7E1);               // addd  $C7E1
+    if (reg.ab >= ram.word(RAM_ENGINE_RPM)) // subd  engineRPM
+        goto LF8B3;                         // bcc   .LF8B3
+
+LF86C:
+    reg.ab = ram.word(0x204F);              // ldd   $204F
+    carry = reg.ab < ram.word(RAM_MAF_LINEAR);
+    reg.ab -= ram.word(RAM_MAF_LINEAR);     // subd  mafLinear
+    if (carry)
+        goto LF8AD;                         // bcs   .LF8AD
+    if (reg.ab < t.word(0xC24B))            // subd  $C24B
+        goto LF8AD;                         // bcs   .LF8AD
+    goto LF8B3;                             // bra   .LF8B3
+
+LF87C:
+    if (reg.r[A] >= t.byte(0xC24D))         // cmpa  $C24D
+        goto LF8B3;                         // bcc   .LF8B3
+    if (!t.laterFaultTest)
+        goto LF8A0;
+    reg.r[A] = ram[0x201D];                 // ldaa  $201D
+    if (reg.r[A] != 0)
+        goto LF8B3;                         // bne   .LF8B3
+    reg.r[A] = ram[RAM_SHORT_TRIM_R];       // ldaa  shortLambdaTrimR
+    if (reg.r[A] & 0x80)
+        goto LF88C;                         // bmi   .LF88C
+    reg.r[A] = (UCHAR)~reg.r[A];            // coma
+    reg.r[A]++;                             // inca
+
+LF88C:
+    reg.r[A] -= 0x80;                       // suba  #$80
+    if (reg.r[A] >= t.byte(0xC7E3))         // cmpa  $C7E3
+        goto LF8B3;                         // bcc   .LF8B3
+    reg.r[A] = ram[RAM_SHORT_TRIM_L];       // ldaa  shortLambdaTrimL
+    if (reg.r[A] & 0x80)
+        goto LF899;                         // bmi   .LF899
+    reg.r[A] = (UCHAR)~reg.r[A];            // coma
+    reg.r[A]++;                             // inca
+
+LF899:
+    reg.r[A] -= 0x80;                       // suba  #$80
+    if (reg.r[A] >= t.byte(0xC7E3))         // cmpa  $C7E3
+        goto LF8B3;                         // bcc   .LF8B3
+
+LF8A0:
+    reg.ab = ram.word(RAM_MAF_LINEAR);      // ldd   mafLinear
+    carry = reg.ab < ram.word(0x204F);
+    reg.ab -= ram.word(0x204F);             // subd  $204F
+    if (carry)
+        goto LF8AD;                         // bcs   .LF8AD
+    if (reg.ab >= t.word(0xC249))           // subd  $C249
+        goto LF8B3;                         // bcc   .LF8B3
+
+LF8AD:
+    reg.r[A] = ram[RAM_FAULT_BITS_4C];      // ldaa  faultBits_4C
+    reg.r[A] |= 0x10;                       // oraa  #$10
+    ram[RAM_FAULT_BITS_4C] = reg.r[A];      // staa  faultBits_4C
+
+LF8B3:
+    return;                                 // rts
+}
+
+// LF8B4 (Calculate_X2048), moves X2048 toward the valve's MAF error by up to $C25A
+// ($C25B) a pass and sets X2059.0 when the valve is out of range and the engine slow
+inline void calculateX2048_6803 (Cpu6803 &cpu, IdleRam &ram, const IdleTables &t)
+{
+    ABunion &reg = cpu.reg;
+    UCHAR stacked;
+    bool carry;
+
+    reg.r[B] = 0x80;                        // ldab  #$80
+    reg.r[A] = ram[RAM_IGN_PERIOD];         // ldaa  ignPeriod
+    if (reg.r[A] >= 0x92)                   // cmpa  #$92
+        goto LF8C2;                         // bcc   .LF8C2
+    reg.r[A] = ram[RAM_PORT1_DATA];         // ldaa  port1data
+    if (!(reg.r[A] & 0x40))
+        goto LF8C6;                         // bita  #$40 / beq .LF8C6
+
+LF8C2:
+    ram[0x2048] = reg.r[B];                 // stab  $2048
+    return;                                 // rts
+
+LF8C6:
+    reg.r[A] = 0;                           // clra
+    reg.r[B] = ram[0x00AD];                 // ldab  $00AD
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+    reg.r[A] = 0x80;                        // ldaa  #$80
+    reg.r[B] = ram[0x006E];                 // ldab  $006E
+    reg.ab -= ram.word(0x00C8);             // subd  $00C8
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+    reg.r[A] = 0;                           // clra
+    reg.r[B] = ram[0x004F];                 // ldab  $004F
+    if (reg.r[B] & 0x80)
+        goto LF8E4;                         // bmi   .LF8E4
+    reg.r[B] = 0x80;                        // ldab  #$80
+    reg.r[B] -= ram[0x004F];                // subb  $004F
+    ram.setWord(0x00CA, reg.ab);            // std   $00CA
+    reg.ab = ram.word(0x00C8);              // ldd   $00C8
+    reg.ab -= ram.word(0x00CA);             // subd  $00CA
+    goto LF8E8;                             // bra   .LF8E8
+
+LF8E4:
+    reg.r[B] &= 0x7F;                       // andb  #$7F
+    reg.ab += ram.word(0x00C8);             // addd  $00C8
+
+LF8E8:
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+    reg.r[A] = 0;                           // clra
+    reg.r[B] = ram[0x0072];                 // ldab  $0072
+    if (!(reg.r[B] & 0x80))
+        goto LF8F5;                         // bpl   .LF8F5
+    reg.r[B] &= 0x7F;                       // andb  #$7F
+    reg.ab += ram.word(0x00C8);             // addd  $00C8
+    goto LF904;                             // bra   .LF904
+
+LF8F5:
+    reg.r[B] = 0x80;                        // ldab  #$80
+    reg.r[B] -= ram[0x0072];                // subb  $0072
+    ram.setWord(0x00CA, reg.ab);            // std   $00CA
+    reg.ab = ram.word(0x00C8);              // ldd   $00C8
+    carry = reg.ab < ram.word(0x00CA);
+    reg.ab -= ram.word(0x00CA);             // subd  $00CA
+    if (!carry)
+        goto LF904;                         // bcc   .LF904
+    reg.ab = 0x0000;                        // ldd   #$0000
+
+LF904:
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+    if (!(reg.ab & 0x8000))
+        goto LF917;                         // bpl   .LF917
+    reg.r[A] &= 0x7F;                       // anda  #$7F
+    ram.setWord(0x00C8, reg.ab);            // std   $00C8
+    reg.ab = ram.word(0x2053);              // ldd   $2053
+    carry = reg.ab < ram.word(0x00C8);
+    reg.ab -= ram.word(0x00C8);             // subd  $00C8
+    if (!carry)
+        goto LF925;                         // bcc   .LF925
+
+LF913:
+    reg.r[B] = 0x00;                        // ldab  #$00
+    goto LF943;                             // bra   .LF943
+
+LF917:
+    reg.ab = 0x8000;                        // ldd   #$8000
+    reg.ab -= ram.word(0x00C8);             // subd  $00C8
+    carry = reg.ab + ram.word(0x2053) > 0xFFFF;
+    reg.ab += ram.word(0x2053);             // addd  $2053
+    if (!carry)
+        goto LF925;                         // bcc   .LF925
+
+LF921:
+    reg.r[B] = 0xFF;                        // ldab  #$FF
+    goto LF943;                             // bra   .LF943
+
+LF925:
+    ram.setWord(0x00CA, reg.ab);            // std   $00CA
+    if (reg.r[A] == 0x80)                   // cmpa  #$80
+        goto LF939;                         // beq   .LF939
+    if (reg.r[A] > 0x80)
+        goto LF921;                         // bcc   .LF921
+    if (reg.r[A] < 0x7F)                    // cmpa  #$7F
+        goto LF913;                         // bcs   .LF913
+    if (reg.r[B] <= 0x80)                   // cmpb  #$80
+        goto LF913;                         // bls   .LF913
+    reg.r[B] -= 0x80;                       // subb  #$80
+    goto LF943;                             // bra   .LF943
+
+LF939:
+    if (reg.r[B] >= 0x80)                   // cmpb  #$80
+        goto LF921;                         // bcc   .LF921
+    carry = reg.r[B] + 0x80 > 0xFF;
+    reg.r[B] += 0x80;                       // addb  #$80
+    if (!carry)
+        goto LF943;                         // bcc   .LF943
+    reg.r[B] = 0xFF;                        // ldab  #$FF
+
+LF943:
+    stacked = reg.r[B];                     // pshb
+    reg.r[A] = ram[0x2059];                 // ldaa  $2059
+    reg.r[A] &= 0xFE;                       // anda  #$FE
+    ram[0x2059] = reg.r[A];                 // staa  $2059
+    reg.ab = ram.word(0x00CA);              // ldd   $00CA
+    if (reg.ab >= t.word(0xC262))           // subd  $C262
+        goto LF964;                         // bcc   .LF964
+    reg.ab = ram.word(RAM_ENGINE_RPM);      // ldd   engineRPM
+    if (reg.ab >= ram.word(RAM_TARGET_IDLE_RPM))    // subd  targetIdleRPM
+        goto LF972;                         // bcc   .LF972
+
+LF95A:
+    reg.r[A] = ram[0x2059];                 // ldaa  $2059
+    reg.r[A] |= 0x01;                       // oraa  #$01
+    ram[0x2059] = reg.r[A];                 // staa  $2059
+    goto LF972;                             // bra   .LF972
+
+LF964:
+    reg.ab = ram.word(0x00CA);              // ldd   $00CA
+    if (reg.ab < t.word(0xC264))            // subd  $C264
+        goto LF972;                         // bcs   .LF972
+    reg.ab = ram.word(RAM_ENGINE_RPM);      // ldd   engineRPM
+    if (reg.ab >= ram.word(RAM_TARGET_IDLE_RPM))    // subd  targetIdleRPM
+        goto LF95A;                         // bcc   .LF95A
+
+LF972:
+    reg.r[B] = stacked;                     // pulb
+    reg.r[A] = ram[0x2048];                 // ldaa  $2048
+    carry = reg.r[A] < reg.r[B];
+    reg.r[A] -= reg.r[B];                   // sba
+    if (carry)
+        goto LF98A;                         // bcs   .LF98A
+    carry = reg.r[A] < t.byte(0xC25A);
+    reg.r[A] -= t.byte(0xC25A);             // suba  $C25A
+    if (carry)
+        goto LF99D;                         // bcs   .LF99D
+    reg.r[B] = ram[0x2048];                 // ldab  $2048
+    carry = reg.r[B] < t.byte(0xC25A);
+    reg.r[B] -= t.byte(0xC25A);             // subb  $C25A
+    if (!carry)
+        goto LF99D;                         // bcc   .LF99D
+    reg.r[B] = 0x00;                        // ldab  #$00
+    goto LF99D;                             // bra   .LF99D
+
+LF98A:
+    reg.r[A] = reg.r[B];                    // tba
+    reg.r[A] -= ram[0x2048];                // suba  $2048
+    carry = reg.r[A] < t.byte(0xC25B);
+    reg.r[A] -= t.byte(0xC25B);             // suba  $C25B
+    if (carry)
+        goto LF99D;                         // bcs   .LF99D
+    reg.r[B] = ram[0x2048];                 // ldab  $2048
+    carry = reg.r[B] + t.byte(0xC25B) > 0xFF;
+    reg.r[B] += t.byte(0xC25B);             // addb  $C25B
+    if (!carry)
+        goto LF99D;                         // bcc   .LF99D
+    reg.r[B] = 0xFF;                        // ldab  #$FF
+
+LF99D:
+    ram[0x2048] = reg.r[B];                 // stab  $2048
+}                                           // rts
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  idleLoopTail
+//
+//  The end of the main loop, from 'inc $207E' (.LCC53) to .LCCF2, where
+//  driveIacMotor is called if iacMotorStepCount isn't zero. The block at
+//  .LCC78 only runs on the pass the X207E counter passes $C259 (80), and
+//  only while X0087.2 is set; otherwise idleControl is called there.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline void idleLoopTail_6803 (Cpu6803 &cpu, IdleRam &ram, const IdleTables &t)
+{
+    ABunion &reg = cpu.reg;
+
+    ram[0x207E]++;                          // inc   $207E
+    reg.r[A] = t.byte(0xC259);              // ldaa  $C259
+    if (reg.r[A] >= ram[0x207E])            // cmpa  $207E
+        goto LCC76;                         // bcc   .LCC76
+    ram[0x207E] = 0;                        // clr   $207E
+    reg.r[A] = ram[0x2047];                 // ldaa  $2047
+    if (!(reg.r[A] & 0x10))
+        goto LCC76;                         // bita  #$10 / beq .LCC76
+    reg.r[A] = ram[0x0087];                 // ldaa  $0087
+    if (reg.r[A] & 0x04)
+        goto LCC78;                         // bita  #$04 / bne .LCC78
+    idleControl_6803(cpu, ram, t);          // jsr   idleControl
+
+LCC76:
+    return;                                 // bra   .LCCF2
+
+LCC78:
+    reg.r[A] = idleModeCheck_6803(cpu, ram, t);     // jsr   LF5F0
+    if (reg.r[A] == 0)
+        goto LCCEF;                         // beq   .LCCEF
+    reg.r[A] = ram[0x2047];                 // ldaa  $2047
+    if (reg.r[A] & 0x04)
+        goto LCCEF;                         // bita  #$04 / bne .LCCEF
+    iacFaultTest_6803(cpu, ram, t);         // jsr   LF831
+    highRpmCounter_6803(cpu, ram, t);       // jsr   LF611
+    reg.r[A] = ram[0x2047];                 // ldaa  $2047
+    if (!(reg.r[A] & 0x08))
+        goto LCCEF;                         // bita  #$08 / beq .LCCEF
+    if (reg.r[A] & 0x01)
+        goto LCCE5;                         // bita  #$01 / bne .LCCE5
+    reg.r[A] |= 0x01;                       // oraa  #$01
+    ram[0x2047] = reg.r[A];                 // staa  $2047
+    idleMafReference_6803(cpu, ram, t);     // X204F/50
+
+LCCE5:
+    reg.r[A] = ram[0x2059];                 // ldaa  $2059
+    if (reg.r[A] & 0x01)
+        goto LCCEF;                         // bita  #$01 / bne .LCCEF
+    closeIacValve_6803(cpu, ram, t);        // jsr   LF63A
+
+LCCEF:
+    calculateX2048_6803(cpu, ram, t);       // jsr   LF8B4
+}
+
+#endif // IDLE_CONTROL_H
@@ -0,0 +1,465 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Code Models - Idle Simulation
+//
+//  The idle air control models in IdleControl.h closing the loop around the engine plant
+//  (EnginePlant.h), stepped in fixed time steps so that a run is deterministic and
+//  thousands of them (idle scenarios) can go on separate threads at once:
+//
+//      plant       every plantStepUs: the plant integrates with the script's throttle,
+//                  load and coolant temperature, plus the load of whatever is switched
+//                  on (A/C compressor, drive engaged, heated screen), with the idle
+//                  bypass area set by the valve position
+//      main loop   every mainLoopUs: the RAM the idle routines read is written from the
+//                  plant (engine speed, spark period, coolant count, linear MAF and row
+//                  index) and the switches, then, as in the firmware, idleControl at the
+//                  end of every muxPasses'th pass (the end of the ADC mux list), the end
+//                  of the main loop (idleLoopTail_6803) and driveIacMotor
+//
+//  The valve is the stepper motor's position in iacPosition: 180 steps is closed, 0 is
+//  fully open. The bypass area is leakArea + iacArea x (180 - position) / 180 of the full
+//  throttle area. The fueling isn't modelled here (see CoSimulation.h): the plant gets the
+//  fuel for lambda 1 at every plant step, so only the air side moves the engine speed.
+//
+//  The other RAM the idle routines test is set the way the listings say it reads at idle
+//  with the engine running and the car stopped:
+//
+//      X0085.7     engine speed below 505 RPM          X0086.7     throttle closed
+//      X0087.6     engine speed above 1200 RPM         X008A.1     set (fuel temp routine)
+//      X008A.3     A/C off                             X008A.5     drive engaged
+//      X008B.0     road speed below 4 KPH (always)     X008B.6     main voltage good
+//      X00DD.2     heated screen off                   X2047.4     set (coolant routine)
+//      P1.6        fuel pump relay on
+//      shortLambdaTrimR/L $8000, fuelMapNumber the tune's default, neutralSwitchVal $20 in
+//      drive and $E0 in park (an automatic), counterHigh the simulated time in
+//      microseconds (the timer overflow flag is set on the pass it wraps)
+//
+//  and the battery backed values are at their defaults (X004F $6C, X0072 $80, X2048 $80).
+//  X2053/54, the 16-bit valve counter, starts at $8000 + the start position.
+//
+//  The period of the main loop isn't known exactly. It is about 2 ms (a step of the valve
+//  takes at least 6.25 ms, and the routines wait a few seconds after the engine starts
+//  before closing the loop); it can be changed, as can everything else in IdleSimConfig.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef IDLE_SIMULATION_H
+#define IDLE_SIMULATION_H
+
+#include <math.h>
+#include <string.h>
+#include <string>
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+#include "MafLinearizeBatch.h"
+#include "FuelSurface.h"
+#include "EnginePlant.h"
+#include "CoSimulation.h"
+#include "CoolantFueling.h"
+#include "IdleControl.h"
+
+
+#define IDLE_LOW_RPM                505.0   // X0085.7
+#define IDLE_HIGH_RPM               1200.0  // X0087.6
+#define IDLE_CLOSED_THROTTLE        0.01    // X0086.7 below this
+#define IDLE_NEUTRAL_DRIVE          0x20    // neutralSwitchVal
+#define IDLE_NEUTRAL_PARK           0xE0
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Configuration and scenarios
+//
+///////////////////////////////////////////////////////////////////////////////
+struct IdleSimConfig
+{
+    UINT32  plantStepUs;
+    UINT32  mainLoopUs;
+    int     muxPasses;                      // main loop passes per idleControl call
+    double  leakArea;                       // bypass area with the valve closed
+    double  iacArea;                        // more with the valve fully open
+    double  linearPerGs;                    // MAF scale (mafLinear per g/s)
+    double  acLoad;                         // Nm, A/C compressor
+    double  driveLoad;                      // Nm, torque converter in drive at idle
+    double  heatedScreenLoad;               // Nm, the alternator load
+    double  settleSeconds;                  // statistics start after this
+    double  huntBand;                       // RPM either side of the target
+    PlantParams plant;
+};
+
+inline IdleSimConfig defaultIdleSimConfig (void)
+{
+    IdleSimConfig c;
+
+    c.plantStepUs = 500;
+    c.mainLoopUs = 2000;
+    c.muxPasses = 14;
+    c.leakArea = 0.006;
+    c.iacArea = 0.036;
+    c.linearPerGs = 88.0;                   // as CoSim
+    c.acLoad = 12.0;
+    c.driveLoad = 15.0;
+    c.heatedScreenLoad = 4.0;
+    c.settleSeconds = 10.0;
+    c.huntBand = 25.0;
+    c.plant = defaultPlantParams();
+
+    return c;
+}
+
+// An accessory or the gearbox switched on from 'on' to 'off' seconds (-1 for never)
+struct IdleSwitch
+{
+    double  on;
+    double  off;
+
+    bool active (double t) const        { return on >= 0.0 && t >= on && (off < 0.0 || t < off); }
+};
+
+struct IdleScenario
+{
+    std::string name;
+    DriveScript script;                     // throttle, load and coolant temperature
+    IdleSwitch  ac;
+    IdleSwitch  drive;
+    IdleSwitch  heatedScreen;
+    UINT8       startPosition;              // iacPosition at power on
+    double      startRpm;
+};
+
+inline void clearIdleScenario (IdleScenario &s)
+{
+    s.name.clear();
+    s.script.points.clear();
+    s.ac.on = s.ac.off = -1.0;
+    s.drive.on = s.drive.off = -1.0;
+    s.heatedScreen.on = s.heatedScreen.off = -1.0;
+    s.startPosition = 120;
+    s.startRpm = 1000.0;
+}
+
+struct IdleResult
+{
+    double  simSeconds;
+    UINT16  target;                         // targetIdleRPM at the end
+    double  meanRpm;                        // after settleSeconds
+    double  minRpm, maxRpm;
+    double  rmsError;                       // RPM from the target
+    int     huntCycles;                     // swings from below the band to above it
+    double  settleTime;                     // s, last time outside the band
+    UINT32  steps;                          // valve steps taken
+    UINT32  reversals;                      // changes of direction
+    UINT8   positionMin, positionMax;
+    UINT8   positionFinal;
+    bool    fault48;                        // X004C.4, idle air control fault
+    bool    stalled;
+    double  stallTime;
+    UINT32  idleControlCalls;
+};
+
+// Called after each routine with the RAM before and after it (for checking the models
+// against the firmware as the run goes)
+enum IdleRoutine
+{
+    IDLE_CONTROL,
+    IDLE_LOOP_TAIL,
+    IDLE_DRIVE_IAC
+};
+
+typedef void (*IdleCallHook)(void *context, IdleRoutine routine, const IdleRam &before,
+                             const IdleRam &after);
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  IdleSimulation
+//
+//  Like CoSimulation: run() for a whole scenario, or start(), then step()
+//  a main loop pass at a time, then finish().
+//
+///////////////////////////////////////////////////////////////////////////////
+class IdleSimulation
+{
+public:
+    IdleSimulation (const TuneImage &tune, const IdleTables &tables, const MafSensor &maf,
+                    const IdleSimConfig &config) :
+        t(tables), sensor(maf), cfg(config), plant(config.plant), prom(tune.constants(tune.defaultFuelMap())),
+        mapNumber((UINT8)tune.defaultFuelMap()), scenario(0), hook(0), hookContext(0)
+    {
+        memset(&r, 0, sizeof(r));
+    }
+
+    void setHook (IdleCallHook callHook, void *context)
+    {
+        hook = callHook;
+        hookContext = context;
+    }
+
+    IdleResult run (const IdleScenario &s)
+    {
+        start(s);
+        while (step())
+            ;
+
+        return finish();
+    }
+
+    void start (const IdleScenario &s)
+    {
+        scenario = &s;
+        nowUs = 0;
+        endUs = (UINT64)(s.script.duration() * 1e6 + 0.5);
+        pass = 0;
+        lastDirection = -1;
+        below = false;
+        errorSum = rpmSum = 0.0;
+        samples = 0;
+
+        memset(&r, 0, sizeof(r));
+        r.minRpm = 1e9;
+        r.positionMin = 0xFF;
+
+        plant.reset(s.startRpm, s.script.at(0.0).throttle);
+
+        ram.clear();
+        ram[0x004F] = 0x6C;
+        ram[0x0072] = 0x80;
+        ram[0x2048] = 0x80;
+        ram[RAM_IAC_POSITION] = s.startPosition;
+        ram.setWord(0x2053, (UINT16)(0x8000 + s.startPosition));
+        ram[RAM_FUEL_MAP_NUMBER] = mapNumber;
+        ram.setWord(RAM_SHORT_TRIM_R, 0x8000);
+        ram.setWord(RAM_SHORT_TRIM_L, 0x8000);
+    }
+
+    // One main loop pass (and the plant up to the next one). Returns false at the end.
+    bool step (void)
+    {
+        if (nowUs >= endUs)
+            return false;
+
+        double now = nowUs / 1e6;
+        PlantInputs in = scenario->script.at(now);
+
+        sense(in, now);
+
+        if (++pass >= cfg.muxPasses) {
+            pass = 0;
+            call(IDLE_CONTROL);
+            r.idleControlCalls++;
+        }
+
+        call(IDLE_LOOP_TAIL);
+
+        if (ram[RAM_IAC_STEP_COUNT]) {
+            UINT8 before = ram[RAM_IAC_POSITION];
+            call(IDLE_DRIVE_IAC);
+            countStep(before, ram[RAM_IAC_POSITION]);
+        }
+
+        ram[RAM_TIMER_CSR] &= ~TIMER_CSR_TOF;       // read with the counter
+
+        // the plant to the next pass
+        double dt = cfg.plantStepUs / 1e6;
+        UINT8 position = ram[RAM_IAC_POSITION];
+
+        plant.setBypassArea(cfg.leakArea + cfg.iacArea * (IAC_CLOSED_POSITION - position) / IAC_CLOSED_POSITION);
+
+        for (UINT32 us = 0; us < cfg.mainLoopUs; us += cfg.plantStepUs) {
+            PlantInputs load = scenario->script.at((nowUs + us) / 1e6);
+
+            load.loadTorque += accessoryLoad((nowUs + us) / 1e6);
+            fuel(dt);
+            plant.step(dt, load);
+
+            if (plant.stalled() && !r.stalled) {
+                r.stalled = true;
+                r.stallTime = (nowUs + us) / 1e6;
+            }
+        }
+
+        record(now + cfg.mainLoopUs / 1e6, position);
+        nowUs += cfg.mainLoopUs;
+
+        return nowUs < endUs;
+    }
+
+    IdleResult finish (void)
+    {
+        r.simSeconds = endUs / 1e6;
+        r.target = ram.word(RAM_TARGET_IDLE_RPM);
+        r.positionFinal = ram[RAM_IAC_POSITION];
+        r.fault48 = (ram[RAM_FAULT_BITS_4C] & 0x10) != 0;
+
+        if (samples) {
+            r.meanRpm = rpmSum / samples;
+            r.rmsError = sqrt(errorSum / samples);
+        }
+        if (r.minRpm > r.maxRpm)
+            r.minRpm = r.maxRpm = 0.0;
+
+        return r;
+    }
+
+    double now (void) const                     { return nowUs / 1e6; }
+    const IdleRam &idleRam (void) const         { return ram; }
+    const EnginePlant &enginePlant (void) const { return plant; }
+
+private:
+    // RAM from the plant and the switches
+    void sense (const PlantInputs &in, double now)
+    {
+        double rpm = plant.stalled() ? 0.0 : plant.rpm();
+        double period = (rpm > 115.0) ? 7.5e6 / rpm : 0xFFFF;      // 2 us units
+        UINT16 linear = linearizeMAF_Scalar(sensor.mafSum(plant.airFlow()), prom);
+
+        ram.setWord(RAM_ENGINE_RPM, (UINT16)(rpm + 0.5));
+        ram.setWord(RAM_IGN_PERIOD, (UINT16)period);
+        ram[RAM_COOLANT_TEMP_COUNT] = ectCountForTemp(in.coolantTemp);
+        ram.setWord(RAM_MAF_LINEAR, linear);
+        ram[RAM_FUEL_MAP_LOAD_IDX] = rowIndex_Scalar((UINT16)period, linear, prom);
+
+        bool drive = scenario->drive.active(now);
+
+        setBit(0x0085, 0x80, rpm < IDLE_LOW_RPM);
+        setBit(0x0086, 0x80, in.throttle < IDLE_CLOSED_THROTTLE);
+        setBit(0x0087, 0x40, rpm > IDLE_HIGH_RPM);
+        setBit(0x008A, 0x02, true);
+        setBit(0x008A, 0x08, !scenario->ac.active(now));
+        setBit(0x008A, 0x20, drive);
+        setBit(0x008B, 0x01, false);
+        setBit(0x008B, 0x40, true);
+        setBit(0x00DD, 0x04, !scenario->heatedScreen.active(now));
+        setBit(0x2047, 0x10, true);
+        setBit(RAM_PORT1_DATA, 0x40, false);
+        ram[RAM_NEUTRAL_SWITCH] = drive ? IDLE_NEUTRAL_DRIVE : IDLE_NEUTRAL_PARK;
+
+        UINT16 counter = (UINT16)nowUs;
+
+        if (counter < ram.word(RAM_COUNTER_HIGH))
+            ram[RAM_TIMER_CSR] |= TIMER_CSR_TOF;
+        ram.setWord(RAM_COUNTER_HIGH, counter);
+    }
+
+    void call (IdleRoutine routine)
+    {
+        IdleRam before;
+
+        if (hook)
+            before = ram;
+
+        switch (routine) {
+        case IDLE_CONTROL:      idleControl_6803(cpu, ram, t);      break;
+        case IDLE_LOOP_TAIL:    idleLoopTail_6803(cpu, ram, t);     break;
+        case IDLE_DRIVE_IAC:    driveIacMotor_6803(cpu, ram, t);    break;
+        }
+
+        if (hook)
+            hook(hookContext, routine, before, ram);
+    }
+
+    double accessoryLoad (double now) const
+    {
+        double load = 0.0;
+
+        if (scenario->ac.active(now))
+            load += cfg.acLoad;
+        if (scenario->drive.active(now))
+            load += cfg.driveLoad;
+        if (scenario->heatedScreen.active(now))
+            load += cfg.heatedScreenLoad;
+
+        return load;
+    }
+
+    // the fuel for lambda 1, as one bank's pulse
+    void fuel (double dt)
+    {
+        double grams = plant.airFlow() * dt / (PLANT_STOICH_AFR * plant.vaporizedFraction());
+        double open = grams * 1e6 / (PLANT_INJECTORS_PER_BANK * cfg.plant.injectorFlow);
+
+        if (open > 0.0)
+            plant.inject(open + cfg.plant.injectorDeadTime);
+    }
+
+    void countStep (UINT8 before, UINT8 after)
+    {
+        if (before == after)
+            return;
+
+        int direction = (after > before) ? 1 : 0;          // 1 is closing
+
+        if (lastDirection >= 0 && direction != lastDirection)
+            r.reversals++;
+
+        lastDirection = direction;
+        r.steps++;
+    }
+
+    void record (double now, UINT8 position)
+    {
+        if (position < r.positionMin)
+            r.positionMin = position;
+        if (position > r.positionMax)
+            r.positionMax = position;
+
+        if (plant.stalled() || now < cfg.settleSeconds)
+            return;
+
+        double rpm = plant.rpm();
+        double error = rpm - ram.word(RAM_TARGET_IDLE_RPM);
+
+        if (rpm < r.minRpm)
+            r.minRpm = rpm;
+        if (rpm > r.maxRpm)
+            r.maxRpm = rpm;
+
+        rpmSum += rpm;
+        errorSum += error * error;
+        samples++;
+
+        if (error < -cfg.huntBand)
+            below = true;
+        else if (error > cfg.huntBand && below) {
+            below = false;
+            r.huntCycles++;
+        }
+
+        if (fabs(error) > cfg.huntBand)
+            r.settleTime = now;
+    }
+
+    void setBit (UINT16 addr, UCHAR mask, bool set)
+    {
+        if (set)
+            ram[addr] |= mask;
+        else
+            ram[addr] &= (UCHAR)~mask;
+    }
+
+    const IdleTables   &t;
+    const MafSensor    &sensor;
+    IdleSimConfig       cfg;
+    EnginePlant         plant;
+    PromConstants       prom;
+    UINT8               mapNumber;
+    Cpu6803             cpu;
+    IdleRam             ram;
+
+    // the run in progress
+    const IdleScenario *scenario;
+    IdleCallHook        hook;
+    void               *hookContext;
+    UINT64              nowUs;
+    UINT64              endUs;
+    int                 pass;
+    int                 lastDirection;
+    bool                below;
+    double              errorSum;
+    double              rpmSum;
+    UINT32              samples;
+    IdleResult          r;
+};
+
+#endif // IDLE_SIMULATION_H
@@ -0,0 +1,240 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Batch MAF Linearization
+//
+//  linearizeMAF_6803() in MafRowIndex.h handles one value at a time through the register
+//  unions. This file linearizes a whole array of MAF sums in one call, for replaying long
+//  logged MAF traces and for the sweeps.
+//
+//  The results are bit-exact with linearizeMAF_6803(), including its quirks: the squaring
+//  loop is not a true (x * x) / 0x10000 since it drops the low x low product and the low
+//  byte of the cross product. Working it through, the 6803 squaring of a 16-bit value with
+//  high byte H and low byte L is
+//
+//      sq(x) = H * H + 2 * ((H * L) >> 8)          (16-bit result)
+//
+//  and the whole routine becomes
+//
+//      x = 8 * mafSum + XC1C3
+//      x = sq(x)
+//      x = 2 * x - XC1C5                           (zero if the subtract borrows)
+//      x = sq(2 * x)
+//
+//  with every step truncated to 16 bits. The clamp is the firmware's 'bcc' after 'subd', a
+//  borrow test, so it is an unsigned saturating subtract. H * L and H * H both fit in 16
+//  bits, so this maps directly onto 16-bit SIMD lanes: 16 values at a time with AVX2 or 8
+//  with SSE2.
+//
+//  The kernel is picked at run time from what the CPU supports. Non-x86 builds (and
+//  compilers without the GCC/Clang/MSVC intrinsics) use the scalar version.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MAF_LINEARIZE_BATCH_H
+#define MAF_LINEARIZE_BATCH_H
+
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MAF_BATCH_X86   1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define MAF_BATCH_X86   0
+#endif
+
+#if MAF_BATCH_X86 && (defined(__GNUC__) || defined(__clang__))
+#define MAF_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define MAF_TARGET_AVX2
+#endif
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+
+
+typedef void (*MafBatchKernel)(const UINT16 *mafSum, UINT16 *linearMAF, size_t count,
+                               const PromConstants &prom);
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Scalar version (also used for the left over values at the end of a batch)
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT16 squareMAF_6803 (UINT16 x)
+{
+    UINT16 hi = x >> 8;
+    UINT16 lo = x & 0xFF;
+
+    return (UINT16)(hi * hi + 2 * ((hi * lo) >> 8));
+}
+
+inline UINT16 linearizeMAF_Scalar (UINT16 mafSum, const PromConstants &prom)
+{
+    UINT16 x;
+
+    x = (UINT16)(8 * mafSum + prom.XC1C3);
+    x = squareMAF_6803(x);
+    x = (UINT16)(2 * x);
+    x = (x < prom.XC1C5) ? 0 : (UINT16)(x - prom.XC1C5);
+
+    return squareMAF_6803((UINT16)(2 * x));
+}
+
+inline void linearizeMAF_BatchScalar (const UINT16 *mafSum, UINT16 *linearMAF, size_t count,
+                                      const PromConstants &prom)
+{
+    for (size_t i = 0; i < count; i++)
+        linearMAF[i] = linearizeMAF_Scalar(mafSum[i], prom);
+}
+
+
+#if MAF_BATCH_X86
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  SSE2 version, 8 values per pass
+//
+///////////////////////////////////////////////////////////////////////////////
+inline __m128i squareMAF_SSE2 (__m128i x)
+{
+    __m128i hi = _mm_srli_epi16(x, 8);
+    __m128i lo = _mm_and_si128(x, _mm_set1_epi16(0x00FF));
+    __m128i c9 = _mm_srli_epi16(_mm_mullo_epi16(hi, lo), 8);        // staa X00C9
+
+    return _mm_add_epi16(_mm_mullo_epi16(hi, hi), _mm_add_epi16(c9, c9));
+}
+
+inline void linearizeMAF_BatchSSE2 (const UINT16 *mafSum, UINT16 *linearMAF, size_t count,
+                                    const PromConstants &prom)
+{
+    const __m128i c1c3 = _mm_set1_epi16((short)prom.XC1C3);
+    const __m128i c1c5 = _mm_set1_epi16((short)prom.XC1C5);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(mafSum + i));
+
+        x = _mm_add_epi16(_mm_slli_epi16(x, 3), c1c3);
+        x = squareMAF_SSE2(x);
+        x = _mm_subs_epu16(_mm_slli_epi16(x, 1), c1c5);             // borrow -> 0
+        x = squareMAF_SSE2(_mm_slli_epi16(x, 1));
+
+        _mm_storeu_si128((__m128i *)(linearMAF + i), x);
+    }
+
+    linearizeMAF_BatchScalar(mafSum + i, linearMAF + i, count - i, prom);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  AVX2 version, 16 values per pass
+//
+///////////////////////////////////////////////////////////////////////////////
+MAF_TARGET_AVX2 inline __m256i squareMAF_AVX2 (__m256i x)
+{
+    __m256i hi = _mm256_srli_epi16(x, 8);
+    __m256i lo = _mm256_and_si256(x, _mm256_set1_epi16(0x00FF));
+    __m256i c9 = _mm256_srli_epi16(_mm256_mullo_epi16(hi, lo), 8);  // staa X00C9
+
+    return _mm256_add_epi16(_mm256_mullo_epi16(hi, hi), _mm256_add_epi16(c9, c9));
+}
+
+MAF_TARGET_AVX2 inline void linearizeMAF_BatchAVX2 (const UINT16 *mafSum, UINT16 *linearMAF,
+                                                    size_t count, const PromConstants &prom)
+{
+    const __m256i c1c3 = _mm256_set1_epi16((short)prom.XC1C3);
+    const __m256i c1c5 = _mm256_set1_epi16((short)prom.XC1C5);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(mafSum + i));
+
+        x = _mm256_add_epi16(_mm256_slli_epi16(x, 3), c1c3);
+        x = squareMAF_AVX2(x);
+        x = _mm256_subs_epu16(_mm256_slli_epi16(x, 1), c1c5);       // borrow -> 0
+        x = squareMAF_AVX2(_mm256_slli_epi16(x, 1));
+
+        _mm256_storeu_si256((__m256i *)(linearMAF + i), x);
+    }
+
+    linearizeMAF_BatchScalar(mafSum + i, linearMAF + i, count - i, prom);
+}
+
+
+inline bool cpuHasAVX2 (void)
+{
+#ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif // MAF_BATCH_X86
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Kernel selection
+//
+///////////////////////////////////////////////////////////////////////////////
+inline MafBatchKernel selectMafBatchKernel (const char **kernelName = 0)
+{
+    const char *name = "scalar";
+    MafBatchKernel kernel = linearizeMAF_BatchScalar;
+
+#if MAF_BATCH_X86
+    if (cpuHasAVX2()) {
+        name = "AVX2";
+        kernel = linearizeMAF_BatchAVX2;
+    }
+    else {
+        name = "SSE2";
+        kernel = linearizeMAF_BatchSSE2;
+    }
+#endif
+
+    if (kernelName)
+        *kernelName = name;
+
+    return kernel;
+}
+
+// name of the kernel used by linearizeMAF_Batch()
+inline const char *mafBatchKernelName (void)
+{
+    const char *name;
+
+    selectMafBatchKernel(&name);
+
+    return name;
+}
+
+// Linearize count MAF sums into linearMAF[] using the best kernel for this CPU
+inline void linearizeMAF_Batch (const UINT16 *mafSum, UINT16 *linearMAF, size_t count,
+                                const PromConstants &prom)
+{
+    static const MafBatchKernel kernel = selectMafBatchKernel();
+
+    kernel(mafSum, linearMAF, count, prom);
+}
+
+#endif // MAF_LINEARIZE_BATCH_H
@@ -0,0 +1,370 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  MAF Linearization and Fuel Map Row Index Models
+//
+//  This is a model of two sections of 14CUX code from the spark interrupt. The first section
+//  is the MAF linearization. This is for the 3AM/5AM hotwire air flow meter. According to L-R,
+//  the MAF should output from 1.3 to 1.5 volts at idle. Maximum possible value is 5 volts.
+//  The second section calculates the load based row index into the fuel map. Although there
+//  are only 8 rows, the index value can range from 0x00 to 0x70 with 16 steps of resolution
+//  into each row. Interpolation is used later when determininag the map value.
+//
+//  In the attempt to do as literal a translation as possible, we use the goto command as well
+//  as byte/word unions.
+//
+//  These models were originally part of MafModel.cpp and are kept here so that the other
+//  programs (such as the batch tune comparison) can use them.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+;--------------------------------------------------------------------------------------------
+;                         MAF Sensor Linearization 
+;
+; This section executes unless the MAF failure bit is set. It linearizes the  MAF output and
+; stores the 16-bit result (normally in X204D/4E) for later use in determining the fuel map
+; row (load based) index.
+;
+; The MAF reads about 300 decimal at idle and the maximum possible value is 10 bits or 1023
+; decimal. This results in a linearized range of approximately 600 at idle to slightly over
+; 17,000 decimal.
+;
+; The loop part of this code is a 16-bit squaring function:
+;       Input:      16-bit value in AB
+;       Output:     (AB * AB) / 0x10000
+;
+; When entering this section of code, 0x00C8/C9 holds the sum of MAF Low and MAF High. The
+; squaring loop is run twice. The 'C' code equivalent of the whole code section is listed
+; here:
+;
+;       x = 8 * mafSum + 8797;
+;       x = (UINT16)((x * x) / 0x10000);
+;       x = (UINT16)(2 * (2 * x - 2496));
+;       x = (UINT16)((x * x) / 0x10000);
+;       Store result in 00CA/CB for use in 16-bit mpy (for FM row index calc)
+;       Store result in 004D/4E for use elsewhere
+;
+;--------------------------------------------------------------------------------------------
+.linearizeMaf   ldd         $00C8               ; reload MAF sum
+                asld                            ; 2x
+                asld                            ; 4x
+                asld                            ; 8x
+                addd        $C1C3               ; data value is $225D (8797 dec)
+
+.linMafLoop     staa        $00C8               ; squaring function starts here
+                mul
+                staa        $00C9
+                ldaa        $00C8
+                tab
+                mul
+                addb        $00C9
+                adca        #$00
+                addb        $00C9
+                adca        #$00                ; squaring function ends here
+                
+                com         $00CE               ; previously cleared at code address LDCEB
+                beq         .LDF30              ; 1's comp forced branch out here on 2nd pass
+                asld
+                subd        $C1C5               ; data value is $09C0 (2496 dec)
+                bcc         .LDF2D
+                ldd         #$0000              ; if negative, limit to zero
+
+.LDF2D          asld
+                bra         .linMafLoop         ; end loop
+
+.LDF30          std         $00CA               ; store it here for 16-bit mpy
+                std         mafLinear           ; also store it in normal location
+
+---------------------------------------------------------------------------------------------------
+
+
+
+
+;---------------------------------------------------------------------------------------------------
+;                *** Calculate Fuel Map Load Value (Row Index) ***
+;
+; This value, which is normally stored at X005B, is calculated from both air flow and engine speed.
+;
+; The Linearized MAF is calculated above and is stored in the normal X004D/4E locations and the
+; X00CA/CB temporary location.
+;
+; The row index value is clipped low at 0x00 and high at 0x70 so that it is confined to the range
+; of the 8 row fuel map table.
+;   
+;---------------------------------------------------------------------------------------------------
+                ldd         ignPeriod           ; load 16-bit ignition period (instantaneous)
+                jsr         mpy16               ; call 16-bit mpy routine, mpy ignPeriod by mafLinear
+                subd        $C1C7               ; data value is $001E (subtract this)
+                bcc         .LDF61              ; branch ahead if value is still positive
+                clra                            ; else, clear A
+                bra         .LDF6F              ; and branch
+
+.LDF61          lsrd                            ; logical shift right double
+                tsta                            ; test A for zero
+                bne         .LDF6D              ; branch ahead to load $70
+                ldaa        $200A               ; X200A gets initialized from fuel map byte offset $10A
+                mul
+                cmpa        #$70                ; compare A with $70
+                bcs         .LDF6F              ; if A <= $70, branch to store as fuel map row index
+
+.LDF6D          ldaa        #$70                ; else store $70
+
+.LDF6F          staa        fuelMapLoadIdx      ; store value as 'fuelMapLoadIdx'
+
+;---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef MAF_ROW_INDEX_H
+#define MAF_ROW_INDEX_H
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+#include "Registers6803.h"
+#include "PathCounters.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  LinearizeMAFin_C
+//
+//  This is my understanding of what the assembly language code is actually
+//  doing.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT16 linearizeMAF_C (UINT16 mafSum, const PromConstants &prom)
+{
+    UINT16  XC1C3 = prom.XC1C3;
+    UINT16  XC125 = prom.XC1C5;
+    UINT16 x;
+
+
+    x = 8 * mafSum + XC1C3;
+    x = (UINT16)((x * x) / 0x10000);
+
+    if (x > XC125/2) {
+        x = (UINT16)(2 * (2 * x - XC125));
+    }
+    else {
+        x = 0;
+    }
+
+    x = (UINT16)((x * x) / 0x10000);
+
+    return (x);
+
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  LinearizeMAF_6803
+//
+//  This a literal translation of the 6803 assembly code.
+//
+//  Note about possible compiler hazard...
+//  Although there are arithmetic shifts, they are left shifts, so there
+//  should be no problem with possible differences in compiler implementation
+//  (logical vs arithmetic).
+//
+//  The A/B registers and X00C8/C9 are the ones in the Cpu6803 passed in.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT16 linearizeMAF_6803 (Cpu6803 &cpu, UINT16 mafSum, const PromConstants &prom)
+{
+    ABunion  &reg = cpu.reg;
+    memUnion &mem = cpu.mem;
+    UINT16  XC1C3 = prom.XC1C3;
+    UCHAR   X00CE = 0;
+    UINT16  X204D;
+    UINT16  XC125 = prom.XC1C5;
+
+
+    mem.c8c9 = mafSum;
+
+//LDF03:
+    PATH_ENTRY(PATH_LINEARIZE_MAF);
+    reg.ab = mem.c8c9;                      // ldd   X00C8
+    reg.ab <<= 1;                           // asld
+    reg.ab <<= 1;                           // asld
+    reg.ab <<= 1;                           // asld
+    reg.ab += XC1C3;                        // addd  XC1C3
+
+LDF0E:
+    PATH_COUNT(PATH_LDF0E);
+    mem.m[C8] = reg.r[A];                   // staa  X00C8
+    reg.ab = reg.r[A] * reg.r[B];           // mul
+    mem.m[C9] = reg.r[A];                   // staa  X00C9
+    reg.r[A] = mem.m[C8];                   // ldaa  X00C8
+    reg.r[B] = reg.r[A];                    // tab
+    reg.ab = reg.r[A] * reg.r[B];           // mul
+    reg.ab += mem.m[C9];                    // addb  X00C9, adca  #$00
+    reg.ab += mem.m[C9];                    // addb  X00C9, adca  #$00
+    X00CE = ~X00CE;                         // com  (1's complement)
+    if (!X00CE) goto LDF30;                 // beq   LDF30
+    reg.ab <<= 1;                           // asld
+    if (reg.ab >= XC125) {
+        reg.ab -= XC125;                    // subd  XC1C5
+        goto LDF2D;                         // bcc   LDF2D (no borrow)
+    }
+    PATH_COUNT(PATH_LDF2D_CLAMP);
+    reg.ab = 0x0000;                        // ldd   #$0000
+LDF2D:
+    PATH_COUNT(PATH_LDF2D);
+    reg.ab <<= 1;                           // asld
+    goto LDF0E;                             // bra   LDF0E
+
+LDF30:
+    PATH_COUNT(PATH_LDF30);
+                                            // std   X00CA (the mpy16 operand, passed to
+                                            //             Calculate_Row_Index instead)
+    X204D = reg.ab;                         // std   X204D
+
+    return X204D;
+}
+
+// same, using a private set of registers
+inline UINT16 linearizeMAF_6803 (UINT16 mafSum, const PromConstants &prom)
+{
+    Cpu6803 cpu;
+
+    return linearizeMAF_6803 (cpu, mafSum, prom);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  mpy16_6803
+//
+//  A literal translation of the 16-bit multiply routine (mpy16.asm). It
+//  multiplies AB by the 16-bit value at X00CA/CB and leaves the top 16 bits
+//  of the product in AB. Only three of the four 8-bit partial products are
+//  formed (the low x low one is never computed), so the result can be one
+//  or two counts below the top half of the true 32-bit product.
+//
+//  X00C8/C9 is the one in the Cpu6803 passed in. X00CA/CB is passed in and
+//  X00CC/CD are locals.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT16 mpy16_6803 (Cpu6803 &cpu, UINT16 X00CA)
+{
+    ABunion  &reg = cpu.reg;
+    memUnion &mem = cpu.mem;
+    UCHAR   XCA = (UCHAR)(X00CA >> 8);
+    UCHAR   XCB = (UCHAR)X00CA;
+    UCHAR   XCC;
+    UCHAR   XCD;
+
+    mem.c8c9 = reg.ab;                      // std   $00,x
+    reg.r[B] = XCB;                         // ldab  $03,x
+    reg.ab = reg.r[A] * reg.r[B];           // mul
+    XCC = reg.r[A];                         // std   $04,x
+    XCD = reg.r[B];
+    reg.r[A] = mem.m[C9];                   // ldd   $01,x
+    reg.r[B] = XCA;
+    reg.ab = reg.r[A] * reg.r[B];           // mul
+    reg.ab += XCD;                          // addb  $05,x, adca  #$00
+    XCD = reg.r[A];                         // staa  $05,x
+    reg.r[A] = mem.m[C8];                   // ldaa  $00,x
+    reg.r[B] = XCA;                         // ldab  $02,x
+    reg.ab = reg.r[A] * reg.r[B];           // mul
+    reg.ab += XCC;                          // addb  $04,x, adca  #$00
+    reg.ab += XCD;                          // addb  $05,x, adca  #$00
+
+    return reg.ab;                          // rts
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  mpy16_C
+//
+//  The same multiply in C. This is NOT ((a * b) >> 16), since the firmware
+//  drops the low x low partial product and the carries out of it.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT16 mpy16_C (UINT16 a, UINT16 b)
+{
+    UINT16 hiLo = (UINT16)((a >> 8) * (b & 0xFF));
+    UINT16 loHi = (UINT16)((a & 0xFF) * (b >> 8) + (hiLo & 0xFF));
+
+    return (UINT16)((a >> 8) * (b >> 8) + (hiLo >> 8) + (loHi >> 8));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Calculate_Row_Index
+//
+//  There are two values in this formula that come from the data section of the
+//  PROM. They are:
+//  
+//  X200A - This is a multiplier factor that is pulled from the current fuel
+//          map at offset $10A. This is the first value after the map's ADC
+//          control table. It is stored in RAM location X200A for use. This
+//          is a byte value and is often (but not always) $B2.
+//
+//  XC1C7 - This is a 16-bit value in the data section. It is outside of the
+//          fuel map data and does not change with fuel map changes. This
+//          value is typically $001E.
+//
+//  Both are passed in with the other PROM constants (see TuneImage.h).
+//
+//  This routine takes the ignition period and the linearized MAF readings as
+//  arguments and returns the 8-bit row index value (clipped between $00 min
+//  and $70 max). In C it is:
+//
+//      x = mpy16(ignitionPeriod, linearMAF);
+//      if (x < XC1C7) return 0;
+//      x = (x - XC1C7) >> 1;
+//      if (x > 0xFF) return 0x70;
+//      x = (X200A * x) >> 8;
+//      return (x < 0x70) ? x : 0x70;
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT8 Calculate_Row_Index (Cpu6803 &cpu, UINT16 ignitionPeriod, UINT16 linearMAF,
+                                  const PromConstants &prom)
+{
+    ABunion &reg = cpu.reg;
+    UINT8  X200A = prom.X200A;
+    UINT16 XC1C7 = prom.XC1C7;
+
+    PATH_ENTRY(PATH_ROW_INDEX);
+    reg.ab = ignitionPeriod;                        // ldd         ignPeriod
+    mpy16_6803(cpu, linearMAF);                     // jsr         mpy16
+    if (reg.ab >= XC1C7) {
+        reg.ab -= XC1C7;                            // subd        $C1C7
+        goto LDF61;                                 // bcc         .LDF61
+    }
+
+    PATH_COUNT(PATH_LDF61_UNDERFLOW);
+    reg.r[A] = 0;                                   // clra
+    goto LDF6F;                                     // bra         .LDF6F
+
+LDF61:
+    PATH_COUNT(PATH_LDF61);
+    reg.ab >>= 1;                                   // .LDF61       lsrd
+    if (reg.r[A] != 0)                              // tsta                       
+        goto LDF6D;                                 // bne         .LDF6D   
+
+    reg.r[A] = X200A;                               // ldaa        $200A          
+    reg.ab = reg.r[A] * reg.r[B];                   // mul
+    if (reg.r[A] < 0x70)                            // cmpa        #$70           
+        goto LDF6F;                                 // bcs         .LDF6F         
+
+LDF6D:  PATH_COUNT(PATH_LDF6D);
+        reg.r[A] = 0x70;                            // .LDF6D          ldaa        #$70           
+
+LDF6F:  PATH_COUNT(PATH_LDF6F);
+        return (reg.r[A]);                          // .LDF6F          staa        fuelMapLoadIdx 
+
+}
+
+// same, using a private set of registers
+inline UINT8 Calculate_Row_Index (UINT16 ignitionPeriod, UINT16 linearMAF, const PromConstants &prom)
+{
+    Cpu6803 cpu;
+
+    return Calculate_Row_Index (cpu, ignitionPeriod, linearMAF, prom);
+}
+
+#endif // MAF_ROW_INDEX_H
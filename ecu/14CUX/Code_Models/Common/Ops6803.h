@@ -0,0 +1,184 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  6803 Instruction Model (constexpr)
+//
+//  The literal translations use the ABunion in Registers6803.h, with the byte order swapped
+//  for the PC and the branches written as C comparisons of the result. That can't be
+//  evaluated by the compiler. Acc6803 is the same A/B/D and X register set with the
+//  condition codes, and one constexpr member function per instruction, so a routine can be
+//  written out instruction by instruction and still be run at compile time (see
+//  BakedTables.h). The branches test the flags the way the 6803 does, so 'bcc' after
+//  'subd' is a real borrow test rather than a comparison that happens to match.
+//
+//  The flags follow the Motorola 6801/6803 reference manual:
+//
+//      loads, tab, tsta, bita, oraa    N, Z from the result, V = 0 (C unchanged)
+//      clra, clrb                      N = 0, Z = 1, V = 0, C = 0
+//      addb, adca, addd                N, Z, V (two's complement overflow), C (carry out)
+//      subd, cmpa                      N, Z, V, C (borrow)
+//      asla, asld                      C = bit shifted out, N, Z, V = N ^ C
+//      lsra, lsrd                      C = bit shifted out, N = 0, Z, V = C
+//      mul                             D = A x B, C = bit 7 of B (for rounding), others unchanged
+//      com (memory)                    N, Z, V = 0, C = 1
+//      dec (memory)                    N, Z, V = (old value was $80), C unchanged
+//      abx                             X = X + B, no flags
+//
+//  The half carry is not kept (nothing here uses daa). Memory operands are passed by value
+//  for reads, and by reference for the read-modify-write instructions.
+//
+//  This needs C++14 (constexpr functions that change state).
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OPS_6803_H
+#define OPS_6803_H
+
+#if !((defined(_MSVC_LANG) && _MSVC_LANG >= 201402L) || __cplusplus >= 201402L)
+#error "Ops6803.h needs C++14 or later"
+#endif
+
+#include "CuxTypes.h"
+
+
+struct Acc6803
+{
+    UINT8   a;
+    UINT8   b;
+    UINT16  x;
+    bool    c;                              // carry / borrow
+    bool    v;                              // overflow
+    bool    z;                              // zero
+    bool    n;                              // negative
+
+    constexpr Acc6803 () : a(0), b(0), x(0), c(false), v(false), z(false), n(false)
+    {
+    }
+
+    constexpr UINT16 d (void) const         { return (UINT16)((a << 8) | b); }
+
+    // Loads and transfers
+    constexpr void ldaa (UINT8 m)           { a = m; nz8(a); v = false; }
+    constexpr void ldab (UINT8 m)           { b = m; nz8(b); v = false; }
+    constexpr void ldd (UINT16 m)           { setD(m); nz16(m); v = false; }
+    constexpr void ldx (UINT16 m)           { x = m; n = (m & 0x8000) != 0; z = m == 0; v = false; }
+    constexpr void tab (void)               { b = a; nz8(b); v = false; }
+    constexpr void clra (void)              { a = 0; n = false; z = true; v = false; c = false; }
+    constexpr void clrb (void)              { b = 0; n = false; z = true; v = false; c = false; }
+    constexpr void abx (void)               { x = (UINT16)(x + b); }
+
+    // Tests and logic
+    constexpr void tsta (void)              { nz8(a); v = false; c = false; }
+    constexpr void bita (UINT8 m)           { nz8((UINT8)(a & m)); v = false; }
+    constexpr void oraa (UINT8 m)           { a = (UINT8)(a | m); nz8(a); v = false; }
+
+    constexpr void cmpa (UINT8 m)
+    {
+        UINT8 r = (UINT8)(a - m);
+        c = m > a;
+        v = (((a ^ m) & (a ^ r)) & 0x80) != 0;
+        nz8(r);
+    }
+
+    // Arithmetic
+    constexpr void addb (UINT8 m)
+    {
+        UINT16 r = (UINT16)(b + m);
+        v = ((~(b ^ m) & (b ^ r)) & 0x80) != 0;
+        c = r > 0xFF;
+        b = (UINT8)r;
+        nz8(b);
+    }
+
+    constexpr void adca (UINT8 m)
+    {
+        UINT16 r = (UINT16)(a + m + (c ? 1 : 0));
+        v = ((~(a ^ m) & (a ^ r)) & 0x80) != 0;
+        c = r > 0xFF;
+        a = (UINT8)r;
+        nz8(a);
+    }
+
+    constexpr void addd (UINT16 m)
+    {
+        UINT16 dv = d();
+        UINT32 r = (UINT32)dv + m;
+        v = ((~(dv ^ m) & (dv ^ r)) & 0x8000) != 0;
+        c = r > 0xFFFF;
+        setD((UINT16)r);
+        nz16((UINT16)r);
+    }
+
+    constexpr void subd (UINT16 m)
+    {
+        UINT16 dv = d();
+        UINT16 r = (UINT16)(dv - m);
+        v = (((dv ^ m) & (dv ^ r)) & 0x8000) != 0;
+        c = m > dv;
+        setD(r);
+        nz16(r);
+    }
+
+    constexpr void mul (void)
+    {
+        setD((UINT16)(a * b));
+        c = (b & 0x80) != 0;
+    }
+
+    // Shifts
+    constexpr void asla (void)              { c = (a & 0x80) != 0; a = (UINT8)(a << 1); nz8(a); v = n != c; }
+    constexpr void lsra (void)              { c = (a & 0x01) != 0; a = (UINT8)(a >> 1); nz8(a); v = c; }
+
+    constexpr void asld (void)
+    {
+        UINT16 dv = d();
+        c = (dv & 0x8000) != 0;
+        setD((UINT16)(dv << 1));
+        nz16(d());
+        v = n != c;
+    }
+
+    constexpr void lsrd (void)
+    {
+        UINT16 dv = d();
+        c = (dv & 0x0001) != 0;
+        setD((UINT16)(dv >> 1));
+        nz16(d());
+        v = c;
+    }
+
+    // Read-modify-write on a memory byte
+    constexpr void com (UINT8 &m)           { m = (UINT8)~m; nz8(m); v = false; c = true; }
+    constexpr void dec (UINT8 &m)           { v = m == 0x80; m = (UINT8)(m - 1); nz8(m); }
+
+    // Branch conditions
+    constexpr bool bcc (void) const         { return !c; }
+    constexpr bool bcs (void) const         { return c; }
+    constexpr bool beq (void) const         { return z; }
+    constexpr bool bne (void) const         { return !z; }
+    constexpr bool bpl (void) const         { return !n; }
+    constexpr bool bmi (void) const         { return n; }
+    constexpr bool bhi (void) const         { return !c && !z; }
+    constexpr bool bls (void) const         { return c || z; }
+
+private:
+    constexpr void setD (UINT16 m)          { a = (UINT8)(m >> 8); b = (UINT8)m; }
+    constexpr void nz8 (UINT8 r)            { n = (r & 0x80) != 0; z = r == 0; }
+    constexpr void nz16 (UINT16 r)          { n = (r & 0x8000) != 0; z = r == 0; }
+};
+
+
+// Checks of the flag rules, evaluated by the compiler
+namespace Ops6803Check
+{
+    constexpr Acc6803 subdBorrow (void)     { Acc6803 r; r.ldd(0x0100); r.subd(0x0101); return r; }
+    constexpr Acc6803 adcaCarry (void)      { Acc6803 r; r.ldab(0xFF); r.addb(0x02); r.ldaa(0x10); r.adca(0); return r; }
+    constexpr Acc6803 asldOut (void)        { Acc6803 r; r.ldd(0x8001); r.asld(); return r; }
+    constexpr Acc6803 decWrap (void)        { Acc6803 r; UINT8 m = 0; r.dec(m); r.ldaa(m); return r; }
+
+    static_assert(subdBorrow().c && subdBorrow().d() == 0xFFFF && subdBorrow().n, "subd borrow");
+    static_assert(adcaCarry().a == 0x11 && adcaCarry().b == 0x01, "adca takes the carry from addb");
+    static_assert(asldOut().c && asldOut().d() == 0x0002 && asldOut().v, "asld carry and overflow");
+    static_assert(decWrap().a == 0xFF && decWrap().n, "dec wraps to $FF with N set");
+}
+
+#endif // OPS_6803_H
@@ -0,0 +1,279 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Code Models - Branch Path Counters
+//
+//  Counts how often the literal translations reach each of their labels, so that a tune
+//  and a set of inputs (a datalog, a sweep) can be looked at as a histogram of the paths
+//  the firmware would have taken: how often the row index saturates at $70, how often the
+//  RPM is below the table, which column 3 control byte is used and so on.
+//
+//  The counters are compiled in only when CUX_PATH_COUNTERS is defined as non-zero
+//  (-DCUX_PATH_COUNTERS=1). Otherwise PATH_ENTRY() and PATH_COUNT() expand to nothing and
+//  the models are unchanged. Enabled, they cost about 0.5 to 1 ns per call to each model.
+//
+//  Each thread counts into its own block (no locks or atomics on the counting path). The
+//  blocks are registered when a thread first counts, and a thread's counts are kept when
+//  it exits, so pathCountersTotal() gives the sum over every thread. Read the totals after
+//  the worker threads have been joined; pathCounters() gives the calling thread's own
+//  block, which is what a worker that runs one tune uses for a per-tune histogram.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PATH_COUNTERS_H
+#define PATH_COUNTERS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <mutex>
+#include <vector>
+
+#include "CuxTypes.h"
+
+#ifndef CUX_PATH_COUNTERS
+#define CUX_PATH_COUNTERS   0
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Labels. Each routine starts with its entry label, which is the count the
+//  others are shown as a percentage of. Paths that fall through rather than
+//  branch to a label are named after their first instruction.
+//
+///////////////////////////////////////////////////////////////////////////////
+enum PathLabel
+{
+    // linearizeMAF_6803 (MafRowIndex.h)
+    PATH_LINEARIZE_MAF,             // .linearizeMaf
+    PATH_LDF0E,                     // squaring pass
+    PATH_LDF2D_CLAMP,               // ldd #$0000
+    PATH_LDF2D,
+    PATH_LDF30,
+
+    // Calculate_Row_Index (MafRowIndex.h)
+    PATH_ROW_INDEX,                 // ldd ignPeriod
+    PATH_LDF61_UNDERFLOW,           // clra
+    PATH_LDF61,
+    PATH_LDF6D,
+    PATH_LDF6F,
+
+    // getColumnIndex (RpmColumnIndex.h)
+    PATH_LEADB,
+    PATH_LEAE2,                     // table row compared
+    PATH_LEB1F_BELOW_TABLE,         // clr X005C
+    PATH_LEAF5,
+    PATH_LEAF5_CONTROL_80,          // ldd X00C8 / lsrd
+    PATH_LEB0B,
+    PATH_LEB13,
+    PATH_LEB15,
+
+    // fuelMapValue_6803 (FuelMapValue.h)
+    PATH_LE8C0,
+    PATH_LE8C0_CELL_60,             // ldab #$60
+    PATH_LE8D0,
+    PATH_LE8D0_CORNER,              // ldaa $00,x / bra .LE921
+    PATH_LE8F7,
+
+    PATH_LABEL_COUNT
+};
+
+struct PathLabelInfo
+{
+    const char  *routine;
+    const char  *label;
+    const char  *meaning;
+    bool        entry;
+};
+
+static const PathLabelInfo pathLabelInfo[PATH_LABEL_COUNT] = {
+    { "linearizeMAF",   ".linearizeMaf",    "calls",                                true  },
+    { "linearizeMAF",   ".LDF0E",           "squaring passes",                      false },
+    { "linearizeMAF",   "ldd #$0000",       "2 x square - XC1C5 clamped to zero",   false },
+    { "linearizeMAF",   ".LDF2D",           "second square input",                  false },
+    { "linearizeMAF",   ".LDF30",           "done",                                 false },
+
+    { "row index",      "ldd ignPeriod",    "calls",                                true  },
+    { "row index",      "clra",             "load below XC1C7, row 0",              false },
+    { "row index",      ".LDF61",           "above XC1C7",                          false },
+    { "row index",      ".LDF6D",           "saturated at $70",                     false },
+    { "row index",      ".LDF6F",           "stored",                               false },
+
+    { "column index",   ".LEADB",           "calls",                                true  },
+    { "column index",   ".LEAE2",           "table rows compared",                  false },
+    { "column index",   "clr X005C",        "period past the table (RPM < 200)",    false },
+    { "column index",   ".LEAF5",           "bracket found",                        false },
+    { "column index",   "ldd X00C8",        "control $80, delta >> 4",              false },
+    { "column index",   ".LEB0B",           "control $40 or $00",                   false },
+    { "column index",   ".LEB13",           "control $00, delta low byte",          false },
+    { "column index",   ".LEB15",           "multiplied",                           false },
+
+    { "fuel map value", ".LE8C0",           "calls",                                true  },
+    { "fuel map value", "ldab #$60",        "cell 0 replaced by $60",               false },
+    { "fuel map value", ".LE8D0",           "interpolation",                        false },
+    { "fuel map value", "ldaa $00,x",       "corner value, no interpolation",       false },
+    { "fuel map value", ".LE8F7",           "interpolated",                         false },
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Counter blocks
+//
+///////////////////////////////////////////////////////////////////////////////
+struct PathCounts
+{
+    UINT64  count[PATH_LABEL_COUNT];
+
+    PathCounts ()                       { clear(); }
+
+    void clear (void)                   { memset(count, 0, sizeof(count)); }
+
+    void add (const PathCounts &other)
+    {
+        for (int i = 0; i < PATH_LABEL_COUNT; i++)
+            count[i] += other.count[i];
+    }
+
+    UINT64 total (void) const
+    {
+        UINT64 sum = 0;
+
+        for (int i = 0; i < PATH_LABEL_COUNT; i++)
+            sum += count[i];
+
+        return sum;
+    }
+};
+
+// The live blocks of running threads and the counts of threads that have exited
+struct PathCounterRegistry
+{
+    std::mutex                  lock;
+    std::vector<PathCounts *>   live;
+    PathCounts                  retired;
+};
+
+inline PathCounterRegistry &pathCounterRegistry (void)
+{
+    static PathCounterRegistry registry;
+    return registry;
+}
+
+struct ThreadPathCounts : PathCounts
+{
+    ThreadPathCounts ()
+    {
+        PathCounterRegistry &r = pathCounterRegistry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        r.live.push_back(this);
+    }
+
+    ~ThreadPathCounts ()
+    {
+        PathCounterRegistry &r = pathCounterRegistry();
+        std::lock_guard<std::mutex> guard(r.lock);
+
+        r.retired.add(*this);
+
+        for (size_t i = 0; i < r.live.size(); i++)
+            if (r.live[i] == this) {
+                r.live.erase(r.live.begin() + i);
+                break;
+            }
+    }
+};
+
+// The calling thread's block
+inline PathCounts &pathCounters (void)
+{
+    static thread_local ThreadPathCounts counts;
+    return counts;
+}
+
+// Sum over all threads, running or finished
+inline PathCounts pathCountersTotal (void)
+{
+    PathCounterRegistry &r = pathCounterRegistry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    PathCounts sum = r.retired;
+
+    for (size_t i = 0; i < r.live.size(); i++)
+        sum.add(*r.live[i]);
+
+    return sum;
+}
+
+// Clear every thread's counts (call while no other thread is counting)
+inline void pathCountersReset (void)
+{
+    PathCounterRegistry &r = pathCounterRegistry();
+    std::lock_guard<std::mutex> guard(r.lock);
+
+    r.retired.clear();
+
+    for (size_t i = 0; i < r.live.size(); i++)
+        r.live[i]->clear();
+}
+
+// PATH_ENTRY() goes at the top of a routine (before any label) and looks up the
+// thread's block once; PATH_COUNT() then counts into it.
+#if CUX_PATH_COUNTERS
+#define PATH_ENTRY(label)   PathCounts &pathCount = pathCounters(); pathCount.count[label]++
+#define PATH_COUNT(label)   (pathCount.count[label]++)
+#else
+#define PATH_ENTRY(label)   ((void)0)
+#define PATH_COUNT(label)   ((void)0)
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  printPathHistogram
+//
+//  One line per label that was reached, grouped by routine, with the count,
+//  the count as a percentage of the routine's calls and a bar scaled to
+//  the calls. Routines that were never called are left out.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline void printPathHistogram (FILE *fptr, const PathCounts &counts, const char *title)
+{
+    const int barWidth = 40;
+    UINT64 calls = 0;
+
+    fprintf(fptr, "\nBranch paths: %s\n", title);
+
+    if (counts.total() == 0) {
+        fprintf(fptr, "  (none counted%s)\n", CUX_PATH_COUNTERS ? "" : ", built without CUX_PATH_COUNTERS");
+        return;
+    }
+
+    for (int i = 0; i < PATH_LABEL_COUNT; i++) {
+
+        const PathLabelInfo &info = pathLabelInfo[i];
+
+        if (info.entry) {
+            calls = counts.count[i];
+            if (calls)
+                fprintf(fptr, "\n  %-16s %-15s %14llu  %s\n", info.routine, info.label,
+                  (unsigned long long)calls, info.meaning);
+            continue;
+        }
+
+        if (calls == 0 || counts.count[i] == 0)
+            continue;
+
+        double percent = 100.0 * counts.count[i] / calls;
+        int bar = (int)(barWidth * percent / 100.0 + 0.5);
+        char bars[barWidth + 2];
+
+        if (bar > barWidth)
+            bar = barWidth + 1;                 // loops pass a label more than once per call
+        memset(bars, '#', bar);
+        bars[bar] = 0;
+
+        fprintf(fptr, "  %-16s %-15s %14llu %7.2f%%  %-41s %s\n", "", info.label,
+          (unsigned long long)counts.count[i], percent, bars, info.meaning);
+    }
+}
+
+#endif // PATH_COUNTERS_H
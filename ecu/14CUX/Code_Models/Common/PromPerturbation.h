@@ -0,0 +1,365 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Code Models - PROM Constant Perturbation
+//
+//  The row index surface (fuelMapLoadIdx for every MAF sum and ignition period) depends
+//  only on the four PromConstants: XC1C3 and XC1C5 in the MAF linearization, XC1C7 and the
+//  fuel map row multiplier (X200A) in the row index. This compares the surface for a base
+//  set of constants with the surface for each of a batch of changed sets, and reports
+//  which (mafSum, ignPeriod) cells move and by how much, without evaluating all
+//  2047 x 65536 cells of every surface:
+//
+//      - the linearized MAF is worked out once per MAF sum for each set; a MAF sum whose
+//        linearized value, XC1C7 and X200A are all unchanged can't move at all
+//      - along the period the row index is monotone (see Breakpoints.h), so each MAF sum
+//        of each surface is a list of runs of equal row index, found with the breakpoint
+//        search (about 113 edges x 16 evaluations instead of 65536)
+//      - the runs of the base and the changed surface are merged, giving the shifted
+//        cells a run at a time
+//
+//  The base runs are kept by the RowSurfaceDiffer, so any number of sets can be compared
+//  against it from any number of threads; diffRowSurfaces() spreads a batch over a pool
+//  of worker threads. scanRowSurfaceDiff() does the same comparison the slow way, through
+//  the SIMD row index kernel (FuelSurface.h) at every cell, as a check.
+//
+//  Deltas are the changed row index minus the base ($00 to $70 either way, 16 steps to a
+//  fuel map row). The period window (usually the RPM range the engine sees) is counted
+//  separately from the whole 16-bit period range.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PROM_PERTURBATION_H
+#define PROM_PERTURBATION_H
+
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+#include "MafLinearizeBatch.h"
+#include "FuelSurface.h"
+#include "Breakpoints.h"
+
+
+#define SURFACE_MAF_SUMS        2047        // 0 to 2046
+#define SURFACE_PERIODS         65536       // 0x0000 to 0xFFFF
+#define SURFACE_DELTAS          (2 * ROW_INDEX_MAX + 1)
+
+
+// Shifted cells of one MAF sum, from firstPeriod to lastPeriod, all by the same delta
+struct SurfaceShift
+{
+    UINT16  mafSum;
+    UINT16  firstPeriod;
+    UINT16  lastPeriod;
+    UINT8   before;
+    UINT8   after;
+};
+
+// All the shifted cells of one MAF sum
+struct SurfaceRowShift
+{
+    UINT32  cells;
+    UINT32  windowCells;
+    int     minDelta;
+    int     maxDelta;
+    UINT16  firstPeriod;                    // lowest and highest periods that moved
+    UINT16  lastPeriod;
+};
+
+struct SurfaceDiff
+{
+    PromConstants   prom;
+    UINT64          cells;                  // cells whose row index changed
+    UINT64          windowCells;            // ... with the period in the window
+    UINT32          rows;                   // MAF sums with a change
+    int             minDelta;
+    int             maxDelta;
+    UINT64          deltaCells[SURFACE_DELTAS];     // by delta + ROW_INDEX_MAX
+    std::vector<UINT16>             linearMAF;      // of the changed set, by MAF sum
+    std::vector<SurfaceRowShift>    byMafSum;
+    std::vector<SurfaceShift>       shifts;         // only if asked for
+};
+
+inline void clearSurfaceDiff (SurfaceDiff &d, const PromConstants &prom)
+{
+    SurfaceRowShift none;
+
+    memset(&none, 0, sizeof(none));
+
+    d.prom = prom;
+    d.cells = d.windowCells = 0;
+    d.rows = 0;
+    d.minDelta = d.maxDelta = 0;
+    memset(d.deltaCells, 0, sizeof(d.deltaCells));
+    d.linearMAF.assign(SURFACE_MAF_SUMS, 0);
+    d.byMafSum.assign(SURFACE_MAF_SUMS, none);
+    d.shifts.clear();
+}
+
+// Mean size of the shifts, in row index steps
+inline double meanSurfaceDelta (const SurfaceDiff &d)
+{
+    double sum = 0.0;
+
+    for (int i = 0; i < SURFACE_DELTAS; i++)
+        sum += (double)d.deltaCells[i] * ((i < ROW_INDEX_MAX) ? ROW_INDEX_MAX - i : i - ROW_INDEX_MAX);
+
+    return d.cells ? sum / d.cells : 0.0;
+}
+
+inline bool sameSurfaceDiff (const SurfaceDiff &a, const SurfaceDiff &b)
+{
+    if (a.cells != b.cells || a.windowCells != b.windowCells || a.rows != b.rows ||
+        a.minDelta != b.minDelta || a.maxDelta != b.maxDelta ||
+        memcmp(a.deltaCells, b.deltaCells, sizeof(a.deltaCells)) != 0)
+        return false;
+
+    for (size_t m = 0; m < a.byMafSum.size() && m < b.byMafSum.size(); m++)
+        if (memcmp(&a.byMafSum[m], &b.byMafSum[m], sizeof(SurfaceRowShift)) != 0)
+            return false;
+
+    return a.byMafSum.size() == b.byMafSum.size();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Row index runs along the period, for one linearized MAF
+//
+///////////////////////////////////////////////////////////////////////////////
+struct RowIndexRun
+{
+    UINT32  first;                          // first period of the run
+    UINT8   rowIndex;
+};
+
+typedef std::vector<RowIndexRun> RowIndexRuns;
+
+inline void rowIndexRuns (UINT16 linearMAF, const PromConstants &prom, RowIndexRuns &runs)
+{
+    auto value = [linearMAF, &prom](UINT32 p) { return (UINT32)rowIndex_Scalar((UINT16)p, linearMAF, prom); };
+    std::vector<Breakpoint> edges = findBreakpoints(value, value, std::vector<UINT32>(), 0, INPUT_LAST_16BIT);
+    RowIndexRun run;
+
+    runs.clear();
+    run.first = 0;
+    run.rowIndex = (UINT8)value(0);
+    runs.push_back(run);
+
+    for (size_t e = 0; e < edges.size(); e++) {
+        run.first = edges[e].input;
+        run.rowIndex = (UINT8)edges[e].after;
+        runs.push_back(run);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  RowSurfaceDiffer
+//
+///////////////////////////////////////////////////////////////////////////////
+class RowSurfaceDiffer
+{
+public:
+    // Periods from firstPeriod to lastPeriod are the window
+    RowSurfaceDiffer (const PromConstants &base, UINT16 firstPeriod = 0, UINT16 lastPeriod = 0xFFFF) :
+        prom(base), windowFirst(firstPeriod), windowLast(lastPeriod), baseRuns(SURFACE_MAF_SUMS)
+    {
+        UINT16 mafSum[SURFACE_MAF_SUMS];
+
+        for (int m = 0; m < SURFACE_MAF_SUMS; m++)
+            mafSum[m] = (UINT16)m;
+
+        linearizeMAF_Batch(mafSum, linear, SURFACE_MAF_SUMS, prom);
+
+        for (int m = 0; m < SURFACE_MAF_SUMS; m++)
+            if (m > 0 && linear[m] == linear[m - 1])
+                baseRuns[m] = baseRuns[m - 1];
+            else
+                rowIndexRuns(linear[m], prom, baseRuns[m]);
+    }
+
+    const PromConstants &base (void) const      { return prom; }
+    const UINT16 *baseLinearMAF (void) const    { return linear; }
+    UINT16 firstPeriod (void) const             { return windowFirst; }
+    UINT16 lastPeriod (void) const              { return windowLast; }
+
+    // Compare the surface for set with the base. Safe to call from several threads.
+    void diff (const PromConstants &set, SurfaceDiff &d, bool keepShifts = false) const
+    {
+        UINT16 mafSum[SURFACE_MAF_SUMS];
+        RowIndexRuns runs;
+        bool sameRow = set.XC1C7 == prom.XC1C7 && set.X200A == prom.X200A;
+        bool haveRuns = false;
+        UINT16 runsFor = 0;                             // linearized MAF that runs holds
+
+        clearSurfaceDiff(d, set);
+
+        for (int m = 0; m < SURFACE_MAF_SUMS; m++)
+            mafSum[m] = (UINT16)m;
+
+        linearizeMAF_Batch(mafSum, d.linearMAF.data(), SURFACE_MAF_SUMS, set);
+
+        for (int m = 0; m < SURFACE_MAF_SUMS; m++) {
+
+            if (sameRow && d.linearMAF[m] == linear[m])
+                continue;                               // the same inputs to the row index
+
+            if (!haveRuns || d.linearMAF[m] != runsFor) {
+                rowIndexRuns(d.linearMAF[m], set, runs);
+                runsFor = d.linearMAF[m];
+                haveRuns = true;
+            }
+
+            mergeRuns((UINT16)m, baseRuns[m], runs, d, keepShifts);
+        }
+    }
+
+    // Count cells first to last of mafSum as moved from before to after (also used by
+    // scanRowSurfaceDiff, a period at a time)
+    void addShift (UINT16 mafSum, UINT32 first, UINT32 last, UINT8 before, UINT8 after,
+                   SurfaceDiff &d, bool keepShifts) const
+    {
+        SurfaceRowShift &row = d.byMafSum[mafSum];
+        int delta = (int)after - (int)before;
+        UINT32 cells = last - first + 1;
+        UINT32 lo = (first > windowFirst) ? first : windowFirst;
+        UINT32 hi = (last < windowLast) ? last : windowLast;
+        UINT32 inWindow = (lo <= hi) ? hi - lo + 1 : 0;
+
+        if (row.cells == 0) {
+            d.rows++;
+            row.minDelta = row.maxDelta = delta;
+            row.firstPeriod = (UINT16)first;
+        }
+        if (delta < row.minDelta)
+            row.minDelta = delta;
+        if (delta > row.maxDelta)
+            row.maxDelta = delta;
+        row.lastPeriod = (UINT16)last;
+        row.cells += cells;
+        row.windowCells += inWindow;
+
+        if (d.cells == 0)
+            d.minDelta = d.maxDelta = delta;
+        if (delta < d.minDelta)
+            d.minDelta = delta;
+        if (delta > d.maxDelta)
+            d.maxDelta = delta;
+        d.cells += cells;
+        d.windowCells += inWindow;
+        d.deltaCells[delta + ROW_INDEX_MAX] += cells;
+
+        if (keepShifts) {
+            SurfaceShift s = { mafSum, (UINT16)first, (UINT16)last, before, after };
+            d.shifts.push_back(s);
+        }
+    }
+
+private:
+    // Walk both run lists together; every stretch where they differ is a shift
+    void mergeRuns (UINT16 mafSum, const RowIndexRuns &a, const RowIndexRuns &b, SurfaceDiff &d,
+                    bool keepShifts) const
+    {
+        size_t i = 0, j = 0;
+        UINT32 start = 0;
+
+        while (start < SURFACE_PERIODS) {
+
+            UINT32 nextA = (i + 1 < a.size()) ? a[i + 1].first : SURFACE_PERIODS;
+            UINT32 nextB = (j + 1 < b.size()) ? b[j + 1].first : SURFACE_PERIODS;
+            UINT32 end = (nextA < nextB) ? nextA : nextB;          // one past the stretch
+
+            if (a[i].rowIndex != b[j].rowIndex)
+                addShift(mafSum, start, end - 1, a[i].rowIndex, b[j].rowIndex, d, keepShifts);
+
+            start = end;
+            if (end == nextA)
+                i++;
+            if (end == nextB)
+                j++;
+        }
+    }
+
+    PromConstants               prom;
+    UINT16                      windowFirst;
+    UINT16                      windowLast;
+    UINT16                      linear[SURFACE_MAF_SUMS];
+    std::vector<RowIndexRuns>   baseRuns;       // by MAF sum
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  diffRowSurfaces
+//
+//  Compares every set against the differ's base on a pool of worker threads
+//  (one per core by default), one set at a time from a shared counter.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline void diffRowSurfaces (const RowSurfaceDiffer &differ, const std::vector<PromConstants> &sets,
+                             std::vector<SurfaceDiff> &diffs, bool keepShifts = false,
+                             unsigned threadCount = 0)
+{
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+        threadCount = 1;
+
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextSet(0);
+
+    diffs.resize(sets.size());
+
+    auto worker = [&]() {
+        for (size_t s; (s = nextSet++) < sets.size(); )
+            differ.diff(sets[s], diffs[s], keepShifts);
+    };
+
+    for (unsigned t = 0; t < threadCount; t++)
+        workers.push_back(std::thread(worker));
+
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  scanRowSurfaceDiff
+//
+//  Reference version: both surfaces at every cell, through the SIMD row
+//  index kernel. Fills in d the same way as RowSurfaceDiffer::diff() (but
+//  not the shift list).
+//
+///////////////////////////////////////////////////////////////////////////////
+inline void scanRowSurfaceDiff (const RowSurfaceDiffer &differ, const PromConstants &set, SurfaceDiff &d)
+{
+    static const RowIndexKernel kernel = selectRowIndexKernel();
+    const PromConstants &base = differ.base();
+    std::vector<UINT16> baseRows(SURFACE_MAF_SUMS), setRows(SURFACE_MAF_SUMS);
+    UINT16 mafSum[SURFACE_MAF_SUMS];
+
+    clearSurfaceDiff(d, set);
+
+    for (int m = 0; m < SURFACE_MAF_SUMS; m++)
+        mafSum[m] = (UINT16)m;
+
+    linearizeMAF_Batch(mafSum, d.linearMAF.data(), SURFACE_MAF_SUMS, set);
+
+    for (UINT32 p = 0; p < SURFACE_PERIODS; p++) {
+
+        kernel((UINT16)p, differ.baseLinearMAF(), baseRows.data(), SURFACE_MAF_SUMS, base);
+        kernel((UINT16)p, d.linearMAF.data(), setRows.data(), SURFACE_MAF_SUMS, set);
+
+        for (int m = 0; m < SURFACE_MAF_SUMS; m++)
+            if (baseRows[m] != setRows[m])
+                differ.addShift((UINT16)m, p, p, (UINT8)baseRows[m], (UINT8)setRows[m], d, false);
+    }
+}
+
+#endif // PROM_PERTURBATION_H
@@ -0,0 +1,35 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Code Models - Random Numbers
+//
+//  The fuzzers, sweeps and benchmarks make their random inputs with this 32-bit xorshift
+//  generator (13, 17, 5) rather than rand(), so a given seed gives the same inputs on
+//  every compiler and platform and a failing case can be reproduced from its seed.
+//  xorshift never leaves zero, so a zero seed is replaced with 1.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CUX_RANDOM_H
+#define CUX_RANDOM_H
+
+#include "CuxTypes.h"
+
+
+class XorShift
+{
+public:
+    explicit XorShift (UINT32 seed) : state(seed ? seed : 1) {}
+
+    UINT32 next (void)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+private:
+    UINT32 state;
+};
+
+#endif // CUX_RANDOM_H
@@ -0,0 +1,32 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Code Models - Reference Tunes
+//
+//  The ten reference images in OriginalCode/Reference_Bins, in the same order as
+//  buildall.bat. The batch tools (BatchCompare, CoolantSweep, IdleSweep, SymIndex) run
+//  every one of them when no image is named on the command line.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef REFERENCE_TUNES_H
+#define REFERENCE_TUNES_H
+
+
+#define REFERENCE_BIN_DIR       "../../OriginalCode/Reference_Bins"
+
+static const char *const referenceTunes[] = {
+    "R3360.bin",        // 94 RRC/Disco 3.9 NAS
+    "R3361.bin",        // 94 RRC 4.2 NAS
+    "R3365.bin",        // 94 D90 NAS
+    "R3383.BIN",        // 94 RRC UK
+    "R3526.bin",        // 95 RRC NAS
+    "R3652.bin",        // NAS Cold weather upgrade
+    "R2967_55.bin",     // 94 Griffith
+    "R2967_5B.bin",     // 95 Griffith
+    "R2967_9B.bin",     // Chimaera 400
+    "R2967_E0.bin"      // Chimaera 450
+};
+
+#define REFERENCE_TUNE_COUNT    (int)(sizeof(referenceTunes) / sizeof(referenceTunes[0]))
+
+#endif // REFERENCE_TUNES_H
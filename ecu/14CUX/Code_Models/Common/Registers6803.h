@@ -0,0 +1,53 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  6803 Register Model
+//
+//  The A and B accumulators can be used as separate 8-bit registers or together as the
+//  16-bit D register. A union is perfect for modelling this. The X00C8/C9 scratch location
+//  is used in a similar way.
+//
+//  The byte indexes are reversed due to the endian issue (the 6803 is big endian, the PC
+//  is little endian). Note that A, B, C8 and C9 are macros, so include any system or
+//  library headers before this one.
+//
+//  The registers are not globals. Each model routine works on a Cpu6803 passed in by the
+//  caller, so the models are reentrant and any number of threads can run them as long as
+//  each one has its own Cpu6803.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef REGISTERS_6803_H
+#define REGISTERS_6803_H
+
+#include "CuxTypes.h"
+
+
+#define A 1     // these are reversed due to the endian issue
+#define B 0
+
+#define C8 1    // (ditto)
+#define C9 0
+
+
+union ABunion
+{
+   UINT16 ab;
+   UCHAR  r[2];
+};
+
+
+union memUnion
+{
+   UINT16 c8c9;
+   UCHAR  m[2];
+};
+
+
+// CPU state used by the model routines
+struct Cpu6803
+{
+   ABunion  reg;                            // the AB register pair
+   memUnion mem;                            // X00C8/C9 scratch (16-bit memory location)
+};
+
+#endif // REGISTERS_6803_H
@@ -0,0 +1,280 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Code Models - Result Cache
+//
+//  Model results depend only on the model code and a few regions of the PROM: the row
+//  index surface on the constants at $C1C3 to $C1C8 and the fuel map's row multiplier, the
+//  column index table and its breakpoints on the 64 byte RPM table at $C800. Most chips
+//  are one of the reference tunes or a small edit of one, so the same results get computed
+//  over and over. The cache keeps them on disk, keyed by their content:
+//
+//      ResultKey       64-bit FNV-1a hash of the kind of result, CUX_MODEL_VERSION, the
+//                      result file format and the bytes the result is computed from
+//      ResultCache     a directory of ordinary result files (ResultFile.h) named
+//                      <kind>-<key in hex>.bin, mapped with ResultFile when found
+//
+//  Each entry ends with the bytes its key was hashed from, their length and the tag
+//  "14CUXKEY" (ResultFile ignores anything after the columns). find() compares them with
+//  the key it was asked for, so two inputs that happen to share a hash can't be mixed up.
+//
+//  Only the bytes a result reads go into its key, so editing a fuel map cell doesn't lose
+//  the row index surface, and two tunes that share an RPM table share its entries. Bump
+//  CUX_MODEL_VERSION when the models change and every old entry is simply never found
+//  again. The tune named in an entry's header is whichever one computed it first.
+//
+//  The directory is $CUX_CACHE if set, otherwise 14cux under the user's cache directory
+//  (%LOCALAPPDATA% on Windows, $XDG_CACHE_HOME or ~/.cache elsewhere). If none of those is
+//  set it falls back to ../Result_Cache, beside the tool directories like the default tune
+//  paths, which .gitignore keeps out of the repository. It is made when first written to. Entries
+//  are written under a temporary name and renamed into place, so runs in parallel never
+//  see half a file, and the directory can be deleted at any time.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+#include "ResultFile.h"
+
+
+#define RESULT_CACHE_DEFAULT_DIR    "../Result_Cache"
+#define RESULT_CACHE_ENV            "CUX_CACHE"
+#define RESULT_CACHE_SUBDIR         "14cux"
+#define RESULT_CACHE_KEY_TAG        "14CUXKEY"
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ResultKey
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+class ResultKey
+{
+public:
+    // kind names the result and starts its file name (e.g. "rowSurface")
+    explicit ResultKey (const char *resultKind) : hash(14695981039346656037ull), kind(resultKind)
+    {
+        add(resultKind, strlen(resultKind));
+        addValue(CUX_MODEL_VERSION);
+        addValue(RESULT_FORMAT_VERSION);
+    }
+
+    void add (const void *bytes, size_t count)
+    {
+        const UCHAR *p = (const UCHAR *)bytes;
+
+        for (size_t i = 0; i < count; i++)
+            hash = (hash ^ p[i]) * 1099511628211ull;
+
+        keyBytes.insert(keyBytes.end(), p, p + count);
+    }
+
+    // little endian, so a key is the same on every host
+    void addValue (UINT32 value)
+    {
+        UCHAR bytes[4] = { (UCHAR)value, (UCHAR)(value >> 8), (UCHAR)(value >> 16), (UCHAR)(value >> 24) };
+        add(bytes, sizeof(bytes));
+    }
+
+    // the constants as they sit in the PROM ($C1C3 to $C1C8, then X200A)
+    void add (const PromConstants &prom)
+    {
+        UCHAR bytes[7] = { (UCHAR)(prom.XC1C3 >> 8), (UCHAR)prom.XC1C3, (UCHAR)(prom.XC1C5 >> 8),
+                           (UCHAR)prom.XC1C5, (UCHAR)(prom.XC1C7 >> 8), (UCHAR)prom.XC1C7, prom.X200A };
+        add(bytes, sizeof(bytes));
+    }
+
+    UINT64 value (void) const           { return hash; }
+    const char *name (void) const       { return kind; }
+
+    // everything added, in order (stored with the entry and checked when it's found)
+    const std::vector<UCHAR> &bytes (void) const  { return keyBytes; }
+
+private:
+    UINT64      hash;
+    const char *kind;
+    std::vector<UCHAR> keyBytes;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ResultCache
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+class ResultCache
+{
+public:
+    // directory may be null for the default
+    explicit ResultCache (const char *directory = 0)
+    {
+        if (!directory)
+            directory = getenv(RESULT_CACHE_ENV);
+
+        dir = (directory && *directory) ? std::string(directory) : defaultDirectory();
+    }
+
+    const char *directory (void) const  { return dir.c_str(); }
+
+    std::string path (const ResultKey &key) const
+    {
+        char name[64];
+
+        snprintf(name, sizeof(name), "/%s-%016llx.bin", key.name(), (unsigned long long)key.value());
+        return dir + name;
+    }
+
+    // Map the entry for key into file. Returns false if there isn't one.
+    bool find (const ResultKey &key, ResultFile &file) const
+    {
+        std::string entry = path(key);
+        struct stat st;
+
+        if (stat(entry.c_str(), &st) != 0)
+            return false;                           // not cached (quietly)
+
+        if (!keyMatches(entry, key))
+            return false;                           // a different input with the same hash
+
+        return file.open(entry.c_str()) && file.header().modelVersion == CUX_MODEL_VERSION;
+    }
+
+    // Write the writer's result as the entry for key. Returns false (and prints why)
+    // if it couldn't be; the result itself is still good.
+    bool store (const ResultKey &key, ResultWriter &writer) const
+    {
+        std::string entry = path(key);
+        char suffix[32];
+
+        makeDirectory(dir);
+
+#ifdef _WIN32
+        snprintf(suffix, sizeof(suffix), ".%d.tmp", _getpid());
+#else
+        snprintf(suffix, sizeof(suffix), ".%d.tmp", (int)getpid());
+#endif
+
+        std::string temp = entry + suffix;
+
+        if (!writer.write(temp.c_str()) || !appendKey(temp, key)) {
+            remove(temp.c_str());
+            return false;
+        }
+
+#ifdef _WIN32
+        remove(entry.c_str());                      // rename won't replace a file on Windows
+#endif
+        if (rename(temp.c_str(), entry.c_str()) != 0) {
+            printf("Could not add %s to the cache\n", entry.c_str());
+            remove(temp.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+    std::string dir;
+
+    static std::string defaultDirectory (void)
+    {
+#ifdef _WIN32
+        const char *base = getenv("LOCALAPPDATA");
+
+        if (base && *base)
+            return std::string(base) + "/" RESULT_CACHE_SUBDIR;
+#else
+        const char *base = getenv("XDG_CACHE_HOME");
+
+        if (base && *base)
+            return std::string(base) + "/" RESULT_CACHE_SUBDIR;
+
+        base = getenv("HOME");
+        if (base && *base)
+            return std::string(base) + "/.cache/" RESULT_CACHE_SUBDIR;
+#endif
+        return RESULT_CACHE_DEFAULT_DIR;
+    }
+
+    // path and any missing parents (only when storing, so a lookup never makes any)
+    static void makeDirectory (const std::string &path)
+    {
+        for (size_t end = 1; end <= path.size(); end++) {
+            if (end < path.size() && path[end] != '/' && path[end] != '\\')
+                continue;
+
+            std::string part = path.substr(0, end);
+#ifdef _WIN32
+            _mkdir(part.c_str());
+#else
+            mkdir(part.c_str(), 0777);
+#endif
+        }
+    }
+
+    // key bytes, their length (little endian) and the tag, after the result
+    static bool appendKey (const std::string &temp, const ResultKey &key)
+    {
+        const std::vector<UCHAR> &bytes = key.bytes();
+        UINT32 count = (UINT32)bytes.size();
+        UCHAR length[4] = { (UCHAR)count, (UCHAR)(count >> 8), (UCHAR)(count >> 16), (UCHAR)(count >> 24) };
+        FILE *fptr = fopen(temp.c_str(), "ab");
+        bool ok;
+
+        if (!fptr)
+            return false;
+
+        ok = fwrite(bytes.data(), 1, bytes.size(), fptr) == bytes.size() &&
+             fwrite(length, 1, sizeof(length), fptr) == sizeof(length) &&
+             fwrite(RESULT_CACHE_KEY_TAG, 1, 8, fptr) == 8;
+
+        return (fclose(fptr) == 0) && ok;
+    }
+
+    static bool keyMatches (const std::string &entry, const ResultKey &key)
+    {
+        const std::vector<UCHAR> &bytes = key.bytes();
+        UCHAR trailer[12];
+        std::vector<UCHAR> stored;
+        FILE *fptr = fopen(entry.c_str(), "rb");
+        bool ok = false;
+
+        if (!fptr)
+            return false;
+
+        if (fseek(fptr, -(long)sizeof(trailer), SEEK_END) == 0 &&
+            fread(trailer, 1, sizeof(trailer), fptr) == sizeof(trailer) &&
+            memcmp(trailer + 4, RESULT_CACHE_KEY_TAG, 8) == 0) {
+
+            UINT32 count = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | ((UINT32)trailer[3] << 24);
+
+            if (count == bytes.size() &&
+                fseek(fptr, -(long)(sizeof(trailer) + count), SEEK_END) == 0) {
+                stored.resize(count);
+                ok = fread(stored.data(), 1, count, fptr) == count &&
+                     memcmp(stored.data(), bytes.data(), count) == 0;
+            }
+        }
+
+        fclose(fptr);
+        return ok;
+    }
+};
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,406 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Code Models - Binary Result Files
+//
+//  The models can produce far more points than are practical to write with fprintf (the
+//  full row index surface is 134M values). Results are written instead as a small header
+//  followed by fixed-width columns, one after the other:
+//
+//      ResultHeader                128 bytes: tune, PROM constants, model version and
+//                                  the axes the results were evaluated over
+//      ResultColumn[columnCount]   32 bytes each: column name, width and file offset
+//      column data                 rowCount values of 1 or 2 bytes per column, each
+//                                  column starting on a 64 byte boundary
+//
+//  The rows are every combination of the axis values, with the last axis changing
+//  fastest. Axis value i is (first + i * step). For example the row index surface has a
+//  mafSum axis (0 to 2046) and a period axis (0 to 65535), so row (mafSum * 65536 + period)
+//  of the rowIndex column is the fuelMapLoadIdx for that pair.
+//
+//  All values are stored little endian (the native order on every platform the models are
+//  built on), so a column can be used directly from the mapped file.
+//
+//  ResultWriter builds a file from columns held in memory. ResultFile maps a file for
+//  reading like TuneImage does with PROM images; Result_Tools/ResultToText converts one
+//  back to the tab delimited text layouts for Excel.
+//
+//  CUX_MODEL_VERSION is stored in every file. Bump it whenever a change to the models
+//  changes their results, so old result files can be told apart.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef RESULT_FILE_H
+#define RESULT_FILE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+
+
+#define CUX_MODEL_VERSION       2           // bump when model results change
+
+#define RESULT_MAGIC            "14CUXRES"
+#define RESULT_FORMAT_VERSION   1
+#define RESULT_MAX_AXES         2
+#define RESULT_NAME_SIZE        16
+#define RESULT_ALIGNMENT        64
+#define RESULT_NO_MAP           0xFF        // mapNumber when no tune was used
+
+// Tells ResultToText which of the original text layouts to reproduce
+#define RESULT_LAYOUT_GENERIC       0       // axis values and columns, tab delimited
+#define RESULT_LAYOUT_MAF_ROW_INDEX 1       // mafAndRowIndex.txt (MafModel.cpp)
+#define RESULT_LAYOUT_ROW_SURFACE   2       // row index sweep (MafModel.cpp -sweep)
+#define RESULT_LAYOUT_RPM_CURVE     3       // rowIndexCurve.txt (RpmTable.cpp)
+
+
+struct ResultAxis                           // 32 bytes
+{
+    char        name[RESULT_NAME_SIZE];
+    UINT32      first;
+    UINT32      step;
+    UINT32      count;
+    UINT32      reserved;
+};
+
+struct ResultColumn                         // 32 bytes
+{
+    char        name[RESULT_NAME_SIZE];
+    UINT32      width;                      // bytes per value (1 or 2)
+    UINT32      reserved;
+    UINT64      offset;                     // from the start of the file
+};
+
+struct ResultHeader                         // 128 bytes
+{
+    char        magic[8];                   // "14CUXRES"
+    UINT32      formatVersion;              // RESULT_FORMAT_VERSION
+    UINT32      modelVersion;               // CUX_MODEL_VERSION
+    UINT32      layout;                     // RESULT_LAYOUT_xxx
+    UINT16      tuneNumber;                 // BCD from $FFE9 (0 if no tune)
+    UINT8       tuneIdent;                  // $FFEC
+    UINT8       mapNumber;                  // fuel map (RESULT_NO_MAP if no tune)
+    char        tuneName[24];               // image file name, or "default"
+    UINT16      XC1C3;                      // PROM constants used
+    UINT16      XC1C5;
+    UINT16      XC1C7;
+    UINT8       X200A;
+    UINT8       reserved0;
+    UINT32      axisCount;
+    UINT32      columnCount;
+    ResultAxis  axis[RESULT_MAX_AXES];
+};
+
+static_assert(sizeof(ResultAxis) == 32, "ResultAxis must be 32 bytes");
+static_assert(sizeof(ResultColumn) == 32, "ResultColumn must be 32 bytes");
+static_assert(sizeof(ResultHeader) == 128, "ResultHeader must be 128 bytes");
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ResultWriter
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+class ResultWriter
+{
+public:
+    // layout is RESULT_LAYOUT_xxx; tune may be null (or not open) when the defaults were used
+    ResultWriter (UINT32 layout, const TuneImage *tune, int mapNumber, const PromConstants &prom)
+    {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, RESULT_MAGIC, 8);
+        header.formatVersion = RESULT_FORMAT_VERSION;
+        header.modelVersion = CUX_MODEL_VERSION;
+        header.layout = layout;
+        header.XC1C3 = prom.XC1C3;
+        header.XC1C5 = prom.XC1C5;
+        header.XC1C7 = prom.XC1C7;
+        header.X200A = prom.X200A;
+        header.mapNumber = RESULT_NO_MAP;
+
+        if (tune && tune->isOpen()) {
+            header.tuneNumber = tune->tuneNumber();
+            header.tuneIdent = tune->byteAt(ADDR_TUNE_IDENT);
+            header.mapNumber = (UINT8)mapNumber;
+            snprintf(header.tuneName, sizeof(header.tuneName), "%.23s", tune->name());
+        }
+        else
+            strcpy(header.tuneName, "default");
+    }
+
+    void addAxis (const char *name, UINT32 first, UINT32 step, UINT32 count)
+    {
+        if (header.axisCount >= RESULT_MAX_AXES)
+            return;
+
+        ResultAxis &a = header.axis[header.axisCount++];
+        strncpy(a.name, name, RESULT_NAME_SIZE - 1);
+        a.first = first;
+        a.step = step;
+        a.count = count;
+    }
+
+    // data must hold rowCount() values and stay valid until write()
+    void addColumn (const char *name, UINT32 width, const void *data)
+    {
+        ResultColumn c;
+
+        memset(&c, 0, sizeof(c));
+        strncpy(c.name, name, RESULT_NAME_SIZE - 1);
+        c.width = width;
+
+        columns.push_back(c);
+        columnData.push_back(data);
+    }
+
+    UINT64 rowCount (void) const
+    {
+        UINT64 rows = 1;
+
+        for (UINT32 i = 0; i < header.axisCount; i++)
+            rows *= header.axis[i].count;
+
+        return rows;
+    }
+
+    // Returns false (and prints why) if the file could not be written
+    bool write (const char *fileName)
+    {
+        static const UCHAR padding[RESULT_ALIGNMENT] = { 0 };
+        FILE *fptr = fopen(fileName, "wb");
+        UINT64 offset;
+        bool ok;
+
+        if (!fptr) {
+            printf("Could not open %s for writing\n", fileName);
+            return false;
+        }
+
+        header.columnCount = (UINT32)columns.size();
+
+        offset = sizeof(header) + columns.size() * sizeof(ResultColumn);
+
+        for (size_t i = 0; i < columns.size(); i++) {
+            offset = alignUp(offset);
+            columns[i].offset = offset;
+            offset += rowCount() * columns[i].width;
+        }
+
+        ok = fwrite(&header, sizeof(header), 1, fptr) == 1;
+
+        if (ok && !columns.empty())
+            ok = fwrite(&columns[0], sizeof(ResultColumn), columns.size(), fptr) == columns.size();
+
+        offset = sizeof(header) + columns.size() * sizeof(ResultColumn);
+
+        for (size_t i = 0; ok && i < columns.size(); i++) {
+            size_t pad = (size_t)(columns[i].offset - offset);
+            size_t bytes = (size_t)(rowCount() * columns[i].width);
+
+            ok = (pad == 0 || fwrite(padding, 1, pad, fptr) == pad) &&
+                 fwrite(columnData[i], 1, bytes, fptr) == bytes;
+
+            offset = columns[i].offset + bytes;
+        }
+
+        if (fclose(fptr) != 0)
+            ok = false;
+
+        if (!ok)
+            printf("Error writing %s\n", fileName);
+
+        return ok;
+    }
+
+private:
+    static UINT64 alignUp (UINT64 offset)
+    {
+        return (offset + RESULT_ALIGNMENT - 1) & ~(UINT64)(RESULT_ALIGNMENT - 1);
+    }
+
+    ResultHeader                header;
+    std::vector<ResultColumn>   columns;
+    std::vector<const void *>   columnData;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ResultFile
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+class ResultFile
+{
+public:
+    ResultFile () : base(0), size(0)
+    {
+    }
+
+    ~ResultFile ()
+    {
+        close();
+    }
+
+    // Map a result file. Returns false (and prints why) if the file can't be used.
+    bool open (const char *path)
+    {
+        close();
+
+#ifdef _WIN32
+        FILE *fptr = fopen(path, "rb");
+
+        if (!fptr) {
+            printf("Could not open %s\n", path);
+            return false;
+        }
+
+        _fseeki64(fptr, 0, SEEK_END);
+        size = (size_t)_ftelli64(fptr);
+        _fseeki64(fptr, 0, SEEK_SET);
+
+        base = new UCHAR[size ? size : 1];
+        if (fread(base, 1, size, fptr) != size) {
+            delete [] (UCHAR *)base;
+            base = 0;
+        }
+
+        fclose(fptr);
+#else
+        int fd = ::open(path, O_RDONLY);
+        struct stat st;
+
+        if (fd < 0) {
+            printf("Could not open %s\n", path);
+            return false;
+        }
+
+        if (fstat(fd, &st) == 0)
+            size = (size_t)st.st_size;
+
+        if (size >= sizeof(ResultHeader)) {
+            base = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (base == MAP_FAILED)
+                base = 0;
+        }
+
+        ::close(fd);
+#endif
+
+        if (!base || size < sizeof(ResultHeader)) {
+            printf("Could not map %s\n", path);
+            close();
+            return false;
+        }
+
+        const ResultHeader &h = header();
+
+        if (memcmp(h.magic, RESULT_MAGIC, 8) != 0 || h.formatVersion != RESULT_FORMAT_VERSION ||
+            h.axisCount > RESULT_MAX_AXES ||
+            size < sizeof(ResultHeader) + (UINT64)h.columnCount * sizeof(ResultColumn)) {
+            printf("%s is not a version %u result file\n", path, RESULT_FORMAT_VERSION);
+            close();
+            return false;
+        }
+
+        for (UINT32 i = 0; i < h.columnCount; i++) {
+            const ResultColumn &c = column(i);
+            // by subtraction and division, so a damaged offset or count can't wrap the check
+            if ((c.width != 1 && c.width != 2) || c.offset > size ||
+                rowCount() > (size - c.offset) / c.width) {
+                printf("%s is truncated or damaged (column %u)\n", path, i);
+                close();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void close (void)
+    {
+#ifdef _WIN32
+        delete [] (UCHAR *)base;
+#else
+        if (base)
+            munmap(base, size);
+#endif
+        base = 0;
+        size = 0;
+    }
+
+    bool isOpen (void) const                { return base != 0; }
+
+    const ResultHeader &header (void) const { return *(const ResultHeader *)base; }
+
+    UINT64 rowCount (void) const
+    {
+        UINT64 rows = 1;
+
+        for (UINT32 i = 0; i < header().axisCount; i++)
+            rows *= header().axis[i].count;
+
+        return rows;
+    }
+
+    const ResultColumn &column (UINT32 index) const
+    {
+        return ((const ResultColumn *)((const UCHAR *)base + sizeof(ResultHeader)))[index];
+    }
+
+    // index of the named column, or -1
+    int findColumn (const char *name) const
+    {
+        for (UINT32 i = 0; i < header().columnCount; i++)
+            if (strncmp(column(i).name, name, RESULT_NAME_SIZE) == 0)
+                return (int)i;
+        return -1;
+    }
+
+    // the column's values, straight from the mapping
+    const UINT8 *data8 (UINT32 index) const
+    {
+        return (const UINT8 *)base + column(index).offset;
+    }
+
+    const UINT16 *data16 (UINT32 index) const
+    {
+        return (const UINT16 *)((const UCHAR *)base + column(index).offset);
+    }
+
+    UINT32 value (UINT32 index, UINT64 row) const
+    {
+        return (column(index).width == 1) ? data8(index)[row] : data16(index)[row];
+    }
+
+    // the value of an axis at the given row
+    UINT32 axisValue (UINT32 axis, UINT64 row) const
+    {
+        const ResultHeader &h = header();
+
+        if (axis >= h.axisCount || rowCount() == 0)
+            return 0;                               // no such axis, or an empty one
+
+        for (UINT32 i = h.axisCount - 1; i > axis; i--)
+            row /= h.axis[i].count;
+
+        return h.axis[axis].first + (UINT32)(row % h.axis[axis].count) * h.axis[axis].step;
+    }
+
+private:
+    ResultFile (const ResultFile &);            // not copyable (owns the mapping)
+    ResultFile &operator= (const ResultFile &);
+
+    void   *base;
+    size_t  size;
+};
+
+#endif // RESULT_FILE_H
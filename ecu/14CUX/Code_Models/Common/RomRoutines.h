@@ -0,0 +1,453 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Firmware Routines
+//
+//  Runs the real firmware for the routines that the other headers model, using the
+//  emulator in Emulator6803.h:
+//
+//      romMpy16            mpy16 (called with jsr)         MafRowIndex.h
+//      romLinearizeMAF     .linearizeMaf in the spark      linearizeMAF_6803
+//                          interrupt, up to 'std mafLinear'
+//      romRowIndex         'ldd ignPeriod / jsr mpy16'     Calculate_Row_Index
+//                          up to 'staa fuelMapLoadIdx'
+//      romColumnIndex      .LEADB up to 'staa              getColumnIndex
+//                          fuelMapSpeedIdx' (or .LEB1F)
+//
+//  and for the coolant models in CoolantFueling.h (RomCoolantRoutines):
+//
+//      romCoolantTempAdjust    'ldx #$C0B5' up to          coolantTempAdjust_6803
+//                              'staa coolantTempAdjust'
+//      romCrankingInit         'ldx #$C0D0' up to the rts  crankingInit_6803
+//      romCrankingFuel         'ldaa coolantTempCount /    crankingFuel_6803
+//                              cmpa $C0DB' up to .LE983
+//      romAccelPump            'ldx #accelPumpTable' up    accelPump_6803
+//                              to the bcs after 'cmpa #$03'
+//
+//  and for the idle air control models in IdleControl.h (RomIdleRoutines):
+//
+//      romIdleControl          idleControl (LD613 in R3526)    idleControl_6803
+//      romDriveIacMotor        driveIacMotor                   driveIacMotor_6803
+//      romIdleLoopTail         'inc $207E' up to the           idleLoopTail_6803
+//                              driveIacMotor call (.LCCF2)
+//
+//  The addresses differ from tune to tune, so they are found by searching the image for
+//  the instruction bytes that start and end each piece (see the listings in
+//  ../../OriginalCode/asmFiles). All ten reference tunes have all of them.
+//
+//  Only the RAM each piece reads is set up before it is run:
+//
+//      .linearizeMaf   X00C8/C9 = MAF sum, X00CE = 0 (cleared earlier in the interrupt
+//                      so that 'com $00CE' ends the loop on the second pass)
+//      row index       ignPeriod (X007A) = period, X00CA/CB = linearized MAF,
+//                      X200A = row multiplier for the selected fuel map
+//      .LEADB          ignPeriod (X007A) = period
+//      coolant         coolantTempCount (X006A), fuelMapNumber (X202C), fuelMapPtr (X2026)
+//                      and, for the cranking fuel, ignPeriodFiltered (X007C), throttlePot
+//                      (X005F/60) and X009B
+//
+//  The PROM constants ($C1C3, $C1C5, $C1C7) and the RPM table come from the image itself.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ROM_ROUTINES_H
+#define ROM_ROUTINES_H
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+#include "Emulator6803.h"
+#include "IdleControl.h"
+
+
+#define RAM_IGN_PERIOD          0x007A
+#define RAM_FUEL_MAP_LOAD_IDX   0x005B
+#define RAM_FUEL_MAP_SPEED_IDX  0x005C
+#define RAM_MAF_LINEAR          0x204D
+#define RAM_ROW_MULT            0x200A
+#define RAM_THROTTLE_POT        0x005F
+#define RAM_COOLANT_TEMP_COUNT  0x006A
+#define RAM_COOLANT_TEMP_ADJUST 0x006B
+#define RAM_IGN_PERIOD_FILTERED 0x007C
+#define RAM_CRANKING_FUEL       0x009B      // X009B, X009C
+#define RAM_COLD_START_COUNT    0x00A6
+#define RAM_FUEL_MAP_PTR        0x2026
+#define RAM_FUEL_MAP_NUMBER     0x202C
+
+
+struct RomRoutines
+{
+    UINT16  mpy16;
+    UINT16  linearizeMaf;                   // 'ldd $00C8'
+    UINT16  linearizeMafEnd;                // after 'std mafLinear'
+    UINT16  rowIndex;                       // 'ldd ignPeriod'
+    UINT16  rowIndexEnd;                    // after 'staa fuelMapLoadIdx'
+    UINT16  columnIndex;                    // .LEADB
+    UINT16  columnIndexEnd;                 // after 'staa fuelMapSpeedIdx'
+    UINT16  columnIndexOut;                 // .LEB1F (period past the end of the table)
+};
+
+
+// Locate the routines in an image. Returns false if any of them is missing.
+inline bool findRomRoutines (const UCHAR *image, RomRoutines &r)
+{
+    static const int mpy16[] =      { 0xCE, 0x00, 0xC8, 0xED, 0x00, 0xE6, 0x03, 0x3D };
+    static const int linMaf[] =     { 0xDC, 0xC8, 0x05, 0x05, 0x05, 0xF3, 0xC1, 0xC3 };
+    static const int linMafEnd[] =  { 0xDD, 0xCA, 0xFD, 0x20, 0x4D };
+    static const int rowIdx[] =     { 0xDC, 0x7A, 0xBD, SIG_ANY, SIG_ANY, 0xB3, 0xC1, 0xC7 };
+    static const int rowIdxEnd[] =  { 0x97, 0x5B };
+    static const int colIdx[] =     { 0xCE, 0xC8, 0x00, 0x86, 0x0F, 0x97, 0xCA };
+    static const int colIdxOut[] =  { 0x7F, 0x00, 0x5C, 0x20 };
+    static const int colIdxEnd[] =  { 0x97, 0x5C };
+
+    memset(&r, 0, sizeof(r));
+
+    r.mpy16 = findSignature(image, PROM_BASE, mpy16, 8);
+    r.linearizeMaf = findSignature(image, PROM_BASE, linMaf, 8);
+    r.rowIndex = findSignature(image, PROM_BASE, rowIdx, 8);
+    r.columnIndex = findSignature(image, PROM_BASE, colIdx, 7);
+
+    if (!r.mpy16 || !r.linearizeMaf || !r.rowIndex || !r.columnIndex)
+        return false;
+
+    UINT16 end;
+
+    if ((end = findSignature(image, r.linearizeMaf, linMafEnd, 5)) != 0)
+        r.linearizeMafEnd = (UINT16)(end + 5);
+
+    if ((end = findSignature(image, r.rowIndex, rowIdxEnd, 2)) != 0)
+        r.rowIndexEnd = (UINT16)(end + 2);
+
+    if ((end = findSignature(image, r.columnIndex, colIdxEnd, 2)) != 0)
+        r.columnIndexEnd = (UINT16)(end + 2);
+
+    // 'clr fuelMapSpeedIdx / bra .LEB1F'
+    if ((end = findSignature(image, r.columnIndex, colIdxOut, 4)) != 0)
+        r.columnIndexOut = (UINT16)(end + 5 + (CHAR)image[end + 4 - PROM_BASE]);
+
+    return r.linearizeMafEnd && r.rowIndexEnd && r.columnIndexEnd && r.columnIndexOut;
+}
+
+// Load the image and mark the ends of the routines
+inline void loadRomRoutines (Emulator6803 &emu, const UCHAR *image, const RomRoutines &r)
+{
+    emu.load(image);
+    emu.setStop(r.linearizeMafEnd);
+    emu.setStop(r.rowIndexEnd);
+    emu.setStop(r.columnIndexEnd);
+    emu.setStop(r.columnIndexOut);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Routine wrappers. Each returns the result and, if cycles isn't null, the
+//  number of E clock cycles the firmware took. A result of 0xFFFF (or 0xFF)
+//  with zero cycles means the routine didn't reach its end.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT16 romMpy16 (Emulator6803 &emu, const RomRoutines &r, UINT16 d, UINT16 X00CA,
+                        UINT32 *cycles = 0)
+{
+    emu.setD(d);
+    emu.write16(0x00CA, X00CA);
+    emu.setSP(EMU_STACK_TOP);
+
+    bool ok = emu.call(r.mpy16) == EMU_RETURNED;
+
+    if (cycles)
+        *cycles = ok ? emu.cycles() : 0;
+
+    return ok ? emu.regD() : 0xFFFF;
+}
+
+inline UINT16 romLinearizeMAF (Emulator6803 &emu, const RomRoutines &r, UINT16 mafSum,
+                               UINT32 *cycles = 0)
+{
+    emu.write16(0x00C8, mafSum);
+    emu.write8(0x00CE, 0);
+
+    bool ok = emu.run(r.linearizeMaf) == EMU_STOPPED && emu.pc() == r.linearizeMafEnd;
+
+    if (cycles)
+        *cycles = ok ? emu.cycles() : 0;
+
+    return ok ? emu.read16(RAM_MAF_LINEAR) : 0xFFFF;
+}
+
+inline UINT8 romRowIndex (Emulator6803 &emu, const RomRoutines &r, UINT16 period, UINT16 linearMAF,
+                          UINT8 X200A, UINT32 *cycles = 0)
+{
+    emu.write16(RAM_IGN_PERIOD, period);
+    emu.write16(0x00CA, linearMAF);
+    emu.write8(RAM_ROW_MULT, X200A);
+    emu.setSP(EMU_STACK_TOP);
+
+    bool ok = emu.run(r.rowIndex) == EMU_STOPPED && emu.pc() == r.rowIndexEnd;
+
+    if (cycles)
+        *cycles = ok ? emu.cycles() : 0;
+
+    return ok ? emu.read8(RAM_FUEL_MAP_LOAD_IDX) : 0xFF;
+}
+
+// bracket is only set when the period is within the table (as getColumnIndex())
+inline UCHAR romColumnIndex (Emulator6803 &emu, const RomRoutines &r, UINT16 period, UCHAR *bracket,
+                             UINT32 *cycles = 0)
+{
+    emu.write16(RAM_IGN_PERIOD, period);
+
+    EmuStatus status = emu.run(r.columnIndex);
+    bool ok = status == EMU_STOPPED && (emu.pc() == r.columnIndexEnd || emu.pc() == r.columnIndexOut);
+
+    // in some tunes (R3365) .LEB1F is the 'staa fuelMapSpeedIdx' itself, reached with
+    // X00CA counted down to $FF
+    if (ok && emu.pc() == r.columnIndexEnd && emu.read8(0x00CA) != 0xFF)
+        *bracket = emu.read8(0x00CA);
+
+    if (cycles)
+        *cycles = ok ? emu.cycles() : 0;
+
+    return ok ? emu.read8(RAM_FUEL_MAP_SPEED_IDX) : 0xFF;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Coolant and cranking routines
+//
+///////////////////////////////////////////////////////////////////////////////
+struct RomCoolantRoutines
+{
+    UINT16  coolantAdjust;                  // 'ldx #$C0B5'
+    UINT16  coolantAdjustEnd;               // after 'staa coolantTempAdjust'
+    UINT16  crankingInit;                   // 'ldx #$C0D0'
+    UINT16  crankingInitEnd;                // the rts after 'std $009B'
+    UINT16  crankingFuel;                   // 'ldaa coolantTempCount / cmpa $C0DB'
+    UINT16  crankingFuelEnd;                // .LE983 (Phase II)
+    UINT16  accelPump;                      // 'ldaa coolantTempCount / ldab #$0C'
+    UINT16  accelPumpEnd;                   // the bcs after 'cmpa #$03'
+};
+
+inline bool findRomCoolantRoutines (const UCHAR *image, RomCoolantRoutines &r)
+{
+    static const int adjust[] =     { 0xCE, 0xC0, 0xB5, 0xF6, 0x20, 0x2C };
+    static const int adjustEnd[] =  { 0xAB, 0x08, 0x97, 0x6B };
+    static const int init[] =       { 0xCE, 0xC0, 0xD0, 0xF6, 0x20, 0x2C };
+    static const int initEnd[] =    { 0xDD, 0x9B, 0x39 };
+    static const int crank[] =      { 0x96, 0x6A, 0xB1, 0xC0, 0xDB };
+    static const int crankJmp[] =   { 0xDC, 0xC8, 0x7E };               // .LE79F / .LE7A1
+    static const int pump[] =       { 0x96, 0x6A, 0xC6, 0x0C, 0xCE, SIG_ANY, SIG_ANY, 0xBD, SIG_ANY,
+                                      SIG_ANY, 0x5F, 0xA6, 0x0C, 0x81, 0x03 };
+
+    memset(&r, 0, sizeof(r));
+
+    r.coolantAdjust = findSignature(image, PROM_BASE, adjust, 6);
+    r.crankingInit = findSignature(image, PROM_BASE, init, 6);
+    r.crankingFuel = findSignature(image, PROM_BASE, crank, 5);
+    r.accelPump = findSignature(image, PROM_BASE, pump, 15);
+
+    if (!r.coolantAdjust || !r.crankingInit || !r.crankingFuel || !r.accelPump)
+        return false;
+
+    UINT16 end;
+
+    if ((end = findSignature(image, r.coolantAdjust, adjustEnd, 4)) != 0)
+        r.coolantAdjustEnd = (UINT16)(end + 4);
+
+    if ((end = findSignature(image, r.crankingInit, initEnd, 3)) != 0)
+        r.crankingInitEnd = (UINT16)(end + 2);
+
+    if ((end = findSignature(image, r.crankingFuel, crankJmp, 3)) != 0)
+        r.crankingFuelEnd = (UINT16)((image[end + 3 - PROM_BASE] << 8) | image[end + 4 - PROM_BASE]);
+
+    r.accelPumpEnd = (UINT16)(r.accelPump + 15);
+
+    return r.coolantAdjustEnd && r.crankingInitEnd && r.crankingFuelEnd;
+}
+
+inline void loadRomCoolantRoutines (Emulator6803 &emu, const UCHAR *image, const RomCoolantRoutines &r)
+{
+    emu.load(image);
+    emu.setStop(r.coolantAdjustEnd);
+    emu.setStop(r.crankingInitEnd);
+    emu.setStop(r.crankingFuelEnd);
+    emu.setStop(r.accelPumpEnd);
+}
+
+inline void setRomFuelMap (Emulator6803 &emu, int mapNumber)
+{
+    emu.write8(RAM_FUEL_MAP_NUMBER, (UCHAR)mapNumber);
+    emu.write16(RAM_FUEL_MAP_PTR, fuelMapAddress[(mapNumber >= 0 && mapNumber < FUEL_MAP_COUNT) ? mapNumber : 0]);
+}
+
+inline UINT8 romCoolantTempAdjust (Emulator6803 &emu, const RomCoolantRoutines &r, UINT8 ectCount,
+                                   int mapNumber)
+{
+    emu.write8(RAM_COOLANT_TEMP_COUNT, ectCount);
+    emu.setA(ectCount);                     // still in A from the store above it
+    setRomFuelMap(emu, mapNumber);
+    emu.setSP(EMU_STACK_TOP);
+
+    bool ok = emu.run(r.coolantAdjust) == EMU_STOPPED && emu.pc() == r.coolantAdjustEnd;
+
+    return ok ? emu.read8(RAM_COOLANT_TEMP_ADJUST) : 0xFF;
+}
+
+inline bool romCrankingInit (Emulator6803 &emu, const RomCoolantRoutines &r, UINT8 ectCount,
+                             int mapNumber, UINT8 &X009B, UINT8 &X009C)
+{
+    emu.write8(RAM_COOLANT_TEMP_COUNT, ectCount);
+    setRomFuelMap(emu, mapNumber);
+    emu.setSP(EMU_STACK_TOP);
+
+    bool ok = emu.run(r.crankingInit) == EMU_STOPPED && emu.pc() == r.crankingInitEnd;
+
+    X009B = emu.read8(RAM_CRANKING_FUEL);
+    X009C = emu.read8(RAM_CRANKING_FUEL + 1);
+
+    return ok;
+}
+
+// Returns the fuel value in AB at .LE983, 0xFFFF if it wasn't reached
+inline UINT16 romCrankingFuel (Emulator6803 &emu, const RomCoolantRoutines &r, UINT8 ectCount,
+                               UINT8 periodMsb, UINT16 throttlePot, UINT8 X009B, int mapNumber,
+                               UINT8 *X00A6 = 0)
+{
+    emu.write8(RAM_COOLANT_TEMP_COUNT, ectCount);
+    emu.write8(RAM_IGN_PERIOD_FILTERED, periodMsb);
+    emu.write16(RAM_THROTTLE_POT, throttlePot);
+    emu.write8(RAM_CRANKING_FUEL, X009B);
+    emu.write8(RAM_COLD_START_COUNT, 0);
+    setRomFuelMap(emu, mapNumber);
+    emu.setSP(EMU_STACK_TOP);
+
+    bool ok = emu.run(r.crankingFuel) == EMU_STOPPED && emu.pc() == r.crankingFuelEnd;
+
+    if (X00A6)
+        *X00A6 = emu.read8(RAM_COLD_START_COUNT);
+
+    return ok ? emu.regD() : 0xFFFF;
+}
+
+// The pulse added (as accelPump_6803), 0xFFFF if the end wasn't reached
+inline UINT16 romAccelPump (Emulator6803 &emu, const RomCoolantRoutines &r, UINT8 ectCount)
+{
+    emu.write8(RAM_COOLANT_TEMP_COUNT, ectCount);
+    emu.setSP(EMU_STACK_TOP);
+
+    bool ok = emu.run(r.accelPump) == EMU_STOPPED && emu.pc() == r.accelPumpEnd;
+
+    if (!ok)
+        return 0xFFFF;
+
+    return (emu.regCC() & CC_C) ? 0 : emu.regD();       // bcs skips the pulse
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Idle air control routines
+//
+///////////////////////////////////////////////////////////////////////////////
+#define IDLE_RAM_STACK          0xF0        // $00F0 to $00FF is left to the stack
+
+struct RomIdleRoutines
+{
+    UINT16  idleControl;                    // 'ldd baseIdleSetting / std $00CE'
+    UINT16  driveIacMotor;                  // 'tpa / psha / ldaa iacMotorStepCount'
+    UINT16  loopTail;                       // 'inc $207E / ldaa $C259'
+    UINT16  loopTailEnd;                    // .LCCF2 (cli before the driveIacMotor call)
+};
+
+inline bool findRomIdleRoutines (const UCHAR *image, RomIdleRoutines &r)
+{
+    static const int idle[] =       { 0xFC, 0xC1, 0x76, 0xDD, 0xCE, 0x96, 0x8A, 0x85, 0x08 };
+    static const int drive[] =      { 0x07, 0x36, 0x96, 0x75, 0x27 };
+    static const int tail[] =       { 0x7C, 0x20, 0x7E, 0xB6, 0xC2, 0x59 };
+    static const int tailEnd[] =    { 0x0E, 0x96, 0x75, 0x27, 0x03, 0xBD };
+
+    memset(&r, 0, sizeof(r));
+
+    r.idleControl = findSignature(image, PROM_BASE, idle, 9);
+    r.driveIacMotor = findSignature(image, PROM_BASE, drive, 5);
+    r.loopTail = findSignature(image, PROM_BASE, tail, 6);
+
+    if (r.loopTail)
+        r.loopTailEnd = findSignature(image, r.loopTail, tailEnd, 6);
+
+    return r.idleControl && r.driveIacMotor && r.loopTail && r.loopTailEnd;
+}
+
+inline void loadRomIdleRoutines (Emulator6803 &emu, const UCHAR *image, const RomIdleRoutines &r)
+{
+    emu.load(image);
+    emu.setStop(r.loopTailEnd);
+}
+
+inline void setRomIdleRam (Emulator6803 &emu, const IdleRam &ram)
+{
+    for (UINT16 i = 0; i < IDLE_RAM_STACK; i++)
+        emu.write8(i, ram.page00[i]);
+
+    for (UINT16 i = 0; i < 0x100; i++)
+        emu.write8((UINT16)(0x2000 + i), ram.page20[i]);
+
+    emu.setSP(EMU_STACK_TOP);
+}
+
+inline void getRomIdleRam (const Emulator6803 &emu, IdleRam &ram)
+{
+    for (UINT16 i = 0; i < IDLE_RAM_STACK; i++)
+        ram.page00[i] = emu.read8(i);
+
+    for (UINT16 i = 0; i < 0x100; i++)
+        ram.page20[i] = emu.read8((UINT16)(0x2000 + i));
+}
+
+// Each runs the routine on a copy of ram and leaves the result in it. Returns false if
+// the routine didn't finish (ram is then left as the emulator had it).
+inline bool romIdleControl (Emulator6803 &emu, const RomIdleRoutines &r, IdleRam &ram,
+                            UINT32 *cycles = 0)
+{
+    setRomIdleRam(emu, ram);
+
+    bool ok = emu.call(r.idleControl) == EMU_RETURNED;
+
+    getRomIdleRam(emu, ram);
+
+    if (cycles)
+        *cycles = ok ? emu.cycles() : 0;
+
+    return ok;
+}
+
+inline bool romDriveIacMotor (Emulator6803 &emu, const RomIdleRoutines &r, IdleRam &ram,
+                              UINT32 *cycles = 0)
+{
+    setRomIdleRam(emu, ram);
+
+    bool ok = emu.call(r.driveIacMotor) == EMU_RETURNED;
+
+    getRomIdleRam(emu, ram);
+
+    if (cycles)
+        *cycles = ok ? emu.cycles() : 0;
+
+    return ok;
+}
+
+inline bool romIdleLoopTail (Emulator6803 &emu, const RomIdleRoutines &r, IdleRam &ram,
+                             UINT32 *cycles = 0)
+{
+    setRomIdleRam(emu, ram);
+
+    bool ok = emu.run(r.loopTail) == EMU_STOPPED && emu.pc() == r.loopTailEnd;
+
+    getRomIdleRam(emu, ram);
+
+    if (cycles)
+        *cycles = ok ? emu.cycles() : 0;
+
+    return ok;
+}
+
+#endif // ROM_ROUTINES_H
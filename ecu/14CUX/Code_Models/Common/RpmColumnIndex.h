@@ -0,0 +1,170 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX RPM Table Model
+//
+//  This simulates (I hope) the block of 6803U4 assembly language code shown below. The code
+//  is from tune R3526 (a.k.a R3360A) so the addresses will not match up to some other tunes,
+//  such as Griffith tunes.
+//
+//  The model was originally part of RpmTable.cpp and is kept here so that the other programs
+//  (such as the batch tune comparison) can use it.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+---------------------------------------------------------------------------------------------------
+EADB				LEADB:
+EADB : CE C8 00			ldx		#$C800		; Location of engine speed table
+EADE : 86 0F			ldaa	#$0F		; load length of data table
+EAE0 : 97 CA			staa	X00CA		; store $0F into 00CA (general purpose var)
+EAE2				LEAE2:					; * Start Loop *
+EAE2 : EC 00			ldd		$00,x		; value from C800 table (1st value is $0553 or 5502 RPM)
+EAE4 : 93 7A			subd	X007A		; subtract 16-bit instantaneous ignition period
+EAE6 : 24 0D			bcc		LEAF5		; branch out if period is LT table value (RPM is higher)
+EAE8 : C6 04			ldab	#$04		; add 04 to index
+EAEA : 3A			    abx					; add B ($04) to X ($C800) = $C804
+EAEB : 7A 00 CA			dec		X00CA		; decrement table length counter
+EAEE : 2A F2			bpl		LEAE2		; *  End  Loop * (loop back if not end of table)
+EAF0 : 7F 00 5C			clr		X005C		; set fuel map eng spd index to zero
+EAF3 : 20 2A			bra		LEB1F		; table ran out, branch way down
+EAF5				LEAF5:
+EAF5 : DD C8			std		X00C8		; 00C8/C9 is table entry minus current ignition period
+EAF7 : 96 CA			ldaa	X00CA		; 00CA is table entry counter ($F->0) and it becomes
+EAF9 : 48			    asla				;   the fuel map column index which is the upper 
+EAFA : 48			    asla				;   nibble of X005C
+EAFB : 48			    asla
+EAFC : 48			    asla
+EAFD : 97 CA			staa	X00CA		; index shifted to upper nibble
+EAFF : A6 02			ldaa	$02,x		; load value from table column 3 ($40, $00 or $80)
+EB01 : 2A 08			bpl		LEB0B		; bra if value is not $80
+EB03 : DC C8			ldd		X00C8		; value is $80, reload speed delta from above
+EB05 : 04			    lsrd
+EB06 : 04			    lsrd
+EB07 : 04			    lsrd
+EB08 : 04			    lsrd				; shift speed delta down to lower nibble
+EB09 : 20 0A			bra		LEB15
+EB0B				LEB0B:					; value is $40 or $00
+EB0B : 85 40			bita	#$40		; test bit 6
+EB0D : 27 04			beq		LEB13
+EB0F : D6 C8			ldab	X00C8		; value is $40, reload MSB of speed delta from above (no shift)
+EB11 : 20 02			bra		LEB15
+EB13				LEB13:					; value is $00
+EB13 : D6 C9			ldab	X00C9		; reload just the low byte of speed delta (no shift)
+EB15				LEB15:
+EB15 : A6 03			ldaa	$03,x		; load right-most value from table
+EB17 : 3D			    mul					; mpy A (table value) by B (speed delta)
+EB18 : 9A CA			oraa	X00CA		; or it into the low nibble of the column index
+EB1A : 97 5C			staa	X005C		; <-- store the fuel map column index here
+
+EB1C : BD D4 03			jsr		LD403		; road speed test, reloads X2012 in B before returning
+EB1F				LEB1F:
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef RPM_COLUMN_INDEX_H
+#define RPM_COLUMN_INDEX_H
+
+#include "CuxTypes.h"
+#include "Registers6803.h"
+#include "PathCounters.h"
+
+// endian swap macro
+#define USHORT_BE2LE(x) ((((x) & 0x00FF) << 8) | (((x) & 0xFF00) >> 8))
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// This function is a model of the 14CUX RPM to Fuel Map Row Index transfer function.
+//
+// It returns the 8-bit row index into the fuel map for a given spark period (2 uSec units).
+// It also returns (by pointer) the fuel map bracket value. If the RPM table is not correct,
+// the bracket value may differ from the upper nibble of the row index.
+//
+// The table is passed in so that it can come from one of the examples in RpmTable.cpp or
+// straight from a PROM image. The registers and X00C8/C9 are the ones in the Cpu6803 passed in.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+inline UCHAR getColumnIndex (Cpu6803 &cpu, UINT16 X007A, UCHAR *bracket, const UCHAR *table)
+{
+
+    ABunion  &regs = cpu.reg;                   // the AB register pair
+    memUnion &C8C9 = cpu.mem;                   // X00C8/C9 scratch
+    UCHAR  X005C;                               // the column index to be returned
+
+    const UCHAR *tablePtr = table;              // ldx  #$C800
+    CHAR X00CA = 0x0F;                          // ldaa #$0F, staa	X00CA
+
+    PATH_ENTRY(PATH_LEADB);
+
+LEAE2:
+    PATH_COUNT(PATH_LEAE2);
+    regs.ab = *(const UINT16 *)tablePtr;        // ldd	$00,x
+    regs.ab = USHORT_BE2LE(regs.ab);            // oh yes, don't forget the endian issue
+    if (regs.ab >= X007A) {                     // if table value >= period ...
+        regs.ab -= X007A;                       // subd	X007A (subtract period)
+        goto LEAF5;                             // carry bit is clear, branch to process remainder
+    }
+    regs.ab -= X007A;                           // subd X007A
+    tablePtr += 4;                              // ldab #$04, abx
+    X00CA--;                                    // dec  X00CA
+    if (X00CA >= 0)                             // bpl	LEAE2 (branch back if pos value)
+        goto LEAE2;
+
+    PATH_COUNT(PATH_LEB1F_BELOW_TABLE);
+    X005C = 0;                                  // clr X005C (RPM lower than 200)
+    goto LEB1F;                                 // LEB1F = return (0)
+
+    if (X00CA == 0) {                           // if code fell through to here, RPM is < 200
+        X005C = 0x00;                           // so set the col index to zero and return
+        return X005C;
+    }
+    
+LEAF5:                                      // if here, loop terminated before end of table
+    PATH_COUNT(PATH_LEAF5);
+    C8C9.c8c9 = regs.ab;                    // std	X00C8 (store remainder)
+    regs.r[A] = X00CA;                      // ldaa	X00CA
+    regs.r[A] = regs.r[A] << 4;             // 4 * alsa (table row becomes upper nibble)
+    X00CA = regs.r[A];                      // staa	X00CA
+    *bracket = X00CA;                       // this is also the bracket value to be returned
+    regs.r[A] = *(tablePtr + 2);            // ldaa	$02,x (control byte from 3rd column)
+
+    if (!(regs.r[A] & (1 << 7)))            // bpl	LEB0B (test sign bit for value 0x80)
+        goto LEB0B;                         // branch if not 0x80
+
+    PATH_COUNT(PATH_LEAF5_CONTROL_80);
+    regs.ab = C8C9.c8c9;                    // value is 0x80, reload speed delta (remainder)
+    regs.ab = regs.ab >> 4;                 // 4 * lsrd (use high byte)
+    goto LEB15;
+
+LEB0B:
+    PATH_COUNT(PATH_LEB0B);
+    if (!(regs.r[A] & (1 << 6)))            // bita	#$40 (test bit 6 for value 0x40)
+        goto LEB13;                         // branch if not 0x40
+
+    regs.r[B] = C8C9.m[C8];                 // ldab	X00C8
+    goto LEB15;                             // bra	LEB15
+
+LEB13:                                      // control byte is 0x00
+    PATH_COUNT(PATH_LEB13);
+    regs.r[B] = C8C9.m[C9];                 // ldab	X00C9 (use low byte)
+
+LEB15:
+    PATH_COUNT(PATH_LEB15);
+    regs.r[A] = *(tablePtr + 3);            // get the multiplier byte from table (4th column)
+    regs.ab = regs.r[A] * regs.r[B];        // multiply A * B (result in AB
+    regs.r[A] |= X00CA;                     // OR the nibbles
+    X005C = regs.r[A];                      // the final row index
+
+LEB1F:
+	return (X005C);
+}
+
+// same, using a private set of registers
+inline UCHAR getColumnIndex (UINT16 X007A, UCHAR *bracket, const UCHAR *table)
+{
+    Cpu6803 cpu;
+
+    return getColumnIndex (cpu, X007A, bracket, table);
+}
+
+#endif // RPM_COLUMN_INDEX_H
@@ -0,0 +1,274 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX RPM Table Editor
+//
+//  Holds a live copy of the RPM table (64 bytes, as at $C800) together with its column
+//  index curve (a ColumnIndexTable, one entry per 16-bit ignition period) and keeps the
+//  curve up to date as the table is edited.
+//
+//  Each row of the table only governs the periods between the entry of the row before it
+//  (or the highest entry above it, if the table is out of order) and its own entry. So a
+//  change to the control byte or multiplier of one row only needs that interval redone,
+//  typically a few hundred to a few thousand periods instead of 65536. A change to the
+//  period itself also moves the boundary with the neighbouring row, and may shadow or
+//  uncover later rows, so the interval is the span of every row whose range changed.
+//
+//  The curve is checked as it is updated, with the same rules as certifyColumnIndex() in
+//  Breakpoints.h: between firstPeriod and lastPeriod the column index must never rise as
+//  the period rises (RPM drops), and at the start of each constant segment its upper
+//  nibble must match the bracket. The problems are kept per period so the total stays
+//  current without rescanning, and each edit returns the problems in the interval it
+//  touched.
+//
+//  An editor is not thread-safe; it is meant to sit behind one tuning session.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef RPM_TABLE_EDITOR_H
+#define RPM_TABLE_EDITOR_H
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+#include "ColumnIndexTable.h"
+#include "Breakpoints.h"
+
+
+#define RPM_TABLE_ROWS          16
+
+#define EDIT_PROBLEM_DROP       0x01        // column index rises as RPM drops
+#define EDIT_PROBLEM_NIBBLE     0x02        // nibble doesn't match the bracket
+
+
+// The result of one edit
+struct RpmTableEdit
+{
+    UINT32  firstPeriod;                    // periods recomputed, first > last when
+    UINT32  lastPeriod;                     // the edit changed nothing
+    UINT32  problemCount;                   // problems over the whole checked range
+    std::vector<Breakpoint> problems;       // problems in the recomputed range
+};
+
+
+class RpmTableEditor
+{
+public:
+    // The checked range defaults to 120 to 6500 RPM, as scanned by RpmTable.cpp
+    explicit RpmTableEditor (const UCHAR *rpmTable, UINT16 firstPeriod = 1153, UINT16 lastPeriod = 62500)
+        : checkFirst(firstPeriod), checkLast(lastPeriod), problemCount(0),
+          flags(PERIOD_COUNT_16BIT, 0)
+    {
+        setTable(rpmTable);
+    }
+
+    const UCHAR *table (void) const                     { return rpm; }
+    const ColumnIndexTable &curve (void) const          { return columns; }
+    UINT32 problems (void) const                        { return problemCount; }
+
+    UINT16 entry (int row) const                        { return rpmTableEntry(rpm, row); }
+    UCHAR control (int row) const                       { return rpm[4 * row + 2]; }
+    UCHAR multiplier (int row) const                    { return rpm[4 * row + 3]; }
+
+    // Replace the whole table (recomputes everything)
+    void setTable (const UCHAR *rpmTable)
+    {
+        memcpy(rpm, rpmTable, RPM_TABLE_SIZE);
+        columns.build(rpm);
+        problemCount = 0;
+        check(0, PERIOD_COUNT_16BIT - 1);
+    }
+
+    // Edit one row (the 4 bytes of the table) or one field of it
+    RpmTableEdit setRow (int row, UINT16 period, UCHAR control, UCHAR multiplier)
+    {
+        UCHAR bytes[4] = { (UCHAR)(period >> 8), (UCHAR)period, control, multiplier };
+
+        return edit(row, bytes);
+    }
+
+    RpmTableEdit setPeriod (int row, UINT16 period)
+    {
+        return setRow(row, period, control(row), multiplier(row));
+    }
+
+    RpmTableEdit setControl (int row, UCHAR control)
+    {
+        return setRow(row, entry(row), control, multiplier(row));
+    }
+
+    RpmTableEdit setMultiplier (int row, UCHAR multiplier)
+    {
+        return setRow(row, entry(row), control(row), multiplier);
+    }
+
+    // The periods governed by a row; false if it is shadowed by an earlier row
+    bool rowPeriods (int row, UINT32 *first, UINT32 *last) const
+    {
+        Span span[RPM_TABLE_ROWS + 1];
+
+        spans(rpm, span);
+        *first = span[row].first;
+        *last = span[row].last;
+
+        return span[row].first <= span[row].last;
+    }
+
+    // Every problem between first and last (within the checked range)
+    std::vector<Breakpoint> listProblems (UINT32 first = 0, UINT32 last = PERIOD_COUNT_16BIT - 1) const
+    {
+        std::vector<Breakpoint> list;
+
+        if (first < checkFirst)
+            first = checkFirst;
+        if (last > checkLast)
+            last = checkLast;
+
+        for (UINT32 p = first; p <= last; p++) {
+            if (flags[p] & EDIT_PROBLEM_NIBBLE) {
+                Breakpoint bp = { p, columns.lookup((UINT16)p), columns.lookup((UINT16)p) };
+                list.push_back(bp);
+            }
+            if (flags[p] & EDIT_PROBLEM_DROP) {
+                Breakpoint bp = { p, columns.lookup((UINT16)(p - 1)), columns.lookup((UINT16)p) };
+                list.push_back(bp);
+            }
+        }
+
+        return list;
+    }
+
+private:
+    struct Span
+    {
+        UINT32  first;
+        UINT32  last;                       // first > last if the row is shadowed
+    };
+
+    // The period range of each row, plus the range past the end of the table
+    static void spans (const UCHAR *table, Span *span)
+    {
+        long covered = -1;                  // highest period already taken by a row
+
+        for (int row = 0; row < RPM_TABLE_ROWS; row++) {
+            long entry = rpmTableEntry(table, row);
+
+            span[row].first = (UINT32)(covered + 1);
+            span[row].last = (UINT32)entry;
+
+            if (entry <= covered) {
+                span[row].first = 1;
+                span[row].last = 0;
+            }
+            else
+                covered = entry;
+        }
+
+        span[RPM_TABLE_ROWS].first = (UINT32)(covered + 1);
+        span[RPM_TABLE_ROWS].last = INPUT_LAST_16BIT;
+    }
+
+    static void widen (const Span &span, UINT32 &first, UINT32 &last)
+    {
+        if (span.first > span.last)
+            return;
+        if (span.first < first)
+            first = span.first;
+        if (span.last > last)
+            last = span.last;
+    }
+
+    RpmTableEdit edit (int row, const UCHAR *bytes)
+    {
+        Span before[RPM_TABLE_ROWS + 1];
+        Span after[RPM_TABLE_ROWS + 1];
+        UINT16 lastEntry = entry(RPM_TABLE_ROWS - 1);
+        bool rowChanged = memcmp(&rpm[4 * row], bytes, 4) != 0;
+
+        spans(rpm, before);
+        memcpy(&rpm[4 * row], bytes, 4);
+        spans(rpm, after);
+
+        RpmTableEdit result;
+        result.firstPeriod = PERIOD_COUNT_16BIT;
+        result.lastPeriod = 0;
+
+        // every row whose periods or bytes changed, both where it was and where it is now
+        for (int r = 0; r <= RPM_TABLE_ROWS; r++) {
+            if ((r == row && rowChanged) || before[r].first != after[r].first ||
+                before[r].last != after[r].last) {
+                widen(before[r], result.firstPeriod, result.lastPeriod);
+                widen(after[r], result.firstPeriod, result.lastPeriod);
+            }
+        }
+
+        // the nibble check stops at the last row's entry, wherever that row is
+        if (entry(RPM_TABLE_ROWS - 1) != lastEntry) {
+            Span moved = { std::min<UINT32>(lastEntry, entry(RPM_TABLE_ROWS - 1)),
+                           std::max<UINT32>(lastEntry, entry(RPM_TABLE_ROWS - 1)) };
+            widen(moved, result.firstPeriod, result.lastPeriod);
+        }
+
+        if (result.firstPeriod <= result.lastPeriod) {
+            columns.update(rpm, result.firstPeriod, result.lastPeriod);
+            check(result.firstPeriod, result.lastPeriod);
+            result.problems = listProblems(result.firstPeriod, result.lastPeriod + 1);
+        }
+
+        result.problemCount = problemCount;
+
+        return result;
+    }
+
+    // Recheck the periods whose flags depend on the curve between first and last
+    void check (UINT32 first, UINT32 last)
+    {
+        if (last < INPUT_LAST_16BIT)
+            last++;                         // the step into the next period
+        if (first < checkFirst)
+            first = checkFirst;
+        if (last > checkLast)
+            last = checkLast;
+
+        UINT16 pastTable = entry(RPM_TABLE_ROWS - 1);
+
+        for (UINT32 p = first; p <= last; p++) {
+
+            UINT16 value = columns.lookup((UINT16)p);
+            UINT16 previous = (p > checkFirst) ? columns.lookup((UINT16)(p - 1)) : value;
+            UCHAR flag = 0;
+
+            // higher period is lower RPM, so the column index must not go up
+            if ((value & 0xFF) > (previous & 0xFF))
+                flag |= EDIT_PROBLEM_DROP;
+
+            // nibble check at the start of each segment
+            if ((p == checkFirst || value != previous) && p <= pastTable &&
+                (value & 0xF0) != ((value >> 8) & 0xF0))
+                flag |= EDIT_PROBLEM_NIBBLE;
+
+            problemCount -= bitCount(flags[p]);
+            problemCount += bitCount(flag);
+            flags[p] = flag;
+        }
+    }
+
+    static UINT32 bitCount (UCHAR flag)
+    {
+        return (flag & EDIT_PROBLEM_DROP ? 1 : 0) + (flag & EDIT_PROBLEM_NIBBLE ? 1 : 0);
+    }
+
+    RpmTableEditor (const RpmTableEditor &);                // not copyable
+    RpmTableEditor &operator= (const RpmTableEditor &);
+
+    UCHAR               rpm[RPM_TABLE_SIZE];
+    ColumnIndexTable    columns;
+    UINT32              checkFirst;
+    UINT32              checkLast;
+    UINT32              problemCount;
+    std::vector<UCHAR>  flags;              // EDIT_PROBLEM_ bits for each period
+};
+
+#endif // RPM_TABLE_EDITOR_H
@@ -0,0 +1,213 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX RPM Table Fit
+//
+//  Given the RPM brackets (the 1st and 2nd columns of the table at $C800), finds the 3rd
+//  column control byte and 4th column multiplier for every row so that the column index
+//  (X005C) is a smooth monotonic function of RPM whose upper nibble matches the bracket.
+//  This is what RPM_TABLE 2 in RpmTable.cpp was doing by hand after the brackets were
+//  spread to 6200 RPM.
+//
+//  The rows can be fitted one at a time. For a period in a row's range getColumnIndex()
+//  gives
+//
+//      X005C = bracket | ((multiplier * g(entry - period)) >> 8)
+//
+//  where g() takes the low byte, the high byte or bits 4 to 11 of the remainder depending
+//  on the control byte. If the scaled value never sets a bit outside the bracket's nibble
+//  the index stays below the next bracket up, so the step from one row to the next is
+//  always downwards and each row can be checked on its own range:
+//
+//      - the index must not rise as the period rises (this catches the byte wrapping)
+//      - the upper nibble must match the bracket
+//
+//  Of the candidates that pass, the one whose lower nibble is closest to a straight line
+//  from 0 at the row's own entry to $10 at the previous row's entry wins (the mean
+//  absolute error over the checked periods), so the fuel map interpolation moves evenly
+//  across the cell. Ties go to the lowest control byte and then the lowest multiplier.
+//
+//  The first row is left at $40/$00, as in every reference tune: its column is the last
+//  one in the map, so there is no cell to the right to interpolate towards.
+//
+//  The candidates (15 rows x 3 control bytes x 256 multipliers, $C0 behaving as $80)
+//  are spread over a pool of worker threads. The search uses the formula above rather
+//  than getColumnIndex() itself; fitRpmTable() checks the finished table with the literal
+//  model (certifyColumnIndex() in Breakpoints.h) before it returns.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef RPM_TABLE_FIT_H
+#define RPM_TABLE_FIT_H
+
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+#include "Breakpoints.h"
+
+
+#define FIT_ROWS                16
+#define FIT_CONTROL_COUNT       3
+
+
+static const UCHAR fitControls[FIT_CONTROL_COUNT] = { 0x00, 0x40, 0x80 };
+
+
+struct RowFit
+{
+    UCHAR   control;
+    UCHAR   multiplier;
+    double  error;                          // mean distance from the ideal nibble
+    UINT32  candidates;                     // candidates that passed the checks
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  rowFitError
+//
+//  Checks one candidate for one row over the periods from first to last
+//  (the part of the row's range being checked) and returns the mean error,
+//  or -1 if the candidate fails. entry is the row's period and span the
+//  number of periods it governs.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline double rowFitError (UINT16 entry, UINT32 span, UCHAR bracket, UCHAR control,
+                           UCHAR multiplier, UINT32 first, UINT32 last)
+{
+    double error = 0.0;
+    UCHAR previous = 0xFF;
+
+    if (first > last)
+        return 0.0;                         // nothing to check
+
+    for (UINT32 p = first; p <= last; p++) {
+
+        UINT16 delta = (UINT16)(entry - p);
+        UINT16 scaled;
+
+        if (control & 0x80)
+            scaled = (delta >> 4) & 0xFF;
+        else if (control & 0x40)
+            scaled = delta >> 8;
+        else
+            scaled = delta & 0xFF;
+
+        UCHAR colIndex = (UCHAR)(((multiplier * scaled) >> 8) | bracket);
+
+        if ((colIndex & 0xF0) != bracket || colIndex > previous)
+            return -1.0;
+
+        double ideal = 16.0 * delta / span;
+        double diff = (colIndex & 0x0F) - ((ideal < 15.0) ? ideal : 15.0);
+
+        error += (diff < 0.0) ? -diff : diff;
+        previous = colIndex;
+    }
+
+    return error / (last - first + 1);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  fitRpmTable
+//
+//  brackets holds the 16 row periods, lowest (highest RPM) first, which must
+//  be strictly increasing. Fills in table (64 bytes) and fit, and returns
+//  the number of problems certifyColumnIndex() finds between firstPeriod and
+//  lastPeriod (zero unless something is badly wrong), or -1 if the brackets
+//  are out of order.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline long fitRpmTable (const UINT16 *brackets, UCHAR *table, RowFit *fit,
+                         UINT16 firstPeriod, UINT16 lastPeriod, unsigned threadCount = 0)
+{
+    for (int row = 1; row < FIT_ROWS; row++)
+        if (brackets[row] <= brackets[row - 1])
+            return -1;
+
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+        threadCount = 1;
+
+    // one task per (row, control byte), rows 1 to 15
+    const int taskCount = (FIT_ROWS - 1) * FIT_CONTROL_COUNT;
+    std::vector<RowFit> best(taskCount);
+    std::vector<std::thread> workers;
+    std::atomic<int> nextTask(0);
+
+    auto worker = [&]() {
+        for (int task; (task = nextTask++) < taskCount; ) {
+
+            int row = 1 + task / FIT_CONTROL_COUNT;
+            UCHAR control = fitControls[task % FIT_CONTROL_COUNT];
+            UCHAR bracket = (UCHAR)((15 - row) << 4);
+            UINT32 first = std::max<UINT32>(brackets[row - 1] + 1, firstPeriod);
+            UINT32 last = std::min<UINT32>(brackets[row], lastPeriod);
+            RowFit &result = best[task];
+
+            result.control = control;
+            result.multiplier = 0;
+            result.error = -1.0;
+            result.candidates = 0;
+
+            for (int multiplier = 0; multiplier < 256; multiplier++) {
+                double error = rowFitError(brackets[row], brackets[row] - brackets[row - 1], bracket,
+                                           control, (UCHAR)multiplier, first, last);
+                if (error < 0.0)
+                    continue;
+
+                result.candidates++;
+                if (result.error < 0.0 || error < result.error) {
+                    result.error = error;
+                    result.multiplier = (UCHAR)multiplier;
+                }
+            }
+        }
+    };
+
+    for (unsigned t = 0; t < threadCount; t++)
+        workers.push_back(std::thread(worker));
+
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+
+    fit[0].control = 0x40;
+    fit[0].multiplier = 0x00;
+    fit[0].error = 0.0;
+    fit[0].candidates = 1;
+
+    for (int row = 1; row < FIT_ROWS; row++) {
+
+        RowFit &rowFit = fit[row];
+        rowFit.error = -1.0;
+        rowFit.candidates = 0;
+
+        // a multiplier of zero always passes, so every row has at least one
+        for (int c = 0; c < FIT_CONTROL_COUNT; c++) {
+            const RowFit &candidate = best[(row - 1) * FIT_CONTROL_COUNT + c];
+            rowFit.candidates += candidate.candidates;
+            if (candidate.error >= 0.0 && (rowFit.error < 0.0 || candidate.error < rowFit.error)) {
+                rowFit.control = candidate.control;
+                rowFit.multiplier = candidate.multiplier;
+                rowFit.error = candidate.error;
+            }
+        }
+    }
+
+    for (int row = 0; row < FIT_ROWS; row++) {
+        table[4 * row] = (UCHAR)(brackets[row] >> 8);
+        table[4 * row + 1] = (UCHAR)brackets[row];
+        table[4 * row + 2] = fit[row].control;
+        table[4 * row + 3] = fit[row].multiplier;
+    }
+
+    return (long)certifyColumnIndex(columnIndexBreakpoints(table), firstPeriod, lastPeriod, table);
+}
+
+#endif // RPM_TABLE_FIT_H
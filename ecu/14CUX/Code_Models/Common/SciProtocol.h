@@ -0,0 +1,422 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Serial Port (SCI) Model
+//
+//  The diagnostic protocol in serialPort.asm, for the serial stand-in (SerialStandIn.h) and
+//  the logging client (SerialLogClient.h). Three pieces:
+//
+//  - Command encoding. A read is set up by an address/quantity transaction (two bytes,
+//    each one echoed) that sets bits 15:6 of the address and the quantity, and is then
+//    started by a one byte read command carrying bits 5:0 (not echoed; the data is the
+//    reply). Both the upper address bits and the quantity stay set, so reading the same
+//    size of block within the same 64 byte page again only takes the one byte. A write is
+//    two bytes (10pp pppp then the data), both echoed.
+//
+//  - SciHardware, the 6803 SCI at 7812.5 baud (8-N-1, 1.28 ms a byte) in simulated time:
+//    a receive data register with its full flag (a byte that arrives while it's still
+//    full is lost, an overrun), and a transmit data register in front of the shift
+//    register, so the firmware can have one byte going out and one waiting.
+//
+//  - sciService(), a literal translation of the routine the main loop calls once a pass.
+//    It handles at most one received byte and transmits at most one byte per call, so a
+//    read of n bytes takes n passes of the main loop whatever the line speed. Note also
+//    that 'ldd sciTRCS' reads (and so clears) the receive register on every call, which
+//    means a byte received while a read is being transmitted is thrown away.
+//
+//  The state is kept in the ECU's RAM at $00E5 to $00EE, as the firmware does, so the
+//  memory passed to sciService() is the whole 64K address space with the PROM at $C000.
+//
+//  The quantity codes above 16 bytes index a table of words near the end of the routine
+//  (80, 100, 400 and 512). The firmware doesn't check the code, so codes past the table
+//  read whatever follows it in the PROM ($FFFF in the reference images). sciQuantityTable()
+//  finds the table in an image.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SCI_PROTOCOL_H
+#define SCI_PROTOCOL_H
+
+#include <deque>
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+#include "Registers6803.h"
+
+
+#define SCI_BYTE_US             1280        // 10 bits at 7812.5 baud
+#define SCI_MEMORY_SIZE         0x10000
+
+#define SCI_QTY_DIRECT          16          // quantity codes $00-$0F read 1 to 16 bytes
+#define SCI_QTY_CODES           0x14        // $10-$13 read 80, 100, 400 and 512
+#define SCI_QTY_TABLE_OFFSET    0x22        // the ldx #.was.FA31 base is this far before the table
+
+// E5 index offsets (the routine's states)
+#define SCI_STATE_IDLE          0x00
+#define SCI_STATE_WRITE_DATA    0x13
+#define SCI_STATE_ADDRESS_2     0x1B
+#define SCI_STATE_TRANSMIT      0x59
+
+// RAM the routine uses
+#define X00E5   0x00E5                      // index offset (state)
+#define X00E6   0x00E6                      // bits 5:0 of the address
+#define X00E7   0x00E7                      // timeout counter
+#define X00E8   0x00E8                      // 1st address/quantity byte
+#define X00E9   0x00E9                      // transmit pointer
+#define X00EB   0x00EB                      // address bits 15:6
+#define X00ED   0x00ED                      // end of the read
+
+
+static const UINT16 sciPresetQuantity[SCI_QTY_CODES - SCI_QTY_DIRECT] = { 80, 100, 400, 512 };
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Command encoding
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Bytes read for a quantity code ($00 to $13)
+inline UINT32 sciQuantity (UINT8 code)
+{
+    return (code < SCI_QTY_DIRECT) ? code + 1u : sciPresetQuantity[code - SCI_QTY_DIRECT];
+}
+
+// Quantity code for a read of qty bytes, or -1 if it isn't one of the sizes
+inline int sciQuantityCode (UINT32 qty)
+{
+    if (qty >= 1 && qty <= SCI_QTY_DIRECT)
+        return (int)qty - 1;
+
+    for (int i = 0; i < SCI_QTY_CODES - SCI_QTY_DIRECT; i++)
+        if (sciPresetQuantity[i] == qty)
+            return SCI_QTY_DIRECT + i;
+
+    return -1;
+}
+
+// Address/quantity transaction: 0qqq qqMM, nnnn nnnn
+inline void sciAddressCommand (UINT16 addr, UINT8 qtyCode, UCHAR cmd[2])
+{
+    cmd[0] = (UCHAR)(((qtyCode & 0x1F) << 2) | (addr >> 14));
+    cmd[1] = (UCHAR)(addr >> 6);
+}
+
+inline UCHAR sciReadCommand (UINT16 addr)   { return (UCHAR)(0xC0 | (addr & 0x3F)); }
+inline UCHAR sciWriteCommand (UINT16 addr)  { return (UCHAR)(0x80 | (addr & 0x3F)); }
+
+// Address bits 15:6 (the page an address/quantity transaction selects)
+inline UINT16 sciPage (UINT16 addr)         { return (UINT16)(addr & 0xFFC0); }
+
+// The ldx #.was.FA31 base in an image (the preset table less $22), or 0
+inline UINT16 sciQuantityTable (const TuneImage &tune)
+{
+    static const int sig[] = { 0x00, 0x50, 0x00, 0x64, 0x01, 0x90, 0x02, 0x00 };
+    UINT16 addr = findSignature(tune.data(), PROM_BASE, sig, sizeof(sig) / sizeof(sig[0]));
+
+    return addr ? (UINT16)(addr - SCI_QTY_TABLE_OFFSET) : 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  SciHardware
+//
+//  Times are in microseconds of simulated time. The host side (the other end
+//  of the cable) calls hostSend() and hostReceive(); the firmware side calls
+//  rxFull(), readData(), tdre() and writeData() after advance() has brought
+//  the SCI up to the current time.
+//
+///////////////////////////////////////////////////////////////////////////////
+class SciHardware
+{
+public:
+    SciHardware ()                          { reset(); }
+
+    void reset (void)
+    {
+        rx.clear();
+        tx.clear();
+        rxLineFree = 0;
+        rdr = 0;
+        rdrf = false;
+        tdr = 0;
+        tdrFull = false;
+        shifting = false;
+        shiftByte = 0;
+        shiftDone = 0;
+        overruns = 0;
+        stalls = 0;
+    }
+
+    // A byte from the host starts on the wire at 'now' (or when the previous one is done)
+    void hostSend (UINT64 now, UCHAR byte)
+    {
+        Timed t;
+
+        t.time = ((now > rxLineFree) ? now : rxLineFree) + SCI_BYTE_US;
+        t.byte = byte;
+        rxLineFree = t.time;
+
+        rx.push_back(t);
+    }
+
+    // Bytes the ECU has finished sending by time t
+    bool hostReceive (UINT64 t, UCHAR &byte)
+    {
+        if (tx.empty() || tx.front().time > t)
+            return false;
+
+        byte = tx.front().byte;
+        tx.pop_front();
+
+        return true;
+    }
+
+    void advance (UINT64 t)
+    {
+        while (!rx.empty() && rx.front().time <= t) {
+            if (rdrf)
+                overruns++;                 // the new byte is lost
+            else {
+                rdr = rx.front().byte;
+                rdrf = true;
+            }
+            rx.pop_front();
+        }
+
+        while (shifting && shiftDone <= t) {
+            Timed out;
+            out.time = shiftDone;
+            out.byte = shiftByte;
+            tx.push_back(out);
+
+            shifting = tdrFull;             // the waiting byte goes straight into the shifter
+            if (tdrFull) {
+                shiftByte = tdr;
+                shiftDone += SCI_BYTE_US;
+                tdrFull = false;
+            }
+        }
+    }
+
+    // When the next thing happens on either side (for the caller's wait), or ~0
+    UINT64 nextEvent (void) const
+    {
+        UINT64 t = ~(UINT64)0;
+
+        if (!rx.empty())
+            t = rx.front().time;
+        if (shifting && shiftDone < t)
+            t = shiftDone;
+
+        return t;
+    }
+
+    // Firmware side
+    bool rxFull (void) const                { return rdrf; }
+    bool tdre (void) const                  { return !tdrFull; }
+
+    UCHAR readData (void)
+    {
+        rdrf = false;
+        return rdr;
+    }
+
+    void writeData (UINT64 now, UCHAR byte)
+    {
+        if (!shifting) {
+            shifting = true;
+            shiftByte = byte;
+            shiftDone = now + SCI_BYTE_US;
+        }
+        else {
+            tdr = byte;
+            tdrFull = true;
+        }
+    }
+
+    // Wait for the transmit data register to be free, then write (the echo's busy wait).
+    // Returns how long the firmware was held up (us).
+    UINT64 waitAndWrite (UINT64 now, UCHAR byte)
+    {
+        UINT64 stall = 0;
+
+        if (tdrFull) {
+            stall = shiftDone - now;
+            now = shiftDone;
+            advance(now);
+        }
+
+        writeData(now, byte);
+        stalls += stall;
+
+        return stall;
+    }
+
+    // When the host can collect the next byte the ECU has sent, or ~0
+    UINT64 nextDelivery (void) const        { return tx.empty() ? ~(UINT64)0 : tx.front().time; }
+
+    UINT64 overrunCount (void) const        { return overruns; }
+    UINT64 stallTime (void) const           { return stalls; }
+    bool idle (void) const                  { return rx.empty() && !shifting && tx.empty(); }
+
+private:
+    struct Timed
+    {
+        UINT64  time;
+        UCHAR   byte;
+    };
+
+    std::deque<Timed> rx;                   // on the wire to the ECU
+    std::deque<Timed> tx;                   // sent, waiting for the host to collect
+    UINT64  rxLineFree;
+    UCHAR   rdr;
+    bool    rdrf;
+    UCHAR   tdr;
+    bool    tdrFull;
+    bool    shifting;
+    UCHAR   shiftByte;
+    UINT64  shiftDone;
+    UINT64  overruns;
+    UINT64  stalls;                         // us spent in waitAndWrite()
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  sciService
+//
+//  One call of the routine (one main loop pass) at time 'now'. mem is the 64K
+//  address space, written only below the PROM. qtyTable is the .was.FA31 base
+//  from sciQuantityTable(). Returns true if a received byte was thrown away
+//  because a read was being transmitted. If stall isn't null it is set to the
+//  time (us) the echo's busy wait held the pass up, which delays the rest of
+//  the main loop.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline UINT16 sciWord (const UCHAR *mem, UINT16 addr)
+{
+    return (UINT16)((mem[addr] << 8) | mem[(UINT16)(addr + 1)]);
+}
+
+inline void sciSetWord (UCHAR *mem, UINT16 addr, UINT16 value)
+{
+    mem[addr] = (UCHAR)(value >> 8);
+    mem[(UINT16)(addr + 1)] = (UCHAR)value;
+}
+
+inline bool sciService (UCHAR *mem, SciHardware &sci, UINT64 now, UINT16 qtyTable, UINT64 *stall = 0)
+{
+    Cpu6803 cpu;
+    ABunion &reg = cpu.reg;
+    UINT16  X;
+    bool    carry = false;
+    bool    discarded = false;
+
+    if (stall)
+        *stall = 0;
+
+    sci.advance(now);
+
+    reg.r[B] = mem[X00E5];                          // ldab  $00E5
+    if (++mem[X00E7] == 0)                          // inc   $00E7, bne .LF9CC
+        reg.r[B] = 0;                               // clrb
+    mem[X00E5] = reg.r[B];                          // .LF9CC  stab $00E5
+                                                    // ldx   #.sci1, abx
+    if (sci.rxFull()) {                             // ldd   sciTRCS, asla, bcc .LF9DC
+        reg.r[A] = sci.readData();
+        mem[X00E7] = 0;                             // clr   $00E7
+        carry = true;                               // tba, sec
+    }
+
+    switch (reg.r[B]) {                             // .LF9DC  jmp $00,x
+
+    case SCI_STATE_IDLE:                            // .sci1
+        if (!carry)                                 // bcc   .LF9F0
+            return false;
+        if (reg.r[A] & 0x80)                        // bmi   .LFA0B
+            goto LFA0B;
+        mem[X00E8] = reg.r[A];                      // staa  $00E8
+        reg.r[B] = SCI_STATE_ADDRESS_2;             // ldab  #$1B
+        goto LF9E6;
+
+    case SCI_STATE_WRITE_DATA:
+        if (!carry)                                 // bcc   .LF9F0
+            return false;
+        X = (UINT16)(sciWord(mem, X00EB) + mem[X00E6]);     // bsr .LFA18
+        if (X < PROM_BASE)                          // (writes to the PROM go nowhere)
+            mem[X] = reg.r[A];                      // staa  $00,x
+        goto LFA08;                                 // bra   .LFA08
+
+    case SCI_STATE_ADDRESS_2:
+        if (!carry)                                 // bcc   .LF9F0
+            return false;
+        {
+            UCHAR second = reg.r[A];                // psha
+            reg.r[B] = reg.r[A];                    // tab
+            reg.r[A] = mem[X00E8];                  // ldaa  $00E8
+            reg.ab <<= 6;                           // asld x 6
+            sciSetWord(mem, X00EB, reg.ab);         // std   $00EB
+            reg.r[A] = second;                      // pula
+        }
+        goto LFA08;
+
+    case SCI_STATE_TRANSMIT:
+        discarded = carry;                          // (the byte just read is lost)
+        goto LFA37;
+
+    default:                                        // not reached (E5 only holds the above)
+        mem[X00E5] = SCI_STATE_IDLE;
+        return false;
+    }
+
+LFA08:
+    reg.r[B] = 0;                                   // clrb, bra .LF9E6
+LF9E6:
+    mem[X00E5] = reg.r[B];                          // stab  $00E5
+    {
+        UINT64 wait = sci.waitAndWrite(now, reg.r[A]);  // .LF9E8 wait for TDRE, staa sciTxData (echo)
+        if (stall)
+            *stall = wait;
+    }
+    return false;                                   // .LF9F0  rts
+
+LFA0B:
+    reg.r[B] = reg.r[A] & 0x3F;                     // tab, andb #$3F
+    mem[X00E6] = reg.r[B];                          // stab  $00E6
+    if (reg.r[A] & 0x40)                            // bita  #$40, bne .LFA1E
+        goto LFA1E;
+    reg.r[B] = SCI_STATE_WRITE_DATA;                // ldab  #$13
+    goto LF9E6;                                     // bra   .LF9E6
+
+LFA1E:
+    X = (UINT16)(sciWord(mem, X00EB) + mem[X00E6]); // bsr   .LFA18
+    sciSetWord(mem, X00E9, X);                      // stx   $00E9
+    reg.r[A] = 0;                                   // clra
+    reg.r[B] = mem[X00E8];                          // ldab  $00E8
+    reg.r[B] >>= 2;                                 // lsrb, lsrb
+    reg.r[B]++;                                     // incb
+    if (reg.r[B] >= 0x11) {                         // cmpb  #$11, bcs .LFA33
+        reg.r[B] <<= 1;                             // aslb
+        reg.ab = sciWord(mem, (UINT16)(qtyTable + reg.r[B]));   // ldx #.was.FA31, abx, ldd $00,x
+    }
+    reg.ab += sciWord(mem, X00E9);                  // .LFA33  addd $00E9
+    sciSetWord(mem, X00ED, reg.ab);                 // std   $00ED
+
+LFA37:                                              // re-entry point for the rest of the read
+    X = sciWord(mem, X00E9);                        // ldx   $00E9
+    reg.r[B] = SCI_STATE_TRANSMIT;                  // ldab  #$59
+    mem[X00E7] = reg.r[B];                          // stab  $00E7
+    if (sci.tdre()) {                               // ldaa sciTRCS, bita #$20, beq .LFA4F
+        sci.writeData(now, mem[X]);                 // ldaa $00,x, staa sciTxData
+        X++;                                        // inx
+        sciSetWord(mem, X00E9, X);                  // stx   $00E9
+        if (X == sciWord(mem, X00ED))               // cpx   $00ED, bne .LFA4F
+            reg.r[B] = 0;                           // clrb
+    }
+    mem[X00E5] = reg.r[B];                          // .LFA4F  stab $00E5
+
+    return discarded;
+}
+
+#endif // SCI_PROTOCOL_H
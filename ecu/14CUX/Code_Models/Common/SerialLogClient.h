@@ -0,0 +1,447 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Serial Logging Client
+//
+//  Reads a set of RAM variables over the diagnostic protocol (SciProtocol.h) as fast as
+//  the ECU allows. The firmware sends at most one byte per main loop pass and handles at
+//  most one received byte per pass, and every address/quantity byte is echoed, so what
+//  matters is the number of passes a sample takes. A read of n bytes takes n passes (the
+//  pass that takes the read command sends the first byte), and each address/quantity
+//  transaction adds two. The ways of reading, slowest first:
+//
+//      poll        one byte at a time, each with its own address/quantity transaction
+//                  (3 passes a byte)
+//      block       variables close together are read as one block (up to 16 bytes),
+//                  each block with its own address/quantity transaction
+//      batch       as block, but the blocks are ordered by page and quantity (padded to
+//                  a common quantity where that's cheaper), and the address/quantity
+//                  transaction is only sent when the page or the quantity changes, since
+//                  the ECU keeps both. A block in the same page as the one before is a
+//                  single read command byte.
+//      pipeline    as batch, but the read command for the next block is sent before the
+//                  current one has all arrived, so that it gets to the ECU on the pass
+//                  after the last byte went out instead of a round trip later. That only
+//                  gains anything when the round trip (two byte times plus any adapter
+//                  latency both ways) is longer than a pass.
+//
+//  A command that arrives while the ECU is still sending is thrown away by the firmware
+//  (see SciProtocol.h), so only the one byte read commands are ever sent early: a lost
+//  half of an address/quantity transaction would leave the ECU out of step. How early is
+//  found as it goes: the client starts by sending on the last byte, moves one byte
+//  earlier after every run of clean blocks, and backs off (for good) the first time an
+//  early command is lost, which costs one timeout.
+//
+//  Times are ECU times: the client is told how much faster than real time the ECU runs
+//  (1 for a real one, the -speed of the stand-in otherwise).
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SERIAL_LOG_CLIENT_H
+#define SERIAL_LOG_CLIENT_H
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "CuxTypes.h"
+#include "SciProtocol.h"
+
+
+#define LOG_BLOCK_GAP           2           // gap bytes cost no more than an address/quantity transaction
+#define LOG_ADDRESS_PASSES      2
+#define LOG_AHEAD_MAX           16
+#define LOG_AHEAD_CLEAN         32          // clean blocks before trying one byte earlier
+#define LOG_READ_ATTEMPTS       3
+
+
+struct LogVariable
+{
+    std::string name;
+    UINT16      address;
+    UINT8       size;                       // 1 or 2 (16-bit values are big endian)
+};
+
+// The RAM the serial stand-in fills (SerialStandIn.h)
+inline std::vector<LogVariable> defaultLogVariables (void)
+{
+    static const struct { const char *name; UINT16 address; UINT8 size; } vars[] = {
+        { "fuelMapLoadIdx",    0x005B, 1 },
+        { "fuelMapSpeedIdx",   0x005C, 1 },
+        { "coolantTempCount",  0x006A, 1 },
+        { "coolantTempAdjust", 0x006B, 1 },
+        { "ignPeriod",         0x007A, 2 },
+        { "compedFuelingVal",  0x0082, 2 },
+        { "fuelMapNumber",     0x202C, 1 },
+        { "mafLinear",         0x204D, 2 }
+    };
+    std::vector<LogVariable> v;
+
+    for (size_t i = 0; i < sizeof(vars) / sizeof(vars[0]); i++) {
+        LogVariable lv;
+        lv.name = vars[i].name;
+        lv.address = vars[i].address;
+        lv.size = vars[i].size;
+        v.push_back(lv);
+    }
+
+    return v;
+}
+
+// name=address[:size], the address in hex with or without a '$' (e.g. idleCount=$2051:2)
+inline bool parseLogVariable (const char *spec, LogVariable &v)
+{
+    const char *eq = strchr(spec, '=');
+    char *end;
+
+    if (!eq || eq == spec)
+        return false;
+
+    const char *p = (eq[1] == '$') ? eq + 2 : eq + 1;
+    unsigned long addr = strtoul(p, &end, 16);
+
+    if (end == p || addr > 0xFFFF)
+        return false;
+
+    v.name.assign(spec, eq - spec);
+    v.address = (UINT16)addr;
+    v.size = 1;
+
+    if (*end == ':') {
+        v.size = (UINT8)atoi(end + 1);
+        if (v.size < 1 || v.size > 2)
+            return false;
+    }
+    else if (*end)
+        return false;
+
+    return true;
+}
+
+inline UINT16 logValue (const UCHAR *shadow, const LogVariable &v)
+{
+    return (v.size == 2) ? (UINT16)((shadow[v.address] << 8) | shadow[(UINT16)(v.address + 1)])
+                         : shadow[v.address];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Read plan
+//
+///////////////////////////////////////////////////////////////////////////////
+enum LogMode
+{
+    LOG_POLL,
+    LOG_BLOCK,
+    LOG_BATCH,
+    LOG_PIPELINE,
+    LOG_MODES
+};
+
+static const char *logModeName[LOG_MODES] = { "poll", "block", "batch", "pipeline" };
+
+struct ReadBlock
+{
+    UINT16  address;
+    UINT16  qty;
+    UINT8   qtyCode;
+    bool    setAddress;                     // needs an address/quantity transaction first
+};
+
+inline bool sameSetup (const ReadBlock &a, const ReadBlock &b)
+{
+    return sciPage(a.address) == sciPage(b.address) && a.qtyCode == b.qtyCode;
+}
+
+inline bool blockOrder (const ReadBlock &a, const ReadBlock &b)
+{
+    if (sciPage(a.address) != sciPage(b.address))
+        return sciPage(a.address) < sciPage(b.address);
+    if (a.qty != b.qty)
+        return a.qty < b.qty;
+    return a.address < b.address;
+}
+
+// Passes one round of the plan takes (once the ECU is set up for its first block)
+inline UINT32 planPasses (const std::vector<ReadBlock> &plan)
+{
+    UINT32 passes = 0;
+
+    for (size_t i = 0; i < plan.size(); i++)
+        passes += plan[i].qty + (plan[i].setAddress ? LOG_ADDRESS_PASSES : 0);
+
+    return passes;
+}
+
+inline std::vector<ReadBlock> planReads (const std::vector<LogVariable> &vars, LogMode mode)
+{
+    std::vector<UINT16> bytes;
+    std::vector<ReadBlock> plan;
+
+    for (size_t i = 0; i < vars.size(); i++)
+        for (int b = 0; b < vars[i].size; b++)
+            bytes.push_back((UINT16)(vars[i].address + b));
+
+    std::sort(bytes.begin(), bytes.end());
+    bytes.erase(std::unique(bytes.begin(), bytes.end()), bytes.end());
+
+    // Blocks of nearby bytes (one per byte for poll)
+    for (size_t i = 0; i < bytes.size(); ) {
+        ReadBlock blk;
+        size_t j = i;
+
+        while (mode != LOG_POLL && j + 1 < bytes.size() && bytes[j + 1] - bytes[i] < SCI_QTY_DIRECT &&
+               bytes[j + 1] - bytes[j] - 1 <= LOG_BLOCK_GAP)
+            j++;
+
+        blk.address = bytes[i];
+        blk.qty = (UINT16)(bytes[j] - bytes[i] + 1);
+        blk.qtyCode = (UINT8)sciQuantityCode(blk.qty);
+        blk.setAddress = true;
+        plan.push_back(blk);
+
+        i = j + 1;
+    }
+
+    if (mode == LOG_POLL || mode == LOG_BLOCK)
+        return plan;
+
+    // Within a page, read every block at the largest quantity if the extra bytes cost
+    // less than the address/quantity transactions that saves
+    std::sort(plan.begin(), plan.end(), blockOrder);
+
+    for (size_t first = 0; first < plan.size(); ) {
+        size_t last = first;
+        UINT32 padding = 0, changes = 0;
+
+        while (last + 1 < plan.size() && sciPage(plan[last + 1].address) == sciPage(plan[first].address))
+            last++;
+
+        for (size_t i = first; i <= last; i++) {
+            padding += plan[last].qty - plan[i].qty;
+            if (i > first && plan[i].qty != plan[i - 1].qty)
+                changes++;
+        }
+
+        if (padding < changes * LOG_ADDRESS_PASSES)
+            for (size_t i = first; i <= last; i++) {
+                plan[i].qty = plan[last].qty;
+                plan[i].qtyCode = plan[last].qtyCode;
+            }
+
+        first = last + 1;
+    }
+
+    // The plan is read round and round, so the first block follows the last
+    for (size_t i = 0; i < plan.size(); i++)
+        plan[i].setAddress = !sameSetup(plan[i], plan[i ? i - 1 : plan.size() - 1]);
+
+    return plan;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  SerialLogClient
+//
+///////////////////////////////////////////////////////////////////////////////
+struct LogClientStats
+{
+    UINT64  samples;
+    UINT64  commandBytes;
+    UINT64  dataBytes;
+    UINT64  timeouts;
+    UINT64  echoErrors;
+    UINT64  earlySends;
+    UINT64  earlyLost;
+};
+
+class SerialLogClient
+{
+public:
+    SerialLogClient (int fileDesc, double ecuSpeed, UINT32 ecuTimeoutUs) : fd(fileDesc),
+        speed(ecuSpeed), timeoutUs(ecuTimeoutUs), forceAddress(true), early(-1), earlyAt(0), ahead(0), clean(0),
+        aheadFixed(false), start(std::chrono::steady_clock::now())
+    {
+        memset(&stats, 0, sizeof(stats));
+    }
+
+    // ECU seconds since the client was made
+    double elapsed (void) const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * speed;
+    }
+
+    const LogClientStats &statistics (void) const   { return stats; }
+    int lookahead (void) const                      { return ahead; }
+
+    // Read every block of the plan once into shadow (64K, indexed by address)
+    bool sample (const std::vector<ReadBlock> &plan, LogMode mode, UCHAR *shadow)
+    {
+        for (size_t i = 0; i < plan.size(); i++)
+            if (!readBlock(plan, i, mode, shadow))
+                return false;
+
+        stats.samples++;
+        return true;
+    }
+
+private:
+    bool readBlock (const std::vector<ReadBlock> &plan, size_t index, LogMode mode, UCHAR *shadow)
+    {
+        const ReadBlock &blk = plan[index];
+        size_t nextIndex = (index + 1) % plan.size();
+        const ReadBlock &next = plan[nextIndex];
+
+        for (int attempt = 0; attempt < LOG_READ_ATTEMPTS; attempt++) {
+
+            bool sentEarly = (early == (int)index);
+            int sentAt = earlyAt;
+            UINT32 got = 0;
+
+            early = -1;
+
+            if (!sentEarly) {
+                if ((blk.setAddress || forceAddress) && !setAddress(blk)) {
+                    resync();
+                    continue;
+                }
+                if (!sendByte(sciReadCommand(blk.address)))
+                    return false;
+                forceAddress = false;
+            }
+
+            UCHAR b;
+
+            while (got < blk.qty && readByte(b)) {
+                shadow[(UINT16)(blk.address + got)] = b;
+                got++;
+                stats.dataBytes++;
+
+                if (mode == LOG_PIPELINE && early < 0 && !next.setAddress && blk.qty - got <= (UINT32)ahead) {
+                    if (!sendByte(sciReadCommand(next.address)))
+                        return false;
+                    early = (int)nextIndex;
+                    earlyAt = (int)(blk.qty - got);
+                    stats.earlySends++;
+                }
+            }
+
+            if (got == blk.qty) {
+                if (sentEarly && sentAt == ahead && !aheadFixed && ++clean >= LOG_AHEAD_CLEAN && ahead < LOG_AHEAD_MAX) {
+                    ahead++;
+                    clean = 0;
+                }
+                return true;
+            }
+
+            stats.timeouts++;
+
+            if (sentEarly && got == 0) {            // the early read command was thrown away
+                stats.earlyLost++;
+                if (ahead > 0)
+                    ahead--;
+                aheadFixed = true;
+                continue;                           // the ECU is idle, just ask again
+            }
+
+            resync();
+        }
+
+        return false;
+    }
+
+    bool setAddress (const ReadBlock &blk)
+    {
+        UCHAR cmd[2], echo;
+
+        sciAddressCommand(blk.address, blk.qtyCode, cmd);
+
+        for (int i = 0; i < 2; i++) {
+            if (!sendByte(cmd[i]))
+                return false;
+            if (!readByte(echo) || echo != cmd[i]) {
+                stats.echoErrors++;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Drop whatever is on the way in and set up the address again next time
+    void resync (void)
+    {
+        UCHAR b;
+
+        while (readByte(b))
+            ;
+
+        early = -1;
+        forceAddress = true;
+    }
+
+    bool sendByte (UCHAR b)
+    {
+        for (;;) {
+            ssize_t n = write(fd, &b, 1);
+            if (n == 1) {
+                stats.commandBytes++;
+                return true;
+            }
+            if (n < 0 && errno != EINTR && errno != EAGAIN) {
+                perror("write");
+                return false;
+            }
+        }
+    }
+
+    // Next byte from the ECU, or false after timeoutUs (ECU time) with nothing
+    bool readByte (UCHAR &b)
+    {
+        if (input.empty()) {
+            struct pollfd p;
+            UCHAR buf[256];
+            int waitMs = (int)(timeoutUs / speed / 1000.0) + 1;
+
+            p.fd = fd;
+            p.events = POLLIN;
+
+            if (poll(&p, 1, waitMs) <= 0)
+                return false;
+
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0)
+                return false;
+
+            input.insert(input.end(), buf, buf + n);
+        }
+
+        b = input.front();
+        input.pop_front();
+
+        return true;
+    }
+
+    int         fd;
+    double      speed;
+    UINT32      timeoutUs;
+    bool        forceAddress;               // the ECU's page and quantity aren't known
+    int         early;                      // block whose read command has been sent early, or -1
+    int         earlyAt;                    // bytes that were still to come when it went
+    int         ahead;                      // bytes still to come when the next command goes
+    int         clean;
+    bool        aheadFixed;
+    std::deque<UCHAR> input;
+    std::chrono::steady_clock::time_point start;
+    LogClientStats stats;
+};
+
+#endif // SERIAL_LOG_CLIENT_H
@@ -0,0 +1,295 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Serial Stand-In
+//
+//  An ECU at the other end of a serial cable, for developing and load testing logging
+//  software without a car. The diagnostic protocol is served by the model of the
+//  firmware's routine in SciProtocol.h, called once per main loop pass, and the RAM it
+//  reads from is kept up to date by a closed loop co-simulation (CoSimulation.h) of the
+//  chosen tune running a drive script. The script starts over when it reaches its end.
+//
+//  The co-simulation's ECU state is copied into the RAM locations the firmware keeps it in
+//  (ramLocations.asm) after every pass:
+//
+//      $005B   fuelMapLoadIdx          $007A   ignPeriod (16-bit)
+//      $005C   fuelMapSpeedIdx         $0082   compedFuelingVal (16-bit, us)
+//      $006A   coolantTempCount        $202C   fuelMapNumber
+//      $006B   coolantTempAdjust       $204D   mafLinear (16-bit)
+//
+//  The PROM image is at $C000 to $FFFF and the rest of memory starts out zero. Writes
+//  from the host land in RAM (the locations above are overwritten on the next pass).
+//
+//  Everything runs in simulated time. serve() ties it to the clock, sped up by a factor,
+//  for talking to a real program over a file descriptor (a pty or a socket). A latency
+//  can be added to each direction to stand in for a USB serial adapter.
+//
+//  A stand-in is used by one thread.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SERIAL_STAND_IN_H
+#define SERIAL_STAND_IN_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+#include "FuelSurface.h"
+#include "CoolantFueling.h"
+#include "CoSimulation.h"
+#include "SciProtocol.h"
+
+
+#define STAND_IN_MAF_LINEAR_PER_GS  88.0    // linearMAF counts per g/s of air (as CoSim)
+
+// RAM locations filled from the co-simulation
+#define RAM_FUEL_MAP_LOAD_IDX       0x005B
+#define RAM_FUEL_MAP_SPEED_IDX      0x005C
+#define RAM_COOLANT_TEMP_COUNT      0x006A
+#define RAM_COOLANT_TEMP_ADJUST     0x006B
+#define RAM_IGN_PERIOD              0x007A
+#define RAM_COMPED_FUELING_VAL      0x0082
+#define RAM_FUEL_MAP_NUMBER         0x202C
+#define RAM_MAF_LINEAR              0x204D
+
+
+struct StandInStats
+{
+    UINT64  passes;                         // main loop passes (sciService calls)
+    UINT64  bytesIn;
+    UINT64  bytesOut;
+    UINT64  overruns;                       // lost in the receive register
+    UINT64  discarded;                      // thrown away during a read
+    UINT64  stallUs;                        // passes held up by the echo's busy wait
+    UINT64  restarts;                       // times the script started over
+};
+
+
+class SerialStandIn
+{
+public:
+    SerialStandIn () : model(0), sensor(0), sim(0), mapNumber(0), qtyTable(0), latency(0),
+        nextPass(0), simBase(0), mem(SCI_MEMORY_SIZE, 0)
+    {
+        memset(&stats, 0, sizeof(stats));
+    }
+
+    ~SerialStandIn ()
+    {
+        delete sim;
+        delete model;
+        delete sensor;
+    }
+
+    // Returns false (with a message) if the tune's tables can't be used
+    bool open (const TuneImage &tune, int map, const DriveScript &drive, const CoSimConfig &config,
+               UINT32 latencyUs)
+    {
+        mapNumber = map;
+        script = drive;
+        cfg = config;
+        latency = latencyUs;
+
+        if (!loadCoolantTables(tune, mapNumber, coolant))
+            return false;
+
+        if (!(qtyTable = sciQuantityTable(tune))) {
+            printf("%s: could not find the serial port quantity table\n", tune.name());
+            return false;
+        }
+
+        memcpy(&mem[PROM_BASE], tune.data(), PROM_SIZE);
+
+        model = new FuelModel(tune, mapNumber);
+        sensor = new MafSensor(model->constants(), STAND_IN_MAF_LINEAR_PER_GS);
+        sim = new CoSimulation(*model, tune.mapMultiplier(mapNumber), coolant, *sensor,
+                               defaultPlantParams(), cfg);
+
+        sim->start(script, 0);
+        updateRam();
+
+        return true;
+    }
+
+    // Run the ECU up to simulated time t (us)
+    void run (UINT64 t)
+    {
+        while (nextPass <= t) {
+            advanceModel(nextPass);
+
+            UINT64 stall;
+
+            if (sciService(&mem[0], sci, nextPass, qtyTable, &stall))
+                stats.discarded++;
+
+            stats.passes++;
+            stats.stallUs += stall;
+            nextPass += cfg.mainLoopUs + stall;     // the rest of the loop runs that much later
+        }
+
+        sci.advance(t);
+        stats.overruns = sci.overrunCount();
+    }
+
+    // The host's side of the cable
+    void hostSend (UINT64 now, UCHAR byte)
+    {
+        sci.hostSend(now + latency, byte);
+        stats.bytesIn++;
+    }
+
+    bool hostReceive (UINT64 now, UCHAR &byte)
+    {
+        if (now < latency || !sci.hostReceive(now - latency, byte))
+            return false;
+
+        stats.bytesOut++;
+        return true;
+    }
+
+    // Simulated time of the next thing to do (a pass, a byte arriving or leaving)
+    UINT64 nextEvent (void) const
+    {
+        UINT64 t = nextPass, e = sci.nextEvent(), d = sci.nextDelivery();
+
+        if (e < t)
+            t = e;
+        if (d != ~(UINT64)0 && d + latency < t)
+            t = d + latency;
+
+        return t;
+    }
+
+    const UCHAR *memory (void) const            { return &mem[0]; }
+    const StandInStats &statistics (void) const { return stats; }
+
+
+    ///////////////////////////////////////////////////////////////////////////
+    //
+    //  serve
+    //
+    //  Talk to the host on fd in real time, with simulated time running
+    //  'speed' times faster, until *stop is set or the other end closes the
+    //  connection. A read error of EIO (a pty with nothing at the other end)
+    //  is waited out.
+    //
+    ///////////////////////////////////////////////////////////////////////////
+    bool serve (int fd, double speed, const std::atomic<bool> *stop)
+    {
+        auto wallStart = std::chrono::steady_clock::now();
+        std::vector<UCHAR> out;
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        while (!(stop && *stop)) {
+
+            double wallUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - wallStart).count();
+            UINT64 now = (UINT64)(wallUs * speed);
+            UCHAR buf[256];
+            ssize_t n;
+
+            while ((n = read(fd, buf, sizeof(buf))) > 0)
+                for (ssize_t i = 0; i < n; i++)
+                    hostSend(now, buf[i]);
+
+            if (n == 0)
+                return true;                        // closed at the other end
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != EIO) {
+                perror("read");
+                return false;
+            }
+
+            run(now);
+
+            UCHAR byte;
+            out.clear();
+            while (hostReceive(now, byte))
+                out.push_back(byte);
+
+            for (size_t done = 0; done < out.size(); ) {
+                ssize_t w = write(fd, &out[done], out.size() - done);
+                if (w > 0)
+                    done += (size_t)w;
+                else if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    perror("write");
+                    return false;
+                }
+            }
+
+            // Sleep until the next event or input from the host
+            UINT64 next = nextEvent();
+            double waitUs = (next > now) ? (next - now) / speed : 0.0;
+            struct pollfd p;
+            struct timespec ts;
+
+            if (waitUs > 100000.0)
+                waitUs = 100000.0;                  // look at *stop now and then
+
+            p.fd = fd;
+            p.events = POLLIN;
+            ts.tv_sec = 0;
+            ts.tv_nsec = (long)(waitUs * 1000.0);
+
+            if (ppoll(&p, 1, &ts, 0) > 0 && (p.revents & (POLLHUP | POLLERR)) && !(p.revents & POLLIN))
+                nanosleep(&ts, 0);                  // pty with no slave open: don't spin
+        }
+
+        return true;
+    }
+
+private:
+    SerialStandIn (const SerialStandIn &);              // not copyable
+    SerialStandIn &operator= (const SerialStandIn &);
+
+    void advanceModel (UINT64 t)
+    {
+        while (!sim->advance(t - simBase)) {
+            simBase += (UINT64)(script.duration() * 1e6 + 0.5);
+            sim->start(script, 0);
+            stats.restarts++;
+
+            if (script.duration() <= 0.0)
+                break;
+        }
+
+        updateRam();
+    }
+
+    void updateRam (void)
+    {
+        const EcuState &ecu = sim->state();
+
+        mem[RAM_FUEL_MAP_LOAD_IDX] = ecu.rowIndex;
+        mem[RAM_FUEL_MAP_SPEED_IDX] = ecu.colIndex;
+        mem[RAM_COOLANT_TEMP_COUNT] = ecu.ectCount;
+        mem[RAM_COOLANT_TEMP_ADJUST] = ecu.coolantTempAdjust;
+        sciSetWord(&mem[0], RAM_IGN_PERIOD, ecu.ignPeriod);
+        sciSetWord(&mem[0], RAM_COMPED_FUELING_VAL, ecu.pulse);
+        mem[RAM_FUEL_MAP_NUMBER] = (UCHAR)mapNumber;
+        sciSetWord(&mem[0], RAM_MAF_LINEAR, ecu.linearMAF);
+    }
+
+    FuelModel      *model;
+    MafSensor      *sensor;
+    CoSimulation   *sim;
+    CoolantTables   coolant;
+    DriveScript     script;
+    CoSimConfig     cfg;
+    int             mapNumber;
+    UINT16          qtyTable;
+    UINT32          latency;                // us, each way
+    UINT64          nextPass;
+    UINT64          simBase;                // simulated time the current run of the script started
+    SciHardware     sci;
+    std::vector<UCHAR> mem;
+    StandInStats    stats;
+};
+
+#endif // SERIAL_STAND_IN_H
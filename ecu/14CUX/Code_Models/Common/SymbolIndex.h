@@ -0,0 +1,735 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Symbol Index
+//
+//  The data tables only have names in the data_*.asm listings (fuelMap1, LC0B5,
+//  accelPumpTable, hiRPMAdcMux, ...), and some of them sit at different addresses in the
+//  Griffith and Range Rover builds. This reads the listings once and keeps what they say
+//  in a small index file, so a tool can find any table by name in any tune (table())
+//  without going back to the text. The models themselves still go through TuneImage.h,
+//  whose fixed addresses "SymIndex -verify" checks against this index.
+//
+//  parseDataListing() assembles a data listing the way crasm would for the directives
+//  these files use: '* =' origin, DB, DW, DS, IF / ELSE / ENDC on the build flags, and
+//  '=' / EQU equates. Expressions are numbers ($hex or decimal), '*' and equate names
+//  joined by + and -. It keeps every label with its address, size and type, every equate
+//  with its value, and the bytes it assembled, so the result can be checked against the
+//  reference image byte for byte. A label's size runs to the next label or the end of
+//  the block it is in, so a fuel map label covers the whole fuel map data structure.
+//  Any other mnemonic is an error (the code files are not data listings).
+//
+//  The index file is laid out so it can be used straight from the mapping:
+//
+//      SymbolIndexHeader
+//      SymbolIndexTune     tuneCount       build name, and the listing's size and time
+//      SymbolSlot          slotCount       open addressing hash table of the names
+//      SymbolEntry         slotCount x tuneCount, the symbol in each build
+//      names                               NUL terminated
+//
+//  find() hashes the name (FNV-1a) and probes the slots, so a lookup costs the same
+//  however many symbols there are; the slot it returns then indexes the entries of every
+//  tune directly. Values are stored in host byte order and the version is checked on
+//  open, so an index is rebuilt rather than misread.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SYMBOL_INDEX_H
+#define SYMBOL_INDEX_H
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+
+
+#define SYMBOL_INDEX_MAGIC      "CUXSYMS"
+#define SYMBOL_INDEX_VERSION    1
+#define SYMBOL_NO_SLOT          0xFFFFFFFF
+
+// Symbol types
+#define SYM_NONE                0           // not defined in this build
+#define SYM_BYTES               1           // label on DB data
+#define SYM_WORDS               2           // label on DW data
+#define SYM_FILL                3           // label on DS
+#define SYM_LABEL               4           // label = * (an alias for the next data)
+#define SYM_EQUATE              5           // name = value, no address
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Parsing
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+struct AsmSymbol
+{
+    std::string name;
+    UINT16      address;                    // labels
+    UINT16      size;
+    UINT16      value;                      // equates
+    UINT8       type;
+};
+
+struct AsmListing
+{
+    std::string             build;          // "R3526" from data_R3526.asm
+    std::vector<AsmSymbol>  symbols;
+    UCHAR                   image[PROM_SIZE];
+    bool                    assembled[PROM_SIZE];
+};
+
+// "R3526" from ".../data_R3526.asm"
+inline std::string listingBuildName (const char *path)
+{
+    std::string name = path;
+    size_t slash = name.find_last_of("/\\");
+
+    if (slash != std::string::npos)
+        name = name.substr(slash + 1);
+    if (name.compare(0, 5, "data_") == 0)
+        name = name.substr(5);
+
+    return name.substr(0, name.find_last_of('.'));
+}
+
+inline const AsmSymbol *findAsmSymbol (const AsmListing &listing, const std::string &name)
+{
+    for (size_t i = 0; i < listing.symbols.size(); i++)
+        if (listing.symbols[i].name == name)
+            return &listing.symbols[i];
+
+    return 0;
+}
+
+// term {(+|-) term}, term = $hex | decimal | * | equate
+inline bool evalAsmExpression (const AsmListing &listing, const char *text, UINT32 pc, UINT32 &value)
+{
+    const char *p = text;
+    int sign = 1;
+
+    value = 0;
+
+    for (;;) {
+        UINT32 term = 0;
+
+        while (isspace((unsigned char)*p))
+            p++;
+
+        if (*p == '$') {
+            char *end;
+            term = (UINT32)strtoul(p + 1, &end, 16);
+            if (end == p + 1)
+                return false;
+            p = end;
+        }
+        else if (isdigit((unsigned char)*p))
+            term = (UINT32)strtoul(p, (char **)&p, 10);
+        else if (*p == '*') {
+            term = pc;
+            p++;
+        }
+        else if (isalpha((unsigned char)*p) || *p == '_') {
+            const char *start = p;
+            while (isalnum((unsigned char)*p) || *p == '_')
+                p++;
+            const AsmSymbol *s = findAsmSymbol(listing, std::string(start, p - start));
+            if (!s)
+                return false;
+            term = (s->type == SYM_EQUATE) ? s->value : s->address;
+        }
+        else
+            return false;
+
+        value += sign * term;
+
+        while (isspace((unsigned char)*p))
+            p++;
+
+        if (*p == 0)
+            return true;
+        if (*p != '+' && *p != '-')
+            return false;
+
+        sign = (*p++ == '-') ? -1 : 1;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  parseDataListing
+//
+//  Assembles one data listing (optionally followed by others, such as
+//  rpmTable.asm, with the same symbols) into listing. Returns false and
+//  prints the file and line of the first thing it doesn't understand.
+//
+///////////////////////////////////////////////////////////////////////////////
+inline bool parseDataListing (const char *path, AsmListing &listing, bool first = true)
+{
+    FILE *fptr = fopen(path, "r");
+    char line[512];
+    int lineNumber = 0;
+    UINT32 pc = PROM_BASE;
+    std::vector<bool> ifStack;              // true while assembling
+    bool ok = true;
+
+    if (!fptr) {
+        printf("Could not open %s\n", path);
+        return false;
+    }
+
+    if (first) {
+        listing.build = listingBuildName(path);
+        listing.symbols.clear();
+        memset(listing.image, 0xFF, sizeof(listing.image));
+        memset(listing.assembled, 0, sizeof(listing.assembled));
+    }
+
+    while (ok && fgets(line, sizeof(line), fptr)) {
+
+        char *semi = strchr(line, ';');
+        char *tok[2] = { 0, 0 };
+        char *rest = 0;
+        int count = 0;
+
+        lineNumber++;
+
+        if (semi)
+            *semi = 0;
+
+        // the first two words, then the rest of the line as the operand
+        char *p = line;
+        while (count < 2) {
+            while (isspace((unsigned char)*p))
+                p++;
+            if (!*p)
+                break;
+            tok[count++] = p;
+            while (*p && !isspace((unsigned char)*p))
+                p++;
+            if (*p)
+                *p++ = 0;
+        }
+        rest = p;
+
+        if (count == 0)
+            continue;
+
+        bool active = ifStack.empty() || ifStack.back();
+
+        if (strcmp(tok[0], "IF") == 0) {
+            UINT32 v = 0;
+            std::string expr = std::string(tok[1] ? tok[1] : "") + (rest ? rest : "");
+            if (active && !evalAsmExpression(listing, expr.c_str(), pc, v))
+                ok = false;
+            ifStack.push_back(active && v != 0);
+            continue;
+        }
+        if (strcmp(tok[0], "ELSE") == 0 || strcmp(tok[0], "ENDC") == 0) {
+            if (ifStack.empty()) {
+                ok = false;
+                break;
+            }
+            bool outer = ifStack.size() == 1 || ifStack[ifStack.size() - 2];
+            if (tok[0][0] == 'E' && tok[0][1] == 'L')
+                ifStack.back() = outer && !ifStack.back();
+            else
+                ifStack.pop_back();
+            continue;
+        }
+
+        if (!active || strcmp(tok[0], "cpu") == 0 || strcmp(tok[0], "output") == 0)
+            continue;
+
+        // a label is any first word that isn't a directive
+        const char *label = 0;
+        const char *op = tok[0];
+        std::string operand;
+
+        if (strcmp(tok[0], "DB") && strcmp(tok[0], "DW") && strcmp(tok[0], "DS")) {
+            label = tok[0];
+            op = tok[1] ? tok[1] : "";
+            operand = rest ? rest : "";
+        }
+        else
+            operand = std::string(tok[1] ? tok[1] : "") + " " + (rest ? rest : "");
+
+        if (strcmp(op, "=") == 0 || strcmp(op, "EQU") == 0) {
+            UINT32 v;
+            if (!evalAsmExpression(listing, operand.c_str(), pc, v)) {
+                ok = false;
+                break;
+            }
+            if (strcmp(label, "*") == 0) {
+                pc = v;
+                continue;
+            }
+            AsmSymbol s = { label, 0, 0, (UINT16)v, SYM_EQUATE };
+            if (operand.find('*') != std::string::npos) {
+                s.address = (UINT16)v;
+                s.type = SYM_LABEL;
+            }
+            listing.symbols.push_back(s);
+            continue;
+        }
+
+        UINT8 type = !strcmp(op, "DB") ? SYM_BYTES : !strcmp(op, "DW") ? SYM_WORDS : !strcmp(op, "DS") ? SYM_FILL : SYM_NONE;
+
+        if (type == SYM_NONE) {
+            ok = false;
+            break;
+        }
+
+        if (label) {
+            AsmSymbol s = { label, (UINT16)pc, 0, 0, type };
+            listing.symbols.push_back(s);
+        }
+
+        // operands, comma separated
+        std::vector<UINT32> values;
+        size_t start = 0;
+
+        for (;;) {
+            size_t comma = operand.find(',', start);
+            std::string item = operand.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+            UINT32 v;
+            if (!evalAsmExpression(listing, item.c_str(), pc, v)) {
+                ok = false;
+                break;
+            }
+            values.push_back(v);
+            if (comma == std::string::npos)
+                break;
+            start = comma + 1;
+        }
+
+        if (!ok || (type == SYM_FILL && values.size() != 2)) {
+            ok = false;
+            break;
+        }
+
+        UINT32 bytes = (type == SYM_FILL) ? values[0] : (UINT32)values.size() * (type == SYM_WORDS ? 2 : 1);
+
+        if (pc < PROM_BASE || pc + bytes > PROM_BASE + PROM_SIZE) {
+            ok = false;
+            break;
+        }
+
+        for (UINT32 i = 0; i < bytes; i++) {
+            UINT32 v = (type == SYM_FILL) ? values[1] :
+                       (type == SYM_WORDS) ? ((i & 1) ? values[i / 2] : values[i / 2] >> 8) : values[i];
+            listing.image[pc - PROM_BASE + i] = (UCHAR)v;
+            listing.assembled[pc - PROM_BASE + i] = true;
+        }
+
+        pc += bytes;
+    }
+
+    if (ok && !ifStack.empty())
+        ok = false;
+
+    if (!ok)
+        printf("%s line %d: not understood\n", path, lineNumber);
+
+    fclose(fptr);
+
+    // sizes: up to the next label or the end of the assembled block
+    std::vector<UINT32> starts;
+
+    for (size_t i = 0; i < listing.symbols.size(); i++)
+        if (listing.symbols[i].type != SYM_EQUATE)
+            starts.push_back(listing.symbols[i].address);
+
+    std::sort(starts.begin(), starts.end());
+
+    for (size_t i = 0; i < listing.symbols.size(); i++) {
+        AsmSymbol &s = listing.symbols[i];
+
+        if (s.type == SYM_EQUATE)
+            continue;
+
+        UINT32 end = s.address;
+        std::vector<UINT32>::iterator next = std::upper_bound(starts.begin(), starts.end(), (UINT32)s.address);
+        UINT32 limit = (next != starts.end()) ? *next : PROM_BASE + PROM_SIZE;
+
+        while (end < limit && listing.assembled[end - PROM_BASE])
+            end++;
+
+        s.size = (UINT16)(end - s.address);
+    }
+
+    return ok;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Index file
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+struct SymbolIndexHeader
+{
+    char    magic[8];
+    UINT32  version;
+    UINT32  tuneCount;
+    UINT32  slotCount;                      // power of two
+    UINT32  symbolCount;
+    UINT32  nameBytes;
+    UINT32  reserved;
+};
+
+struct SymbolIndexTune
+{
+    char    build[16];                      // "R3526"
+    char    source[48];                     // listing file name
+    UINT64  sourceSize;
+    UINT64  sourceTime;                     // modification time
+};
+
+struct SymbolSlot
+{
+    UINT32  hash;
+    UINT32  nameOffset;                     // SYMBOL_NO_SLOT when empty
+};
+
+struct SymbolEntry
+{
+    UINT16  address;
+    UINT16  size;
+    UINT16  value;
+    UINT8   type;                           // SYM_NONE when this build doesn't have it
+    UINT8   reserved;
+};
+
+inline UINT32 symbolHash (const char *name)
+{
+    UINT32 h = 2166136261u;
+
+    while (*name)
+        h = (h ^ (UCHAR)*name++) * 16777619u;
+
+    return h;
+}
+
+inline bool listingStat (const char *path, UINT64 &size, UINT64 &time)
+{
+    struct stat st;
+
+    if (stat(path, &st) != 0)
+        return false;
+
+    size = (UINT64)st.st_size;
+    time = (UINT64)st.st_mtime;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  writeSymbolIndex
+//
+//  listingPaths[i] is the source of listings[i] (for the staleness check).
+//
+///////////////////////////////////////////////////////////////////////////////
+inline bool writeSymbolIndex (const char *indexPath, const std::vector<AsmListing *> &listings,
+                              const std::vector<std::string> &listingPaths)
+{
+    std::vector<std::string> names;
+
+    for (size_t t = 0; t < listings.size(); t++)
+        for (size_t i = 0; i < listings[t]->symbols.size(); i++)
+            names.push_back(listings[t]->symbols[i].name);
+
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    UINT32 slotCount = 16;
+    while (slotCount < names.size() * 2)    // at most half full
+        slotCount *= 2;
+
+    SymbolIndexHeader header;
+    std::vector<SymbolIndexTune> tunes(listings.size());
+    std::vector<SymbolSlot> slots(slotCount);
+    std::vector<SymbolEntry> entries((size_t)slotCount * listings.size());
+    std::string pool;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SYMBOL_INDEX_MAGIC, sizeof(SYMBOL_INDEX_MAGIC));
+    header.version = SYMBOL_INDEX_VERSION;
+    header.tuneCount = (UINT32)listings.size();
+    header.slotCount = slotCount;
+    header.symbolCount = (UINT32)names.size();
+
+    for (size_t t = 0; t < listings.size(); t++) {
+        std::string file = listingPaths[t].substr(listingPaths[t].find_last_of("/\\") + 1);
+
+        memset(&tunes[t], 0, sizeof(tunes[t]));
+        strncpy(tunes[t].build, listings[t]->build.c_str(), sizeof(tunes[t].build) - 1);
+        strncpy(tunes[t].source, file.c_str(), sizeof(tunes[t].source) - 1);
+        listingStat(listingPaths[t].c_str(), tunes[t].sourceSize, tunes[t].sourceTime);
+    }
+
+    for (size_t i = 0; i < slots.size(); i++)
+        slots[i].hash = 0, slots[i].nameOffset = SYMBOL_NO_SLOT;
+    memset(entries.data(), 0, entries.size() * sizeof(SymbolEntry));
+
+    for (size_t n = 0; n < names.size(); n++) {
+
+        UINT32 h = symbolHash(names[n].c_str());
+        UINT32 slot = h & (slotCount - 1);
+
+        while (slots[slot].nameOffset != SYMBOL_NO_SLOT)
+            slot = (slot + 1) & (slotCount - 1);
+
+        slots[slot].hash = h;
+        slots[slot].nameOffset = (UINT32)pool.size();
+        pool += names[n];
+        pool += '\0';
+
+        for (size_t t = 0; t < listings.size(); t++) {
+            const AsmSymbol *s = findAsmSymbol(*listings[t], names[n]);
+            SymbolEntry &e = entries[(size_t)slot * listings.size() + t];
+            if (s) {
+                e.address = s->address;
+                e.size = s->size;
+                e.value = s->value;
+                e.type = s->type;
+            }
+        }
+    }
+
+    header.nameBytes = (UINT32)pool.size();
+
+    FILE *fptr = fopen(indexPath, "wb");
+
+    if (!fptr) {
+        printf("Could not open %s for writing\n", indexPath);
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, fptr) == 1 &&
+              (tunes.empty() || fwrite(tunes.data(), sizeof(SymbolIndexTune), tunes.size(), fptr) == tunes.size()) &&
+              fwrite(slots.data(), sizeof(SymbolSlot), slots.size(), fptr) == slots.size() &&
+              (entries.empty() || fwrite(entries.data(), sizeof(SymbolEntry), entries.size(), fptr) == entries.size()) &&
+              fwrite(pool.data(), 1, pool.size(), fptr) == pool.size();
+
+    if (fclose(fptr) != 0)
+        ok = false;
+
+    if (!ok)
+        printf("Could not write %s\n", indexPath);
+
+    return ok;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  SymbolIndex
+//
+//  A mapped index file. Nothing is copied; the entries point into the
+//  mapping and stay valid until close().
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+class SymbolIndex
+{
+public:
+    SymbolIndex () : base(0), size(0), header(0), tunes(0), slots(0), entries(0), names(0)
+    {
+    }
+
+    ~SymbolIndex ()
+    {
+        close();
+    }
+
+    // Map an index file. Returns false (quietly, so the caller can rebuild
+    // it) if the file is missing, from another version or truncated.
+    bool open (const char *path)
+    {
+        close();
+
+#ifdef _WIN32
+        FILE *fptr = fopen(path, "rb");
+
+        if (!fptr)
+            return false;
+
+        fseek(fptr, 0, SEEK_END);
+        size = (size_t)ftell(fptr);
+        fseek(fptr, 0, SEEK_SET);
+
+        base = new UCHAR[size ? size : 1];
+        if (fread(base, 1, size, fptr) != size)
+            size = 0;
+        fclose(fptr);
+#else
+        int fd = ::open(path, O_RDONLY);
+        struct stat st;
+
+        if (fd < 0)
+            return false;
+
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            size = (size_t)st.st_size;
+            base = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (base == MAP_FAILED)
+                base = 0, size = 0;
+        }
+
+        ::close(fd);
+#endif
+
+        const UCHAR *p = (const UCHAR *)base;
+        header = (const SymbolIndexHeader *)p;
+
+        if (!base || size < sizeof(SymbolIndexHeader) || memcmp(header->magic, SYMBOL_INDEX_MAGIC, 8) ||
+            header->version != SYMBOL_INDEX_VERSION ||
+            size != sizeof(SymbolIndexHeader) + header->tuneCount * sizeof(SymbolIndexTune) +
+                    header->slotCount * (sizeof(SymbolSlot) + header->tuneCount * sizeof(SymbolEntry)) +
+                    header->nameBytes) {
+            close();
+            return false;
+        }
+
+        p += sizeof(SymbolIndexHeader);
+        tunes = (const SymbolIndexTune *)p;
+        p += header->tuneCount * sizeof(SymbolIndexTune);
+        slots = (const SymbolSlot *)p;
+        p += header->slotCount * sizeof(SymbolSlot);
+        entries = (const SymbolEntry *)p;
+        p += (size_t)header->slotCount * header->tuneCount * sizeof(SymbolEntry);
+        names = (const char *)p;
+
+        return true;
+    }
+
+    void close (void)
+    {
+#ifdef _WIN32
+        delete [] (UCHAR *)base;
+#else
+        if (base)
+            munmap(base, size);
+#endif
+        base = 0;
+        size = 0;
+        header = 0;
+    }
+
+    bool isOpen (void) const                { return header != 0; }
+    int tuneCount (void) const              { return header ? (int)header->tuneCount : 0; }
+    int symbolCount (void) const            { return header ? (int)header->symbolCount : 0; }
+    int slotCount (void) const              { return header ? (int)header->slotCount : 0; }
+    const char *build (int tune) const      { return tunes[tune].build; }
+
+    // True if a listing in asmDir has changed (or gone) since the index was built
+    bool stale (const char *asmDir) const
+    {
+        for (int t = 0; t < tuneCount(); t++) {
+            std::string path = std::string(asmDir) + "/" + tunes[t].source;
+            UINT64 s, m;
+            if (!listingStat(path.c_str(), s, m) || s != tunes[t].sourceSize || m != tunes[t].sourceTime)
+                return true;
+        }
+        return false;
+    }
+
+    // Build number for a tune or image name ("R3526", "R3526.bin", "r3383.BIN"), or -1
+    int findTune (const char *name) const
+    {
+        const char *base = name;
+        const char *s;
+
+        if ((s = strrchr(base, '/')) != 0)
+            base = s + 1;
+        if ((s = strrchr(base, '\\')) != 0)
+            base = s + 1;
+
+        size_t len = strcspn(base, ".");
+
+        for (int t = 0; t < tuneCount(); t++)
+            if (strlen(tunes[t].build) == len && compareNoCase(tunes[t].build, base, len))
+                return t;
+
+        return -1;
+    }
+
+    // Slot of a symbol name, or -1
+    int find (const char *name) const
+    {
+        if (!header)
+            return -1;
+
+        UINT32 h = symbolHash(name);
+        UINT32 mask = header->slotCount - 1;
+
+        for (UINT32 slot = h & mask; slots[slot].nameOffset != SYMBOL_NO_SLOT; slot = (slot + 1) & mask)
+            if (slots[slot].hash == h && strcmp(names + slots[slot].nameOffset, name) == 0)
+                return (int)slot;
+
+        return -1;
+    }
+
+    // Name in a slot (0 for an empty slot), for listing the index
+    const char *name (int slot) const
+    {
+        return slots[slot].nameOffset == SYMBOL_NO_SLOT ? 0 : names + slots[slot].nameOffset;
+    }
+
+    const SymbolEntry &entry (int slot, int tune) const
+    {
+        return entries[(size_t)slot * header->tuneCount + tune];
+    }
+
+    // A table in a mapped image, or 0 if this build doesn't have it
+    const UCHAR *table (const TuneImage &image, int slot, int tune) const
+    {
+        const SymbolEntry &e = entry(slot, tune);
+
+        if (e.type == SYM_NONE || e.type == SYM_EQUATE || e.address < PROM_BASE)
+            return 0;
+
+        return image.ptr(e.address);
+    }
+
+    const UCHAR *table (const TuneImage &image, const char *symbol) const
+    {
+        int slot = find(symbol);
+        int tune = findTune(image.name());
+
+        return (slot < 0 || tune < 0) ? 0 : table(image, slot, tune);
+    }
+
+private:
+    SymbolIndex (const SymbolIndex &);          // not copyable (owns the mapping)
+    SymbolIndex &operator= (const SymbolIndex &);
+
+    static bool compareNoCase (const char *a, const char *b, size_t len)
+    {
+        for (size_t i = 0; i < len; i++)
+            if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i]))
+                return false;
+        return true;
+    }
+
+    void                    *base;
+    size_t                   size;
+    const SymbolIndexHeader *header;
+    const SymbolIndexTune   *tunes;
+    const SymbolSlot        *slots;
+    const SymbolEntry       *entries;
+    const char              *names;
+};
+
+#endif // SYMBOL_INDEX_H
@@ -0,0 +1,338 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Tune Image Reader
+//
+//  This maps a 16K PROM image (such as the ones in OriginalCode/Reference_Bins) into memory
+//  and gives the code models direct access to the data tables they need. Nothing is copied;
+//  the pointers returned below point straight into the mapped file, so the models can be
+//  run against any tune without editing and rebuilding them.
+//
+//  The image covers $C000 through $FFFF. The 2K data section is at the start ($C000 to
+//  $C7FF) and the RPM table is at $C800. A 32K image (16K code stacked twice by the
+//  'finalize' tool) is also accepted, in which case the upper 16K is used.
+//
+//  On Windows the image is simply read into memory. (Including windows.h here would clash
+//  with the CHAR type used by the models.)
+//
+//  An image that is already in memory (such as one being patched by TunePatcher.h) can be
+//  attached instead of opened. The TuneImage then only points at it; the caller keeps it.
+//
+//  The fuel map addresses are the same in all ten reference tunes, so they are fixed here
+//  rather than looked up in the symbol index (SymbolIndex.h); "SymIndex -verify" checks
+//  them, and the RPM table address, against the data listings. Each fuel map data
+//  structure starts with the 8 x 16 map itself and is followed by the multiplier and the
+//  tables listed in the data_*.asm files. The byte at offset $10A is the row multiplier
+//  that is copied to X200A for the load (row) index calculation. Fuel map 0 (the limp
+//  home map) does not have this structure, so X200A keeps its reset value from $C1C9.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUNE_IMAGE_H
+#define TUNE_IMAGE_H
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "CuxTypes.h"
+
+
+#define PROM_BASE               0xC000      // first address of the 16K image
+#define PROM_SIZE               0x4000      // 16K
+
+#define ADDR_RPM_TABLE          0xC800      // 16 rows of 4 bytes
+#define RPM_TABLE_SIZE          64
+
+#define ADDR_MAF_OFFSET         0xC1C3      // $225D, added to 8 x MAF sum
+#define ADDR_MAF_SUBTRACT       0xC1C5      // $09C0, subtracted after 1st squaring
+#define ADDR_ROW_OFFSET         0xC1C7      // $001E, subtracted from mpy16 result
+#define ADDR_ROW_MULT_RESET     0xC1C9      // $B2, copied to X200A at reset
+#define ADDR_FUEL_MAP_LOCK      0xC7C1      // non-zero locks the ECU into fuel map 5
+#define ADDR_TUNE_NUMBER        0xFFE9      // BCD tune number (e.g. $3526)
+#define ADDR_CHECKSUM_FIXER     0xFFEB
+#define ADDR_TUNE_IDENT         0xFFEC
+
+#define FUEL_MAP_COUNT          6           // map 0 (limp home) plus maps 1 to 5
+#define FUEL_MAP_ROWS           8
+#define FUEL_MAP_COLS           16
+#define FUEL_MAP_SIZE           (FUEL_MAP_ROWS * FUEL_MAP_COLS)
+#define FUEL_MAP_MULT_OFFSET    0x80        // 16-bit fuel map multiplier
+#define FUEL_MAP_ROW_MULT_OFFSET 0x10A      // row multiplier (copied to X200A)
+
+
+static const UINT16 fuelMapAddress[FUEL_MAP_COUNT] = {
+    0xC000,                                 // limpHomeMap (map 0)
+    0xC267,                                 // fuelMap1
+    0xC379,                                 // fuelMap2
+    0xC48B,                                 // fuelMap3
+    0xC59D,                                 // fuelMap4
+    0xC6AF                                  // fuelMap5
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  PROM constants used by the MAF linearization and row index code in the spark interrupt.
+//  The default values are the ones found in R3526 (and, as it happens, all ten reference
+//  tunes when running on fuel map 5).
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+struct PromConstants
+{
+    UINT16 XC1C3;                           // added to 8 x MAF sum ($225D)
+    UINT16 XC1C5;                           // subtracted after the 1st squaring ($09C0)
+    UINT16 XC1C7;                           // subtracted from the mpy16 result ($001E)
+    UINT8  X200A;                           // fuel map row multiplier ($B2)
+};
+
+inline PromConstants defaultPromConstants (void)
+{
+    PromConstants k;
+
+    k.XC1C3 = 0x225D;
+    k.XC1C5 = 0x09C0;
+    k.XC1C7 = 0x001E;
+    k.X200A = 0xB2;
+
+    return k;
+}
+
+// R3526 RPM table ($C800), used by the tools when no tune image is given
+static const UCHAR defaultRpmTable[RPM_TABLE_SIZE] = {
+    0x05, 0x53, 0x40, 0x00,  0x06, 0x2A, 0x00, 0x13,  0x07, 0x25, 0x00, 0x10,  0x07, 0xD0, 0x00, 0x18,
+    0x09, 0x73, 0x80, 0x9C,  0x0A, 0xD9, 0x80, 0xB7,  0x0E, 0xA6, 0x80, 0x43,  0x10, 0xBD, 0x80, 0x7A,
+    0x14, 0xED, 0x80, 0x3D,  0x1A, 0xA2, 0x80, 0x2C,  0x20, 0x8D, 0x80, 0x2B,  0x25, 0x8F, 0x80, 0x33,
+    0x29, 0xDA, 0x80, 0x3B,  0x2F, 0x40, 0x80, 0x2F,  0x3D, 0x09, 0x80, 0x12,  0x92, 0x7C, 0x40, 0x2F
+};
+
+
+// Code signatures, for finding routines and assembler constants that move from build
+// to build (see RomRoutines.h)
+#define SIG_ANY                 -1          // matches any byte
+
+// Address of the first match of sig at or after from, or zero
+inline UINT16 findSignature (const UCHAR *image, UINT16 from, const int *sig, int length)
+{
+    for (UINT32 addr = from; addr + length <= PROM_BASE + PROM_SIZE; addr++) {
+
+        int i = 0;
+
+        while (i < length && (sig[i] == SIG_ANY || sig[i] == image[addr - PROM_BASE + i]))
+            i++;
+
+        if (i == length)
+            return (UINT16)addr;
+    }
+
+    return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  TuneImage
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+class TuneImage
+{
+public:
+    TuneImage () : image(0), mapBase(0), mapSize(0)
+    {
+        fileName[0] = 0;
+    }
+
+    ~TuneImage ()
+    {
+        close();
+    }
+
+    // Map a PROM image. Returns false (and prints why) if the file can't be used.
+    bool open (const char *path)
+    {
+        size_t size = 0;
+
+        close();
+
+#ifdef _WIN32
+        FILE *fptr = fopen(path, "rb");
+
+        if (!fptr) {
+            printf("Could not open %s\n", path);
+            return false;
+        }
+
+        fseek(fptr, 0, SEEK_END);
+        size = (size_t)ftell(fptr);
+        fseek(fptr, 0, SEEK_SET);
+
+        if (size == PROM_SIZE || size == 2 * PROM_SIZE) {
+            mapBase = new UCHAR[size];
+            if (fread(mapBase, 1, size, fptr) != size) {
+                delete [] (UCHAR *)mapBase;
+                mapBase = 0;
+            }
+        }
+
+        fclose(fptr);
+#else
+        int fd = ::open(path, O_RDONLY);
+        struct stat st;
+
+        if (fd < 0) {
+            printf("Could not open %s\n", path);
+            return false;
+        }
+
+        if (fstat(fd, &st) == 0)
+            size = (size_t)st.st_size;
+
+        if (size == PROM_SIZE || size == 2 * PROM_SIZE) {
+            mapBase = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapBase == MAP_FAILED)
+                mapBase = 0;
+        }
+
+        ::close(fd);                        // the mapping stays valid after close
+#endif
+
+        if (size != PROM_SIZE && size != 2 * PROM_SIZE) {
+            printf("%s is %u bytes (expected a 16K or 32K PROM image)\n", path, (unsigned)size);
+            close();
+            return false;
+        }
+
+        if (!mapBase) {
+            printf("Could not map %s\n", path);
+            close();
+            return false;
+        }
+
+        mapSize = size;
+        image = (const UCHAR *)mapBase + (size - PROM_SIZE);
+
+        const char *base = strrchr(path, '/');
+        const char *base2 = strrchr(path, '\\');
+        if (base2 > base)
+            base = base2;
+        base = base ? base + 1 : path;
+
+        strncpy(fileName, base, sizeof(fileName) - 1);
+        fileName[sizeof(fileName) - 1] = 0;
+
+        return true;
+    }
+
+    // Use a 16K image that is already in memory (not copied, and not freed by close)
+    void attach (const UCHAR *data, const char *name)
+    {
+        close();
+
+        image = data;
+        strncpy(fileName, name, sizeof(fileName) - 1);
+        fileName[sizeof(fileName) - 1] = 0;
+    }
+
+    void close (void)
+    {
+#ifdef _WIN32
+        delete [] (UCHAR *)mapBase;
+#else
+        if (mapBase)
+            munmap(mapBase, mapSize);
+#endif
+        image = 0;
+        mapBase = 0;
+        mapSize = 0;
+        fileName[0] = 0;
+    }
+
+    bool isOpen (void) const            { return image != 0; }
+
+    // file name without the path (e.g. "R3526.bin")
+    const char *name (void) const       { return fileName; }
+
+    // the raw 16K image, starting at $C000
+    const UCHAR *data (void) const      { return image; }
+
+    // pointer to a PROM address ($C000 to $FFFF)
+    const UCHAR *ptr (UINT16 addr) const
+    {
+        return image + (addr - PROM_BASE);
+    }
+
+    UINT8 byteAt (UINT16 addr) const
+    {
+        return image[addr - PROM_BASE];
+    }
+
+    // 16-bit values are stored big endian (MSB first) like all 6800 family data
+    UINT16 wordAt (UINT16 addr) const
+    {
+        const UCHAR *p = ptr(addr);
+        return (UINT16)((p[0] << 8) | p[1]);
+    }
+
+    UINT16 tuneNumber (void) const      { return wordAt(ADDR_TUNE_NUMBER); }
+
+    // the 64 byte RPM table at $C800 (same layout as rpmTable[] in RpmTable.cpp)
+    const UCHAR *rpmTable (void) const  { return ptr(ADDR_RPM_TABLE); }
+
+    // fuel map 0 to 5, the 8 rows x 16 columns map followed by its data structure
+    const UCHAR *fuelMap (int mapNumber) const
+    {
+        if (mapNumber < 0 || mapNumber >= FUEL_MAP_COUNT)
+            return 0;
+        return ptr(fuelMapAddress[mapNumber]);
+    }
+
+    // NAS tunes are locked to map 5, the others default to map 0 until the
+    // tune resistor is read
+    int defaultFuelMap (void) const
+    {
+        return byteAt(ADDR_FUEL_MAP_LOCK) ? 5 : 0;
+    }
+
+    // 16-bit fuel map multiplier (copied to X2008/09)
+    UINT16 mapMultiplier (int mapNumber) const
+    {
+        const UCHAR *p = fuelMap(mapNumber);
+        return p ? (UINT16)((p[FUEL_MAP_MULT_OFFSET] << 8) | p[FUEL_MAP_MULT_OFFSET + 1]) : 0;
+    }
+
+    // value loaded into X200A for the given fuel map
+    UINT8 rowMultiplier (int mapNumber) const
+    {
+        if (mapNumber <= 0 || mapNumber >= FUEL_MAP_COUNT)
+            return byteAt(ADDR_ROW_MULT_RESET);
+        return fuelMap(mapNumber)[FUEL_MAP_ROW_MULT_OFFSET];
+    }
+
+    PromConstants constants (int mapNumber) const
+    {
+        PromConstants k;
+
+        k.XC1C3 = wordAt(ADDR_MAF_OFFSET);
+        k.XC1C5 = wordAt(ADDR_MAF_SUBTRACT);
+        k.XC1C7 = wordAt(ADDR_ROW_OFFSET);
+        k.X200A = rowMultiplier(mapNumber);
+
+        return k;
+    }
+
+private:
+    TuneImage (const TuneImage &);              // not copyable (owns the mapping)
+    TuneImage &operator= (const TuneImage &);
+
+    const UCHAR *image;                         // $C000 within the mapping
+    void        *mapBase;
+    size_t       mapSize;
+    char         fileName[64];
+};
+
+#endif // TUNE_IMAGE_H
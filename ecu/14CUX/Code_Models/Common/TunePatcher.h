@@ -0,0 +1,268 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Tune Patcher
+//
+//  Holds a private copy of a 16K PROM image and patches data bytes in it directly, in place
+//  of the build.bat round trip (crasm, srec2bin and finalize) for edits that only touch the
+//  data section: fuel map cells and multipliers, the RPM table and single constants.
+//
+//  The firmware's PROM test (mainLoop.asm) adds up every byte from $C000 to $FFFF with
+//  'addb' and sets fault code 29 unless the 8-bit sum comes to $01. finalize makes it so by
+//  adjusting the checksum fixer byte at $FFEB. Here the sum is worked out once when the
+//  image is loaded and then kept up to date from the old and new value of each byte that
+//  is patched, so fixChecksum() just moves the fixer by the difference. Nothing else in the
+//  image depends on its contents (the CRC16 at $FFE0 is not used by the code).
+//
+//  Every patch is logged with the byte it replaced, so revert() puts the image back the
+//  way it was at the last checkpoint() (or when loaded) by touching only the patched bytes.
+//  That makes it cheap to build many candidate images from one base: patch, check, write,
+//  revert.
+//
+//  tune() is a TuneImage attached to the patched copy, so the models in this directory
+//  (FuelModel, loadCoolantTables, the firmware in the emulator, ...) can be run against
+//  the patched image straight away. write() saves it as a 16K image, or as a 32K one with
+//  the code stacked twice like finalize does.
+//
+//  Note that the reference R2967_55 image doesn't pass the PROM test as shipped (it sums
+//  to $06). checksumOk() reports that; fixChecksum() will correct it.
+//
+//  A patcher is not thread-safe; give each thread its own.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUNE_PATCHER_H
+#define TUNE_PATCHER_H
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "CuxTypes.h"
+#include "TuneImage.h"
+
+
+#define PROM_CHECKSUM           0x01        // 8-bit sum of $C000 to $FFFF the PROM test wants
+
+
+class TunePatcher
+{
+public:
+    explicit TunePatcher (const TuneImage &source)
+    {
+        load(source.data(), source.name());
+    }
+
+    TunePatcher (const UCHAR *image, const char *name)
+    {
+        load(image, name);
+    }
+
+    // The patched image, for the models
+    const TuneImage &tune (void) const      { return view; }
+    const UCHAR *data (void) const          { return image; }
+
+    UINT8 byteAt (UINT16 addr) const        { return image[addr - PROM_BASE]; }
+
+    UINT16 wordAt (UINT16 addr) const
+    {
+        return (UINT16)((byteAt(addr) << 8) | byteAt((UINT16)(addr + 1)));
+    }
+
+    // 8-bit sum of the whole image, as the PROM test computes it
+    UINT8 checksum (void) const             { return sum; }
+    bool checksumOk (void) const            { return sum == PROM_CHECKSUM; }
+
+    // Same sum the slow way, to check the running one
+    UINT8 fullChecksum (void) const
+    {
+        UINT8 s = 0;
+
+        for (UINT32 i = 0; i < PROM_SIZE; i++)
+            s = (UINT8)(s + image[i]);
+
+        return s;
+    }
+
+    // Bytes patched since the last checkpoint (a byte patched twice counts twice)
+    size_t patchCount (void) const          { return undo.size(); }
+
+
+    ///////////////////////////////////////////////////////////////////////////
+    //
+    //  Patching. The address checks return false (and change nothing) for an
+    //  address outside the image or a map, row or column out of range.
+    //
+    ///////////////////////////////////////////////////////////////////////////
+    bool setByte (UINT16 addr, UINT8 value)
+    {
+        if (addr < PROM_BASE)
+            return false;
+
+        UCHAR &b = image[addr - PROM_BASE];
+
+        if (b != value) {
+            PatchedByte p = { addr, b };
+            undo.push_back(p);
+            sum = (UINT8)(sum - b + value);
+            b = value;
+        }
+
+        return true;
+    }
+
+    // 16-bit values are big endian, as the 6803 reads them
+    bool setWord (UINT16 addr, UINT16 value)
+    {
+        if (addr < PROM_BASE || addr == 0xFFFF)
+            return false;
+
+        setByte(addr, (UINT8)(value >> 8));
+        setByte((UINT16)(addr + 1), (UINT8)value);
+
+        return true;
+    }
+
+    bool setBytes (UINT16 addr, const UCHAR *bytes, size_t count)
+    {
+        if (addr < PROM_BASE || addr - PROM_BASE + count > PROM_SIZE)
+            return false;
+
+        for (size_t i = 0; i < count; i++)
+            setByte((UINT16)(addr + i), bytes[i]);
+
+        return true;
+    }
+
+    bool setFuelCell (int mapNumber, int row, int col, UINT8 value)
+    {
+        if (mapNumber < 0 || mapNumber >= FUEL_MAP_COUNT || row < 0 || row >= FUEL_MAP_ROWS ||
+            col < 0 || col >= FUEL_MAP_COLS)
+            return false;
+
+        return setByte((UINT16)(fuelMapAddress[mapNumber] + row * FUEL_MAP_COLS + col), value);
+    }
+
+    // Multiply every cell of a fuel map by percent / 100 (rounded, clamped to $FF)
+    bool scaleFuelMap (int mapNumber, double percent)
+    {
+        if (mapNumber < 0 || mapNumber >= FUEL_MAP_COUNT || percent < 0.0)
+            return false;
+
+        for (int i = 0; i < FUEL_MAP_SIZE; i++) {
+            UINT16 addr = (UINT16)(fuelMapAddress[mapNumber] + i);
+            double v = byteAt(addr) * percent / 100.0 + 0.5;
+            setByte(addr, (UINT8)(v < 255.0 ? v : 255.0));
+        }
+
+        return true;
+    }
+
+    // The 16-bit multiplier follows the map itself (map 0 doesn't have one)
+    bool setMapMultiplier (int mapNumber, UINT16 value)
+    {
+        if (mapNumber <= 0 || mapNumber >= FUEL_MAP_COUNT)
+            return false;
+
+        return setWord((UINT16)(fuelMapAddress[mapNumber] + FUEL_MAP_MULT_OFFSET), value);
+    }
+
+    // One RPM table row: 16-bit period entry, control byte and multiplier
+    bool setRpmRow (int row, UINT16 period, UINT8 control, UINT8 multiplier)
+    {
+        if (row < 0 || row >= RPM_TABLE_SIZE / 4)
+            return false;
+
+        UINT16 addr = (UINT16)(ADDR_RPM_TABLE + row * 4);
+
+        setWord(addr, period);
+        setByte((UINT16)(addr + 2), control);
+        setByte((UINT16)(addr + 3), multiplier);
+
+        return true;
+    }
+
+    bool setRpmTable (const UCHAR *table)
+    {
+        return setBytes(ADDR_RPM_TABLE, table, RPM_TABLE_SIZE);
+    }
+
+    // Move the fixer byte so the image sums to PROM_CHECKSUM. (The fixer change is
+    // logged like any other patch, so revert() undoes it too.)
+    void fixChecksum (void)
+    {
+        setByte(ADDR_CHECKSUM_FIXER, (UINT8)(byteAt(ADDR_CHECKSUM_FIXER) + PROM_CHECKSUM - sum));
+    }
+
+
+    ///////////////////////////////////////////////////////////////////////////
+    //
+    //  Undo
+    //
+    ///////////////////////////////////////////////////////////////////////////
+
+    // Make the image as it is now the one revert() goes back to
+    void checkpoint (void)
+    {
+        undo.clear();
+    }
+
+    void revert (void)
+    {
+        for (size_t i = undo.size(); i-- > 0; ) {
+            UCHAR &b = image[undo[i].addr - PROM_BASE];
+            sum = (UINT8)(sum - b + undo[i].old);
+            b = undo[i].old;
+        }
+
+        undo.clear();
+    }
+
+
+    // Save as a 16K image, or 32K with the code stacked twice (as finalize does)
+    bool write (const char *path, bool stacked = false) const
+    {
+        FILE *fptr = fopen(path, "wb");
+
+        if (!fptr) {
+            printf("Could not open %s for writing\n", path);
+            return false;
+        }
+
+        bool ok = fwrite(image, 1, PROM_SIZE, fptr) == PROM_SIZE;
+
+        if (ok && stacked)
+            ok = fwrite(image, 1, PROM_SIZE, fptr) == PROM_SIZE;
+
+        if (fclose(fptr) != 0)
+            ok = false;
+
+        if (!ok)
+            printf("Could not write %s\n", path);
+
+        return ok;
+    }
+
+private:
+    TunePatcher (const TunePatcher &);          // not copyable (the view points at image)
+    TunePatcher &operator= (const TunePatcher &);
+
+    void load (const UCHAR *source, const char *name)
+    {
+        memcpy(image, source, PROM_SIZE);
+        sum = fullChecksum();
+        view.attach(image, name);
+    }
+
+    struct PatchedByte
+    {
+        UINT16  addr;
+        UCHAR   old;
+    };
+
+    UCHAR       image[PROM_SIZE];
+    UINT8       sum;
+    std::vector<PatchedByte> undo;
+    TuneImage   view;
+};
+
+#endif // TUNE_PATCHER_H
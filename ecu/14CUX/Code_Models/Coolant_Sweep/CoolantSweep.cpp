@@ -0,0 +1,436 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Coolant and Cold Start Fueling Sweep
+//
+//  Runs the coolant temperature and cranking fueling models (../Common/CoolantFueling.h)
+//  over every coolant sensor count and a cranking RPM axis for a set of PROM images, so the
+//  cold start behaviour of the whole tune family can be compared in one go. The cold
+//  weather chip (R3652) is the interesting one: it has its own cranking table, a larger
+//  'wicked cold' factor ($12) and takes the engine as started at 375 RPM rather than 505.
+//
+//  By default the ten reference images are used (the same list as BatchCompare), one
+//  worker thread per tune. Each tune is swept with the batched SSE2 version
+//  (../Common/CoolantSweep.h) and then checked, over every input:
+//
+//      SIMD        the batched sweep against the scalar (C) version
+//      Literal     the literal _6803 translations against the C versions, for every
+//                  fuel map, every count, every filtered period MSB and a few throttle
+//                  positions for the cranking fuel
+//      ROM         the same inputs through the firmware itself in the 6803 emulator
+//                  (../Common/RomRoutines.h), skipped with -nocheck
+//
+//  The sweep is written as two tab delimited files with the tune name as the first column:
+//
+//      coolantSweep.txt    per count: coolantTempAdjust, X009B, X009C, accelerator pump
+//                          pulse, the compensation factor just after the start and once
+//                          warm, and the enrichment both give over a warm engine (%)
+//      crankingSweep.txt   per count and RPM: the cranking fuel value handed to Phase II
+//                          (0 where the engine counts as running)
+//
+//  The temperatures are from the approximate sensor curve in CoolantFueling.h.
+//
+//  Usage: CoolantSweep [-dir <bin directory>] [-map <n>] [-tps <count>] [-nocheck] [image ...]
+//
+//      -dir    directory holding the reference images (default ../../OriginalCode/Reference_Bins)
+//      -map    fuel map to use for every tune (default is each tune's own default map)
+//      -tps    throttle pot reading while cranking (default 0, closed)
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/ReferenceTunes.h"
+#include "../Common/CoolantFueling.h"
+#include "../Common/CoolantSweep.h"
+#include "../Common/Emulator6803.h"
+#include "../Common/RomRoutines.h"
+
+
+#define RPM_FIRST           60          // cranking RPM axis
+#define RPM_LAST            600
+#define RPM_STEP            20
+#define SWEEP_REPEAT        1000        // for the timing
+#define WARM_TEMP           85.0        // deg C, the enrichment is relative to this
+#define CRANK_SHOW_RPM      150
+#define CRANK_SHOW_TEMP     -18.0
+
+
+static const double summaryTemp[] = { -18.0, 0.0, 20.0, 40.0, 60.0, 85.0 };
+#define SUMMARY_TEMPS       (int)(sizeof(summaryTemp) / sizeof(summaryTemp[0]))
+
+// Cranking fuel is checked at these throttle readings (below, at and above $70)
+static const UINT16 checkThrottle[] = { 0x0000, 0x006F, 0x0070, 0x0100, 0x0240, 0x03FF };
+#define CHECK_THROTTLES     (int)(sizeof(checkThrottle) / sizeof(checkThrottle[0]))
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Results for one tune. Each worker thread fills in one of these. (The
+//  table pointers in 'tables' are only valid inside runTune.)
+//
+///////////////////////////////////////////////////////////////////////////////
+struct TuneResult
+{
+    std::string     path;
+    char            name[64];
+    bool            ok;
+    UINT16          tuneNumber;
+    int             mapNumber;
+    CoolantTables   tables;
+    bool            constantsFound;
+    CoolantSweep    sweep;
+    double          sweepUs;                // one batched sweep
+
+    UINT64          checks;
+    UINT32          simdMismatches;
+    UINT32          literalMismatches;
+    bool            romFound;
+    UINT32          romMismatches;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Checks
+//
+///////////////////////////////////////////////////////////////////////////////
+static UINT32 compareSweeps (const CoolantSweep &a, const CoolantSweep &b)
+{
+    UINT32 diffs = 0;
+
+    for (int i = 0; i < ECT_COUNTS; i++)
+        if (a.coolantAdjust[i] != b.coolantAdjust[i] || a.X009B[i] != b.X009B[i] ||
+            a.X009C[i] != b.X009C[i] || a.accelPump[i] != b.accelPump[i] ||
+            a.startComp[i] != b.startComp[i] || a.warmComp[i] != b.warmComp[i])
+            diffs++;
+
+    for (size_t i = 0; i < a.crankFuel.size(); i++)
+        if (a.crankFuel[i] != b.crankFuel[i])
+            diffs++;
+
+    return diffs;
+}
+
+// Literal models against the C versions and, if rom is given, against the firmware
+static void checkModels (TuneResult *result, const TuneImage &tune, Emulator6803 *emu,
+                         const RomCoolantRoutines &rom)
+{
+    Cpu6803 cpu;
+
+    for (int map = 0; map < FUEL_MAP_COUNT; map++) {
+
+        CoolantTables t;
+        loadCoolantTables(tune, map, t);
+
+        for (int count = 0; count < ECT_COUNTS; count++) {
+
+            UINT8 ect = (UINT8)count;
+            UINT8 adjust = coolantTempAdjust_6803(cpu, ect, t);
+            UINT16 pump = accelPump_6803(cpu, ect, t);
+            UINT8 x9b, x9c, cx9b, cx9c;
+
+            crankingInit_6803(cpu, ect, t, x9b, x9c);
+            crankingInit_C(ect, t, cx9b, cx9c);
+
+            result->checks += 3;
+
+            if (adjust != coolantTempAdjust_C(ect, t) || pump != accelPump_C(ect, t) ||
+                x9b != cx9b || x9c != cx9c)
+                result->literalMismatches++;
+
+            if (emu) {
+                UINT8 rx9b, rx9c;
+                bool ok = romCrankingInit(*emu, rom, ect, map, rx9b, rx9c);
+
+                if (adjust != romCoolantTempAdjust(*emu, rom, ect, map) ||
+                    pump != romAccelPump(*emu, rom, ect) || !ok || x9b != rx9b || x9c != rx9c)
+                    result->romMismatches++;
+            }
+
+            for (int msb = 0; msb < 256; msb++)
+                for (int tp = 0; tp < CHECK_THROTTLES; tp++) {
+
+                    UINT8 a6 = 0, ra6 = 0;
+                    UINT16 fuel = crankingFuel_6803(cpu, ect, (UINT8)msb, checkThrottle[tp], x9b, t, &a6);
+
+                    result->checks++;
+
+                    if (fuel != crankingFuel_C(ect, (UINT8)msb, checkThrottle[tp], x9b, t))
+                        result->literalMismatches++;
+
+                    if (emu && (fuel != romCrankingFuel(*emu, rom, ect, (UINT8)msb, checkThrottle[tp], x9b,
+                                                        map, &ra6) || a6 != ra6))
+                        result->romMismatches++;
+                }
+        }
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  runTune
+//
+//  Worker thread. Maps the image, sweeps the selected fuel map and checks
+//  the models.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void runTune (TuneResult *result, int forcedMap, UINT16 throttlePot, bool check)
+{
+    TuneImage tune;
+    CoolantSweepAxes axes;
+    CoolantSweep scalar;
+
+    result->ok = tune.open(result->path.c_str());
+
+    if (!result->ok)
+        return;
+
+    strcpy(result->name, tune.name());
+    result->tuneNumber = tune.tuneNumber();
+    result->mapNumber = (forcedMap >= 0) ? forcedMap : tune.defaultFuelMap();
+    result->constantsFound = loadCoolantTables(tune, result->mapNumber, result->tables);
+
+    for (UINT16 rpm = RPM_FIRST; rpm <= RPM_LAST; rpm += RPM_STEP)
+        axes.rpm.push_back(rpm);
+    axes.throttlePot = throttlePot;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < SWEEP_REPEAT; i++)
+        sweepCoolant(result->tables, axes, result->sweep);
+
+    result->sweepUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count()
+                      / SWEEP_REPEAT;
+
+    sweepCoolant(result->tables, axes, scalar, false);
+    result->simdMismatches = compareSweeps(result->sweep, scalar);
+
+    if (!check)
+        return;
+
+    RomCoolantRoutines rom;
+    Emulator6803 *emu = 0;
+
+    result->romFound = findRomCoolantRoutines(tune.data(), rom);
+
+    if (result->romFound) {
+        emu = new Emulator6803;
+        loadRomCoolantRoutines(*emu, tune.data(), rom);
+    }
+
+    checkModels(result, tune, emu, rom);
+
+    delete emu;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Output files
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Extra fuel over a warm engine, in percent
+static double enrichment (const CoolantSweep &s, UINT16 comp)
+{
+    UINT16 warm = s.warmComp[ectCountForTemp(WARM_TEMP)];
+
+    return warm ? 100.0 * comp / warm - 100.0 : 0.0;
+}
+
+static void writeCoolantFile (const char *fileName, const std::vector<TuneResult *> &results)
+{
+    FILE *fptr = fopen(fileName, "w");
+
+    if (!fptr) {
+        printf("Could not open %s for writing\n", fileName);
+        return;
+    }
+
+    fprintf(fptr, "Tune\tMap\tECT\tTemp C\tcoolantAdj\tX009B\tX009C\tAccel us\tStart comp\tWarm comp\t"
+                  "Start %%\tWarm %%\n");
+
+    for (size_t t = 0; t < results.size(); t++) {
+
+        const TuneResult *r = results[t];
+        const CoolantSweep &s = r->sweep;
+
+        if (!r->ok)
+            continue;
+
+        for (int count = 0; count < ECT_COUNTS; count++)
+            fprintf(fptr, "%s\t%d\t0x%02X\t%.1f\t0x%02X\t0x%02X\t%u\t%u\t0x%04X\t0x%04X\t%.1f\t%.1f\n",
+              r->name, r->mapNumber, count, ectTempForCount((UINT8)count), s.coolantAdjust[count],
+              s.X009B[count], s.X009C[count], s.accelPump[count], s.startComp[count], s.warmComp[count],
+              enrichment(s, s.startComp[count]), enrichment(s, s.warmComp[count]));
+    }
+
+    fclose(fptr);
+}
+
+static void writeCrankingFile (const char *fileName, const std::vector<TuneResult *> &results)
+{
+    FILE *fptr = fopen(fileName, "w");
+
+    if (!fptr) {
+        printf("Could not open %s for writing\n", fileName);
+        return;
+    }
+
+    fprintf(fptr, "Tune\tMap\tECT\tTemp C\tRPM\tPeriod MSB\tCranking fuel\n");
+
+    for (size_t t = 0; t < results.size(); t++) {
+
+        const TuneResult *r = results[t];
+        const CoolantSweep &s = r->sweep;
+
+        if (!r->ok)
+            continue;
+
+        for (int count = 0; count < ECT_COUNTS; count++)
+            for (size_t i = 0; i < s.periodMsb.size(); i++)
+                fprintf(fptr, "%s\t%d\t0x%02X\t%.1f\t%u\t0x%02X\t%u\n", r->name, r->mapNumber, count,
+                  ectTempForCount((UINT8)count), RPM_FIRST + (unsigned)i * RPM_STEP, s.periodMsb[i],
+                  s.cranking(count, i));
+    }
+
+    fclose(fptr);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  printSummary
+//
+///////////////////////////////////////////////////////////////////////////////
+static void printSummary (const std::vector<TuneResult *> &results, bool check)
+{
+    printf("\nEnrichment over a warm engine just after starting (%%), cranking fuel at %d RPM and %.0f C\n\n",
+      CRANK_SHOW_RPM, CRANK_SHOW_TEMP);
+    printf("Tune           Map  Start  Cold ");
+    for (int i = 0; i < SUMMARY_TEMPS; i++)
+        printf("  %4.0f C", summaryTemp[i]);
+    printf("   Crank   Sweep us   SIMD  Literal    ROM\n");
+    printf("----------------------------------------------------------------------------------------"
+           "-----------------------\n");
+
+    for (size_t t = 0; t < results.size(); t++) {
+
+        const TuneResult *r = results[t];
+        const CoolantSweep &s = r->sweep;
+
+        if (!r->ok) {
+            printf("%-14s (could not be loaded)\n", r->path.c_str());
+            continue;
+        }
+
+        printf("%-14s  %d  %5.0f   $%02X%s", r->name, r->mapNumber,
+          SWEEP_RPM_TO_PERIOD / (r->tables.engStartPeriodMsb << 8), r->tables.coldStartupFactor,
+          r->constantsFound ? " " : "?");
+
+        for (int i = 0; i < SUMMARY_TEMPS; i++)
+            printf("  %6.1f", enrichment(s, s.startComp[ectCountForTemp(summaryTemp[i])]));
+
+        size_t crankPoint = (CRANK_SHOW_RPM - RPM_FIRST) / RPM_STEP;
+
+        printf("  %6u  %9.2f  %5s", s.cranking(ectCountForTemp(CRANK_SHOW_TEMP), crankPoint), r->sweepUs,
+          r->simdMismatches ? "FAIL" : "ok");
+
+        if (check)
+            printf("  %7s  %5s", r->literalMismatches ? "FAIL" : "ok",
+              !r->romFound ? "n/a" : r->romMismatches ? "FAIL" : "ok");
+
+        printf("\n");
+    }
+
+    if (check) {
+        UINT64 checks = 0;
+        UINT32 literal = 0, rom = 0;
+
+        for (size_t t = 0; t < results.size(); t++) {
+            checks += results[t]->checks;
+            literal += results[t]->literalMismatches;
+            rom += results[t]->romMismatches;
+        }
+
+        printf("\n%llu points checked, %u literal and %u firmware mismatches\n",
+          (unsigned long long)checks, literal, rom);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    std::string dir = REFERENCE_BIN_DIR;
+    std::vector<std::string> paths;
+    std::vector<TuneResult *> results;
+    std::vector<std::thread> workers;
+    int forcedMap = -1;
+    UINT16 throttlePot = 0;
+    bool check = true;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-dir") == 0 && arg + 1 < argc)
+            dir = argv[++arg];
+        else if (strcmp(argv[arg], "-map") == 0 && arg + 1 < argc)
+            forcedMap = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-tps") == 0 && arg + 1 < argc)
+            throttlePot = (UINT16)strtol(argv[++arg], 0, 0);
+        else if (strcmp(argv[arg], "-nocheck") == 0)
+            check = false;
+        else if (argv[arg][0] == '-') {
+            printf("Usage: CoolantSweep [-dir <bin directory>] [-map <n>] [-tps <count>] [-nocheck] [image ...]\n");
+            return 1;
+        }
+        else
+            paths.push_back(argv[arg]);
+    }
+
+    if (paths.empty())
+        for (int i = 0; i < REFERENCE_TUNE_COUNT; i++)
+            paths.push_back(dir + "/" + referenceTunes[i]);
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        TuneResult *r = new TuneResult;
+        r->path = paths[i];
+        r->ok = false;
+        r->name[0] = 0;
+        r->checks = 0;
+        r->simdMismatches = r->literalMismatches = r->romMismatches = 0;
+        r->romFound = false;
+        results.push_back(r);
+        workers.push_back(std::thread(runTune, r, forcedMap, throttlePot, check));
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    writeCoolantFile("coolantSweep.txt", results);
+    writeCrankingFile("crankingSweep.txt", results);
+    printSummary(results, check);
+
+    bool failed = false;
+
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i]->ok && (results[i]->simdMismatches || results[i]->literalMismatches ||
+                               results[i]->romMismatches))
+            failed = true;
+        delete results[i];
+    }
+
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,382 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Firmware Check
+//
+//  Runs the real firmware routines from a PROM image in the 6803 emulator
+//  (../Common/Emulator6803.h, ../Common/RomRoutines.h) and compares them with the C models
+//  over their whole input domain:
+//
+//      .linearizeMaf   every MAF sum (0 to 2046)           linearizeMAF_6803, linearizeMAF_C
+//      row index       every ignition period for every     Calculate_Row_Index, rowIndex_Scalar
+//                      linearized MAF value the ECU can
+//                      produce (every 16th period unless
+//                      -full is given)
+//      .LEADB          every ignition period               getColumnIndex
+//      mpy16           random operands                     mpy16_6803, mpy16_C
+//
+//  The mismatches are counted and the first few listed. Nothing here changes the models;
+//  a mismatch means the model (or the emulator) needs a closer look. Two comparisons are
+//  known to differ and are listed but not counted: mpy16 against the exact top 16 bits of
+//  the product (mpy16 drops the low x low term) and linearizeMAF_C, which is the plain C
+//  reading of the squaring loop and is kept as it was written.
+//
+//  It also reports the cycles each piece takes in the ECU (1 cycle = 1 us), minimum,
+//  maximum and mean, and the worst case for the three pieces together, which is their
+//  share of the spark interrupt's budget for that tune.
+//
+//  Usage: FirmwareCheck [-map <n>] [-full] [-threads <n>] [image ...]
+//
+//      image   PROM images (default ../../OriginalCode/Reference_Bins/R3526.bin)
+//      -map    fuel map for the row multiplier (default is each tune's default map)
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/Emulator6803.h"
+#include "../Common/RomRoutines.h"
+#include "../Common/MafRowIndex.h"
+#include "../Common/RpmColumnIndex.h"
+#include "../Common/FuelSurface.h"
+#include "../Common/Random.h"
+
+
+#define MAF_SUM_COUNT       2047        // 0 to 2046
+#define MPY16_SAMPLES       1000000
+#define SHOW_MISMATCHES     3
+
+
+struct CycleStats
+{
+    UINT32  min;
+    UINT32  max;
+    UINT64  total;
+    UINT64  count;
+
+    CycleStats () : min(0xFFFFFFFF), max(0), total(0), count(0) {}
+
+    void add (UINT32 cycles)
+    {
+        if (cycles < min)
+            min = cycles;
+        if (cycles > max)
+            max = cycles;
+        total += cycles;
+        count++;
+    }
+
+    void merge (const CycleStats &other)
+    {
+        if (other.min < min)
+            min = other.min;
+        if (other.max > max)
+            max = other.max;
+        total += other.total;
+        count += other.count;
+    }
+};
+
+struct Mismatch
+{
+    UINT32  input1;
+    UINT32  input2;
+    UINT32  rom;
+    UINT32  model;
+};
+
+// mismatch count against one model, keeping the first few
+struct MismatchList
+{
+    UINT64  count;
+    std::vector<Mismatch> first;
+
+    MismatchList () : count(0) {}
+
+    void add (UINT32 input1, UINT32 input2, UINT32 rom, UINT32 model)
+    {
+        count++;
+        if (first.size() < SHOW_MISMATCHES) {
+            Mismatch m = { input1, input2, rom, model };
+            first.push_back(m);
+        }
+    }
+
+    void merge (const MismatchList &other)
+    {
+        count += other.count;
+        for (size_t i = 0; i < other.first.size() && first.size() < SHOW_MISMATCHES; i++)
+            first.push_back(other.first[i]);
+    }
+};
+
+
+static void report (const char *what, const MismatchList &list, UINT64 checked, const char *inputs)
+{
+    printf("  %-34s %10llu mismatches in %llu\n", what, (unsigned long long)list.count,
+      (unsigned long long)checked);
+
+    for (size_t i = 0; i < list.first.size(); i++)
+        printf("      %s 0x%04X 0x%04X: firmware 0x%04X, model 0x%04X\n", inputs,
+          list.first[i].input1, list.first[i].input2, list.first[i].rom, list.first[i].model);
+}
+
+static void reportCycles (const char *what, const CycleStats &stats)
+{
+    printf("  %-16s %5u min %5u max %7.1f mean cycles\n", what, stats.min, stats.max,
+      stats.count ? (double)stats.total / stats.count : 0.0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Row index worker: every period for a share of the linearized MAF values
+//
+///////////////////////////////////////////////////////////////////////////////
+struct RowWork
+{
+    MismatchList    model;
+    MismatchList    scalar;
+    CycleStats      cycles;
+    UINT64          checked;
+};
+
+static void rowIndexWorker (const UCHAR *image, const RomRoutines *r, const std::vector<UINT16> *linearMAF,
+                            PromConstants prom, UINT32 periodStep, unsigned first, unsigned step,
+                            RowWork *work)
+{
+    Emulator6803 emu;
+    Cpu6803 cpu;
+
+    loadRomRoutines(emu, image, *r);
+    work->checked = 0;
+
+    for (size_t i = first; i < linearMAF->size(); i += step) {
+
+        UINT16 lin = (*linearMAF)[i];
+
+        for (UINT32 period = 0; period < 0x10000; period += periodStep) {
+            UINT32 cycles;
+            UINT8 rom = romRowIndex(emu, *r, (UINT16)period, lin, prom.X200A, &cycles);
+            UINT8 model = Calculate_Row_Index(cpu, (UINT16)period, lin, prom);
+            UINT8 scalar = rowIndex_Scalar((UINT16)period, lin, prom);
+
+            if (model != rom)
+                work->model.add(period, lin, rom, model);
+            if (scalar != rom)
+                work->scalar.add(period, lin, rom, scalar);
+
+            work->cycles.add(cycles);
+            work->checked++;
+        }
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  One tune
+//
+///////////////////////////////////////////////////////////////////////////////
+static UINT64 checkTune (const TuneImage &tune, int mapNumber, bool full, unsigned threadCount)
+{
+    const UCHAR *image = tune.data();
+    RomRoutines r;
+
+    if (mapNumber < 0 || mapNumber >= FUEL_MAP_COUNT)
+        mapNumber = tune.defaultFuelMap();
+
+    printf("\n%s (tune %04X) fuel map %d\n", tune.name(), tune.tuneNumber(), mapNumber);
+
+    if (!findRomRoutines(image, r)) {
+        printf("  the routines could not be found in this image\n");
+        return 1;
+    }
+
+    printf("  mpy16 $%04X, .linearizeMaf $%04X-$%04X, row index $%04X-$%04X, .LEADB $%04X-$%04X/$%04X\n",
+      r.mpy16, r.linearizeMaf, r.linearizeMafEnd, r.rowIndex, r.rowIndexEnd,
+      r.columnIndex, r.columnIndexEnd, r.columnIndexOut);
+
+    PromConstants prom = tune.constants(mapNumber);
+    Emulator6803 emu;
+    Cpu6803 cpu;
+    UINT64 mismatches = 0;
+    UINT64 runs = 0;
+
+    loadRomRoutines(emu, image, r);
+
+    auto start = std::chrono::steady_clock::now();
+
+    // mpy16 against the models and the exact product (xorshift operands)
+    MismatchList mpy, mpy6803, mpyC;
+    CycleStats mpyCycles;
+    XorShift rng(0x14C0);
+
+    for (UINT32 i = 0; i < MPY16_SAMPLES; i++) {
+        UINT32 operands = rng.next();
+        UINT16 d = (UINT16)operands, m = (UINT16)(operands >> 16);
+        UINT32 cycles;
+        UINT16 rom = romMpy16(emu, r, d, m, &cycles);
+        UINT16 exact = (UINT16)(((UINT32)d * m) >> 16);
+        cpu.reg.ab = d;
+        UINT16 model = mpy16_6803(cpu, m);
+        UINT16 modelC = mpy16_C(d, m);
+
+        if (model != rom)
+            mpy6803.add(d, m, rom, model);
+        if (modelC != rom)
+            mpyC.add(d, m, rom, modelC);
+        if (rom != exact)
+            mpy.add(d, m, rom, exact);
+        mpyCycles.add(cycles);
+    }
+    runs += MPY16_SAMPLES;
+
+    // MAF linearization, every MAF sum
+    MismatchList lin6803, linC;
+    CycleStats linCycles;
+    std::vector<bool> seen(0x10000, false);
+    std::vector<UINT16> linearMAF;
+
+    for (UINT16 mafSum = 0; mafSum < MAF_SUM_COUNT; mafSum++) {
+        UINT32 cycles;
+        UINT16 rom = romLinearizeMAF(emu, r, mafSum, &cycles);
+        UINT16 model = linearizeMAF_6803(cpu, mafSum, prom);
+        UINT16 modelC = linearizeMAF_C(mafSum, prom);
+
+        if (model != rom)
+            lin6803.add(mafSum, 0, rom, model);
+        if (modelC != rom)
+            linC.add(mafSum, 0, rom, modelC);
+        linCycles.add(cycles);
+
+        if (!seen[rom]) {
+            seen[rom] = true;
+            linearMAF.push_back(rom);
+        }
+    }
+    runs += MAF_SUM_COUNT;
+
+    // column index, every period
+    MismatchList column;
+    CycleStats columnCycles;
+
+    for (UINT32 period = 0; period < 0x10000; period++) {
+        UINT32 cycles;
+        UCHAR romBracket = 0, modelBracket = 0;
+        UCHAR rom = romColumnIndex(emu, r, (UINT16)period, &romBracket, &cycles);
+        UCHAR model = getColumnIndex(cpu, (UINT16)period, &modelBracket, tune.rpmTable());
+
+        if (rom != model || romBracket != modelBracket)
+            column.add(period, 0, (romBracket << 8) | rom, (modelBracket << 8) | model);
+        columnCycles.add(cycles);
+    }
+    runs += 0x10000;
+
+    // row index, spread over the threads
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+        threadCount = 1;
+
+    std::vector<RowWork> work(threadCount);
+    std::vector<std::thread> workers;
+    UINT32 periodStep = full ? 1 : 16;
+
+    for (unsigned t = 0; t < threadCount; t++)
+        workers.push_back(std::thread(rowIndexWorker, image, &r, &linearMAF, prom, periodStep,
+                                      t, threadCount, &work[t]));
+
+    RowWork rows;
+    rows.checked = 0;
+
+    for (unsigned t = 0; t < threadCount; t++) {
+        workers[t].join();
+        rows.model.merge(work[t].model);
+        rows.scalar.merge(work[t].scalar);
+        rows.cycles.merge(work[t].cycles);
+        rows.checked += work[t].checked;
+    }
+    runs += rows.checked;
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    report("mpy16 vs mpy16_6803", mpy6803, MPY16_SAMPLES, "D, X00CA");
+    report("mpy16 vs mpy16_C", mpyC, MPY16_SAMPLES, "D, X00CA");
+    report(".linearizeMaf vs linearizeMAF_6803", lin6803, MAF_SUM_COUNT, "mafSum");
+    report("row index vs Calculate_Row_Index", rows.model, rows.checked, "period, linearMAF");
+    report("row index vs rowIndex_Scalar", rows.scalar, rows.checked, "period, linearMAF");
+    report(".LEADB vs getColumnIndex", column, 0x10000, "period");
+    printf("  expected to differ:\n");
+    report("mpy16 vs exact product", mpy, MPY16_SAMPLES, "D, X00CA");
+    report(".linearizeMaf vs linearizeMAF_C", linC, MAF_SUM_COUNT, "mafSum");
+
+    printf("  (%u distinct linearized MAF values, every %u%s period)\n", (UINT32)linearMAF.size(),
+      periodStep, (periodStep == 1) ? "" : "th");
+
+    reportCycles("mpy16", mpyCycles);
+    reportCycles(".linearizeMaf", linCycles);
+    reportCycles("row index", rows.cycles);
+    reportCycles(".LEADB", columnCycles);
+
+    printf("  worst case for .linearizeMaf + row index + .LEADB: %u us\n",
+      linCycles.max + rows.cycles.max + columnCycles.max);
+    printf("  %llu routine runs in %.2f s (%.1f M/s on %u threads)\n", (unsigned long long)runs,
+      seconds, runs / seconds / 1e6, threadCount);
+
+    mismatches += mpy6803.count + mpyC.count + lin6803.count + rows.model.count + rows.scalar.count +
+                  column.count;
+
+    return mismatches;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    std::vector<const char *> images;
+    int mapNumber = -1;
+    bool full = false;
+    unsigned threads = 0;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-map") == 0 && arg + 1 < argc)
+            mapNumber = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-full") == 0)
+            full = true;
+        else if (strcmp(argv[arg], "-threads") == 0 && arg + 1 < argc)
+            threads = (unsigned)atoi(argv[++arg]);
+        else if (argv[arg][0] == '-') {
+            printf("Usage: FirmwareCheck [-map <n>] [-full] [-threads <n>] [image ...]\n");
+            return 1;
+        }
+        else
+            images.push_back(argv[arg]);
+    }
+
+    if (images.empty())
+        images.push_back("../../OriginalCode/Reference_Bins/R3526.bin");
+
+    UINT64 mismatches = 0;
+
+    for (size_t i = 0; i < images.size(); i++) {
+        TuneImage tune;
+        if (!tune.open(images[i]))
+            return 1;
+        mismatches += checkTune(tune, mapNumber, full, threads);
+    }
+
+    printf("\n%llu mismatches in all\n", (unsigned long long)mismatches);
+
+    return mismatches ? 2 : 0;
+}
@@ -0,0 +1,189 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Fuel Map Interpolation and Fueling Surface
+//
+//  Runs the fused fueling model (../Common/FuelSurface.h) over a grid of MAF sums and
+//  engine speeds for one tune and fuel map, giving the uncompensated fuel map value the
+//  ECU would look up at each point. This is the surface to tune against.
+//
+//  The grid is every MAF sum (0 to 2046) against an RPM range, by default 500 to 6500 RPM
+//  in 25 RPM steps. It is written as a binary result file (../Common/ResultFile.h) with an
+//  rpm axis and a mafSum axis and two columns, rowIndex (fuelMapLoadIdx) and fuelValue.
+//  Use ../Result_Tools/ResultToText to get a tab delimited version.
+//
+//  Run with "-verify" to check the fused model against the literal models: every row and
+//  column index through fuelMapValue_6803 for each of the six fuel maps, then every point
+//  of the surface through linearizeMAF_6803, Calculate_Row_Index, getColumnIndex and
+//  fuelMapValue_6803.
+//
+//  Usage: FuelMapModel [-tune <bin>] [-map <n>] [-rpm <first> <last> <step>] [-verify] [output]
+//
+//      -tune   PROM image (default ../../OriginalCode/Reference_Bins/R3526.bin)
+//      -map    fuel map (default is the tune's default map)
+//      output  result file name (default fuelSurface.bin)
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/MafRowIndex.h"
+#include "../Common/RpmColumnIndex.h"
+#include "../Common/FuelMapValue.h"
+#include "../Common/FuelSurface.h"
+#include "../Common/ResultFile.h"
+
+
+#define MAF_SUM_COUNT       2047        // 0 to 2046
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Checks against the literal models
+//
+///////////////////////////////////////////////////////////////////////////////
+static UINT32 verifyInterpolation (const TuneImage &tune)
+{
+    Cpu6803 cpu;
+    UINT32 mismatches = 0;
+
+    for (int mapNumber = 0; mapNumber < FUEL_MAP_COUNT; mapNumber++) {
+
+        const UCHAR *map = tune.fuelMap(mapNumber);
+        UINT32 mapMismatches = 0;
+
+        for (int row = 0; row < ROW_INDEX_COUNT; row++)
+            for (int col = 0; col < 256; col++)
+                if (fuelMapValue_C((UINT8)row, (UCHAR)col, map) !=
+                    fuelMapValue_6803(cpu, (UINT8)row, (UCHAR)col, map))
+                    mapMismatches++;
+
+        printf("Fuel map %d interpolation: %u mismatches in %u points\n",
+          mapNumber, mapMismatches, ROW_INDEX_COUNT * 256);
+
+        mismatches += mapMismatches;
+    }
+
+    return mismatches;
+}
+
+
+static UINT32 verifySurface (const TuneImage &tune, int mapNumber, const std::vector<UINT16> &period,
+                             const std::vector<UINT16> &fuel, const std::vector<UINT8> &rowIndex)
+{
+    Cpu6803 cpu;
+    PromConstants prom = tune.constants(mapNumber);
+    UINT32 mismatches = 0;
+
+    for (size_t p = 0; p < period.size(); p++) {
+
+        UCHAR bracket = 0;
+        UCHAR colIndex = getColumnIndex(cpu, period[p], &bracket, tune.rpmTable());
+
+        for (UINT16 mafSum = 0; mafSum < MAF_SUM_COUNT; mafSum++) {
+
+            UINT16 linearMAF = linearizeMAF_6803(cpu, mafSum, prom);
+            UINT8 row = Calculate_Row_Index(cpu, period[p], linearMAF, prom);
+            UINT16 value = fuelMapValue_6803(cpu, row, colIndex, tune.fuelMap(mapNumber));
+            size_t i = p * MAF_SUM_COUNT + mafSum;
+
+            if (row != rowIndex[i] || value != fuel[i])
+                mismatches++;
+        }
+    }
+
+    printf("Surface: %u mismatches in %u points\n", mismatches, (UINT32)fuel.size());
+
+    return mismatches;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    TuneImage tune;
+    const char *tuneName = "../../OriginalCode/Reference_Bins/R3526.bin";
+    const char *outName = "fuelSurface.bin";
+    int mapNumber = -1;
+    UINT32 rpmFirst = 500, rpmLast = 6500, rpmStep = 25;
+    bool verify = false;
+    bool badArg = false;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-tune") == 0 && arg + 1 < argc)
+            tuneName = argv[++arg];
+        else if (strcmp(argv[arg], "-map") == 0 && arg + 1 < argc)
+            mapNumber = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-rpm") == 0 && arg + 3 < argc) {
+            rpmFirst = (UINT32)atoi(argv[++arg]);
+            rpmLast = (UINT32)atoi(argv[++arg]);
+            rpmStep = (UINT32)atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "-verify") == 0)
+            verify = true;
+        else if (argv[arg][0] == '-')
+            badArg = true;
+        else
+            outName = argv[arg];
+    }
+
+    // the period is 7500000 / rpm, which must fit in 16 bits
+    if (badArg || rpmFirst < 115 || rpmLast < rpmFirst || rpmStep == 0) {
+        printf("Usage: FuelMapModel [-tune <bin>] [-map <n>] [-rpm <first> <last> <step>] [-verify] [output]\n");
+        return 1;
+    }
+
+    if (!tune.open(tuneName))
+        return 1;
+
+    if (mapNumber < 0 || mapNumber >= FUEL_MAP_COUNT)
+        mapNumber = tune.defaultFuelMap();
+
+    UINT32 rpmCount = (rpmLast - rpmFirst) / rpmStep + 1;
+    std::vector<UINT16> period(rpmCount);
+    std::vector<UINT16> mafSum(MAF_SUM_COUNT);
+    std::vector<UINT16> fuel((size_t)rpmCount * MAF_SUM_COUNT);
+    std::vector<UINT8> rowIndex(fuel.size());
+
+    for (UINT32 i = 0; i < rpmCount; i++)
+        period[i] = (UINT16)(7500000.0 / (rpmFirst + i * rpmStep));
+
+    for (UINT16 i = 0; i < MAF_SUM_COUNT; i++)
+        mafSum[i] = i;
+
+    auto start = std::chrono::steady_clock::now();
+
+    FuelModel model(tune, mapNumber);
+
+    auto built = std::chrono::steady_clock::now();
+
+    model.buildSurface(period.data(), rpmCount, mafSum.data(), MAF_SUM_COUNT, fuel.data(), rowIndex.data());
+
+    auto done = std::chrono::steady_clock::now();
+
+    printf("%s (tune %04X) fuel map %d: %u x %u points, setup %.2f ms, surface %.2f ms\n",
+      tune.name(), tune.tuneNumber(), mapNumber, rpmCount, MAF_SUM_COUNT,
+      std::chrono::duration<double>(built - start).count() * 1000.0,
+      std::chrono::duration<double>(done - built).count() * 1000.0);
+
+    if (verify)
+        return (verifyInterpolation(tune) + verifySurface(tune, mapNumber, period, fuel, rowIndex)) ? 1 : 0;
+
+    ResultWriter writer(RESULT_LAYOUT_GENERIC, &tune, mapNumber, model.constants());
+
+    writer.addAxis("rpm", rpmFirst, rpmStep, rpmCount);
+    writer.addAxis("mafSum", 0, 1, MAF_SUM_COUNT);
+    writer.addColumn("rowIndex", 1, rowIndex.data());
+    writer.addColumn("fuelValue", 2, fuel.data());
+
+    return writer.write(outName) ? 0 : 1;
+}
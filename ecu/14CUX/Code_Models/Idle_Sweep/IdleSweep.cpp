@@ -0,0 +1,589 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Idle Scenario Sweep
+//
+//  Runs the idle air control models (../Common/IdleControl.h) in closed loop with the
+//  engine plant (../Common/IdleSimulation.h) over a grid of idle scenarios for a set of
+//  PROM images, so the stepper motor behaviour of different tunes can be compared
+//  without a car. Each scenario holds the coolant temperature and an extra load steady,
+//  switches an accessory or the gearbox on half way through and starts the valve at a
+//  given position:
+//
+//      coolant     -10, 10, 30, 50, 70, 85 and 95 C
+//      load        0, 10 and 20 Nm
+//      events      none, A/C, drive, heated screen, A/C and drive
+//      start       valve position 40, 120 (the power on default) and 170
+//
+//  By default the ten reference images are used (the same list as BatchCompare). The runs
+//  (tunes x scenarios) are taken in order by worker threads from a shared counter, as in
+//  CoSim. Before the sweep each tune is checked, unless -nocheck is given:
+//
+//      Literal     idleControl, the end of the main loop and driveIacMotor through the
+//                  _6803 models and through the firmware itself in the 6803 emulator
+//                  (../Common/RomRoutines.h) from the same random RAM states
+//      ROM         a few scenarios run in lockstep with the firmware: every routine
+//                  call is repeated in the emulator from the RAM the model started with
+//
+//  The sweep is written to idleSweep.txt, tab delimited, one line per run with the tune
+//  name as the first column: the target idle speed, the engine speed after the settling
+//  time (mean, min, max and RMS error from the target), hunting (swings from below the
+//  band to above it), when it last left the band, valve steps and reversals, the valve
+//  positions and whether the idle air control fault was set or the engine stalled.
+//
+//  Usage: IdleSweep [-dir <bin directory>] [-threads <n>] [-time <s>] [-nocheck] [image ...]
+//
+//      -dir        directory holding the reference images (default ../../OriginalCode/Reference_Bins)
+//      -threads    worker threads (default is one per hardware thread)
+//      -time       length of each scenario in seconds (default 60)
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/ReferenceTunes.h"
+#include "../Common/IdleControl.h"
+#include "../Common/IdleSimulation.h"
+#include "../Common/Emulator6803.h"
+#include "../Common/RomRoutines.h"
+
+
+#define RANDOM_CHECKS       30000       // random RAM states per tune
+#define LOCKSTEP_SECONDS    20.0        // length of the lockstep runs
+
+
+static const double sweepCoolant[] = { -10.0, 10.0, 30.0, 50.0, 70.0, 85.0, 95.0 };
+static const double sweepLoad[] = { 0.0, 10.0, 20.0 };
+static const UINT8 sweepStart[] = { 40, 120, 170 };
+
+#define EVENT_AC            0x01
+#define EVENT_DRIVE         0x02
+#define EVENT_SCREEN        0x04
+
+static const int sweepEvents[] = { 0, EVENT_AC, EVENT_DRIVE, EVENT_SCREEN, EVENT_AC | EVENT_DRIVE };
+
+#define COUNT_OF(a)         (int)(sizeof(a) / sizeof(a[0]))
+
+// Lockstep runs: coolant, load, events, start position
+struct LockstepCase
+{
+    double  coolant;
+    double  load;
+    int     events;
+    UINT8   start;
+};
+
+static const LockstepCase lockstepCases[] = {
+    { 85.0,  0.0, EVENT_AC | EVENT_DRIVE, 120 },
+    { -10.0, 10.0, EVENT_SCREEN,           40 },
+    { 50.0,  20.0, EVENT_DRIVE,           170 }
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  One tune: the image and its tables, shared (read only) by every run of
+//  it, and the results of its checks.
+//
+///////////////////////////////////////////////////////////////////////////////
+struct TuneData
+{
+    std::string     path;
+    char            name[64];
+    bool            ok;
+    TuneImage      *tune;
+    IdleTables      tables;
+    bool            tablesFound;
+    MafSensor      *sensor;
+
+    UINT64          checks;
+    UINT32          literalMismatches;
+    bool            romFound;
+    UINT64          lockstepCalls;
+    UINT32          romMismatches;
+};
+
+struct SweepRun
+{
+    IdleResult      result;
+    double          wallSeconds;
+};
+
+struct SweepJobs
+{
+    std::vector<TuneData *>     *tunes;
+    const std::vector<IdleScenario> *scenarios;
+    IdleSimConfig               config;
+    bool                        check;
+
+    std::atomic<unsigned>       nextCheck;  // tunes
+    std::atomic<unsigned>       next;       // runs, tune by tune
+    std::vector<SweepRun>       runs;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Scenarios
+//
+///////////////////////////////////////////////////////////////////////////////
+static std::string eventName (int events)
+{
+    std::string name;
+
+    if (events & EVENT_AC)
+        name = "A/C";
+    if (events & EVENT_DRIVE)
+        name += name.empty() ? "drive" : "+drive";
+    if (events & EVENT_SCREEN)
+        name += name.empty() ? "screen" : "+screen";
+
+    return name.empty() ? "none" : name;
+}
+
+static void makeScenario (IdleScenario &s, double coolant, double load, int events, UINT8 start,
+                          double seconds)
+{
+    char name[80];
+
+    clearIdleScenario(s);
+
+    snprintf(name, sizeof(name), "%.0fC %.0fNm %s start %u", coolant, load, eventName(events).c_str(),
+      start);
+    s.name = name;
+    s.script.add(0.0, 0, load, coolant);
+    s.script.add(seconds, 0, load, coolant);
+    s.startPosition = start;
+
+    if (events & EVENT_AC)
+        s.ac.on = seconds / 2;
+    if (events & EVENT_DRIVE)
+        s.drive.on = seconds / 2;
+    if (events & EVENT_SCREEN)
+        s.heatedScreen.on = seconds / 2;
+}
+
+static void makeScenarios (std::vector<IdleScenario> &scenarios, double seconds)
+{
+    for (int c = 0; c < COUNT_OF(sweepCoolant); c++)
+        for (int l = 0; l < COUNT_OF(sweepLoad); l++)
+            for (int e = 0; e < COUNT_OF(sweepEvents); e++)
+                for (int p = 0; p < COUNT_OF(sweepStart); p++) {
+                    IdleScenario s;
+                    makeScenario(s, sweepCoolant[c], sweepLoad[l], sweepEvents[e], sweepStart[p], seconds);
+                    scenarios.push_back(s);
+                }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Checks
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool sameIdleRam (const IdleRam &a, const IdleRam &b)
+{
+    // not the stack, the firmware's return addresses are on it
+    return memcmp(a.page00, b.page00, IDLE_RAM_STACK) == 0 && memcmp(a.page20, b.page20, 0x100) == 0;
+}
+
+// Random RAM, biased towards the states the routines branch on (valve at rest, the
+// waits run out, the main loop counter about to wrap, an engine running)
+static void randomIdleRam (IdleRam &ram, UINT32 &seed)
+{
+    for (int i = 0; i < 0x100; i++) {
+        seed = seed * 1103515245 + 12345;
+        ram.page00[i] = (UCHAR)(seed >> 16);
+        seed = seed * 1103515245 + 12345;
+        ram.page20[i] = (UCHAR)(seed >> 16);
+    }
+
+    seed = seed * 1103515245 + 12345;
+    UINT32 bias = seed >> 8;
+
+    if (bias & 0x01)
+        ram[RAM_IAC_STEP_COUNT] = 0;
+    if (bias & 0x02)
+        ram[0x00AE] = 0;
+    if (bias & 0x04)
+        ram[0x00B3] = 0;
+    if (bias & 0x08)
+        ram[0x00B4] = 0;
+
+    ram[0x00C0] = (bias & 0x10) ? (UCHAR)((bias >> 8) % 0xC0) : 0;
+    ram[0x00C1] = 0;
+
+    if ((bias >> 16) % 3 == 0)
+        ram[0x207E] = 0x50;
+    if (bias & 0x20)
+        ram[RAM_IGN_PERIOD] &= 0x1F;
+}
+
+static void checkRandom (TuneData *d, Emulator6803 &emu, const RomIdleRoutines &rom)
+{
+    Cpu6803 cpu;
+    UINT32 seed = d->tune->tuneNumber() + 1;
+
+    for (int n = 0; n < RANDOM_CHECKS; n++) {
+
+        IdleRam ram, model, firmware;
+        bool ok = false;
+
+        randomIdleRam(ram, seed);
+        model = firmware = ram;
+
+        switch (n % 3) {
+        case 0:
+            idleControl_6803(cpu, model, d->tables);
+            ok = romIdleControl(emu, rom, firmware);
+            break;
+        case 1:
+            idleLoopTail_6803(cpu, model, d->tables);
+            ok = romIdleLoopTail(emu, rom, firmware);
+            break;
+        case 2:
+            driveIacMotor_6803(cpu, model, d->tables);
+            ok = romDriveIacMotor(emu, rom, firmware);
+            break;
+        }
+
+        d->checks++;
+
+        if (!ok || !sameIdleRam(model, firmware))
+            d->literalMismatches++;
+    }
+}
+
+struct Lockstep
+{
+    TuneData               *tune;
+    Emulator6803           *emu;
+    const RomIdleRoutines  *rom;
+};
+
+static void lockstepHook (void *context, IdleRoutine routine, const IdleRam &before, const IdleRam &after)
+{
+    Lockstep *l = (Lockstep *)context;
+    IdleRam firmware = before;
+    bool ok = false;
+
+    switch (routine) {
+    case IDLE_CONTROL:      ok = romIdleControl(*l->emu, *l->rom, firmware);     break;
+    case IDLE_LOOP_TAIL:    ok = romIdleLoopTail(*l->emu, *l->rom, firmware);    break;
+    case IDLE_DRIVE_IAC:    ok = romDriveIacMotor(*l->emu, *l->rom, firmware);   break;
+    }
+
+    l->tune->lockstepCalls++;
+
+    if (!ok || !sameIdleRam(firmware, after))
+        l->tune->romMismatches++;
+}
+
+static void checkLockstep (TuneData *d, Emulator6803 &emu, const RomIdleRoutines &rom,
+                           const IdleSimConfig &config)
+{
+    IdleSimulation sim(*d->tune, d->tables, *d->sensor, config);
+    Lockstep l = { d, &emu, &rom };
+
+    sim.setHook(lockstepHook, &l);
+
+    for (int c = 0; c < COUNT_OF(lockstepCases); c++) {
+        const LockstepCase &lc = lockstepCases[c];
+        IdleScenario s;
+
+        makeScenario(s, lc.coolant, lc.load, lc.events, lc.start, LOCKSTEP_SECONDS);
+        sim.run(s);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Worker threads: first the checks, a tune at a time, then the runs
+//
+///////////////////////////////////////////////////////////////////////////////
+static void sweepWorker (SweepJobs *jobs)
+{
+    std::vector<TuneData *> &tunes = *jobs->tunes;
+
+    if (jobs->check)
+        for (unsigned i = jobs->nextCheck++; i < tunes.size(); i = jobs->nextCheck++) {
+
+            TuneData *d = tunes[i];
+            RomIdleRoutines rom;
+
+            if (!d->ok || !(d->romFound = findRomIdleRoutines(d->tune->data(), rom)))
+                continue;
+
+            Emulator6803 *emu = new Emulator6803;
+
+            loadRomIdleRoutines(*emu, d->tune->data(), rom);
+            checkRandom(d, *emu, rom);
+            checkLockstep(d, *emu, rom, jobs->config);
+
+            delete emu;
+        }
+
+    unsigned perTune = (unsigned)jobs->scenarios->size();
+    unsigned runs = (unsigned)jobs->runs.size();
+    IdleSimulation *sim = 0;
+    unsigned simTune = 0;
+
+    for (unsigned run = jobs->next++; run < runs; run = jobs->next++) {
+
+        unsigned t = run / perTune;
+        TuneData *d = tunes[t];
+
+        if (!d->ok)
+            continue;
+
+        if (!sim || simTune != t) {
+            delete sim;
+            sim = new IdleSimulation(*d->tune, d->tables, *d->sensor, jobs->config);
+            simTune = t;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        jobs->runs[run].result = sim->run((*jobs->scenarios)[run % perTune]);
+        jobs->runs[run].wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    delete sim;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Output
+//
+///////////////////////////////////////////////////////////////////////////////
+static void writeSweepFile (const char *fileName, const SweepJobs &jobs)
+{
+    FILE *fptr = fopen(fileName, "w");
+    const std::vector<IdleScenario> &scenarios = *jobs.scenarios;
+
+    if (!fptr) {
+        printf("Could not open %s for writing\n", fileName);
+        return;
+    }
+
+    fprintf(fptr, "Tune\tScenario\tCoolant C\tLoad Nm\tEvents\tStart\tTarget\tMean RPM\tMin RPM\tMax RPM\t"
+                  "RMS error\tHunts\tSettle s\tSteps\tReversals\tPos min\tPos max\tPos final\tFault 48\t"
+                  "Stalled\n");
+
+    for (size_t run = 0; run < jobs.runs.size(); run++) {
+
+        const TuneData *d = (*jobs.tunes)[run / scenarios.size()];
+        const IdleScenario &s = scenarios[run % scenarios.size()];
+        const IdleResult &r = jobs.runs[run].result;
+        int events = (s.ac.on >= 0 ? EVENT_AC : 0) | (s.drive.on >= 0 ? EVENT_DRIVE : 0) |
+                     (s.heatedScreen.on >= 0 ? EVENT_SCREEN : 0);
+
+        if (!d->ok)
+            continue;
+
+        fprintf(fptr, "%s\t%s\t%.0f\t%.0f\t%s\t%u\t%u\t%.0f\t%.0f\t%.0f\t%.1f\t%d\t%.2f\t%u\t%u\t%u\t%u\t%u\t%d\t",
+          d->name, s.name.c_str(), s.script.points[0].in.coolantTemp, s.script.points[0].in.loadTorque,
+          eventName(events).c_str(), s.startPosition, r.target, r.meanRpm, r.minRpm, r.maxRpm, r.rmsError,
+          r.huntCycles, r.settleTime, r.steps, r.reversals, r.positionMin, r.positionMax, r.positionFinal,
+          r.fault48 ? 1 : 0);
+
+        if (r.stalled)
+            fprintf(fptr, "%.2f\n", r.stallTime);
+        else
+            fprintf(fptr, "-\n");
+    }
+
+    fclose(fptr);
+}
+
+static void printSummary (const SweepJobs &jobs, double seconds)
+{
+    const std::vector<TuneData *> &tunes = *jobs.tunes;
+    size_t perTune = jobs.scenarios->size();
+    double simTotal = 0.0;
+
+    printf("\nTarget idle speed warm (85 C) and cold (-10 C) in park with nothing on; over the runs: mean RMS\n"
+           "error from the target, runs that hunt (%.0f RPM band), stalls and idle air control faults\n\n",
+      jobs.config.huntBand);
+    printf("Tune          Warm  Cold  Drive   A/C   Runs   RMS  Hunting  Stalled  Fault  x Real time");
+    if (jobs.check)
+        printf("  Literal    ROM");
+    printf("\n-------------------------------------------------------------------------------------------");
+    if (jobs.check)
+        printf("---------------");
+    printf("\n");
+
+    for (size_t t = 0; t < tunes.size(); t++) {
+
+        const TuneData *d = tunes[t];
+        double rms = 0.0, sim = 0.0, wall = 0.0;
+        int hunting = 0, stalled = 0, faults = 0;
+
+        if (!d->ok) {
+            printf("%-13s (could not be loaded)\n", d->path.c_str());
+            continue;
+        }
+
+        for (size_t s = 0; s < perTune; s++) {
+            const SweepRun &run = jobs.runs[t * perTune + s];
+            rms += run.result.rmsError;
+            sim += run.result.simSeconds;
+            wall += run.wallSeconds;
+            hunting += run.result.huntCycles > 0;
+            stalled += run.result.stalled;
+            faults += run.result.fault48;
+        }
+
+        simTotal += sim;
+
+        UINT8 warm = ectCountForTemp(85.0), cold = ectCountForTemp(-10.0);
+
+        printf("%-12s%s %5u %5u %6u %5u %6u %5.1f %8d %8d %6d %12.0f", d->name, d->tablesFound ? " " : "?",
+          idleTarget_C(d->tables, warm, false, false, false), idleTarget_C(d->tables, cold, false, false, false),
+          idleTarget_C(d->tables, warm, false, true, false), idleTarget_C(d->tables, warm, true, false, false),
+          (unsigned)perTune, perTune ? rms / perTune : 0.0, hunting, stalled, faults, wall ? sim / wall : 0.0);
+
+        if (jobs.check)
+            printf("  %7s  %5s", !d->romFound ? "n/a" : d->literalMismatches ? "FAIL" : "ok",
+              !d->romFound ? "n/a" : d->romMismatches ? "FAIL" : "ok");
+
+        printf("\n");
+    }
+
+    printf("\n%u runs, %.0f simulated seconds in %.2f s (%.0f x real time overall)\n",
+      (unsigned)jobs.runs.size(), simTotal, seconds, seconds ? simTotal / seconds : 0.0);
+
+    if (jobs.check) {
+        UINT64 checks = 0, calls = 0;
+        UINT32 literal = 0, rom = 0;
+
+        for (size_t t = 0; t < tunes.size(); t++) {
+            checks += tunes[t]->checks;
+            calls += tunes[t]->lockstepCalls;
+            literal += tunes[t]->literalMismatches;
+            rom += tunes[t]->romMismatches;
+        }
+
+        printf("%llu random states and %llu lockstep calls checked, %u literal and %u firmware mismatches\n",
+          (unsigned long long)checks, (unsigned long long)calls, literal, rom);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    std::string dir = REFERENCE_BIN_DIR;
+    std::vector<std::string> paths;
+    std::vector<TuneData *> tunes;
+    std::vector<IdleScenario> scenarios;
+    IdleSimConfig config = defaultIdleSimConfig();
+    double seconds = 60.0;
+    unsigned threads = 0;
+    bool check = true;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-dir") == 0 && arg + 1 < argc)
+            dir = argv[++arg];
+        else if (strcmp(argv[arg], "-threads") == 0 && arg + 1 < argc)
+            threads = (unsigned)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-time") == 0 && arg + 1 < argc)
+            seconds = atof(argv[++arg]);
+        else if (strcmp(argv[arg], "-nocheck") == 0)
+            check = false;
+        else if (argv[arg][0] == '-') {
+            printf("Usage: IdleSweep [-dir <bin directory>] [-threads <n>] [-time <s>] [-nocheck] [image ...]\n");
+            return 1;
+        }
+        else
+            paths.push_back(argv[arg]);
+    }
+
+    if (seconds <= config.settleSeconds) {
+        printf("Each scenario must be longer than the %.0f s settling time\n", config.settleSeconds);
+        return 1;
+    }
+
+    if (paths.empty())
+        for (int i = 0; i < REFERENCE_TUNE_COUNT; i++)
+            paths.push_back(dir + "/" + referenceTunes[i]);
+
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        TuneData *d = new TuneData;
+        d->path = paths[i];
+        d->name[0] = 0;
+        d->tune = new TuneImage;
+        d->sensor = 0;
+        d->ok = d->tune->open(paths[i].c_str());
+        d->tablesFound = d->romFound = false;
+        d->checks = d->lockstepCalls = 0;
+        d->literalMismatches = d->romMismatches = 0;
+
+        if (d->ok) {
+            strcpy(d->name, d->tune->name());
+            d->tablesFound = loadIdleTables(*d->tune, d->tables);
+            d->sensor = new MafSensor(d->tune->constants(d->tune->defaultFuelMap()), config.linearPerGs);
+        }
+
+        tunes.push_back(d);
+    }
+
+    makeScenarios(scenarios, seconds);
+
+    SweepJobs jobs;
+
+    jobs.tunes = &tunes;
+    jobs.scenarios = &scenarios;
+    jobs.config = config;
+    jobs.check = check;
+    jobs.nextCheck = 0;
+    jobs.next = 0;
+    jobs.runs.resize(tunes.size() * scenarios.size());
+
+    printf("%u tunes x %u idle scenarios of %.0f s on %u threads\n", (unsigned)tunes.size(),
+      (unsigned)scenarios.size(), seconds, threads);
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+        workers.push_back(std::thread(sweepWorker, &jobs));
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    writeSweepFile("idleSweep.txt", jobs);
+    printSummary(jobs, elapsed);
+
+    bool failed = false;
+
+    for (size_t i = 0; i < tunes.size(); i++) {
+        if (tunes[i]->ok && (tunes[i]->literalMismatches || tunes[i]->romMismatches))
+            failed = true;
+        delete tunes[i]->sensor;
+        delete tunes[i]->tune;
+        delete tunes[i];
+    }
+
+    return failed ? 2 : 0;
+}
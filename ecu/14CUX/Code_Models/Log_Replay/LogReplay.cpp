@@ -0,0 +1,426 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Datalog Replay
+//
+//  Feeds a recorded datalog of MAF sum and ignition period (X007A) through the MAF
+//  linearization, load (row) index and RPM (column) index models, giving the
+//  fuelMapLoadIdx and X005C values the ECU would have computed for each sample.
+//
+//  Dyno logs can run to tens of millions of samples, so the log is never loaded as a
+//  whole. It is read in fixed-size blocks and split into chunks of REPLAY_CHUNK_SAMPLES,
+//  and the chunks go through a three stage pipeline, one thread per stage:
+//
+//      parse       read and parse the text log into a chunk of samples
+//      model       batch MAF linearization, row index and column index lookup
+//      output      format the results and write them
+//
+//  Only REPLAY_CHUNK_COUNT chunks exist; they are passed from stage to stage and then
+//  back to the parser (see ChunkQueue.h), so memory use is the same for any log length.
+//
+//  The log is plain text, one sample per line. Fields are separated by spaces, tabs or
+//  commas and may be decimal or hex (0x prefix). By default the first field is the MAF
+//  sum and the second is the ignition period; use -fields to pick other columns (for
+//  example when the logger writes a time stamp first). Blank lines, lines starting
+//  with '#' and lines that don't have numbers in those columns (column titles) are
+//  skipped.
+//
+//  The output is tab delimited:
+//
+//      sample  mafSum  period  linearMAF  fuelMapLoadIdx  X005C
+//
+//  When built with -DCUX_PATH_COUNTERS=1 the literal linearizeMAF_6803 and getColumnIndex
+//  models are run on every sample as well (the batch and lookup table versions have no
+//  branches), and a histogram of the paths taken for this tune and log is printed to
+//  stderr at the end (see PathCounters.h).
+//
+//  Usage: LogReplay [-tune <bin>] [-map <n>] [-fields <maf> <period>] <log> [output]
+//
+//      output defaults to replay.txt; use "-" for stdout
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/MafRowIndex.h"
+#include "../Common/MafLinearizeBatch.h"
+#include "../Common/ColumnIndexTable.h"
+#include "../Common/ChunkQueue.h"
+#include "../Common/RpmColumnIndex.h"
+#include "../Common/PathCounters.h"
+
+
+#define REPLAY_CHUNK_SAMPLES    16384       // samples per chunk
+#define REPLAY_CHUNK_COUNT      4           // chunks in the pool
+#define READ_BLOCK_SIZE         65536       // bytes per read from the log
+#define MAX_LINE_LENGTH         256         // room for a line carried over between blocks
+#define MAX_FIELDS              16
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  One chunk of samples and the model results for them
+//
+///////////////////////////////////////////////////////////////////////////////
+struct ReplayChunk
+{
+    size_t      count;                      // samples in this chunk
+    double      firstSample;                // sample number of the first entry
+    bool        last;                       // end of log (count may be zero)
+
+    UINT16      mafSum[REPLAY_CHUNK_SAMPLES];
+    UINT16      period[REPLAY_CHUNK_SAMPLES];
+    UINT16      linearMAF[REPLAY_CHUNK_SAMPLES];
+    UINT8       rowIndex[REPLAY_CHUNK_SAMPLES];
+    UCHAR       colIndex[REPLAY_CHUNK_SAMPLES];
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  LogReader
+//
+//  Returns the log one line at a time out of a fixed-size block buffer. A
+//  line that runs past the end of the block is moved to the front and the
+//  rest of the block is refilled. A line that doesn't fit in the buffer at
+//  all is counted and skipped, up to and including its newline.
+//
+///////////////////////////////////////////////////////////////////////////////
+class LogReader
+{
+public:
+    LogReader () : fptr(0), length(0), pos(0), eof(false), skipping(false), tooLong(0)
+    {
+    }
+
+    ~LogReader ()
+    {
+        if (fptr)
+            fclose(fptr);
+    }
+
+    bool open (const char *path)
+    {
+        fptr = fopen(path, "rb");
+        if (!fptr)
+            printf("Could not open %s\n", path);
+        return fptr != 0;
+    }
+
+    // Sets line to the next line (terminated in place). Returns false at the end of the log.
+    bool nextLine (char *&line)
+    {
+        for (;;) {
+            char *start = buffer + pos;
+            char *end = (char *)memchr(start, '\n', length - pos);
+
+            if (end) {
+                pos = (end - buffer) + 1;
+                if (skipping) {             // the tail of an overlong line
+                    skipping = false;
+                    continue;
+                }
+                *end = 0;
+                line = start;
+                return true;
+            }
+
+            if (eof) {
+                if (pos == length || skipping)
+                    return false;
+                buffer[length] = 0;         // last line has no newline
+                pos = length;
+                line = start;
+                return true;
+            }
+
+            // keep the partial line and refill the rest of the buffer
+            length -= pos;
+            memmove(buffer, start, length);
+            pos = 0;
+
+            if (length == sizeof(buffer) - 1) {
+                if (!skipping)
+                    tooLong++;              // no newline in a whole block; drop it
+                skipping = true;            // and the rest of the line after it
+                length = 0;
+            }
+
+            size_t got = fread(buffer + length, 1, sizeof(buffer) - 1 - length, fptr);
+            length += got;
+            if (got == 0)
+                eof = true;
+        }
+    }
+
+    unsigned long overlongLines (void) const    { return tooLong; }
+
+private:
+    FILE           *fptr;
+    char            buffer[READ_BLOCK_SIZE + MAX_LINE_LENGTH + 1];
+    size_t          length;                 // bytes in the buffer
+    size_t          pos;                    // start of the next line
+    bool            eof;
+    bool            skipping;               // dropping the rest of an overlong line
+    unsigned long   tooLong;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  parseSample
+//
+//  Picks the MAF sum and ignition period out of one log line. Returns false
+//  for lines that should be skipped.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool parseSample (char *line, int mafField, int periodField, UINT16 &mafSum, UINT16 &period)
+{
+    unsigned long value[MAX_FIELDS];
+    int fields = 0;
+    int needed = (mafField > periodField) ? mafField : periodField;
+    char *p = line;
+
+    while (fields <= needed) {
+
+        while (*p == ' ' || *p == '\t' || *p == ',' || *p == '\r')
+            p++;
+
+        if (*p == 0 || *p == '#')
+            return false;
+
+        char *end;
+        value[fields] = strtoul(p, &end, 0);
+
+        if (end == p)
+            return false;                   // not a number (column titles)
+
+        fields++;
+        p = end;
+    }
+
+    if (value[mafField] > 0xFFFF || value[periodField] > 0xFFFF)
+        return false;
+
+    mafSum = (UINT16)value[mafField];
+    period = (UINT16)value[periodField];
+
+    return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Pipeline stages
+//
+///////////////////////////////////////////////////////////////////////////////
+struct ReplayContext
+{
+    ChunkQueue<ReplayChunk> freeChunks;
+    ChunkQueue<ReplayChunk> parsedChunks;
+    ChunkQueue<ReplayChunk> modeledChunks;
+
+    LogReader              *reader;
+    int                     mafField;
+    int                     periodField;
+    PromConstants           prom;
+    const ColumnIndexTable *lookupTable;
+    const UCHAR            *rpmTable;       // for the literal model (path counters)
+
+    unsigned long           skippedLines;
+};
+
+
+static void parseStage (ReplayContext *ctx)
+{
+    double sample = 0;
+    bool done = false;
+    char *line;
+
+    while (!done) {
+
+        ReplayChunk *chunk = ctx->freeChunks.pop();
+
+        chunk->count = 0;
+        chunk->firstSample = sample;
+
+        while (chunk->count < REPLAY_CHUNK_SAMPLES) {
+
+            if (!ctx->reader->nextLine(line)) {
+                done = true;
+                break;
+            }
+
+            if (parseSample(line, ctx->mafField, ctx->periodField,
+                            chunk->mafSum[chunk->count], chunk->period[chunk->count]))
+                chunk->count++;
+            else
+                ctx->skippedLines++;
+        }
+
+        sample += chunk->count;
+        chunk->last = done;
+        ctx->parsedChunks.push(chunk);
+    }
+}
+
+
+static void modelStage (ReplayContext *ctx)
+{
+    Cpu6803 cpu;                            // this stage's registers
+    bool done = false;
+
+    while (!done) {
+
+        ReplayChunk *chunk = ctx->parsedChunks.pop();
+
+        linearizeMAF_Batch(chunk->mafSum, chunk->linearMAF, chunk->count, ctx->prom);
+
+        for (size_t i = 0; i < chunk->count; i++) {
+            chunk->rowIndex[i] = Calculate_Row_Index(cpu, chunk->period[i], chunk->linearMAF[i], ctx->prom);
+            chunk->colIndex[i] = ctx->lookupTable->colIndex(chunk->period[i]);
+        }
+
+#if CUX_PATH_COUNTERS
+        for (size_t i = 0; i < chunk->count; i++) {
+            UCHAR bracket;
+            linearizeMAF_6803(cpu, chunk->mafSum[i], ctx->prom);
+            getColumnIndex(cpu, chunk->period[i], &bracket, ctx->rpmTable);
+        }
+#endif
+
+        done = chunk->last;
+        ctx->modeledChunks.push(chunk);
+    }
+}
+
+
+static double outputStage (ReplayContext *ctx, FILE *out)
+{
+    double samples = 0;
+    bool done = false;
+
+    fprintf(out, "sample\tmafSum\tperiod\tlinearMAF\tfuelMapLoadIdx\tX005C\n");
+
+    while (!done) {
+
+        ReplayChunk *chunk = ctx->modeledChunks.pop();
+
+        for (size_t i = 0; i < chunk->count; i++)
+            fprintf(out, "%.0f\t%u\t0x%04X\t%u\t0x%02X\t0x%02X\n", chunk->firstSample + i,
+              chunk->mafSum[i], chunk->period[i], chunk->linearMAF[i],
+              chunk->rowIndex[i], chunk->colIndex[i]);
+
+        samples += chunk->count;
+        done = chunk->last;
+        ctx->freeChunks.push(chunk);
+    }
+
+    return samples;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    TuneImage tune;
+    LogReader *reader = new LogReader;
+    ReplayContext ctx;
+    PromConstants prom = defaultPromConstants();
+    const char *logName = 0;
+    const char *outName = "replay.txt";
+    int mapNumber = -1;
+    int mafField = 1, periodField = 2;
+    FILE *out;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-tune") == 0 && arg + 1 < argc) {
+            if (!tune.open(argv[++arg]))
+                return 1;
+        }
+        else if (strcmp(argv[arg], "-map") == 0 && arg + 1 < argc)
+            mapNumber = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-fields") == 0 && arg + 2 < argc) {
+            mafField = atoi(argv[++arg]);
+            periodField = atoi(argv[++arg]);
+        }
+        else if (!logName)
+            logName = argv[arg];
+        else
+            outName = argv[arg];
+    }
+
+    if (!logName || mafField < 1 || periodField < 1 ||
+        mafField > MAX_FIELDS - 1 || periodField > MAX_FIELDS - 1) {
+        printf("Usage: LogReplay [-tune <bin>] [-map <n>] [-fields <maf> <period>] <log> [output]\n");
+        return 1;
+    }
+
+    if (tune.isOpen())
+        prom = tune.constants((mapNumber < 0) ? tune.defaultFuelMap() : mapNumber);
+
+    if (!reader->open(logName))
+        return 1;
+
+    if (strcmp(outName, "-") == 0)
+        out = stdout;
+    else if (!(out = fopen(outName, "w"))) {
+        printf("Could not open %s for writing\n", outName);
+        return 1;
+    }
+
+    ColumnIndexTable lookupTable(tune.isOpen() ? tune.rpmTable() : defaultRpmTable);
+
+    ctx.reader = reader;
+    ctx.mafField = mafField - 1;
+    ctx.periodField = periodField - 1;
+    ctx.prom = prom;
+    ctx.lookupTable = &lookupTable;
+    ctx.rpmTable = tune.isOpen() ? tune.rpmTable() : defaultRpmTable;
+    ctx.skippedLines = 0;
+
+    for (int i = 0; i < REPLAY_CHUNK_COUNT; i++)
+        ctx.freeChunks.push(new ReplayChunk);
+
+    pathCountersReset();                    // building the lookup table runs the model too
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread parser(parseStage, &ctx);
+    std::thread model(modelStage, &ctx);
+
+    double samples = outputStage(&ctx, out);
+
+    parser.join();
+    model.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (out != stdout)
+        fclose(out);
+
+    for (int i = 0; i < REPLAY_CHUNK_COUNT; i++)
+        delete ctx.freeChunks.pop();
+
+    fprintf(stderr, "Replayed %.0f samples in %.2f seconds (%lu lines skipped, %lu too long)\n",
+      samples, seconds, ctx.skippedLines, reader->overlongLines());
+
+#if CUX_PATH_COUNTERS
+    std::string title = std::string(tune.isOpen() ? tune.name() : "default constants") + ", " + logName;
+    printPathHistogram(stderr, pathCountersTotal(), title.c_str());
+#endif
+
+    delete reader;
+
+    return 0;
+}
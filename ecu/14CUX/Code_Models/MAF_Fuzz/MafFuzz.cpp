@@ -0,0 +1,596 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX MAF Linearization Differential Fuzzer
+//
+//  Drives every implementation of the MAF linearization with the same inputs and compares
+//  each one with a reference:
+//
+//      firmware            .linearizeMaf run in the 6803 emulator (../Common/RomRoutines.h),
+//                          the reference when a PROM image is available
+//      linearizeMAF_6803   literal translation (the reference without an image)
+//      linearizeMAF_C      C version
+//      linearizeMAF_Scalar 6803 squaring written out (../Common/MafLinearizeBatch.h)
+//      Batch kernels       scalar, SSE2 and AVX2 (whichever this CPU has)
+//
+//  New variants (table driven, other SIMD widths) go in the variants[] table below.
+//
+//  Each pass runs every variant over all 65536 MAF sums: first with the tune's constants,
+//  then with random XC1C3/XC1C5 pairs (-rounds). The passes are split over the threads.
+//
+//  Each mismatch goes in a bucket named after the variant, the path the reference took
+//  through the routine and which way the variant is off:
+//
+//      wrap        8 x mafSum + XC1C3 overflows 16 bits
+//      borrow      2 x square - XC1C5 borrows (the firmware clamps to zero on the carry)
+//      bit15       the difference has bit 15 set (where a sign bit clamp would go wrong)
+//      ovf         2 x square overflows 16 bits
+//
+//  The first case in each bucket (lowest pass, then lowest MAF sum, so the same on any
+//  number of threads) is shrunk: the MAF sum towards zero and the constants towards the
+//  tune's values, as long as it stays in the same bucket. The shrunk cases are written out
+//  as regression cases (mafRegression.txt, tab delimited) that "-replay" runs again,
+//  reporting any case whose outputs have changed.
+//
+//  linearizeMAF_C is the original C approximation and differs almost everywhere, so its
+//  buckets are marked "known" rather than counted as findings. The exit code is 2 when
+//  any other variant has a bucket.
+//
+//  Usage: MafFuzz [-tune <bin>] [-rounds <n>] [-seed <n>] [-threads <n>] [-out <file>]
+//         MafFuzz [-tune <bin>] -replay <file>
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/MafLinearizeBatch.h"
+#include "../Common/Emulator6803.h"
+#include "../Common/RomRoutines.h"
+#include "../Common/MafRowIndex.h"
+#include "../Common/Random.h"
+
+
+#define MAF_INPUTS          65536
+#define MAX_CASE_FIELDS     3           // mafSum, XC1C3, XC1C5
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Variants. Each one fills out[] for mafSum[] with one set of constants.
+//  The context carries the per thread state some of them need.
+//
+///////////////////////////////////////////////////////////////////////////////
+struct FuzzContext
+{
+    Cpu6803         cpu;
+    Emulator6803    *emu;               // null without a PROM image
+    const RomRoutines *routines;
+    UINT16          emuC1C3;            // constants currently patched into the emulator
+    UINT16          emuC1C5;
+};
+
+typedef void (*MafVariant)(const UINT16 *mafSum, UINT16 *out, size_t count,
+                           const PromConstants &prom, FuzzContext &ctx);
+
+static void variantFirmware (const UINT16 *mafSum, UINT16 *out, size_t count,
+                             const PromConstants &prom, FuzzContext &ctx)
+{
+    if (prom.XC1C3 != ctx.emuC1C3 || prom.XC1C5 != ctx.emuC1C5) {
+        ctx.emu->patch16(ADDR_MAF_OFFSET, prom.XC1C3);
+        ctx.emu->patch16(ADDR_MAF_SUBTRACT, prom.XC1C5);
+        ctx.emuC1C3 = prom.XC1C3;
+        ctx.emuC1C5 = prom.XC1C5;
+    }
+
+    for (size_t i = 0; i < count; i++)
+        out[i] = romLinearizeMAF(*ctx.emu, *ctx.routines, mafSum[i]);
+}
+
+static void variant6803 (const UINT16 *mafSum, UINT16 *out, size_t count,
+                         const PromConstants &prom, FuzzContext &ctx)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = linearizeMAF_6803(ctx.cpu, mafSum[i], prom);
+}
+
+static void variantC (const UINT16 *mafSum, UINT16 *out, size_t count,
+                      const PromConstants &prom, FuzzContext &)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = linearizeMAF_C(mafSum[i], prom);
+}
+
+static void variantScalar (const UINT16 *mafSum, UINT16 *out, size_t count,
+                           const PromConstants &prom, FuzzContext &)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = linearizeMAF_Scalar(mafSum[i], prom);
+}
+
+static void variantBatchScalar (const UINT16 *mafSum, UINT16 *out, size_t count,
+                                const PromConstants &prom, FuzzContext &)
+{
+    linearizeMAF_BatchScalar(mafSum, out, count, prom);
+}
+
+#if MAF_BATCH_X86
+static void variantBatchSSE2 (const UINT16 *mafSum, UINT16 *out, size_t count,
+                              const PromConstants &prom, FuzzContext &)
+{
+    linearizeMAF_BatchSSE2(mafSum, out, count, prom);
+}
+
+static void variantBatchAVX2 (const UINT16 *mafSum, UINT16 *out, size_t count,
+                              const PromConstants &prom, FuzzContext &)
+{
+    linearizeMAF_BatchAVX2(mafSum, out, count, prom);
+}
+#endif
+
+struct VariantInfo
+{
+    const char  *name;
+    MafVariant  run;
+    bool        needsImage;
+    bool        needsAVX2;
+    bool        approximate;            // not expected to match (known bucket)
+};
+
+static const VariantInfo variants[] = {
+    { "firmware",               variantFirmware,    true,   false,  false },
+    { "linearizeMAF_6803",      variant6803,        false,  false,  false },
+    { "linearizeMAF_C",         variantC,           false,  false,  true  },
+    { "linearizeMAF_Scalar",    variantScalar,      false,  false,  false },
+    { "BatchScalar",            variantBatchScalar, false,  false,  false },
+#if MAF_BATCH_X86
+    { "BatchSSE2",              variantBatchSSE2,   false,  false,  false },
+    { "BatchAVX2",              variantBatchAVX2,   false,  true,   false },
+#endif
+};
+
+#define VARIANT_COUNT   (int)(sizeof(variants) / sizeof(variants[0]))
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Buckets
+//
+///////////////////////////////////////////////////////////////////////////////
+struct FuzzCase
+{
+    UINT16  mafSum;
+    UINT16  XC1C3;
+    UINT16  XC1C5;
+};
+
+static PromConstants caseConstants (const FuzzCase &c, const PromConstants &base)
+{
+    PromConstants prom = base;
+    prom.XC1C3 = c.XC1C3;
+    prom.XC1C5 = c.XC1C5;
+    return prom;
+}
+
+// The path the firmware takes for this input (see the list at the top)
+static std::string pathName (const FuzzCase &c)
+{
+    UINT32 x = 8u * c.mafSum + c.XC1C3;
+    UINT32 square = squareMAF_6803((UINT16)x);
+    UINT32 twice = 2 * square;
+    UINT32 diff = (twice & 0xFFFF) - c.XC1C5;
+    std::string path;
+
+    if (x > 0xFFFF)
+        path += "wrap ";
+    if (twice > 0xFFFF)
+        path += "ovf ";
+    if (diff & 0x10000)
+        path += "borrow ";
+    if (diff & 0x8000)
+        path += "bit15 ";
+
+    return path.empty() ? "normal" : path.substr(0, path.size() - 1);
+}
+
+static std::string bucketName (int variant, const FuzzCase &c, UINT16 reference, UINT16 value)
+{
+    return std::string(variants[variant].name) + " " + pathName(c) +
+           ((value > reference) ? " high" : " low");
+}
+
+struct Bucket
+{
+    int         variant;
+    FuzzCase    first;
+    UINT32      firstPass;              // first is the lowest (pass, mafSum) in the bucket
+    UINT64      count;
+};
+
+typedef std::map<std::string, Bucket> BucketMap;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Single case evaluation and shrinking
+//
+///////////////////////////////////////////////////////////////////////////////
+static UINT16 runCase (int variant, const FuzzCase &c, const PromConstants &base, FuzzContext &ctx)
+{
+    UINT16 out;
+    variants[variant].run(&c.mafSum, &out, 1, caseConstants(c, base), ctx);
+    return out;
+}
+
+static bool sameBucket (int variant, int reference, const FuzzCase &c, const PromConstants &base,
+                        FuzzContext &ctx, const std::string &bucket)
+{
+    UINT16 ref = runCase(reference, c, base, ctx);
+    UINT16 value = runCase(variant, c, base, ctx);
+
+    return value != ref && bucketName(variant, c, ref, value) == bucket;
+}
+
+static UINT32 distance (UINT16 value, UINT16 goal)
+{
+    return (value > goal) ? value - goal : goal - value;
+}
+
+// Move each field towards its target in halving steps while the case stays in the bucket
+static FuzzCase shrink (int variant, int reference, FuzzCase c, const FuzzCase &target,
+                        const PromConstants &base, FuzzContext &ctx, const std::string &bucket)
+{
+    for (bool progress = true; progress; ) {
+
+        progress = false;
+
+        for (int field = 0; field < MAX_CASE_FIELDS; field++) {
+
+            UINT16 *value = (field == 0) ? &c.mafSum : (field == 1) ? &c.XC1C3 : &c.XC1C5;
+            UINT16 goal = (field == 0) ? target.mafSum : (field == 1) ? target.XC1C3 : target.XC1C5;
+
+            for (UINT32 step = distance(*value, goal); step > 0; ) {
+
+                UINT16 saved = *value;
+                *value = (UINT16)((*value > goal) ? *value - step : *value + step);
+
+                if (sameBucket(variant, reference, c, base, ctx, bucket))
+                    progress = true;
+                else {
+                    *value = saved;
+                    step >>= 1;
+                }
+
+                // never step past the goal
+                if (step > distance(*value, goal))
+                    step = distance(*value, goal);
+            }
+        }
+    }
+
+    return c;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Fuzzing passes
+//
+///////////////////////////////////////////////////////////////////////////////
+struct FuzzShared
+{
+    const TuneImage     *tune;
+    const RomRoutines   *routines;
+    PromConstants       base;
+    std::vector<bool>   enabled;
+    int                 reference;
+    UINT32              rounds;
+    UINT32              seed;
+    unsigned            threads;
+
+    std::mutex          lock;
+    BucketMap           buckets;
+    UINT64              compared;
+};
+
+static void setupContext (FuzzContext &ctx, Emulator6803 &emu, const FuzzShared &shared)
+{
+    ctx.emu = 0;
+    ctx.routines = shared.routines;
+    ctx.emuC1C3 = ctx.emuC1C5 = 0;
+
+    if (shared.routines) {
+        loadRomRoutines(emu, shared.tune->data(), *shared.routines);
+        ctx.emu = &emu;
+        ctx.emuC1C3 = shared.tune->wordAt(ADDR_MAF_OFFSET);
+        ctx.emuC1C5 = shared.tune->wordAt(ADDR_MAF_SUBTRACT);
+    }
+}
+
+// Pass 0 uses the tune's constants, the rest random ones
+static void fuzzWorker (FuzzShared *shared, unsigned first)
+{
+    Emulator6803 emu;
+    FuzzContext ctx;
+    std::vector<UINT16> mafSum(MAF_INPUTS);
+    std::vector<UINT16> reference(MAF_INPUTS);
+    std::vector<UINT16> value(MAF_INPUTS);
+    BucketMap buckets;
+    UINT64 compared = 0;
+
+    setupContext(ctx, emu, *shared);
+
+    for (UINT32 i = 0; i < MAF_INPUTS; i++)
+        mafSum[i] = (UINT16)i;
+
+    for (UINT32 pass = first; pass <= shared->rounds; pass += shared->threads) {
+
+        PromConstants prom = shared->base;
+
+        if (pass > 0) {
+            XorShift rng(shared->seed + pass * 0x9E3779B9u);
+            prom.XC1C3 = (UINT16)rng.next();
+            prom.XC1C5 = (UINT16)rng.next();
+        }
+
+        variants[shared->reference].run(mafSum.data(), reference.data(), MAF_INPUTS, prom, ctx);
+
+        for (int v = 0; v < VARIANT_COUNT; v++) {
+
+            if (v == shared->reference || !shared->enabled[v])
+                continue;
+
+            variants[v].run(mafSum.data(), value.data(), MAF_INPUTS, prom, ctx);
+            compared += MAF_INPUTS;
+
+            for (UINT32 i = 0; i < MAF_INPUTS; i++) {
+                if (value[i] == reference[i])
+                    continue;
+
+                FuzzCase c = { (UINT16)i, prom.XC1C3, prom.XC1C5 };
+                std::string name = bucketName(v, c, reference[i], value[i]);
+                BucketMap::iterator it = buckets.find(name);
+
+                if (it == buckets.end()) {
+                    Bucket b = { v, c, pass, 1 };
+                    buckets[name] = b;
+                }
+                else
+                    it->second.count++;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(shared->lock);
+
+    shared->compared += compared;
+
+    for (BucketMap::iterator it = buckets.begin(); it != buckets.end(); ++it) {
+        BucketMap::iterator found = shared->buckets.find(it->first);
+        if (found == shared->buckets.end())
+            shared->buckets[it->first] = it->second;
+        else {
+            Bucket &b = found->second;
+
+            // keep the lowest (pass, mafSum), whichever thread finishes first
+            if (it->second.firstPass < b.firstPass ||
+                (it->second.firstPass == b.firstPass && it->second.first.mafSum < b.first.mafSum)) {
+                b.first = it->second.first;
+                b.firstPass = it->second.firstPass;
+            }
+            b.count += it->second.count;
+        }
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Regression cases
+//
+//  One line per case: bucket, variant, mafSum, XC1C3, XC1C5, reference output,
+//  variant output. Numbers are hex.
+//
+///////////////////////////////////////////////////////////////////////////////
+static int replay (const char *fileName, FuzzShared &shared)
+{
+    FILE *fptr = fopen(fileName, "r");
+    char line[512];
+    UINT32 cases = 0, changed = 0;
+
+    if (!fptr) {
+        printf("Can't open %s\n", fileName);
+        return 1;
+    }
+
+    Emulator6803 emu;
+    FuzzContext ctx;
+    setupContext(ctx, emu, shared);
+
+    while (fgets(line, sizeof(line), fptr)) {
+
+        char bucket[256], variantName[64];
+        unsigned mafSum, c1c3, c1c5, ref, value;
+
+        if (line[0] == '#' ||
+            sscanf(line, "%255[^\t]\t%63s %x %x %x %x %x", bucket, variantName, &mafSum, &c1c3,
+                   &c1c5, &ref, &value) != 7)
+            continue;
+
+        int v = 0;
+        while (v < VARIANT_COUNT && strcmp(variants[v].name, variantName) != 0)
+            v++;
+
+        if (v == VARIANT_COUNT || !shared.enabled[v]) {
+            printf("  %s: variant not available here, skipped\n", bucket);
+            continue;
+        }
+
+        FuzzCase c = { (UINT16)mafSum, (UINT16)c1c3, (UINT16)c1c5 };
+        UINT16 nowRef = runCase(shared.reference, c, shared.base, ctx);
+        UINT16 nowValue = runCase(v, c, shared.base, ctx);
+
+        cases++;
+
+        if (nowRef != ref || nowValue != value) {
+            printf("  %s: mafSum 0x%04X XC1C3 0x%04X XC1C5 0x%04X was 0x%04X/0x%04X, now 0x%04X/0x%04X\n",
+              bucket, mafSum, c1c3, c1c5, ref, value, nowRef, nowValue);
+            changed++;
+        }
+    }
+
+    fclose(fptr);
+
+    printf("%u regression cases, %u changed\n", cases, changed);
+
+    return changed ? 2 : 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    TuneImage tune;
+    RomRoutines routines;
+    const char *tuneName = "../../OriginalCode/Reference_Bins/R3526.bin";
+    const char *outName = "mafRegression.txt";
+    const char *replayName = 0;
+    FuzzShared shared;
+
+    shared.rounds = 64;
+    shared.seed = 0x14C0;
+    shared.threads = 0;
+    shared.compared = 0;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-tune") == 0 && arg + 1 < argc)
+            tuneName = argv[++arg];
+        else if (strcmp(argv[arg], "-rounds") == 0 && arg + 1 < argc)
+            shared.rounds = (UINT32)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-seed") == 0 && arg + 1 < argc)
+            shared.seed = (UINT32)strtoul(argv[++arg], 0, 0);
+        else if (strcmp(argv[arg], "-threads") == 0 && arg + 1 < argc)
+            shared.threads = (unsigned)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-out") == 0 && arg + 1 < argc)
+            outName = argv[++arg];
+        else if (strcmp(argv[arg], "-replay") == 0 && arg + 1 < argc)
+            replayName = argv[++arg];
+        else {
+            printf("Usage: MafFuzz [-tune <bin>] [-rounds <n>] [-seed <n>] [-threads <n>] [-out <file>]\n");
+            printf("       MafFuzz [-tune <bin>] -replay <file>\n");
+            return 1;
+        }
+    }
+
+    shared.tune = 0;
+    shared.routines = 0;
+    shared.base = defaultPromConstants();
+
+    if (tune.open(tuneName)) {
+        shared.tune = &tune;
+        shared.base = tune.constants(tune.defaultFuelMap());
+        if (findRomRoutines(tune.data(), routines))
+            shared.routines = &routines;
+        printf("Using %s (tune %04X)%s\n", tune.name(), tune.tuneNumber(),
+          shared.routines ? "" : ", firmware routine not found");
+    }
+    else
+        printf("No PROM image, checking against linearizeMAF_6803\n");
+
+    for (int v = 0; v < VARIANT_COUNT; v++) {
+        bool ok = true;
+        if (variants[v].needsImage && !shared.routines)
+            ok = false;
+#if MAF_BATCH_X86
+        if (variants[v].needsAVX2 && !cpuHasAVX2())
+            ok = false;
+#endif
+        shared.enabled.push_back(ok);
+    }
+
+    shared.reference = shared.routines ? 0 : 1;
+
+    if (replayName)
+        return replay(replayName, shared);
+
+    if (shared.threads == 0)
+        shared.threads = std::thread::hardware_concurrency();
+    if (shared.threads == 0)
+        shared.threads = 1;
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < shared.threads; t++)
+        workers.push_back(std::thread(fuzzWorker, &shared, t));
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("Reference %s; %u passes of %u inputs (tune constants + %u random); %llu compared in %.2f s\n",
+      variants[shared.reference].name, shared.rounds + 1, MAF_INPUTS, shared.rounds,
+      (unsigned long long)shared.compared, seconds);
+
+    for (int v = 0; v < VARIANT_COUNT; v++)
+        if (!shared.enabled[v])
+            printf("  %s not available here\n", variants[v].name);
+
+    // shrink each bucket's first case and write the regression cases
+    FILE *fptr = fopen(outName, "w");
+    if (!fptr) {
+        printf("Can't create %s\n", outName);
+        return 1;
+    }
+
+    fprintf(fptr, "# MafFuzz regression cases, reference %s. Replay with MafFuzz -replay.\n",
+      variants[shared.reference].name);
+    fprintf(fptr, "# bucket\tvariant\tmafSum\tXC1C3\tXC1C5\treference\tvariant\n");
+
+    Emulator6803 emu;
+    FuzzContext ctx;
+    setupContext(ctx, emu, shared);
+
+    FuzzCase target = { 0, shared.base.XC1C3, shared.base.XC1C5 };
+
+    UINT32 newBuckets = 0;
+
+    printf("\n%-52s %12s   shrunk case (mafSum XC1C3 XC1C5)\n", "Bucket", "Mismatches");
+
+    for (BucketMap::iterator it = shared.buckets.begin(); it != shared.buckets.end(); ++it) {
+
+        const Bucket &b = it->second;
+        bool known = variants[b.variant].approximate;
+        FuzzCase c = shrink(b.variant, shared.reference, b.first, target, shared.base, ctx, it->first);
+        UINT16 ref = runCase(shared.reference, c, shared.base, ctx);
+        UINT16 value = runCase(b.variant, c, shared.base, ctx);
+
+        printf("%-52s %12llu   0x%04X 0x%04X 0x%04X%s\n", it->first.c_str(),
+          (unsigned long long)b.count, c.mafSum, c.XC1C3, c.XC1C5, known ? "   known" : "");
+
+        if (!known)
+            newBuckets++;
+
+        fprintf(fptr, "%s\t%s\t%04X\t%04X\t%04X\t%04X\t%04X\n", it->first.c_str(),
+          variants[b.variant].name, c.mafSum, c.XC1C3, c.XC1C5, ref, value);
+    }
+
+    fclose(fptr);
+
+    printf("%u buckets (%u known, %u new), regression cases written to %s\n",
+      (UINT32)shared.buckets.size(), (UINT32)shared.buckets.size() - newBuckets, newBuckets, outName);
+
+    return newBuckets ? 2 : 0;
+}
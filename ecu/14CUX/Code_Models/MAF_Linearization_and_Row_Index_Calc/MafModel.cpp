@@ -13,283 +13,211 @@
 //  In the attempt to do as literal a translation as possible, we use the goto command as well
 //  as byte/word unions.
 //
+//  The models (and the assembly code they are based on) are in ../Common/MafRowIndex.h.
+//
+//  Run with no arguments to produce the original sampled text table (mafAndRowIndex.txt).
+//  Run with "-sweep [file] [threads]" to evaluate the row index over the full input domain
+//  (every MAF sum against every 16-bit ignition period) and write it as a binary surface.
+//  Run with "-bin [file]" to write the sampled table as a binary result file instead (see
+//  ../Common/ResultFile.h and ../Result_Tools/ResultToText.cpp).
+//  Run with "-verify" to check the batch (SIMD) MAF linearization kernels against
+//  linearizeMAF_6803 for every 16-bit input.
+//
+//  The PROM constants used by both sections default to the R3526 values. Add "-tune <bin>"
+//  (and optionally "-map <n>") to read them from a PROM image instead, for example:
+//
+//      MafModel -tune ../../OriginalCode/Reference_Bins/R3652.bin -sweep
+//
+//  The swept surface is kept in the result cache (../Common/ResultCache.h) under a hash of
+//  the constants, so sweeping any tune with the same constants again just copies it out.
+//  Add "-nocache" (with the options above) to sweep regardless.
+//
+//
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
-/*
-;--------------------------------------------------------------------------------------------
-;                         MAF Sensor Linearization 
-;
-; This section executes unless the MAF failure bit is set. It linearizes the  MAF output and
-; stores the 16-bit result (normally in X204D/4E) for later use in determining the fuel map
-; row (load based) index.
-;
-; The MAF reads about 300 decimal at idle and the maximum possible value is 10 bits or 1023
-; decimal. This results in a linearized range of approximately 600 at idle to slightly over
-; 17,000 decimal.
-;
-; The loop part of this code is a 16-bit squaring function:
-;       Input:      16-bit value in AB
-;       Output:     (AB * AB) / 0x10000
-;
-; When entering this section of code, 0x00C8/C9 holds the sum of MAF Low and MAF High. The
-; squaring loop is run twice. The 'C' code equivalent of the whole code section is listed
-; here:
-;
-;       x = 8 * mafSum + 8797;
-;       x = (UINT16)((x * x) / 0x10000);
-;       x = (UINT16)(2 * (2 * x - 2496));
-;       x = (UINT16)((x * x) / 0x10000);
-;       Store result in 00CA/CB for use in 16-bit mpy (for FM row index calc)
-;       Store result in 004D/4E for use elsewhere
-;
-;--------------------------------------------------------------------------------------------
-.linearizeMaf   ldd         $00C8               ; reload MAF sum
-                asld                            ; 2x
-                asld                            ; 4x
-                asld                            ; 8x
-                addd        $C1C3               ; data value is $225D (8797 dec)
-
-.linMafLoop     staa        $00C8               ; squaring function starts here
-                mul
-                staa        $00C9
-                ldaa        $00C8
-                tab
-                mul
-                addb        $00C9
-                adca        #$00
-                addb        $00C9
-                adca        #$00                ; squaring function ends here
-                
-                com         $00CE               ; previously cleared at code address LDCEB
-                beq         .LDF30              ; 1's comp forced branch out here on 2nd pass
-                asld
-                subd        $C1C5               ; data value is $09C0 (2496 dec)
-                bcc         .LDF2D
-                ldd         #$0000              ; if negative, limit to zero
-
-.LDF2D          asld
-                bra         .linMafLoop         ; end loop
-
-.LDF30          std         $00CA               ; store it here for 16-bit mpy
-                std         mafLinear           ; also store it in normal location
-
----------------------------------------------------------------------------------------------------
-
-
-
-
-;---------------------------------------------------------------------------------------------------
-;                *** Calculate Fuel Map Load Value (Row Index) ***
-;
-; This value, which is normally stored at X005B, is calculated from both air flow and engine speed.
-;
-; The Linearized MAF is calculated above and is stored in the normal X004D/4E locations and the
-; X00CA/CB temporary location.
-;
-; The row index value is clipped low at 0x00 and high at 0x70 so that it is confined to the range
-; of the 8 row fuel map table.
-;   
-;---------------------------------------------------------------------------------------------------
-                ldd         ignPeriod           ; load 16-bit ignition period (instantaneous)
-                jsr         mpy16               ; call 16-bit mpy routine, mpy ignPeriod by mafLinear
-                subd        $C1C7               ; data value is $001E (subtract this)
-                bcc         .LDF61              ; branch ahead if value is still positive
-                clra                            ; else, clear A
-                bra         .LDF6F              ; and branch
-
-.LDF61          lsrd                            ; logical shift right double
-                tsta                            ; test A for zero
-                bne         .LDF6D              ; branch ahead to load $70
-                ldaa        $200A               ; X200A gets initialized from fuel map byte offset $10A
-                mul
-                cmpa        #$70                ; compare A with $70
-                bcs         .LDF6F              ; if A <= $70, branch to store as fuel map row index
-
-.LDF6D          ldaa        #$70                ; else store $70
-
-.LDF6F          staa        fuelMapLoadIdx      ; store value as 'fuelMapLoadIdx'
-
-;---------------------------------------------------------------------------------------------------
-*/
 
 #include <stdio.h>
-#include <conio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/MafRowIndex.h"
+#include "../Common/MafLinearizeBatch.h"
+#include "../Common/ResultFile.h"
+#include "../Common/ResultCache.h"
 
-typedef   signed char  CHAR;
-typedef unsigned char  UCHAR;
-typedef unsigned char  UINT8;
-typedef unsigned short UINT16;
-typedef unsigned long  DWORD;
 
 
-#define A 1     // these are reversed due to the endian issue
-#define B 0
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Full domain sweep
+//
+//  The MAF sum is the sum of two 10-bit readings (0 to 2046) and the ignition
+//  period is a 16-bit value, so the whole row index surface is 2047 x 65536
+//  (about 134M) calls to Calculate_Row_Index. The linearized MAF value only
+//  depends on the MAF sum, so it is calculated once per row. The rows are
+//  split into blocks and handed to one worker thread per core.
+//
+//  The surface is written as a result file (see ../Common/ResultFile.h) with
+//  a mafSum axis, a period axis and a single rowIndex column, so row
+//  (mafSum * 65536 + period) is the fuelMapLoadIdx for that pair.
+//
+//  The surface only depends on the PROM constants, so it is looked up in the
+//  result cache first. On a hit the rows come straight from the mapped entry.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define SWEEP_MAF_SUMS      2047        // 0 to 2046
+#define SWEEP_PERIODS       65536       // 0x0000 to 0xFFFF
 
-#define C8 1    // (ditto)
-#define C9 0
+#define SAMPLE_STEP         20          // MAF counts between points in the text table
+#define SAMPLE_POINTS       ((1023 + SAMPLE_STEP) / SAMPLE_STEP)
 
 
-// The A and B accumulators can be used as separate 8-bit registers
-// or together as a 16-bit register. A union is perfect for modelling this.
-// X00C8 and X00C9 are used in a similar way
-union ABunion
+static void sweepRows (UINT8 *surface, const UINT16 *linearMAF, UINT32 firstRow, UINT32 lastRow,
+                       PromConstants prom)
 {
-   UINT16 ab;
-   UCHAR  r[2];
-};
+    Cpu6803 cpu;                            // this worker's registers
+
+    for (UINT32 mafSum = firstRow; mafSum < lastRow; mafSum++) {
 
-ABunion reg;                               // the AB register pair
+        UINT8 *row = surface + (size_t)mafSum * SWEEP_PERIODS;
 
+        for (UINT32 period = 0; period < SWEEP_PERIODS; period++)
+            row[period] = Calculate_Row_Index (cpu, (UINT16)period, linearMAF[mafSum], prom);
+    }
+}
 
-union memUnion
+
+static int sweepSurface (const char *fileName, unsigned threadCount, const TuneImage &tune,
+                         int mapNumber, const PromConstants &prom, bool useCache)
 {
-   UINT16 c8c9;
-   UCHAR  m[2];
-};
+    std::vector<UINT8> surface;
+    std::vector<std::thread> workers;
+    UINT16 mafSums[SWEEP_MAF_SUMS];
+    UINT16 linearMAF[SWEEP_MAF_SUMS];
+    ResultCache cache;
+    ResultKey key("rowSurface");
+    ResultFile cached;
+    int column;
 
-memUnion mem;                               // 16-bit memory location
+    key.add(prom);
+    key.addValue(SWEEP_MAF_SUMS);
+    key.addValue(SWEEP_PERIODS);
 
+    if (useCache && cache.find(key, cached) && (column = cached.findColumn("rowIndex")) >= 0 &&
+        cached.rowCount() == (UINT64)SWEEP_MAF_SUMS * SWEEP_PERIODS) {
 
+        ResultWriter writer(RESULT_LAYOUT_ROW_SURFACE, &tune, mapNumber, prom);
 
-///////////////////////////////////////////////////////////////////////////////
-//
-//  LinearizeMAFin_C
-//
-//  This is my understanding of what the assembly language code is actually
-//  doing.
-//
-///////////////////////////////////////////////////////////////////////////////
-UINT16 linearizeMAF_C (UINT16 mafSum)
-{
-    UINT16  XC1C3 = 0x225D;
-    UINT16  XC125 = 0x09C0;
-	UINT16 x;
+        printf("Row index surface from %s\n", cache.path(key).c_str());
 
+        writer.addAxis("mafSum", 0, 1, SWEEP_MAF_SUMS);
+        writer.addAxis("period", 0, 1, SWEEP_PERIODS);
+        writer.addColumn("rowIndex", 1, cached.data8((UINT32)column));
 
-	x = 8 * mafSum + XC1C3;
-	x = (UINT16)((x * x) / 0x10000);
+        return writer.write(fileName) ? 0 : 1;
+    }
 
-    if (x > 2496/2)
-	    x = (UINT16)(2 * (2 * x - XC125));
-    else
-        x = 0;
+    surface.resize((size_t)SWEEP_MAF_SUMS * SWEEP_PERIODS);
 
-	x = (UINT16)((x * x) / 0x10000);
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+        threadCount = 1;
 
-    return (x);
+    auto start = std::chrono::steady_clock::now();
 
-}
+    for (UINT32 mafSum = 0; mafSum < SWEEP_MAF_SUMS; mafSum++)
+        mafSums[mafSum] = (UINT16)mafSum;
 
+    linearizeMAF_Batch (mafSums, linearMAF, SWEEP_MAF_SUMS, prom);
 
-///////////////////////////////////////////////////////////////////////////////
-//
-//  LinearizeMAF_6803
-//
-//  This a literal translation of the 6803 assembly code.
-//
-//  Note about possible compiler hazard...
-//  Although there are arithmetic shifts, they are left shifts, so there
-//  should be no problem with possible differences in compiler implementation
-//  (logical vs arithmetic).
-//
-///////////////////////////////////////////////////////////////////////////////
-UINT16 linearizeMAF_6803 (UINT16 mafSum)
-{
-    UINT16  XC1C3 = 0x225D;
-    UCHAR   X00CE = 0;
-    UINT16  X00CA;
-    UINT16  X204D;
-    UINT16  XC125 = 0x09C0;
-
-
-    mem.c8c9 = mafSum;
-
-//LDF03:
-    reg.ab = mem.c8c9;                      // ldd   X00C8
-    reg.ab <<= 1;                           // asld
-    reg.ab <<= 1;                           // asld
-    reg.ab <<= 1;                           // asld
-    reg.ab += XC1C3;                        // addd  XC1C3
-
-LDF0E:
-    mem.m[C8] = reg.r[A];                   // staa  X00C8
-    reg.ab = reg.r[A] * reg.r[B];           // mul
-    mem.m[C9] = reg.r[A];                   // staa  X00C9
-    reg.r[A] = mem.m[C8];                   // ldaa  X00C8
-    reg.r[B] = reg.r[A];                    // tab
-    reg.ab = reg.r[A] * reg.r[B];           // mul
-    reg.ab += mem.m[C9];                    // addb  X00C9, adca  #$00
-    reg.ab += mem.m[C9];                    // addb  X00C9, adca  #$00
-    X00CE = ~X00CE;                         // com  (1's complement)
-    if (!X00CE) goto LDF30;                 // beq   LDF30
-    reg.ab <<= 1;                           // asld
-    reg.ab -= XC125;                        // subd  XC1C5
-    if (!(reg.ab & 0x8000)) goto LDF2D;     // bcc   LDF2D
-    reg.ab = 0x0000;                        // ldd   #$0000
-LDF2D:
-    reg.ab <<= 1;                           // asld
-    goto LDF0E;                             // bra   LDF0E
-
-LDF30:
-    X00CA = reg.ab;                         // std   X00CA
-    X204D = reg.ab;                         // std   X204D
-
-    return X204D;
+    UINT32 rowsPerThread = (SWEEP_MAF_SUMS + threadCount - 1) / threadCount;
+
+    for (UINT32 first = 0; first < SWEEP_MAF_SUMS; first += rowsPerThread) {
+        UINT32 last = first + rowsPerThread;
+        if (last > SWEEP_MAF_SUMS)
+            last = SWEEP_MAF_SUMS;
+        workers.push_back(std::thread(sweepRows, surface.data(), linearMAF, first, last, prom));
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("Swept %u x %u points on %u threads in %.2f seconds\n",
+      SWEEP_MAF_SUMS, SWEEP_PERIODS, (unsigned)workers.size(), seconds);
+
+    ResultWriter writer(RESULT_LAYOUT_ROW_SURFACE, &tune, mapNumber, prom);
+
+    writer.addAxis("mafSum", 0, 1, SWEEP_MAF_SUMS);
+    writer.addAxis("period", 0, 1, SWEEP_PERIODS);
+    writer.addColumn("rowIndex", 1, surface.data());
+
+    if (useCache)
+        cache.store(key, writer);
+
+    return writer.write(fileName) ? 0 : 1;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
 //
-//  Calculate_Row_Index
-//
-//  There are two values in this formula that come from the data section of the
-//  PROM. They are:
-//  
-//  X2005 - This is a multiplier factor that is pulled from the current fuel
-//          map at offset $10A. This is the first value after the map's ADC
-//          control table. It is stored in RAM location X2005 for use. This
-//          is a byte value and is often (but not always) $B2.
-//
-//  XC1C7 - This is a 16-bit value in the data section. It is outside of the
-//          fuel map data and does not change with fuel map changes. This
-//          value is typically $001E.
+//  Batch kernel check
 //
-//  This routine takes the ignition period and the linearized MAF readings as
-//  arguments and returns the 8-bit row index value (clipped between $00 min
-//  and $70 max).
+//  Runs every 16-bit input through each of the batch MAF linearization
+//  kernels this CPU can run and compares them with linearizeMAF_6803.
 //
 ///////////////////////////////////////////////////////////////////////////////
-UINT8 Calculate_Row_Index (UINT16 ignitionPeriod, UINT16 linearMAF)
+static UINT32 checkKernel (const char *name, MafBatchKernel kernel, const UINT16 *input,
+                           const UINT16 *expected, const PromConstants &prom)
 {
-    UINT8  X2005 = 0xB2;
-    UINT16 XC1C7 = 0x001E;
-
-    reg.ab = ignitionPeriod;                        // ldd         ignPeriod
-    reg.ab = (UINT16)((reg.ab * linearMAF) >> 16);  // jsr         mpy16
-    if (reg.ab > XC1C7) {
-        reg.ab -= XC1C7;                            // subd        $C1C7
-        goto LDF61;                                 // bcc         .LDF61
-    }
+    std::vector<UINT16> output(SWEEP_PERIODS);
+    UINT32 mismatches = 0;
 
-    reg.r[A] = 0;                                   // clra
-    goto LDF6F;                                     // bra         .LDF6F
+    auto start = std::chrono::steady_clock::now();
+    kernel (input, output.data(), SWEEP_PERIODS, prom);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-LDF61:                                              // .LDF61       lsrd
-                                                    //
-    if (reg.r[A] != 0)                              // tsta                       
-        goto LDF6D;                                 // bne         .LDF6D   
+    for (UINT32 i = 0; i < SWEEP_PERIODS; i++)
+        if (output[i] != expected[i])
+            mismatches++;
 
-    reg.r[A] = X2005;                               // ldaa        $200A          
-    reg.r[A] = (reg.r[A] * reg.r[B]) >> 8;          // mul
-    if (reg.r[A] <= 0x70)                           // cmpa        #$70           
-        goto LDF6F;                                 // bcs         .LDF6F         
+    printf("%-8s %6u mismatches  %8.3f ms\n", name, mismatches, seconds * 1000.0);
 
-LDF6D:  reg.r[A] = 0x70;                            // .LDF6D          ldaa        #$70           
+    return mismatches;
+}
 
-LDF6F:  return (reg.r[A]);                          // .LDF6F          staa        fuelMapLoadIdx 
 
-}
+static int verifyKernels (const PromConstants &prom)
+{
+    std::vector<UINT16> input(SWEEP_PERIODS);
+    std::vector<UINT16> expected(SWEEP_PERIODS);
+    UINT32 mismatches = 0;
+
+    for (UINT32 i = 0; i < SWEEP_PERIODS; i++) {
+        input[i] = (UINT16)i;
+        expected[i] = linearizeMAF_6803 ((UINT16)i, prom);
+    }
 
+    printf("Batch kernel used on this CPU: %s\n", mafBatchKernelName());
+
+    mismatches += checkKernel ("scalar", linearizeMAF_BatchScalar, input.data(), expected.data(), prom);
+#if MAF_BATCH_X86
+    mismatches += checkKernel ("SSE2", linearizeMAF_BatchSSE2, input.data(), expected.data(), prom);
+    if (cpuHasAVX2())
+        mismatches += checkKernel ("AVX2", linearizeMAF_BatchAVX2, input.data(), expected.data(), prom);
+#endif
+    mismatches += checkKernel ("dispatch", linearizeMAF_Batch, input.data(), expected.data(), prom);
+
+    return mismatches ? 1 : 0;
+}
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -299,30 +227,97 @@ LDF6F:  return (reg.r[A]);                          // .LDF6F          staa
 //  This scans through the MAF voltage range and calls the routines above.
 //
 ///////////////////////////////////////////////////////////////////////////////
-void main(void)
+int main(int argc, char *argv[])
 {
     UINT16 mafCounts;
     FILE *fptr;
     UINT16 linearVal1, linearVal2;
     UINT8 rowIndex[3];
+    UINT16 linearC[SAMPLE_POINTS], linear6803[SAMPLE_POINTS];
+    UINT8 row900[SAMPLE_POINTS], row3100[SAMPLE_POINTS], row5102[SAMPLE_POINTS];
+    const char *binName = 0;
+    int sample = 0;
+    TuneImage tune;
+    PromConstants prom = defaultPromConstants();
+    int mapNumber = -1;
+    bool useCache = true;
+    bool badArg = false;
+    int arg = 1;
+
+    while (arg < argc) {
+        if (strcmp(argv[arg], "-tune") == 0 && arg + 1 < argc) {
+            if (!tune.open(argv[arg + 1]))
+                return 1;
+            arg += 2;
+        }
+        else if (strcmp(argv[arg], "-map") == 0 && arg + 1 < argc) {
+            mapNumber = atoi(argv[arg + 1]);
+            if (mapNumber < 0 || mapNumber >= FUEL_MAP_COUNT)
+                badArg = true;
+            arg += 2;
+        }
+        else if (strcmp(argv[arg], "-nocache") == 0) {
+            useCache = false;
+            arg++;
+        }
+        else
+            break;
+    }
 
-	fptr = fopen("mafAndRowIndex.txt", "w");
+    // then at most one of -verify, -sweep [file] [threads] or -bin [file]
+    if (arg < argc && strcmp(argv[arg], "-verify") != 0 && strcmp(argv[arg], "-sweep") != 0 &&
+        strcmp(argv[arg], "-bin") != 0)
+        badArg = true;
+
+    if (badArg) {
+        printf("Usage: MafModel [-tune <bin>] [-map <0-5>] [-nocache] [-verify | -sweep [file] [threads] | -bin [file]]\n");
+        return 1;
+    }
+
+    if (tune.isOpen()) {
+        if (mapNumber < 0)
+            mapNumber = tune.defaultFuelMap();
+        prom = tune.constants(mapNumber);
+        printf("%s (tune %04X) fuel map %d: C1C3=$%04X C1C5=$%04X C1C7=$%04X 200A=$%02X\n",
+          tune.name(), tune.tuneNumber(), mapNumber, prom.XC1C3, prom.XC1C5, prom.XC1C7, prom.X200A);
+    }
+
+    if (arg < argc && strcmp(argv[arg], "-verify") == 0)
+        return verifyKernels (prom);
+
+    if (arg < argc && strcmp(argv[arg], "-sweep") == 0) {
+        return sweepSurface ((arg + 1 < argc) ? argv[arg + 1] : "rowIndexSurface.bin",
+                             (arg + 2 < argc) ? (unsigned)atoi(argv[arg + 2]) : 0, tune, mapNumber, prom,
+                             useCache);
+    }
+
+    if (arg < argc && strcmp(argv[arg], "-bin") == 0) {
+        binName = (arg + 1 < argc) ? argv[arg + 1] : "mafAndRowIndex.bin";
+    }
+
+    fptr = binName ? 0 : fopen("mafAndRowIndex.txt", "w");
 
     if (fptr) {
             fprintf( fptr, "MAF Volts   MAF Counts   Linear C    Linear 6800    900  3100  5102\n");
             fprintf( fptr, "--------------------------------------------------------------------\n");
     }
 
-	for (mafCounts = 0; mafCounts < 1024; mafCounts += 20) {
+	for (mafCounts = 0; mafCounts < 1024; mafCounts += SAMPLE_STEP) {
 
-        linearVal1 = linearizeMAF_C (2 * mafCounts);
+        linearVal1 = linearizeMAF_C (2 * mafCounts, prom);
 
-        linearVal2 = linearizeMAF_6803 (2 * mafCounts);
+        linearVal2 = linearizeMAF_6803 (2 * mafCounts, prom);
 
-        rowIndex[0] = Calculate_Row_Index (0x208D, linearVal2);     //  900 RPM
-        rowIndex[1] = Calculate_Row_Index (0x0973, linearVal2);     // 3100 RPM
-        rowIndex[2] = Calculate_Row_Index (0x0553, linearVal2);     // 5102 RPM
+        rowIndex[0] = Calculate_Row_Index (0x208D, linearVal2, prom);     //  900 RPM
+        rowIndex[1] = Calculate_Row_Index (0x0973, linearVal2, prom);     // 3100 RPM
+        rowIndex[2] = Calculate_Row_Index (0x0553, linearVal2, prom);     // 5102 RPM
 
+        linearC[sample] = linearVal1;
+        linear6803[sample] = linearVal2;
+        row900[sample] = rowIndex[0];
+        row3100[sample] = rowIndex[1];
+        row5102[sample] = rowIndex[2];
+        sample++;
 
         if (fptr)
             fprintf( fptr, "%5.2f  \t  %5u  \t  %5u  \t  %5u    0x%02X  0x%02X  0x%02X\n", 
@@ -332,4 +327,18 @@ void main(void)
     if (fptr)
         fclose(fptr);
 
+    if (binName) {
+        ResultWriter writer(RESULT_LAYOUT_MAF_ROW_INDEX, &tune, mapNumber, prom);
+
+        writer.addAxis("mafCounts", 0, SAMPLE_STEP, SAMPLE_POINTS);
+        writer.addColumn("linearC", 2, linearC);
+        writer.addColumn("linear6803", 2, linear6803);
+        writer.addColumn("row900", 1, row900);
+        writer.addColumn("row3100", 1, row3100);
+        writer.addColumn("row5102", 1, row5102);
+
+        return writer.write(binName) ? 0 : 1;
+    }
+
+    return 0;
 }
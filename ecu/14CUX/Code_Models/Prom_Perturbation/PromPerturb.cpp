@@ -0,0 +1,492 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX PROM Constant Perturbation
+//
+//  Evaluates the fuel map row index surface (every MAF sum against every ignition period)
+//  under a batch of changed PROM constants and reports, for each set, which cells move
+//  and by how much compared with the tune's own constants. The constants are the ones
+//  linearizeMAF_C and Calculate_Row_Index take in a PromConstants (../Common/TuneImage.h):
+//
+//      XC1C3   added to 8 x MAF sum ($225D)
+//      XC1C5   subtracted after the 1st squaring ($09C0)
+//      XC1C7   subtracted from the mpy16 result ($001E)
+//      X200A   fuel map row multiplier ($B2, from the fuel map)
+//
+//  so the effect of rescaling for a different MAF sensor or a larger engine can be seen
+//  for many candidate sets in one run instead of by editing and rebuilding each time.
+//
+//  The comparison is done by ../Common/PromPerturbation.h, one set per worker thread at a
+//  time. By default the batch is every constant changed on its own by -20, -10, -5, -2,
+//  -1, +1, +2, +5, +10 and +20% (at least one count); -set gives sets of its own instead
+//  and -random adds sets with all four constants changed at once. With -verify each set
+//  is also compared cell by cell through the SIMD row index kernel, as a check, and the
+//  models the comparison is built on are checked against the firmware: the set's constants
+//  are patched into a copy of the PROM image, and the real .linearizeMaf and row index code
+//  is run in the 6803 emulator (../Common/RomRoutines.h) for every MAF sum and, for each
+//  distinct linearized value, every 128th ignition period. Without -tune the firmware is
+//  taken from the R3526 reference image. -verify also adds two sets with XC1C5 at $8000 or
+//  above, where the clamp after 'subd $C1C5' is only right if it is a borrow test.
+//
+//  Two tab delimited files are written, with the set number as the first column:
+//
+//      promPerturb.txt     per set and MAF sum that moved: linearized MAF before and after,
+//                          cells moved (in all and in the RPM range), the smallest and
+//                          largest shift and the lowest and highest period that moved
+//      promShifts.txt      with -shifts, every run of cells moved by the same amount
+//                          (MAF sum, first and last period, row index before and after)
+//
+//  Usage: PromPerturb [-tune <bin>] [-map <n>] [-rpm <low> <high>] [-threads <n>]
+//                     [-set <c1c3> <c1c5> <c1c7> <200a>] ... [-random <n> <percent>]
+//                     [-shifts] [-verify]
+//
+//      -tune       PROM image to take the base constants from (default is the R3526 values)
+//      -rpm        range counted separately (default 120 to 6500)
+//      -set        a set of constants to compare (hex with 0x, or decimal); may be repeated
+//      -random     n sets with every constant changed by up to percent either way
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/PromPerturbation.h"
+#include "../Common/Emulator6803.h"
+#include "../Common/RomRoutines.h"
+#include "../Common/Random.h"
+
+
+static const double gridPercent[] = { -20.0, -10.0, -5.0, -2.0, -1.0, 1.0, 2.0, 5.0, 10.0, 20.0 };
+#define GRID_STEPS          (int)(sizeof(gridPercent) / sizeof(gridPercent[0]))
+
+#define SURFACE_CELLS       ((double)SURFACE_MAF_SUMS * SURFACE_PERIODS)
+#define ROM_PERIOD_STEP     128         // periods run through the firmware with -verify
+#define ROM_DEFAULT_IMAGE   "../../OriginalCode/Reference_Bins/R3526.bin"
+
+
+static double periodToRpm (UINT32 period)
+{
+    return period ? 7500000.0 / period : 0.0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Building the batch
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// value changed by percent, by at least one count, kept in range
+static UINT32 perturb (UINT32 value, double percent, UINT32 limit)
+{
+    long step = (long)(value * percent / 100.0 + ((percent < 0.0) ? -0.5 : 0.5));
+    long result;
+
+    if (step == 0)
+        step = (percent < 0.0) ? -1 : 1;
+
+    result = (long)value + step;
+
+    if (result < 0)
+        result = 0;
+    if (result > (long)limit)
+        result = (long)limit;
+
+    return (UINT32)result;
+}
+
+static PromConstants perturbOne (const PromConstants &base, int constant, double percent)
+{
+    PromConstants k = base;
+
+    switch (constant) {
+    case 0:     k.XC1C3 = (UINT16)perturb(k.XC1C3, percent, 0xFFFF);    break;
+    case 1:     k.XC1C5 = (UINT16)perturb(k.XC1C5, percent, 0xFFFF);    break;
+    case 2:     k.XC1C7 = (UINT16)perturb(k.XC1C7, percent, 0xFFFF);    break;
+    case 3:     k.X200A = (UINT8)perturb(k.X200A, percent, 0xFF);       break;
+    }
+
+    return k;
+}
+
+// small constants round to the same set for several steps; each goes in once
+static void gridSets (const PromConstants &base, std::vector<PromConstants> &sets)
+{
+    for (int constant = 0; constant < 4; constant++)
+        for (int step = 0; step < GRID_STEPS; step++) {
+            PromConstants k = perturbOne(base, constant, gridPercent[step]);
+
+            if (!sets.empty() && sets.back().XC1C3 == k.XC1C3 && sets.back().XC1C5 == k.XC1C5 &&
+                sets.back().XC1C7 == k.XC1C7 && sets.back().X200A == k.X200A)
+                continue;
+            sets.push_back(k);
+        }
+}
+
+static void randomSets (const PromConstants &base, int count, double percent, std::vector<PromConstants> &sets)
+{
+    XorShift rng(0x14C1C3);
+
+    for (int n = 0; n < count; n++) {
+        PromConstants k = base;
+
+        for (int constant = 0; constant < 4; constant++) {
+            double change = percent * (2.0 * (rng.next() % 10001) / 10000.0 - 1.0);
+            k = perturbOne(k, constant, change);
+        }
+
+        sets.push_back(k);
+    }
+}
+
+
+// Added with -verify: XC1C5 past $8000, where a sign bit test in place of the
+// firmware's borrow test gets most MAF sums wrong
+static void verifySets (const PromConstants &base, std::vector<PromConstants> &sets)
+{
+    PromConstants k = base;
+
+    k.XC1C5 = 0xC000;
+    sets.push_back(k);
+
+    k = base;
+    k.XC1C3 = 0x1000;
+    k.XC1C5 = 0x8939;
+    sets.push_back(k);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  romMismatches
+//
+//  Runs the set's constants through the firmware and counts the MAF sums
+//  whose linearized value differs from d.linearMAF and the (period, linear
+//  MAF) points whose row index differs from rowIndex_Scalar.
+//
+///////////////////////////////////////////////////////////////////////////////
+static void patchWord (std::vector<UCHAR> &image, UINT16 addr, UINT16 value)
+{
+    image[addr - PROM_BASE] = (UCHAR)(value >> 8);
+    image[addr - PROM_BASE + 1] = (UCHAR)value;
+}
+
+static UINT32 romMismatches (const UCHAR *image, const RomRoutines &r, const SurfaceDiff &d)
+{
+    std::vector<UCHAR> patched(image, image + PROM_SIZE);
+    std::vector<bool> seen(0x10000, false);
+    Emulator6803 emu;
+    UINT32 mismatches = 0;
+
+    patchWord(patched, ADDR_MAF_OFFSET, d.prom.XC1C3);
+    patchWord(patched, ADDR_MAF_SUBTRACT, d.prom.XC1C5);
+    patchWord(patched, ADDR_ROW_OFFSET, d.prom.XC1C7);
+    loadRomRoutines(emu, &patched[0], r);
+
+    for (UINT16 m = 0; m < SURFACE_MAF_SUMS; m++) {
+
+        UINT16 linear = romLinearizeMAF(emu, r, m);
+
+        if (linear != d.linearMAF[m]) {
+            mismatches++;
+            continue;
+        }
+
+        if (seen[linear])
+            continue;
+        seen[linear] = true;
+
+        for (UINT32 p = 0; p < SURFACE_PERIODS; p += ROM_PERIOD_STEP)
+            if (romRowIndex(emu, r, (UINT16)p, linear, d.prom.X200A) != rowIndex_Scalar((UINT16)p, linear, d.prom))
+                mismatches++;
+    }
+
+    return mismatches;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Output
+//
+///////////////////////////////////////////////////////////////////////////////
+static void writeRowFile (const char *fileName, const RowSurfaceDiffer &differ,
+                          const std::vector<SurfaceDiff> &diffs)
+{
+    FILE *fptr = fopen(fileName, "w");
+
+    if (!fptr) {
+        printf("Could not open %s for writing\n", fileName);
+        return;
+    }
+
+    fprintf(fptr, "Set\tXC1C3\tXC1C5\tXC1C7\tX200A\tmafSum\tLinear before\tLinear after\tCells\t"
+                  "RPM range cells\tMin shift\tMax shift\tFirst period\tLast period\tHigh RPM\tLow RPM\n");
+
+    for (size_t s = 0; s < diffs.size(); s++) {
+
+        const SurfaceDiff &d = diffs[s];
+
+        for (int m = 0; m < SURFACE_MAF_SUMS; m++) {
+
+            const SurfaceRowShift &row = d.byMafSum[m];
+
+            if (!row.cells)
+                continue;
+
+            fprintf(fptr, "%u\t0x%04X\t0x%04X\t0x%04X\t0x%02X\t%d\t%u\t%u\t%u\t%u\t%d\t%d\t0x%04X\t0x%04X\t%.0f\t%.0f\n",
+              (unsigned)s + 1, d.prom.XC1C3, d.prom.XC1C5, d.prom.XC1C7, d.prom.X200A, m,
+              differ.baseLinearMAF()[m], d.linearMAF[m], row.cells, row.windowCells, row.minDelta,
+              row.maxDelta, row.firstPeriod, row.lastPeriod, periodToRpm(row.firstPeriod),
+              periodToRpm(row.lastPeriod));
+        }
+    }
+
+    fclose(fptr);
+}
+
+static void writeShiftFile (const char *fileName, const std::vector<SurfaceDiff> &diffs)
+{
+    FILE *fptr = fopen(fileName, "w");
+
+    if (!fptr) {
+        printf("Could not open %s for writing\n", fileName);
+        return;
+    }
+
+    fprintf(fptr, "Set\tmafSum\tFirst period\tLast period\tRow before\tRow after\tShift\n");
+
+    for (size_t s = 0; s < diffs.size(); s++)
+        for (size_t i = 0; i < diffs[s].shifts.size(); i++) {
+            const SurfaceShift &shift = diffs[s].shifts[i];
+            fprintf(fptr, "%u\t%u\t0x%04X\t0x%04X\t0x%02X\t0x%02X\t%d\n", (unsigned)s + 1, shift.mafSum,
+              shift.firstPeriod, shift.lastPeriod, shift.before, shift.after,
+              (int)shift.after - (int)shift.before);
+        }
+
+    fclose(fptr);
+}
+
+// The constant, marked if it differs from the base
+static void printConstant (UINT32 value, UINT32 base, int digits)
+{
+    printf(" %s%0*X%c", (digits == 2) ? "  $" : "$", digits, value, (value != base) ? '*' : ' ');
+}
+
+static void printSummary (const RowSurfaceDiffer &differ, const std::vector<SurfaceDiff> &diffs,
+                          const std::vector<int> &verified, const std::vector<int> &romVerified,
+                          UINT32 rpmLow, UINT32 rpmHigh)
+{
+    const PromConstants &base = differ.base();
+
+    printf("\nRow index cells moved from the base surface (%.0f cells), %u to %u RPM counted separately\n"
+           "(* marks the constants that differ from the base)\n\n", SURFACE_CELLS, rpmLow, rpmHigh);
+    printf("Set   XC1C3  XC1C5  XC1C7  X200A   MAF sums     Cells       %%  RPM range       %%"
+           "      Shift   Mean    MAF sum   RPM range moved");
+    if (!verified.empty())
+        printf("  Scan");
+    if (!romVerified.empty())
+        printf("   ROM");
+    printf("\n----------------------------------------------------------------------------------"
+           "--------------------------------------------------");
+    if (!verified.empty())
+        printf("------");
+    if (!romVerified.empty())
+        printf("------");
+    printf("\n");
+
+    for (size_t s = 0; s < diffs.size(); s++) {
+
+        const SurfaceDiff &d = diffs[s];
+        int firstSum = -1, lastSum = -1;
+        UINT32 firstPeriod = 0xFFFF, lastPeriod = 0;
+
+        for (int m = 0; m < SURFACE_MAF_SUMS; m++)
+            if (d.byMafSum[m].cells) {
+                if (firstSum < 0)
+                    firstSum = m;
+                lastSum = m;
+                if (d.byMafSum[m].firstPeriod < firstPeriod)
+                    firstPeriod = d.byMafSum[m].firstPeriod;
+                if (d.byMafSum[m].lastPeriod > lastPeriod)
+                    lastPeriod = d.byMafSum[m].lastPeriod;
+            }
+
+        printf("%3u ", (unsigned)s + 1);
+        printConstant(d.prom.XC1C3, base.XC1C3, 4);
+        printConstant(d.prom.XC1C5, base.XC1C5, 4);
+        printConstant(d.prom.XC1C7, base.XC1C7, 4);
+        printConstant(d.prom.X200A, base.X200A, 2);
+        printf("  %8u %9llu %7.3f %10llu %7.3f", d.rows, (unsigned long long)d.cells, 100.0 * d.cells / SURFACE_CELLS,
+          (unsigned long long)d.windowCells, 100.0 * d.windowCells / SURFACE_CELLS);
+
+        if (d.cells)
+            printf("  %+4d/%+-4d %6.2f  %4d-%-4d  %5.0f-%-5.0f", d.minDelta, d.maxDelta, meanSurfaceDelta(d),
+              firstSum, lastSum, periodToRpm(lastPeriod), periodToRpm(firstPeriod));
+        else
+            printf("          -      -          -              -");
+
+        if (!verified.empty())
+            printf("  %4s", (verified[s] < 0) ? "-" : verified[s] ? "ok" : "FAIL");
+        if (!romVerified.empty())
+            printf("  %4s", (romVerified[s] < 0) ? "-" : romVerified[s] ? "ok" : "FAIL");
+
+        printf("\n");
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    TuneImage tune;
+    PromConstants base = defaultPromConstants();
+    std::vector<PromConstants> sets;
+    int mapNumber = -1, randomCount = 0;
+    double randomPercent = 0.0;
+    UINT32 rpmLow = 120, rpmHigh = 6500;
+    unsigned threads = 0;
+    bool keepShifts = false, runVerify = false;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-tune") == 0 && arg + 1 < argc) {
+            if (!tune.open(argv[++arg]))
+                return 1;
+        }
+        else if (strcmp(argv[arg], "-map") == 0 && arg + 1 < argc)
+            mapNumber = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-rpm") == 0 && arg + 2 < argc) {
+            rpmLow = (UINT32)atoi(argv[++arg]);
+            rpmHigh = (UINT32)atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "-threads") == 0 && arg + 1 < argc)
+            threads = (unsigned)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-set") == 0 && arg + 4 < argc) {
+            PromConstants k;
+            k.XC1C3 = (UINT16)strtol(argv[++arg], 0, 0);
+            k.XC1C5 = (UINT16)strtol(argv[++arg], 0, 0);
+            k.XC1C7 = (UINT16)strtol(argv[++arg], 0, 0);
+            k.X200A = (UINT8)strtol(argv[++arg], 0, 0);
+            sets.push_back(k);
+        }
+        else if (strcmp(argv[arg], "-random") == 0 && arg + 2 < argc) {
+            randomCount = atoi(argv[++arg]);
+            randomPercent = atof(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "-shifts") == 0)
+            keepShifts = true;
+        else if (strcmp(argv[arg], "-verify") == 0)
+            runVerify = true;
+        else {
+            printf("Usage: PromPerturb [-tune <bin>] [-map <n>] [-rpm <low> <high>] [-threads <n>]\n");
+            printf("                   [-set <c1c3> <c1c5> <c1c7> <200a>] ... [-random <n> <percent>]\n");
+            printf("                   [-shifts] [-verify]\n");
+            return 1;
+        }
+    }
+
+    if (rpmLow < 115 || rpmHigh < rpmLow) {
+        printf("The RPM range must be at least 115 (a 16-bit period) and low to high\n");
+        return 1;
+    }
+
+    if (tune.isOpen()) {
+        if (mapNumber < 0)
+            mapNumber = tune.defaultFuelMap();
+        base = tune.constants(mapNumber);
+        printf("Using %s (tune %04X), fuel map %d\n", tune.name(), tune.tuneNumber(), mapNumber);
+    }
+
+    if (sets.empty())
+        gridSets(base, sets);
+    randomSets(base, randomCount, randomPercent, sets);
+    if (runVerify)
+        verifySets(base, sets);
+
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+
+    printf("Base constants $%04X $%04X $%04X $%02X, %u sets on %u threads\n", base.XC1C3, base.XC1C5,
+      base.XC1C7, base.X200A, (unsigned)sets.size(), threads);
+
+    auto start = std::chrono::steady_clock::now();
+
+    RowSurfaceDiffer differ(base, (UINT16)(7500000.0 / rpmHigh), (UINT16)(7500000.0 / rpmLow));
+
+    double setupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::vector<SurfaceDiff> diffs;
+
+    start = std::chrono::steady_clock::now();
+    diffRowSurfaces(differ, sets, diffs, keepShifts, threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<int> verified, romVerified;
+    UINT32 failures = 0, romFailures = 0;
+    double scanSeconds = 0.0, romSeconds = 0.0;
+
+    if (runVerify) {
+        SurfaceDiff scan;
+
+        start = std::chrono::steady_clock::now();
+
+        for (size_t s = 0; s < diffs.size(); s++) {
+            scanRowSurfaceDiff(differ, sets[s], scan);
+            verified.push_back(sameSurfaceDiff(diffs[s], scan) ? 1 : 0);
+            if (!verified.back())
+                failures++;
+        }
+
+        scanSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        TuneImage reference;
+        const TuneImage *rom = &tune;
+        RomRoutines r;
+
+        if (!tune.isOpen() && reference.open(ROM_DEFAULT_IMAGE))
+            rom = &reference;
+
+        if (!rom->isOpen() || !findRomRoutines(rom->data(), r))
+            printf("No firmware to check the models against\n");
+        else {
+            start = std::chrono::steady_clock::now();
+
+            for (size_t s = 0; s < diffs.size(); s++) {
+                romVerified.push_back(romMismatches(rom->data(), r, diffs[s]) ? 0 : 1);
+                if (!romVerified.back())
+                    romFailures++;
+            }
+
+            romSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    writeRowFile("promPerturb.txt", differ, diffs);
+    if (keepShifts)
+        writeShiftFile("promShifts.txt", diffs);
+
+    printSummary(differ, diffs, verified, romVerified, rpmLow, rpmHigh);
+
+    printf("\nBase surface in %.1f ms, %u sets (%.0f cells each) in %.1f ms (%.2f ms a set)\n",
+      setupSeconds * 1e3, (unsigned)sets.size(), SURFACE_CELLS, seconds * 1e3,
+      sets.empty() ? 0.0 : seconds * 1e3 / sets.size());
+
+    if (runVerify)
+        printf("Cell by cell scan in %.1f ms a set: %u of %u sets differ from the scan\n",
+          sets.empty() ? 0.0 : scanSeconds * 1e3 / sets.size(), failures, (unsigned)sets.size());
+    if (!romVerified.empty())
+        printf("Firmware in %.1f ms a set: %u of %u sets differ from the firmware\n",
+          sets.empty() ? 0.0 : romSeconds * 1e3 / sets.size(), romFailures, (unsigned)sets.size());
+
+    return (failures || romFailures) ? 2 : 0;
+}
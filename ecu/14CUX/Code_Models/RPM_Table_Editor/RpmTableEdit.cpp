@@ -0,0 +1,263 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX RPM Table Editor
+//
+//  A command line front end for ../Common/RpmTableEditor.h. The table is loaded from a
+//  PROM image (or the R3526 table by default) and then edited a row at a time with
+//  commands read from stdin. After each edit the column index curve is brought up to date
+//  for just the periods the row governs, and any drop in the column index or nibble that
+//  doesn't match its bracket in that range is listed straight away (the same checks as
+//  "RpmTable -edges", which recomputes everything).
+//
+//  Commands (numbers may be decimal or 0x hex):
+//
+//      row <n> <period> <control> <multiplier>     replace row n (0 to 15)
+//      period <n> <period>                         change one field of row n
+//      control <n> <control>
+//      mult <n> <multiplier>
+//      show                                        list the table and each row's periods
+//      check                                       list every problem in the checked range
+//      verify                                      compare the curve with a full rebuild
+//      save                                        print the table as a C initializer
+//      quit
+//
+//  Usage: RpmTableEdit [-tune <bin>] [-rpm <low> <high>] [-selftest <edits>]
+//
+//      -rpm        range to check (default 120 to 6500)
+//      -selftest   make this many random edits, checking the curve and the problem count
+//                  against a full rebuild after each one
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/ColumnIndexTable.h"
+#include "../Common/Breakpoints.h"
+#include "../Common/RpmTableEditor.h"
+#include "../Common/Random.h"
+
+
+static double periodToRpm (UINT32 period)
+{
+    return period ? 7500000.0 / period : 0.0;
+}
+
+static void printProblems (const std::vector<Breakpoint> &problems)
+{
+    for (size_t i = 0; i < problems.size(); i++) {
+        if (problems[i].before == problems[i].after)
+            printf("  from %7.1f RPM down: X005C 0x%02X does not match bracket 0x%02X\n",
+              periodToRpm(problems[i].input), problems[i].after & 0xFF, problems[i].after >> 8);
+        else
+            printf("  at %7.1f RPM: X005C rises from 0x%02X to 0x%02X as RPM drops\n",
+              periodToRpm(problems[i].input), problems[i].before & 0xFF, problems[i].after & 0xFF);
+    }
+}
+
+static void printEdit (const RpmTableEdit &edit, double seconds)
+{
+    if (edit.firstPeriod > edit.lastPeriod)
+        printf("No change\n");
+    else
+        printf("Recomputed 0x%04X to 0x%04X (%u periods) in %.1f us, %u problems in the table\n",
+          edit.firstPeriod, edit.lastPeriod, edit.lastPeriod - edit.firstPeriod + 1,
+          seconds * 1e6, edit.problemCount);
+
+    printProblems(edit.problems);
+}
+
+static void showTable (const RpmTableEditor &editor)
+{
+    printf("\nRow  Period  Ctrl  Mult      RPM    Periods\n");
+    printf("---------------------------------------------------\n");
+
+    for (int row = 0; row < RPM_TABLE_ROWS; row++) {
+        UINT32 first, last;
+        printf(" %2d  0x%04X  0x%02X  0x%02X  %7.1f    ", row, editor.entry(row),
+          editor.control(row), editor.multiplier(row), periodToRpm(editor.entry(row)));
+        if (editor.rowPeriods(row, &first, &last))
+            printf("0x%04X to 0x%04X\n", first, last);
+        else
+            printf("shadowed\n");
+    }
+}
+
+static void saveTable (const RpmTableEditor &editor)
+{
+    const UCHAR *table = editor.table();
+
+    printf("static UCHAR rpmTable[64] = {\n\n");
+
+    for (int row = 0; row < RPM_TABLE_ROWS; row++)
+        printf("    0x%02X, 0x%02X, 0x%02X, 0x%02X%s   // %4.0f RPM\n", table[4 * row],
+          table[4 * row + 1], table[4 * row + 2], table[4 * row + 3],
+          (row < RPM_TABLE_ROWS - 1) ? "," : " ", periodToRpm(editor.entry(row)));
+
+    printf("};\n");
+}
+
+// Compare the editor's curve and problem count against a fresh build of the same table
+static UINT32 verifyEditor (const RpmTableEditor &editor, UINT16 firstPeriod, UINT16 lastPeriod)
+{
+    UINT32 mismatches = editor.curve().verify(editor.table());
+    UINT32 problems = certifyColumnIndex(columnIndexBreakpoints(editor.table()),
+                                         firstPeriod, lastPeriod, editor.table());
+
+    if (problems != editor.problems())
+        mismatches++;
+
+    return mismatches;
+}
+
+
+static int selfTest (RpmTableEditor &editor, UINT32 edits, UINT16 firstPeriod, UINT16 lastPeriod)
+{
+    static const UCHAR controls[] = { 0x00, 0x40, 0x80, 0xC0 };
+    XorShift rng(0x14C0);
+    UINT32 failures = 0;
+    UINT64 periods = 0;
+    double seconds = 0.0;
+
+    for (UINT32 i = 0; i < edits; i++) {
+
+        int row = (int)(rng.next() % RPM_TABLE_ROWS);
+        RpmTableEdit edit;
+
+        auto start = std::chrono::steady_clock::now();
+
+        switch (rng.next() % 4) {
+        case 0:     edit = editor.setControl(row, controls[rng.next() % 4]);      break;
+        case 1:     edit = editor.setMultiplier(row, (UCHAR)rng.next());          break;
+        case 2:     // nudge the period, now and then far enough to reorder the table
+            edit = editor.setPeriod(row, (UINT16)(editor.entry(row) +
+                     ((rng.next() % 16 == 0) ? rng.next() : rng.next() % 512 - 256)));
+            break;
+        default:
+            edit = editor.setRow(row, (UINT16)rng.next(), controls[rng.next() % 4],
+                     (UCHAR)rng.next());
+            break;
+        }
+
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (edit.firstPeriod <= edit.lastPeriod)
+            periods += edit.lastPeriod - edit.firstPeriod + 1;
+
+        if (verifyEditor(editor, firstPeriod, lastPeriod)) {
+            printf("Edit %u (row %d): curve or problem count differs from a full rebuild\n", i, row);
+            failures++;
+        }
+    }
+
+    printf("%u edits, %.1f periods and %.1f us per edit on average, %u failures\n", edits,
+      edits ? (double)periods / edits : 0.0, edits ? seconds * 1e6 / edits : 0.0, failures);
+
+    return failures ? 1 : 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    TuneImage tune;
+    const UCHAR *table = defaultRpmTable;
+    UINT32 rpmLow = 120, rpmHigh = 6500;
+    long selfTestEdits = -1;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-tune") == 0 && arg + 1 < argc) {
+            if (!tune.open(argv[++arg]))
+                return 1;
+        }
+        else if (strcmp(argv[arg], "-rpm") == 0 && arg + 2 < argc) {
+            rpmLow = (UINT32)atoi(argv[++arg]);
+            rpmHigh = (UINT32)atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "-selftest") == 0 && arg + 1 < argc)
+            selfTestEdits = atol(argv[++arg]);
+        else {
+            printf("Usage: RpmTableEdit [-tune <bin>] [-rpm <low> <high>] [-selftest <edits>]\n");
+            return 1;
+        }
+    }
+
+    if (rpmLow < 115 || rpmHigh < rpmLow) {
+        printf("The RPM range must be at least 115 (a 16-bit period) and low to high\n");
+        return 1;
+    }
+
+    if (tune.isOpen()) {
+        table = tune.rpmTable();
+        printf("Using %s (tune %04X)\n", tune.name(), tune.tuneNumber());
+    }
+
+    UINT16 firstPeriod = (UINT16)(7500000.0 / rpmHigh);
+    UINT16 lastPeriod = (UINT16)(7500000.0 / rpmLow);
+    RpmTableEditor editor(table, firstPeriod, lastPeriod);
+
+    if (selfTestEdits >= 0)
+        return selfTest(editor, (UINT32)selfTestEdits, firstPeriod, lastPeriod);
+
+    showTable(editor);
+    printf("\n%u problems from %u to %u RPM\n", editor.problems(), rpmLow, rpmHigh);
+
+    char line[256];
+
+    while (printf("> "), fflush(stdout), fgets(line, sizeof(line), stdin)) {
+
+        char command[16] = "";
+        unsigned long v[4] = { 0, 0, 0, 0 };
+        char n[4][16];
+        int count = sscanf(line, "%15s %15s %15s %15s %15s", command, n[0], n[1], n[2], n[3]) - 1;
+
+        for (int i = 0; i < count; i++)
+            v[i] = strtoul(n[i], 0, 0);
+
+        if (count > 0 && v[0] >= RPM_TABLE_ROWS) {
+            printf("The row must be 0 to 15\n");
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        RpmTableEdit edit;
+
+        if (strcmp(command, "row") == 0 && count == 4)
+            edit = editor.setRow((int)v[0], (UINT16)v[1], (UCHAR)v[2], (UCHAR)v[3]);
+        else if (strcmp(command, "period") == 0 && count == 2)
+            edit = editor.setPeriod((int)v[0], (UINT16)v[1]);
+        else if (strcmp(command, "control") == 0 && count == 2)
+            edit = editor.setControl((int)v[0], (UCHAR)v[1]);
+        else if (strcmp(command, "mult") == 0 && count == 2)
+            edit = editor.setMultiplier((int)v[0], (UCHAR)v[1]);
+        else {
+            if (strcmp(command, "show") == 0)
+                showTable(editor);
+            else if (strcmp(command, "check") == 0) {
+                printProblems(editor.listProblems());
+                printf("%u problems from %u to %u RPM\n", editor.problems(), rpmLow, rpmHigh);
+            }
+            else if (strcmp(command, "verify") == 0)
+                printf("%u mismatches against a full rebuild\n", verifyEditor(editor, firstPeriod, lastPeriod));
+            else if (strcmp(command, "save") == 0)
+                saveTable(editor);
+            else if (strcmp(command, "quit") == 0)
+                break;
+            else if (command[0])
+                printf("Commands: row, period, control, mult, show, check, verify, save, quit\n");
+            continue;
+        }
+
+        printEdit(edit, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    return 0;
+}
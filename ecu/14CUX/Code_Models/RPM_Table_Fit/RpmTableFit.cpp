@@ -0,0 +1,172 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX RPM Table Fit
+//
+//  Takes a set of RPM brackets and fills in the 3rd and 4th columns of the RPM table using
+//  the search in ../Common/RpmTableFit.h, so the column index is monotonic and its upper
+//  nibble matches the bracket over the whole RPM range. The result is printed as a C
+//  initializer that can be pasted into RpmTable.cpp (or edited further with RpmTableEdit).
+//
+//  The brackets are given as 16 RPM values, highest first, or taken from the table in a
+//  PROM image. The default is the 6200 RPM re-bracketing from RPM_TABLE 1 in RpmTable.cpp.
+//  The existing 3rd and 4th columns are listed alongside the fitted ones, with the error
+//  for each row ("fails" if the row has a drop or a nibble that doesn't match).
+//
+//  Usage: RpmTableFit [-tune <bin> | -brackets <rpm0> ... <rpm15>] [-rpm <low> <high>]
+//                     [-threads <n>]
+//
+//      -rpm        range to check (default 120 to 6500)
+//      -threads    worker threads (default one per core)
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/Breakpoints.h"
+#include "../Common/RpmTableFit.h"
+
+
+// RPM_TABLE 1 from RpmTable.cpp (brackets spread to 6200 RPM)
+static const UCHAR spreadRpmTable[RPM_TABLE_SIZE] = {
+    0x04, 0xB9, 0x40, 0x00,
+    0x05, 0xBE, 0x00, 0x13,
+    0x06, 0xA8, 0x00, 0x10,
+    0x07, 0x9C, 0x00, 0x18,
+    0x08, 0x9A, 0x80, 0x9C,
+    0x0A, 0x76, 0x80, 0xB7,
+    0x0D, 0xF3, 0x80, 0x43,
+    0x10, 0xBD, 0x80, 0x7A,
+    0x14, 0xED, 0x80, 0x3D,
+    0x1A, 0xA2, 0x80, 0x2C,
+    0x20, 0x8D, 0x80, 0x2B,
+    0x25, 0x8F, 0x80, 0x33,
+    0x29, 0xDA, 0x80, 0x3B,
+    0x2F, 0x40, 0x80, 0x2F,
+    0x3D, 0x09, 0x80, 0x12,
+    0x92, 0x7C, 0x40, 0x2F
+};
+
+
+static double periodToRpm (UINT32 period)
+{
+    return period ? 7500000.0 / period : 0.0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    TuneImage tune;
+    const UCHAR *original = spreadRpmTable;
+    UINT16 brackets[FIT_ROWS];
+    bool haveBrackets = false;
+    UINT32 rpmLow = 120, rpmHigh = 6500;
+    unsigned threads = 0;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-tune") == 0 && arg + 1 < argc) {
+            if (!tune.open(argv[++arg]))
+                return 1;
+            original = tune.rpmTable();
+        }
+        else if (strcmp(argv[arg], "-brackets") == 0 && arg + FIT_ROWS < argc) {
+            for (int row = 0; row < FIT_ROWS; row++) {
+                double rpm = atof(argv[++arg]);
+                if (rpm < 115.0) {
+                    printf("Each bracket must be at least 115 RPM (a 16-bit period)\n");
+                    return 1;
+                }
+                brackets[row] = (UINT16)(7500000.0 / rpm);
+            }
+            haveBrackets = true;
+            original = 0;
+        }
+        else if (strcmp(argv[arg], "-rpm") == 0 && arg + 2 < argc) {
+            rpmLow = (UINT32)atoi(argv[++arg]);
+            rpmHigh = (UINT32)atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "-threads") == 0 && arg + 1 < argc)
+            threads = (unsigned)atoi(argv[++arg]);
+        else {
+            printf("Usage: RpmTableFit [-tune <bin> | -brackets <rpm0> ... <rpm15>] [-rpm <low> <high>] [-threads <n>]\n");
+            return 1;
+        }
+    }
+
+    if (rpmLow < 115 || rpmHigh < rpmLow) {
+        printf("The RPM range must be at least 115 (a 16-bit period) and low to high\n");
+        return 1;
+    }
+
+    if (!haveBrackets)
+        for (int row = 0; row < FIT_ROWS; row++)
+            brackets[row] = rpmTableEntry(original, row);
+
+    if (tune.isOpen())
+        printf("Using the brackets from %s (tune %04X)\n", tune.name(), tune.tuneNumber());
+
+    UINT16 firstPeriod = (UINT16)(7500000.0 / rpmHigh);
+    UINT16 lastPeriod = (UINT16)(7500000.0 / rpmLow);
+    UCHAR table[RPM_TABLE_SIZE];
+    RowFit fit[FIT_ROWS];
+
+    auto start = std::chrono::steady_clock::now();
+
+    long problems = fitRpmTable(brackets, table, fit, firstPeriod, lastPeriod, threads);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (problems < 0) {
+        printf("The brackets must go from the highest RPM to the lowest\n");
+        return 1;
+    }
+
+    printf("\nRow   Period     RPM     Fitted      Error   Candidates");
+    printf(original ? "     Existing    Error\n" : "\n");
+
+    for (int row = 0; row < FIT_ROWS; row++) {
+
+        printf(" %2d   0x%04X  %7.1f    0x%02X 0x%02X  %6.3f   %6u", row, brackets[row],
+          periodToRpm(brackets[row]), fit[row].control, fit[row].multiplier, fit[row].error,
+          fit[row].candidates);
+
+        if (original) {
+            double error = 0.0;
+            if (row > 0)
+                error = rowFitError(brackets[row], brackets[row] - brackets[row - 1],
+                          (UCHAR)((15 - row) << 4), original[4 * row + 2], original[4 * row + 3],
+                          std::max<UINT32>(brackets[row - 1] + 1, firstPeriod),
+                          std::min<UINT32>(brackets[row], lastPeriod));
+            printf("       0x%02X 0x%02X  ", original[4 * row + 2], original[4 * row + 3]);
+            if (error < 0.0)
+                printf(" fails");
+            else
+                printf("%6.3f", error);
+        }
+
+        printf("\n");
+    }
+
+    printf("\nstatic UCHAR rpmTable[64] = {   // fitted by RpmTableFit\n\n");
+
+    for (int row = 0; row < FIT_ROWS; row++)
+        printf("    0x%02X, 0x%02X, 0x%02X, 0x%02X%s   // %4.0f RPM\n", table[4 * row],
+          table[4 * row + 1], table[4 * row + 2], table[4 * row + 3],
+          (row < FIT_ROWS - 1) ? "," : " ", periodToRpm(brackets[row]));
+
+    printf("};\n\n");
+
+    printf("Searched in %.1f ms, %u to %u RPM: %s\n", seconds * 1000.0, rpmLow, rpmHigh,
+      problems ? "NOT monotonic" : "monotonic, nibbles match brackets");
+
+    return problems ? 2 : 0;
+}
@@ -3,90 +3,53 @@
 //
 //  14CUX RPM Table Simulator (dhb)
 //
-//  This program simulates (I hope) the block of 6803U4 assembly language code shown below.
-//  The code is from tune R3526 (a.k.a R3360A) so the addresses will not match up to some 
-//  other tunes, such as Griffith tunes.
+//  This program simulates (I hope) the block of 6803U4 assembly language code shown in
+//  ../Common/RpmColumnIndex.h. The code is from tune R3526 (a.k.a R3360A) so the addresses
+//  will not match up to some other tunes, such as Griffith tunes.
 //
 //  Besides adjusting the RPM brackets, it is important to adjust the 3rd and 4th columns to
 //  create a smooth "monotonic function". This program provides a way to test the table by
 //  scanning through the RPM range and producing a graphable output file.
 //
+//  The table is normally one of the examples selected with RPM_TABLE below. To test the
+//  table in a PROM image instead, pass the image on the command line:
+//
+//      RpmTable ../../OriginalCode/Reference_Bins/R2967_9B.bin
+//
+//  Add "-lut" (before the image name) to expand the table into the 64K entry lookup table
+//  from ../Common/ColumnIndexTable.h, cross-check it against the literal model for every
+//  period and use it for the scan.
+//
+//  Add "-bin" (also before the image name) to write the scan as a binary result file,
+//  rowIndexCurve.bin, instead of the text file. See ../Common/ResultFile.h; the text
+//  layout can be recreated with ../Result_Tools/ResultToText.
+//
+//  Add "-edges" to also find every period where the column index changes (see
+//  ../Common/Breakpoints.h) and check the whole scan range for a drop in the column index
+//  or a nibble that doesn't match its bracket, including points between the 10 RPM steps.
+//
+//  The lookup table and the edges are kept in the result cache (../Common/ResultCache.h)
+//  under a hash of the 64 byte RPM table, so they are only worked out once for each table.
+//  Add "-nocache" to work them out regardless. The "-lut" check runs whenever the lookup
+//  table is built rather than taken from the cache, and a table that fails it isn't stored.
+//
+//  To try changes to the 3rd and 4th columns without recompiling, use
+//  ../RPM_Table_Editor/RpmTableEdit, which keeps the curve live and rechecks it as each
+//  row is edited.
+//
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
-/*
----------------------------------------------------------------------------------------------------
-EADB				LEADB:
-EADB : CE C8 00			ldx		#$C800		; Location of engine speed table
-EADE : 86 0F			ldaa	#$0F		; load length of data table
-EAE0 : 97 CA			staa	X00CA		; store $0F into 00CA (general purpose var)
-EAE2				LEAE2:					; * Start Loop *
-EAE2 : EC 00			ldd		$00,x		; value from C800 table (1st value is $0553 or 5502 RPM)
-EAE4 : 93 7A			subd	X007A		; subtract 16-bit instantaneous ignition period
-EAE6 : 24 0D			bcc		LEAF5		; branch out if period is LT table value (RPM is higher)
-EAE8 : C6 04			ldab	#$04		; add 04 to index
-EAEA : 3A			    abx					; add B ($04) to X ($C800) = $C804
-EAEB : 7A 00 CA			dec		X00CA		; decrement table length counter
-EAEE : 2A F2			bpl		LEAE2		; *  End  Loop * (loop back if not end of table)
-EAF0 : 7F 00 5C			clr		X005C		; set fuel map eng spd index to zero
-EAF3 : 20 2A			bra		LEB1F		; table ran out, branch way down
-EAF5				LEAF5:
-EAF5 : DD C8			std		X00C8		; 00C8/C9 is table entry minus current ignition period
-EAF7 : 96 CA			ldaa	X00CA		; 00CA is table entry counter ($F->0) and it becomes
-EAF9 : 48			    asla				;   the fuel map column index which is the upper 
-EAFA : 48			    asla				;   nibble of X005C
-EAFB : 48			    asla
-EAFC : 48			    asla
-EAFD : 97 CA			staa	X00CA		; index shifted to upper nibble
-EAFF : A6 02			ldaa	$02,x		; load value from table column 3 ($40, $00 or $80)
-EB01 : 2A 08			bpl		LEB0B		; bra if value is not $80
-EB03 : DC C8			ldd		X00C8		; value is $80, reload speed delta from above
-EB05 : 04			    lsrd
-EB06 : 04			    lsrd
-EB07 : 04			    lsrd
-EB08 : 04			    lsrd				; shift speed delta down to lower nibble
-EB09 : 20 0A			bra		LEB15
-EB0B				LEB0B:					; value is $40 or $00
-EB0B : 85 40			bita	#$40		; test bit 6
-EB0D : 27 04			beq		LEB13
-EB0F : D6 C8			ldab	X00C8		; value is $40, reload MSB of speed delta from above (no shift)
-EB11 : 20 02			bra		LEB15
-EB13				LEB13:					; value is $00
-EB13 : D6 C9			ldab	X00C9		; reload just the low byte of speed delta (no shift)
-EB15				LEB15:
-EB15 : A6 03			ldaa	$03,x		; load right-most value from table
-EB17 : 3D			    mul					; mpy A (table value) by B (speed delta)
-EB18 : 9A CA			oraa	X00CA		; or it into the low nibble of the column index
-EB1A : 97 5C			staa	X005C		; <-- store the fuel map column index here
-
-EB1C : BD D4 03			jsr		LD403		; road speed test, reloads X2012 in B before returning
-EB1F				LEB1F:
----------------------------------------------------------------------------------------------------
-*/
-
 #include <stdio.h>
+#include <string.h>
 
-typedef   signed char  CHAR;
-typedef unsigned char  UCHAR;
-typedef unsigned short UINT16;
-
-// endian swap macro
-#define USHORT_BE2LE(x) ((((x) & 0x00FF) << 8) | (((x) & 0xFF00) >> 8))
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/RpmColumnIndex.h"
+#include "../Common/ColumnIndexTable.h"
+#include "../Common/ResultFile.h"
+#include "../Common/ResultCache.h"
+#include "../Common/Breakpoints.h"
 
-#define A 1     // these are reversed due to the endian issue
-#define B 0
-
-#define C8 1    // (ditto)
-#define C9 0
-
-
-// The A and B accumulators can be used as separate 8-bit registers
-// or together as a 16-bit register. A union is perfect for modelling this.
-// X00C8 and X00C9 are used in a similar way
-union ABunion
-{
-   UINT16 ab16;
-   UCHAR  ab8[2];
-};
 
 
 // There are 4 RPM table examples here
@@ -97,6 +60,11 @@ union ABunion
 
 #define RPM_TABLE 3     // <<--- SELECT A TABLE HERE
 
+#define RPM_CURVE_FIRST     120
+#define RPM_CURVE_LAST      6500
+#define RPM_CURVE_STEP      10
+#define RPM_CURVE_POINTS    ((RPM_CURVE_LAST - RPM_CURVE_FIRST) / RPM_CURVE_STEP)
+
 
 #if RPM_TABLE == 0
 
@@ -190,79 +158,91 @@ static UCHAR rpmTable[64] = {   // an aftermarket tune
 #endif
 
 
-
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-// 
-// This function is a model of the 14CUX RPM to Fuel Map Row Index transfer function.
 //
-// It returns the 8-bit row index into the fuel map for a given spark period (2 uSec units).
-// It also returns (by pointer) the fuel map bracket value. If the RPM table is not correct,
-// the bracket value may differ from the upper nibble of the row index.
+//  Cached results
+//
+//  The lookup table is stored as a single column of 65536 entries, which the
+//  table attaches to straight from the mapped cache entry. The edges are stored
+//  as three columns (input, before and after), one row per edge.
 //
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-UCHAR getColumnIndex (UINT16 X007A, UCHAR *bracket)
+// A built table is checked against the literal model before it is stored, and only
+// stored if it matches, so a table from the cache doesn't need checking again
+static void loadLookupTable (ColumnIndexTable &lookupTable, ResultFile &cached, const UCHAR *table,
+                             const TuneImage &tune, bool useCache)
+{
+    ResultCache cache;
+    ResultKey key("columnIndexTable");
+    UINT32 mismatches;
+    int column;
+
+    key.add(table, RPM_TABLE_SIZE);
+
+    if (useCache && cache.find(key, cached) && (column = cached.findColumn("entry")) >= 0 &&
+        cached.rowCount() == PERIOD_COUNT_16BIT) {
+        lookupTable.attach(cached.data16((UINT32)column));
+        printf("Lookup table from %s\n", cache.path(key).c_str());
+        return;
+    }
+
+    lookupTable.build(table);
+    mismatches = lookupTable.verify(table);
+    printf("Lookup table check: %u mismatches in %u periods\n", mismatches, PERIOD_COUNT_16BIT);
+
+    if (useCache && mismatches == 0) {
+        ResultWriter writer(RESULT_LAYOUT_GENERIC, &tune, -1, defaultPromConstants());
+
+        writer.addAxis("period", 0, 1, PERIOD_COUNT_16BIT);
+        writer.addColumn("entry", 2, lookupTable.entries());
+        cache.store(key, writer);
+    }
+}
+
+static std::vector<Breakpoint> loadEdges (const UCHAR *table, const TuneImage &tune, bool useCache)
 {
+    static const char *names[3] = { "input", "before", "after" };
+    ResultCache cache;
+    ResultKey key("columnIndexEdges");
+    ResultFile cached;
+    std::vector<Breakpoint> edges;
+    int column[3];
+
+    key.add(table, RPM_TABLE_SIZE);
 
-    ABunion regs, C8C9;                         // union defined above
-    UCHAR  X005C;                               // the column index to be returned
+    if (useCache && cache.find(key, cached) && (column[0] = cached.findColumn(names[0])) >= 0 &&
+        (column[1] = cached.findColumn(names[1])) >= 0 && (column[2] = cached.findColumn(names[2])) >= 0) {
 
-    UCHAR *tablePtr = rpmTable;                 // ldx  #$C800
-    CHAR X00CA = 0x0F;                          // ldaa #$0F, staa	X00CA
+        edges.resize((size_t)cached.rowCount());
 
-LEAE2:
-    regs.ab16 = *(UINT16 *)tablePtr;            // ldd	$00,x
-    regs.ab16 = USHORT_BE2LE(regs.ab16);        // oh yes, don't forget the endian issue
-    if (regs.ab16 >= X007A) {                   // if table value >= period ...
-        regs.ab16 -= X007A;                     // subd	X007A (subtract period)
-        goto LEAF5;                             // carry bit is clear, branch to process remainder
+        for (size_t i = 0; i < edges.size(); i++) {
+            edges[i].input = cached.value((UINT32)column[0], i);
+            edges[i].before = cached.value((UINT32)column[1], i);
+            edges[i].after = cached.value((UINT32)column[2], i);
+        }
+
+        return edges;
     }
-    regs.ab16 -= X007A;                         // subd X007A
-    tablePtr += 4;                              // ldab #$04, abx
-    X00CA--;                                    // dec  X00CA
-    if (X00CA >= 0)                             // bpl	LEAE2 (branch back if pos value)
-        goto LEAE2;
-
-    X005C = 0;                                  // clr X005C (RPM lower than 200)
-    goto LEB1F;                                 // LEB1F = return (0)
-
-    if (X00CA == 0) {                           // if code fell through to here, RPM is < 200
-        X005C = 0x00;                           // so set the col index to zero and return
-        return X005C;
+
+    edges = columnIndexBreakpoints(table);
+
+    if (useCache) {
+        std::vector<UINT16> values[3];
+        ResultWriter writer(RESULT_LAYOUT_GENERIC, &tune, -1, defaultPromConstants());
+
+        for (size_t i = 0; i < edges.size(); i++) {
+            values[0].push_back((UINT16)edges[i].input);
+            values[1].push_back((UINT16)edges[i].before);
+            values[2].push_back((UINT16)edges[i].after);
+        }
+
+        writer.addAxis("edge", 0, 1, (UINT32)edges.size());
+        for (int c = 0; c < 3; c++)
+            writer.addColumn(names[c], 2, values[c].data());
+        cache.store(key, writer);
     }
-    
-LEAF5:                                      // if here, loop terminated before end of table
-    C8C9.ab16 = regs.ab16;                  // std	X00C8 (store remainder)
-    regs.ab8[A] = X00CA;                    // ldaa	X00CA
-    regs.ab8[A] = regs.ab8[A] << 4;         // 4 * alsa (table row becomes upper nibble)
-    X00CA = regs.ab8[A];                    // staa	X00CA
-    *bracket = X00CA;                       // this is also the bracket value to be returned
-    regs.ab8[A] = *(tablePtr + 2);          // ldaa	$02,x (control byte from 3rd column)
-
-    if (!(regs.ab8[A] & (1 << 7)))          // bpl	LEB0B (test sign bit for value 0x80)
-        goto LEB0B;                         // branch if not 0x80
-
-    regs.ab16 = C8C9.ab16;                  // value is 0x80, reload speed delta (remainder)
-    regs.ab16 = regs.ab16 >> 4;             // 4 * lsrd (use high byte)
-    goto LEB15;
-
-LEB0B:
-    if (!(regs.ab8[A] & (1 << 6)))          // bita	#$40 (test bit 6 for value 0x40)
-        goto LEB13;                         // branch if not 0x40
-
-    regs.ab8[B] = C8C9.ab8[C8];             // ldab	X00C8
-    goto LEB15;                             // bra	LEB15
-
-LEB13:                                      // control byte is 0x00
-    regs.ab8[B] = C8C9.ab8[C9];             // ldab	X00C9 (use low byte)
-
-LEB15:
-    regs.ab8[A] = *(tablePtr + 3);          // get the multiplier byte from table (4th column)
-    regs.ab16 = regs.ab8[A] * regs.ab8[B];  // multiply A * B (result in AB
-    regs.ab8[A] |= X00CA;                   // OR the nibbles
-    X005C = regs.ab8[A];                    // the final row index
-
-LEB1F:
-	return (X005C);
+
+    return edges;
 }
 
 
@@ -278,31 +258,107 @@ LEB1F:
 //  As mentioned above, a smooth monotonic curve is important.
 //
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-int main(void)
+int main(int argc, char *argv[])
 {
     FILE *fptr;
     UINT16 period;
     UCHAR colIndex;
     UCHAR bracket;
+    TuneImage tune;
+    const UCHAR *table = rpmTable;
+    ColumnIndexTable lookupTable;
+    ResultFile cachedTable;
+    bool useLookup = false;
+    bool useCache = true;
+    bool useBinary = false;
+    bool findEdges = false;
+    UCHAR brackets[RPM_CURVE_POINTS];
+    UCHAR colIndexes[RPM_CURVE_POINTS];
+    int point = 0;
+    int arg = 1;
+
+    while (arg < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-lut") == 0)
+            useLookup = true;
+        else if (strcmp(argv[arg], "-bin") == 0)
+            useBinary = true;
+        else if (strcmp(argv[arg], "-edges") == 0)
+            findEdges = true;
+        else if (strcmp(argv[arg], "-nocache") == 0)
+            useCache = false;
+        else {
+            printf("Usage: RpmTable [-lut] [-bin] [-edges] [-nocache] [image]\n");
+            return 1;
+        }
+        arg++;
+    }
+
+    if (arg < argc) {
+        if (!tune.open(argv[arg]))
+            return 1;
+        table = tune.rpmTable();
+        printf("Using RPM table from %s (tune %04X)\n", tune.name(), tune.tuneNumber());
+    }
 
+    if (useLookup)
+        loadLookupTable(lookupTable, cachedTable, table, tune, useCache);
 
-    fptr = fopen ("rowIndexCurve.txt", "wt");
+    if (findEdges) {
+        std::vector<Breakpoint> edges = loadEdges(table, tune, useCache);
+        std::vector<Breakpoint> problems;
+        UINT32 count = certifyColumnIndex(edges, (UINT16)(7500000.0/RPM_CURVE_LAST),
+                                          (UINT16)(7500000.0/RPM_CURVE_FIRST), table, &problems);
 
-    if (!fptr)
+        printf("%u column index edges, %u problems from %u to %u RPM\n", (UINT32)edges.size(), count,
+          RPM_CURVE_FIRST, RPM_CURVE_LAST);
+
+        for (size_t i = 0; i < problems.size(); i++)
+            printf("  period 0x%04X (%6.1f RPM): X005C 0x%02X -> 0x%02X, bracket 0x%02X\n",
+              problems[i].input, 7500000.0/problems[i].input, problems[i].before & 0xFF,
+              problems[i].after & 0xFF, problems[i].after >> 8);
+    }
+
+    fptr = useBinary ? 0 : fopen ("rowIndexCurve.txt", "wt");
+
+    if (!fptr && !useBinary)
         printf("Could not open file for writing\n");
 
 
-    for (UINT16 rpm = 120; rpm < 6500; rpm += 10) {
+    for (UINT16 rpm = RPM_CURVE_FIRST; rpm < RPM_CURVE_LAST; rpm += RPM_CURVE_STEP) {
 
         bracket = 0;
 
         period = (UINT16)(7500000.0/rpm);
 
-        colIndex = getColumnIndex(period, &bracket);
+        if (useLookup) {
+            colIndex = lookupTable.colIndex(period);
+            bracket = lookupTable.bracket(period);
+        }
+        else
+            colIndex = getColumnIndex(period, &bracket, table);
+
+        brackets[point] = bracket;
+        colIndexes[point] = colIndex;
+        point++;
 
         if (fptr)
             fprintf(fptr, "%5u \t 0x%02X \t %3u \t %3u\n", rpm, bracket, colIndex, (colIndex & 0xF0));
 
     }
+
+    if (fptr)
+        fclose(fptr);
+
+    if (useBinary) {
+        ResultWriter writer(RESULT_LAYOUT_RPM_CURVE, &tune, -1, defaultPromConstants());
+
+        writer.addAxis("rpm", RPM_CURVE_FIRST, RPM_CURVE_STEP, RPM_CURVE_POINTS);
+        writer.addColumn("bracket", 1, brackets);
+        writer.addColumn("colIndex", 1, colIndexes);
+
+        return writer.write("rowIndexCurve.bin") ? 0 : 1;
+    }
+
+    return 0;
 }
 
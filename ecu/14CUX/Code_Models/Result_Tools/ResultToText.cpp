@@ -0,0 +1,190 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Result File to Text Converter
+//
+//  Converts a binary result file (../Common/ResultFile.h) back to tab delimited text for
+//  Excel, Matlab, etc. Files from MafModel -bin and RpmTable -bin are written in the same
+//  layout as mafAndRowIndex.txt and rowIndexCurve.txt. Anything else (including the full
+//  row index surface from MafModel -sweep) is written with a title line followed by one
+//  line per row: the axis values and then each column.
+//
+//  Usage: ResultToText [-info] <result file> [output]
+//
+//      -info   print the header and column list instead of converting
+//      output  defaults to stdout
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/ResultFile.h"
+
+
+static void printInfo (const char *path, const ResultFile &file)
+{
+    const ResultHeader &h = file.header();
+
+    printf("%s\n", path);
+    printf("  model version  %u\n", h.modelVersion);
+    printf("  layout         %u\n", h.layout);
+    printf("  tune           %.24s", h.tuneName);
+    if (h.mapNumber != RESULT_NO_MAP)
+        printf(" (tune %04X ident %02X, fuel map %u)", h.tuneNumber, h.tuneIdent, h.mapNumber);
+    printf("\n");
+    printf("  constants      C1C3=$%04X C1C5=$%04X C1C7=$%04X 200A=$%02X\n",
+      h.XC1C3, h.XC1C5, h.XC1C7, h.X200A);
+
+    for (UINT32 i = 0; i < h.axisCount; i++)
+        printf("  axis %u         %-16.16s %u to %u step %u (%u points)\n", i, h.axis[i].name,
+          h.axis[i].first, h.axis[i].first + (h.axis[i].count - 1) * h.axis[i].step,
+          h.axis[i].step, h.axis[i].count);
+
+    for (UINT32 i = 0; i < h.columnCount; i++)
+        printf("  column %u       %-16.16s %u byte%s\n", i, file.column(i).name,
+          file.column(i).width, (file.column(i).width == 1) ? "" : "s");
+
+    printf("  rows           %llu\n", file.rowCount());
+}
+
+
+// mafAndRowIndex.txt
+static bool writeMafRowIndex (const ResultFile &file, FILE *out)
+{
+    int linearC = file.findColumn("linearC");
+    int linear6803 = file.findColumn("linear6803");
+    int row900 = file.findColumn("row900");
+    int row3100 = file.findColumn("row3100");
+    int row5102 = file.findColumn("row5102");
+
+    if (linearC < 0 || linear6803 < 0 || row900 < 0 || row3100 < 0 || row5102 < 0)
+        return false;
+
+    fprintf( out, "MAF Volts   MAF Counts   Linear C    Linear 6800    900  3100  5102\n");
+    fprintf( out, "--------------------------------------------------------------------\n");
+
+    for (UINT64 row = 0; row < file.rowCount(); row++) {
+
+        UINT32 mafCounts = file.axisValue(0, row);
+
+        fprintf( out, "%5.2f  \t  %5u  \t  %5u  \t  %5u    0x%02X  0x%02X  0x%02X\n",
+          ((mafCounts/1023.0)*5.0), mafCounts, file.value(linearC, row), file.value(linear6803, row),
+          file.value(row900, row), file.value(row3100, row), file.value(row5102, row));
+    }
+
+    return true;
+}
+
+
+// rowIndexCurve.txt
+static bool writeRpmCurve (const ResultFile &file, FILE *out)
+{
+    int bracket = file.findColumn("bracket");
+    int colIndex = file.findColumn("colIndex");
+
+    if (bracket < 0 || colIndex < 0)
+        return false;
+
+    for (UINT64 row = 0; row < file.rowCount(); row++) {
+
+        UINT32 col = file.value(colIndex, row);
+
+        fprintf(out, "%5u \t 0x%02X \t %3u \t %3u\n", file.axisValue(0, row),
+          file.value(bracket, row), col, (col & 0xF0));
+    }
+
+    return true;
+}
+
+
+static void writeGeneric (const ResultFile &file, FILE *out)
+{
+    const ResultHeader &h = file.header();
+    const char *sep = "";
+
+    for (UINT32 i = 0; i < h.axisCount; i++, sep = "\t")
+        fprintf(out, "%s%.16s", sep, h.axis[i].name);
+    for (UINT32 i = 0; i < h.columnCount; i++, sep = "\t")
+        fprintf(out, "%s%.16s", sep, file.column(i).name);
+    fprintf(out, "\n");
+
+    for (UINT64 row = 0; row < file.rowCount(); row++) {
+
+        sep = "";
+
+        for (UINT32 i = 0; i < h.axisCount; i++, sep = "\t")
+            fprintf(out, "%s%u", sep, file.axisValue(i, row));
+        for (UINT32 i = 0; i < h.columnCount; i++, sep = "\t")
+            fprintf(out, "%s%u", sep, file.value(i, row));
+        fprintf(out, "\n");
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    ResultFile file;
+    const char *inName = 0;
+    const char *outName = 0;
+    bool info = false;
+    bool ok = true;
+    FILE *out = stdout;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-info") == 0)
+            info = true;
+        else if (!inName)
+            inName = argv[arg];
+        else
+            outName = argv[arg];
+    }
+
+    if (!inName) {
+        printf("Usage: ResultToText [-info] <result file> [output]\n");
+        return 1;
+    }
+
+    if (!file.open(inName))
+        return 1;
+
+    if (info) {
+        printInfo(inName, file);
+        return 0;
+    }
+
+    if (outName && !(out = fopen(outName, "w"))) {
+        printf("Could not open %s for writing\n", outName);
+        return 1;
+    }
+
+    switch (file.header().layout) {
+
+    case RESULT_LAYOUT_MAF_ROW_INDEX:
+        ok = writeMafRowIndex(file, out);
+        break;
+
+    case RESULT_LAYOUT_RPM_CURVE:
+        ok = writeRpmCurve(file, out);
+        break;
+
+    default:
+        writeGeneric(file, out);
+        break;
+    }
+
+    if (!ok) {
+        fprintf(stderr, "%s is missing columns for its layout; writing all columns\n", inName);
+        writeGeneric(file, out);
+    }
+
+    if (out != stdout)
+        fclose(out);
+
+    return 0;
+}
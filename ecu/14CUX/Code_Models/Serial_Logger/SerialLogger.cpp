@@ -0,0 +1,372 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Serial Logger
+//
+//  Logs RAM variables over the diagnostic protocol with the client in
+//  ../Common/SerialLogClient.h, from an ECU on a serial port, the serial stand-in on a pty
+//  (StandIn) or the stand-in on a TCP port. Each sample is a tab delimited line: the time
+//  in seconds, then every variable in decimal.
+//
+//      -mode       poll, block, batch or pipeline (default), see SerialLogClient.h
+//      -var        name=address[:size] (address in hex), may be given more than once; the
+//                  default is the RAM the stand-in fills
+//      -speed      how much faster than real time the other end runs (the stand-in's -speed)
+//      -timeout    ms of ECU time to wait for a byte before giving up on it (default 50)
+//
+//  -bench runs the stand-in in this process over a socket pair, and logs with each mode in
+//  turn for -seconds of ECU time, to show what the block reads and the pipelining gain. The
+//  tune number at $FFE9 is added to the variables and checked in every sample.
+//
+//  Usage: SerialLogger [-port <path> | -connect <tcp port>] [-mode <m>] [-var <spec> ...]
+//                      [-seconds <s>] [-speed <x>] [-timeout <ms>] [-o <file>]
+//         SerialLogger -bench [-tune <bin>] [-loop <us>] [-latency <us>] [-speed <x>]
+//                      [-seconds <s>] [-var <spec> ...]
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/CoSimulation.h"
+#include "../Common/SerialStandIn.h"
+#include "../Common/SerialLogClient.h"
+
+
+#define BENCH_SPEED         10.0        // stand-in speed for -bench
+#define BENCH_SECONDS       20.0        // ECU seconds per mode
+
+
+static int parseMode (const char *name)
+{
+    for (int m = 0; m < LOG_MODES; m++)
+        if (strcmp(name, logModeName[m]) == 0)
+            return m;
+
+    return -1;
+}
+
+// A serial port or pty, raw. A real port is set to 7812.5 baud where the driver allows
+// a custom rate; otherwise set it up beforehand (e.g. with setserial).
+static int openSerial (const char *path)
+{
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    struct termios tio;
+
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &tio);
+        tcflush(fd, TCIOFLUSH);
+    }
+
+    return fd;
+}
+
+static int connectTcp (int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("connect");
+        return -1;
+    }
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));     // don't hold commands back
+
+    return fd;
+}
+
+static void printPlan (const std::vector<ReadBlock> &plan)
+{
+    printf("%u blocks, %u passes a sample:", (unsigned)plan.size(), planPasses(plan));
+
+    for (size_t i = 0; i < plan.size(); i++)
+        printf(" %s$%04X/%u", plan[i].setAddress ? "*" : "", plan[i].address, plan[i].qty);
+
+    printf("   (* address/quantity first)\n");
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Logging
+//
+///////////////////////////////////////////////////////////////////////////////
+struct LogRun
+{
+    double  seconds;                        // ECU time
+    UINT64  samples;
+    UINT64  checkErrors;                    // samples where the check variable was wrong
+    LogClientStats client;
+    int     ahead;
+    bool    failed;
+};
+
+static LogRun logSamples (int fd, const std::vector<LogVariable> &vars, LogMode mode, double speed,
+                          UINT32 timeoutUs, double seconds, FILE *out, int checkVar, UINT16 checkValue)
+{
+    std::vector<ReadBlock> plan = planReads(vars, mode);
+    std::vector<UCHAR> shadow(SCI_MEMORY_SIZE, 0);
+    SerialLogClient client(fd, speed, timeoutUs);
+    LogRun run;
+
+    memset(&run, 0, sizeof(run));
+
+    if (out) {
+        fprintf(out, "time");
+        for (size_t v = 0; v < vars.size(); v++)
+            fprintf(out, "\t%s", vars[v].name.c_str());
+        fprintf(out, "\n");
+    }
+
+    while (client.elapsed() < seconds) {
+
+        if (!client.sample(plan, mode, &shadow[0])) {
+            printf("Lost contact with the ECU after %.1f s\n", client.elapsed());
+            run.failed = true;
+            break;
+        }
+
+        if (checkVar >= 0 && logValue(&shadow[0], vars[checkVar]) != checkValue)
+            run.checkErrors++;
+
+        if (out) {
+            fprintf(out, "%.3f", client.elapsed());
+            for (size_t v = 0; v < vars.size(); v++)
+                fprintf(out, "\t%u", logValue(&shadow[0], vars[v]));
+            fprintf(out, "\n");
+        }
+    }
+
+    run.seconds = client.elapsed();
+    run.client = client.statistics();
+    run.samples = run.client.samples;
+    run.ahead = client.lookahead();
+
+    return run;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  bench
+//
+///////////////////////////////////////////////////////////////////////////////
+static int bench (const char *tuneName, std::vector<LogVariable> vars, const CoSimConfig &config,
+                  UINT32 latency, double speed, double seconds, UINT32 timeoutUs)
+{
+    TuneImage tune;
+    DriveScript script;
+
+    if (!tune.open(tuneName))
+        return 1;
+
+    script.add(0.0, 0, 0, 85);
+    script.add(2.0, 0, 0, 85);
+    script.add(2.5, 40, 80, 85);
+    script.add(10.0, 40, 80, 85);
+    script.add(10.5, 0, 0, 85);
+    script.add(15.0, 0, 0, 85);
+
+    LogVariable check;
+    check.name = "tuneNumber";
+    check.address = ADDR_TUNE_NUMBER;
+    check.size = 2;
+    vars.push_back(check);
+
+    printf("%s (tune %04X), %u us a pass, %u us latency each way, %.0f s of ECU time per mode at %.0fx\n",
+      tune.name(), tune.tuneNumber(), config.mainLoopUs, latency, seconds, speed);
+
+    std::vector<LogRun> runs;
+    std::vector<StandInStats> ecu;
+    std::vector<std::vector<ReadBlock> > plans;
+
+    for (int m = 0; m < LOG_MODES; m++) {
+
+        SerialStandIn standIn;
+        std::atomic<bool> stop(false);
+        int sv[2];
+
+        if (!standIn.open(tune, tune.defaultFuelMap(), script, config, latency))
+            return 1;
+
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+            perror("socketpair");
+            return 1;
+        }
+
+        std::thread server([&]() { standIn.serve(sv[0], speed, &stop); });
+
+        plans.push_back(planReads(vars, (LogMode)m));
+        runs.push_back(logSamples(sv[1], vars, (LogMode)m, speed, timeoutUs, seconds, 0,
+                                  (int)vars.size() - 1, tune.tuneNumber()));
+
+        stop = true;
+        server.join();
+        close(sv[0]);
+        close(sv[1]);
+
+        ecu.push_back(standIn.statistics());
+    }
+
+    printf("\nMode       Blocks  Passes  Samples/s  Bytes out/in  Timeouts  Ahead  Discarded  Check\n");
+    printf("--------------------------------------------------------------------------------------\n");
+
+    for (int m = 0; m < LOG_MODES; m++) {
+        const LogRun &r = runs[m];
+        double perSample = r.samples ? 1.0 / r.samples : 0.0;
+
+        printf("%-9s  %6u  %6u  %9.2f  %6.1f/%-5.1f  %8llu  %5s  %9llu  %5s%s\n", logModeName[m],
+          (unsigned)plans[m].size(), planPasses(plans[m]), r.seconds ? r.samples / r.seconds : 0.0,
+          r.client.commandBytes * perSample, (r.client.dataBytes + r.client.commandBytes - r.client.earlySends) * perSample,
+          (unsigned long long)r.client.timeouts, (m == LOG_PIPELINE) ? std::to_string(r.ahead).c_str() : "-",
+          (unsigned long long)ecu[m].discarded, r.checkErrors ? "FAIL" : "ok", r.failed ? "  (lost contact)" : "");
+    }
+
+    printf("\n");
+    for (int m = 0; m < LOG_MODES; m++) {
+        printf("%-9s  ", logModeName[m]);
+        printPlan(plans[m]);
+    }
+
+    bool failed = false;
+    for (int m = 0; m < LOG_MODES; m++)
+        if (runs[m].failed || runs[m].checkErrors || !runs[m].samples)
+            failed = true;
+
+    if (runs[LOG_POLL].samples)
+        printf("\nBlock reads: %.1fx the samples of single byte polling, pipelined: %.1fx\n",
+          (double)runs[LOG_BATCH].samples / runs[LOG_POLL].samples,
+          (double)runs[LOG_PIPELINE].samples / runs[LOG_POLL].samples);
+
+    return failed ? 2 : 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    const char *tuneName = "../../OriginalCode/Reference_Bins/R3526.bin";
+    const char *portName = 0, *outName = 0;
+    std::vector<LogVariable> vars;
+    CoSimConfig config = defaultCoSimConfig();
+    int tcpPort = 0, mode = LOG_PIPELINE;
+    double speed = 0.0, seconds = 0.0;
+    UINT32 timeoutUs = 50000, latency = 0;
+    bool runBench = false;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-port") == 0 && arg + 1 < argc)
+            portName = argv[++arg];
+        else if (strcmp(argv[arg], "-connect") == 0 && arg + 1 < argc)
+            tcpPort = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-mode") == 0 && arg + 1 < argc && (mode = parseMode(argv[arg + 1])) >= 0)
+            arg++;
+        else if (strcmp(argv[arg], "-var") == 0 && arg + 1 < argc) {
+            LogVariable v;
+            if (!parseLogVariable(argv[++arg], v)) {
+                printf("Bad variable %s (name=address[:size])\n", argv[arg]);
+                return 1;
+            }
+            vars.push_back(v);
+        }
+        else if (strcmp(argv[arg], "-seconds") == 0 && arg + 1 < argc)
+            seconds = atof(argv[++arg]);
+        else if (strcmp(argv[arg], "-speed") == 0 && arg + 1 < argc)
+            speed = atof(argv[++arg]);
+        else if (strcmp(argv[arg], "-timeout") == 0 && arg + 1 < argc)
+            timeoutUs = (UINT32)(atof(argv[++arg]) * 1000.0);
+        else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc)
+            outName = argv[++arg];
+        else if (strcmp(argv[arg], "-bench") == 0)
+            runBench = true;
+        else if (strcmp(argv[arg], "-tune") == 0 && arg + 1 < argc)
+            tuneName = argv[++arg];
+        else if (strcmp(argv[arg], "-loop") == 0 && arg + 1 < argc)
+            config.mainLoopUs = (UINT32)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-latency") == 0 && arg + 1 < argc)
+            latency = (UINT32)atoi(argv[++arg]);
+        else {
+            printf("Usage: SerialLogger [-port <path> | -connect <tcp port>] [-mode <m>] [-var <spec> ...]\n");
+            printf("                    [-seconds <s>] [-speed <x>] [-timeout <ms>] [-o <file>]\n");
+            printf("       SerialLogger -bench [-tune <bin>] [-loop <us>] [-latency <us>] [-speed <x>]\n");
+            printf("                    [-seconds <s>] [-var <spec> ...]\n");
+            printf("Modes: poll, block, batch, pipeline\n");
+            return 1;
+        }
+    }
+
+    if (vars.empty())
+        vars = defaultLogVariables();
+
+    if (runBench) {
+        if (config.mainLoopUs == 0) {
+            printf("The main loop pass must be more than zero\n");
+            return 1;
+        }
+        config.logUs = 0;
+        return bench(tuneName, vars, config, latency, speed > 0.0 ? speed : BENCH_SPEED,
+                     seconds > 0.0 ? seconds : BENCH_SECONDS, timeoutUs);
+    }
+
+    if (!portName && !tcpPort) {
+        printf("Give -port or -connect (or -bench)\n");
+        return 1;
+    }
+
+    int fd = portName ? openSerial(portName) : connectTcp(tcpPort);
+    FILE *out = stdout;
+
+    if (fd < 0)
+        return 1;
+
+    if (outName && !(out = fopen(outName, "w"))) {
+        printf("Could not open %s for writing\n", outName);
+        return 1;
+    }
+
+    std::vector<ReadBlock> plan = planReads(vars, (LogMode)mode);
+
+    LogRun run = logSamples(fd, vars, (LogMode)mode, speed > 0.0 ? speed : 1.0, timeoutUs,
+                            seconds > 0.0 ? seconds : 1e30, out, -1, 0);
+
+    if (out != stdout)
+        fclose(out);
+    close(fd);
+
+    fprintf(stderr, "%s: %llu samples in %.1f s (%.2f a second), %u passes a sample planned, %llu timeouts\n",
+      logModeName[mode], (unsigned long long)run.samples, run.seconds, run.seconds ? run.samples / run.seconds : 0.0,
+      planPasses(plan), (unsigned long long)run.client.timeouts);
+
+    return run.failed ? 2 : 0;
+}
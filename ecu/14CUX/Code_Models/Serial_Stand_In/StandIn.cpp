@@ -0,0 +1,228 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Serial Stand-In
+//
+//  Serves the 14CUX diagnostic protocol from the models (../Common/SerialStandIn.h), so
+//  that logging software can be developed and load tested without a car. The ECU's RAM
+//  comes from a closed loop co-simulation of the tune running a drive script (the same
+//  format as CoSim's), which starts over when it reaches its end.
+//
+//  By default a pseudo terminal is opened and its name printed; point the logging program
+//  at it as if it were the serial adapter (the baud rate setting doesn't matter, the
+//  stand-in paces the bytes itself at 7812.5 baud). With -port, it listens on that TCP
+//  port on 127.0.0.1 instead and serves one connection at a time, each from a fresh start.
+//
+//      -loop       main loop pass in us (default 10000, as CoSim); the firmware sends at
+//                  most one byte a pass
+//      -speed      run this many times faster than real time (the client must be told)
+//      -latency    delay in us added to each direction, like a USB serial adapter
+//
+//  Ctrl-C stops it and prints the statistics.
+//
+//  Usage: StandIn [-tune <bin>] [-map <n>] [-loop <us>] [-speed <x>] [-latency <us>]
+//                 [-port <n>] [script]
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <atomic>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/CoSimulation.h"
+#include "../Common/SerialStandIn.h"
+
+
+static std::atomic<bool> stopRequested(false);
+
+static void onSignal (int)
+{
+    stopRequested = true;
+}
+
+// Idle, a tip-in and back to idle, warm
+static void builtInScript (DriveScript &script)
+{
+    script.name = "tipIn";
+    script.add(0.0, 0, 0, 85);
+    script.add(2.0, 0, 0, 85);
+    script.add(2.5, 40, 80, 85);
+    script.add(10.0, 40, 80, 85);
+    script.add(10.5, 0, 0, 85);
+    script.add(15.0, 0, 0, 85);
+}
+
+static void printStats (const SerialStandIn &standIn)
+{
+    const StandInStats &s = standIn.statistics();
+
+    printf("%llu passes, %llu bytes in, %llu bytes out, %llu overruns, %llu discarded during reads, "
+           "%.1f ms waiting to echo, script restarted %llu times\n",
+      (unsigned long long)s.passes, (unsigned long long)s.bytesIn, (unsigned long long)s.bytesOut,
+      (unsigned long long)s.overruns, (unsigned long long)s.discarded, s.stallUs / 1000.0,
+      (unsigned long long)s.restarts);
+}
+
+// A pty in raw mode. The slave is kept open here so the master doesn't report
+// EIO between clients.
+static int openPty (int &slave)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        return -1;
+    }
+
+    const char *name = ptsname(master);
+    struct termios tio;
+
+    if ((slave = open(name, O_RDWR | O_NOCTTY)) < 0 || tcgetattr(slave, &tio) != 0) {
+        perror(name);
+        return -1;
+    }
+
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    printf("Serving on %s\n", name);
+    fflush(stdout);
+
+    return master;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    TuneImage tune;
+    const char *tuneName = "../../OriginalCode/Reference_Bins/R3526.bin";
+    DriveScript script;
+    CoSimConfig config = defaultCoSimConfig();
+    int mapNumber = -1, port = 0;
+    double speed = 1.0;
+    UINT32 latency = 0;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-tune") == 0 && arg + 1 < argc)
+            tuneName = argv[++arg];
+        else if (strcmp(argv[arg], "-map") == 0 && arg + 1 < argc)
+            mapNumber = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-loop") == 0 && arg + 1 < argc)
+            config.mainLoopUs = (UINT32)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-speed") == 0 && arg + 1 < argc)
+            speed = atof(argv[++arg]);
+        else if (strcmp(argv[arg], "-latency") == 0 && arg + 1 < argc)
+            latency = (UINT32)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-port") == 0 && arg + 1 < argc)
+            port = atoi(argv[++arg]);
+        else if (argv[arg][0] == '-' || !script.points.empty()) {
+            printf("Usage: StandIn [-tune <bin>] [-map <n>] [-loop <us>] [-speed <x>] [-latency <us>]\n");
+            printf("               [-port <n>] [script]\n");
+            return 1;
+        }
+        else if (!script.load(argv[arg]))
+            return 1;
+    }
+
+    if (!tune.open(tuneName))
+        return 1;
+
+    if (config.mainLoopUs == 0 || speed <= 0.0) {
+        printf("The main loop pass and the speed must be more than zero\n");
+        return 1;
+    }
+
+    if (mapNumber < 0)
+        mapNumber = tune.defaultFuelMap();
+
+    if (script.points.empty())
+        builtInScript(script);
+
+    config.logUs = 0;
+
+    struct sigaction action;                    // no SA_RESTART, so accept() gives up on Ctrl-C
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, 0);
+    sigaction(SIGTERM, &action, 0);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("%s (tune %04X), fuel map %d, script %s, %u us a pass, %.1fx real time, %u us latency\n",
+      tune.name(), tune.tuneNumber(), mapNumber, script.name.c_str(), config.mainLoopUs, speed, latency);
+
+    if (!port) {
+        int slave, master = openPty(slave);
+        SerialStandIn standIn;
+
+        if (master < 0 || !standIn.open(tune, mapNumber, script, config, latency))
+            return 1;
+
+        standIn.serve(master, speed, &stopRequested);
+        printStats(standIn);
+
+        close(slave);
+        close(master);
+        return 0;
+    }
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0) {
+        perror("listen");
+        return 1;
+    }
+
+    printf("Listening on 127.0.0.1:%d\n", port);
+    fflush(stdout);
+
+    while (!stopRequested) {
+        SerialStandIn standIn;                      // ready before the host is, as an ECU would be
+
+        if (!standIn.open(tune, mapNumber, script, config, latency))
+            return 1;
+
+        int conn = accept(listener, 0, 0);
+
+        if (conn < 0)
+            continue;                               // interrupted
+
+        setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));   // a byte at a time, as the wire
+
+        printf("Connected\n");
+        fflush(stdout);
+
+        standIn.serve(conn, speed, &stopRequested);
+        printStats(standIn);
+        fflush(stdout);
+
+        close(conn);
+    }
+
+    close(listener);
+    return 0;
+}
@@ -0,0 +1,337 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Symbol Index Tool
+//
+//  Builds the symbol index (../Common/SymbolIndex.h) from the ten data_*.asm listings and
+//  rpmTable.asm, and looks symbols up in it. The index is only rebuilt when it is missing,
+//  from another version, or one of the listings has changed since it was written; after
+//  that, opening it is a single mapping and every lookup is a hash probe.
+//
+//      -verify     assemble the listings and compare every byte they produce with the
+//                  reference image of the same build (the data section and RPM table),
+//                  check the index entries against the listings, and check the fixed
+//                  fuel map and RPM table addresses in ../Common/TuneImage.h against
+//                  the index
+//      -moved      list the labels whose address or size differs between builds
+//      symbol      print the symbol in every build: address, size and type, and the first
+//                  bytes of the table in that build's reference image (or the value, for
+//                  an equate such as coldStartupFactor)
+//
+//  Usage: SymIndex [-asm <dir>] [-bins <dir>] [-index <file>] [-rebuild] [-verify] [-moved]
+//                  [symbol ...]
+//
+//      -asm    directory holding the listings (default ../../OriginalCode/asmFiles)
+//      -bins   directory holding the reference images (default ../../OriginalCode/Reference_Bins)
+//      -index  index file (default symbols.idx)
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/ReferenceTunes.h"
+#include "../Common/SymbolIndex.h"
+
+
+#define SHOW_BYTES          8           // table bytes printed per build
+
+
+static const char *typeName[] = { "-", "DB", "DW", "DS", "label", "equ" };
+
+// The tables TuneImage.h finds at fixed addresses (fuel maps 0 to 5, then the RPM table)
+static const char *fixedTables[FUEL_MAP_COUNT + 1] = {
+    "limpHomeMap", "fuelMap1", "fuelMap2", "fuelMap3", "fuelMap4", "fuelMap5", "rpmTable"
+};
+
+
+static std::string listingPath (const std::string &asmDir, int t)
+{
+    std::string build = referenceTunes[t];
+
+    return asmDir + "/data_" + build.substr(0, build.find_last_of('.')) + ".asm";
+}
+
+// Assemble every listing, each followed by rpmTable.asm
+static bool parseListings (const std::string &asmDir, std::vector<AsmListing *> &listings,
+                           std::vector<std::string> &paths)
+{
+    std::string rpmTable = asmDir + "/rpmTable.asm";
+
+    for (int t = 0; t < REFERENCE_TUNE_COUNT; t++) {
+        AsmListing *listing = new AsmListing;
+
+        paths.push_back(listingPath(asmDir, t));
+        listings.push_back(listing);
+
+        if (!parseDataListing(paths[t].c_str(), *listing) ||
+            !parseDataListing(rpmTable.c_str(), *listing, false))
+            return false;
+    }
+
+    return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  verify
+//
+//  Assembled bytes against the reference images, the index against the
+//  listings, and TuneImage's fixed addresses against the index. Returns the
+//  number of problems.
+//
+///////////////////////////////////////////////////////////////////////////////
+static UINT32 verify (const std::vector<AsmListing *> &listings, const SymbolIndex &index,
+                      const std::string &binDir)
+{
+    UINT32 problems = 0;
+
+    printf("\nBuild        Symbols  Bytes  Image mismatches  Index mismatches  TuneImage mismatches\n");
+    printf("--------------------------------------------------------------------------------------\n");
+
+    for (int t = 0; t < REFERENCE_TUNE_COUNT; t++) {
+
+        const AsmListing &listing = *listings[t];
+        TuneImage tune;
+        UINT32 bytes = 0, imageDiffs = 0, indexDiffs = 0, fixedDiffs = 0;
+        int it = index.findTune(listing.build.c_str());
+
+        if (!tune.open((binDir + "/" + referenceTunes[t]).c_str())) {
+            problems++;
+            continue;
+        }
+
+        for (UINT32 i = 0; i < PROM_SIZE; i++)
+            if (listing.assembled[i]) {
+                bytes++;
+                if (listing.image[i] != tune.data()[i])
+                    imageDiffs++;
+            }
+
+        for (size_t i = 0; i < listing.symbols.size(); i++) {
+            const AsmSymbol &s = listing.symbols[i];
+            int slot = index.find(s.name.c_str());
+
+            if (slot < 0 || it < 0) {
+                indexDiffs++;
+                continue;
+            }
+
+            const SymbolEntry &e = index.entry(slot, it);
+
+            if (e.type != s.type || e.address != s.address || e.size != s.size || e.value != s.value)
+                indexDiffs++;
+        }
+
+        for (int m = 0; m <= FUEL_MAP_COUNT; m++) {
+            int slot = index.find(fixedTables[m]);
+            const UCHAR *fixed = (m < FUEL_MAP_COUNT) ? tune.fuelMap(m) : tune.rpmTable();
+
+            if (slot < 0 || it < 0 || index.table(tune, slot, it) != fixed)
+                fixedDiffs++;
+        }
+
+        printf("%-12s %7u  %5u  %16u  %16u  %20u\n", listing.build.c_str(), (unsigned)listing.symbols.size(),
+          bytes, imageDiffs, indexDiffs, fixedDiffs);
+
+        problems += imageDiffs + indexDiffs + fixedDiffs;
+    }
+
+    return problems;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Lookups
+//
+///////////////////////////////////////////////////////////////////////////////
+static void printMoved (const SymbolIndex &index)
+{
+    printf("\nLabels that move between builds\n\n%-26s", "Label");
+    for (int t = 0; t < index.tuneCount(); t++)
+        printf(" %9s", index.build(t));
+    printf("\n");
+
+    std::vector<std::string> names;
+
+    for (int slot = 0; slot < index.slotCount(); slot++)
+        if (index.name(slot))
+            names.push_back(index.name(slot));
+
+    std::sort(names.begin(), names.end());
+
+    for (size_t n = 0; n < names.size(); n++) {
+
+        const char *name = names[n].c_str();
+        int slot = index.find(name);
+        bool moved = false;
+        int first = -1;
+
+        for (int t = 0; t < index.tuneCount(); t++) {
+            const SymbolEntry &e = index.entry(slot, t);
+            if (e.type == SYM_EQUATE)
+                break;
+            if (first < 0)
+                first = t;
+            else if (e.type != index.entry(slot, first).type || e.address != index.entry(slot, first).address ||
+                     e.size != index.entry(slot, first).size)
+                moved = true;
+        }
+
+        if (!moved)
+            continue;
+
+        printf("%-26s", name);
+        for (int t = 0; t < index.tuneCount(); t++) {
+            const SymbolEntry &e = index.entry(slot, t);
+            if (e.type == SYM_NONE)
+                printf(" %9s", "-");
+            else
+                printf("  $%04X/%-3u", e.address, e.size);
+        }
+        printf("\n");
+    }
+}
+
+static void printSymbol (const SymbolIndex &index, const char *symbol, const std::string &binDir)
+{
+    int slot = index.find(symbol);
+
+    if (slot < 0) {
+        printf("\n%s is not in the index\n", symbol);
+        return;
+    }
+
+    printf("\n%s\n", symbol);
+
+    for (int t = 0; t < index.tuneCount(); t++) {
+
+        const SymbolEntry &e = index.entry(slot, t);
+
+        printf("  %-10s ", index.build(t));
+
+        if (e.type == SYM_NONE) {
+            printf("(not in this build)\n");
+            continue;
+        }
+
+        if (e.type == SYM_EQUATE) {
+            printf("equ    $%04X (%u)\n", e.value, e.value);
+            continue;
+        }
+
+        printf("$%04X  %4u bytes  %-5s ", e.address, e.size, typeName[e.type]);
+
+        TuneImage tune;
+        int r = -1;
+
+        for (int i = 0; i < REFERENCE_TUNE_COUNT; i++)
+            if (index.findTune(referenceTunes[i]) == t)
+                r = i;
+
+        const UCHAR *table = 0;
+
+        if (r >= 0 && tune.open((binDir + "/" + referenceTunes[r]).c_str()))
+            table = index.table(tune, slot, t);
+
+        for (int i = 0; table && i < SHOW_BYTES && i < e.size; i++)
+            printf(" %02X", table[i]);
+
+        printf("%s\n", (table && e.size > SHOW_BYTES) ? " ..." : "");
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    std::string asmDir = "../../OriginalCode/asmFiles";
+    std::string binDir = REFERENCE_BIN_DIR;
+    std::string indexPath = "symbols.idx";
+    std::vector<const char *> symbols;
+    bool rebuild = false, check = false, moved = false;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-asm") == 0 && arg + 1 < argc)
+            asmDir = argv[++arg];
+        else if (strcmp(argv[arg], "-bins") == 0 && arg + 1 < argc)
+            binDir = argv[++arg];
+        else if (strcmp(argv[arg], "-index") == 0 && arg + 1 < argc)
+            indexPath = argv[++arg];
+        else if (strcmp(argv[arg], "-rebuild") == 0)
+            rebuild = true;
+        else if (strcmp(argv[arg], "-verify") == 0)
+            check = true;
+        else if (strcmp(argv[arg], "-moved") == 0)
+            moved = true;
+        else if (argv[arg][0] == '-') {
+            printf("Usage: SymIndex [-asm <dir>] [-bins <dir>] [-index <file>] [-rebuild] [-verify] [-moved]\n");
+            printf("                [symbol ...]\n");
+            return 1;
+        }
+        else
+            symbols.push_back(argv[arg]);
+    }
+
+    SymbolIndex index;
+    std::vector<AsmListing *> listings;
+    std::vector<std::string> paths;
+    int failed = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    bool opened = !rebuild && index.open(indexPath.c_str()) && !index.stale(asmDir.c_str());
+    double openUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    if (opened)
+        printf("Opened %s in %.0f us\n", indexPath.c_str(), openUs);
+
+    if (!opened || check) {
+
+        start = std::chrono::steady_clock::now();
+
+        if (!parseListings(asmDir, listings, paths))
+            failed = 1;
+
+        double parseUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        printf("Parsed %d listings in %.0f us\n", REFERENCE_TUNE_COUNT, parseUs);
+
+        if (!failed && !opened) {
+            index.close();
+            if (!writeSymbolIndex(indexPath.c_str(), listings, paths) || !index.open(indexPath.c_str()))
+                failed = 1;
+            else
+                printf("Wrote %s\n", indexPath.c_str());
+        }
+    }
+
+    if (!failed) {
+        printf("%d symbols in %d builds\n", index.symbolCount(), index.tuneCount());
+
+        if (check && verify(listings, index, binDir))
+            failed = 2;
+
+        if (moved)
+            printMoved(index);
+
+        for (size_t i = 0; i < symbols.size(); i++)
+            printSymbol(index, symbols[i], binDir);
+    }
+
+    for (size_t i = 0; i < listings.size(); i++)
+        delete listings[i];
+
+    return failed;
+}
@@ -0,0 +1,374 @@
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  14CUX Tune Patcher
+//
+//  A command line front end for ../Common/TunePatcher.h. Patches the data bytes of a PROM
+//  image directly, fixes the checksum from the patched bytes and writes a flashable image,
+//  without the crasm / srec2bin / finalize round trip in build.bat. Each image written is
+//  run through the models first, in the same process:
+//
+//      checksum    running sum against a full recount, and the PROM test result ($01)
+//      fuel        the fuel surface (FuelModel, times the map multiplier) against the
+//                  unpatched image over 500 to 6000 RPM and every MAF sum: points changed
+//                  and the mean change
+//      RPM table   column index problems from 120 to 6500 RPM (as RpmTable -edges)
+//      coolant     whether the cold start constants are still found in the code
+//
+//  Edits are read from a file (or stdin with '-'), one per line. Numbers may be decimal or
+//  0x hex, and '#' starts a comment:
+//
+//      byte <addr> <value> [<value> ...]       bytes from addr on
+//      word <addr> <value>                     16-bit, MSB first
+//      fuel <map> <row> <col> <value>          one fuel map cell
+//      scale <map> <percent>                   every cell of a fuel map
+//      mult <map> <value>                      fuel map multiplier (maps 1 to 5)
+//      rpm <row> <period> <control> <mult>     one RPM table row
+//
+//  -variants writes n candidate images on top of the edits, with the map multiplier
+//  stepped from low% to high% of its value, as <out>_000.bin, <out>_001.bin, ... Each one
+//  is made by patching, checking and writing the image and then reverting the patch.
+//
+//  Usage: TunePatch [-tune <bin>] [-map <n>] [-o <out>] [-32k] [-variants <n> <low%> <high%>]
+//                   [edit file]
+//
+//      -tune       image to patch (default ../../OriginalCode/Reference_Bins/R3526.bin)
+//      -map        fuel map for the checks and the variants (default is the tune's own)
+//      -o          output image (default <tune>_patched.bin)
+//      -32k        write 32K images with the code stacked twice, like finalize
+//
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../Common/CuxTypes.h"
+#include "../Common/TuneImage.h"
+#include "../Common/TunePatcher.h"
+#include "../Common/FuelSurface.h"
+#include "../Common/Breakpoints.h"
+#include "../Common/CoolantFueling.h"
+
+
+#define CHECK_RPM_FIRST     500         // fuel surface check
+#define CHECK_RPM_LAST      6000
+#define CHECK_RPM_STEP      250
+#define CHECK_MAF_SUMS      2047        // 0 to 2046, as FuelMapInterp
+#define EDGE_RPM_LOW        120         // RPM table check, as RpmTable -edges
+#define EDGE_RPM_HIGH       6500
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Model checks
+//
+///////////////////////////////////////////////////////////////////////////////
+struct FuelGrid
+{
+    std::vector<UINT16> period;
+    std::vector<UINT16> mafSum;
+};
+
+struct ImageCheck
+{
+    bool    checksumOk;                 // running sum matches a recount and is $01
+    UINT32  fuelChanged;                // fuel surface points that differ from the original
+    UINT32  fuelPoints;
+    double  fuelChange;                 // mean change (%), fuel value x multiplier
+    UINT32  rpmProblems;
+    bool    coolantFound;
+};
+
+static void makeGrid (FuelGrid &grid)
+{
+    for (UINT32 rpm = CHECK_RPM_FIRST; rpm <= CHECK_RPM_LAST; rpm += CHECK_RPM_STEP)
+        grid.period.push_back((UINT16)(7500000.0 / rpm));
+
+    for (UINT16 i = 0; i < CHECK_MAF_SUMS; i++)
+        grid.mafSum.push_back(i);
+}
+
+// Fuel value x map multiplier (>> 16) over the grid
+static void fuelSurface (const TuneImage &tune, int mapNumber, const FuelGrid &grid, std::vector<UINT32> &out)
+{
+    FuelModel model(tune, mapNumber);
+    std::vector<UINT16> fuel(grid.period.size() * grid.mafSum.size());
+    UINT32 multiplier = (mapNumber > 0) ? tune.mapMultiplier(mapNumber) : 0x10000;
+
+    model.buildSurface(grid.period.data(), grid.period.size(), grid.mafSum.data(), grid.mafSum.size(),
+                       fuel.data());
+
+    out.resize(fuel.size());
+    for (size_t i = 0; i < fuel.size(); i++)
+        out[i] = (UINT32)(((UINT64)fuel[i] * multiplier) >> 16);
+}
+
+static ImageCheck checkImage (const TunePatcher &patcher, int mapNumber, const FuelGrid &grid,
+                              const std::vector<UINT32> &original)
+{
+    ImageCheck c;
+    std::vector<UINT32> fuel;
+    CoolantTables tables;
+    UINT16 firstPeriod = (UINT16)(7500000.0 / EDGE_RPM_HIGH);
+    UINT16 lastPeriod = (UINT16)(7500000.0 / EDGE_RPM_LOW);
+    const UCHAR *rpmTable = patcher.tune().rpmTable();
+    double change = 0.0;
+    UINT32 changePoints = 0;
+
+    c.checksumOk = patcher.checksumOk() && patcher.fullChecksum() == patcher.checksum();
+
+    fuelSurface(patcher.tune(), mapNumber, grid, fuel);
+
+    c.fuelChanged = 0;
+    c.fuelPoints = (UINT32)fuel.size();
+
+    for (size_t i = 0; i < fuel.size(); i++) {
+        if (fuel[i] != original[i])
+            c.fuelChanged++;
+        if (original[i]) {
+            change += (double)fuel[i] / original[i] - 1.0;
+            changePoints++;
+        }
+    }
+
+    c.fuelChange = changePoints ? 100.0 * change / changePoints : 0.0;
+    c.rpmProblems = certifyColumnIndex(columnIndexBreakpoints(rpmTable), firstPeriod, lastPeriod, rpmTable);
+    c.coolantFound = loadCoolantTables(patcher.tune(), mapNumber, tables);
+
+    return c;
+}
+
+static void printCheck (const char *name, const TunePatcher &patcher, const ImageCheck &c)
+{
+    printf("%-24s  $%02X  %-5s  %6u of %u  %+7.2f%%  %4u      %s\n", name,
+      patcher.byteAt(ADDR_CHECKSUM_FIXER), c.checksumOk ? "ok" : "FAIL", c.fuelChanged, c.fuelPoints,
+      c.fuelChange, c.rpmProblems, c.coolantFound ? "ok" : "not found");
+}
+
+static void printCheckHeader (void)
+{
+    printf("Image                     Fixer  Chksum   Fuel points changed  Mean  RPM problems  Coolant\n");
+    printf("--------------------------------------------------------------------------------------------\n");
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  applyEdits
+//
+//  Reads the edit file and patches the image. Returns false on the first
+//  line that can't be used.
+//
+///////////////////////////////////////////////////////////////////////////////
+static bool applyEdits (TunePatcher &patcher, const char *path)
+{
+    FILE *fptr = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    char line[512];
+    const char *name = (fptr == stdin) ? "stdin" : path;
+    int lineNumber = 0;
+    bool ok = true;
+
+    if (!fptr) {
+        printf("Could not open %s\n", path);
+        return false;
+    }
+
+    while (ok && fgets(line, sizeof(line), fptr)) {
+
+        char *hash = strchr(line, '#');
+        char *tokens[64];
+        int count = 0;
+
+        lineNumber++;
+
+        if (hash)
+            *hash = 0;
+
+        for (char *t = strtok(line, " \t\r\n"); t && count < 64; t = strtok(0, " \t\r\n"))
+            tokens[count++] = t;
+
+        if (count == 0)
+            continue;
+
+        unsigned long v[64];
+        for (int i = 1; i < count; i++)
+            v[i] = strtoul(tokens[i], 0, 0);
+
+        const char *command = tokens[0];
+
+        if (strcmp(command, "byte") == 0 && count >= 3) {
+            for (int i = 2; ok && i < count; i++)
+                ok = v[1] + i - 2 <= 0xFFFF && patcher.setByte((UINT16)(v[1] + i - 2), (UINT8)v[i]);
+        }
+        else if (strcmp(command, "word") == 0 && count == 3)
+            ok = v[1] <= 0xFFFF && patcher.setWord((UINT16)v[1], (UINT16)v[2]);
+        else if (strcmp(command, "fuel") == 0 && count == 5)
+            ok = patcher.setFuelCell((int)v[1], (int)v[2], (int)v[3], (UINT8)v[4]);
+        else if (strcmp(command, "scale") == 0 && count == 3)
+            ok = patcher.scaleFuelMap((int)v[1], atof(tokens[2]));
+        else if (strcmp(command, "mult") == 0 && count == 3)
+            ok = patcher.setMapMultiplier((int)v[1], (UINT16)v[2]);
+        else if (strcmp(command, "rpm") == 0 && count == 5)
+            ok = patcher.setRpmRow((int)v[1], (UINT16)v[2], (UINT8)v[3], (UINT8)v[4]);
+        else {
+            printf("%s line %d: expected byte, word, fuel, scale, mult or rpm\n", name, lineNumber);
+            ok = false;
+            break;
+        }
+
+        if (!ok)
+            printf("%s line %d: address, map, row or column out of range\n", name, lineNumber);
+    }
+
+    if (fptr != stdin)
+        fclose(fptr);
+
+    return ok;
+}
+
+// <out>_NNN.bin (the number goes before the extension)
+static std::string variantName (const std::string &out, int n)
+{
+    char number[16];
+    size_t dot = out.find_last_of('.');
+    size_t slash = out.find_last_of("/\\");
+
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        dot = out.size();
+
+    sprintf(number, "_%03d", n);
+
+    return out.substr(0, dot) + number + out.substr(dot);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Main program.
+//
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    TuneImage tune;
+    const char *tuneName = "../../OriginalCode/Reference_Bins/R3526.bin";
+    const char *editFile = 0;
+    std::string out;
+    int mapNumber = -1;
+    int variants = 0;
+    double low = 100.0, high = 100.0;
+    bool stacked = false;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-tune") == 0 && arg + 1 < argc)
+            tuneName = argv[++arg];
+        else if (strcmp(argv[arg], "-map") == 0 && arg + 1 < argc)
+            mapNumber = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc)
+            out = argv[++arg];
+        else if (strcmp(argv[arg], "-32k") == 0)
+            stacked = true;
+        else if (strcmp(argv[arg], "-variants") == 0 && arg + 3 < argc) {
+            variants = atoi(argv[++arg]);
+            low = atof(argv[++arg]);
+            high = atof(argv[++arg]);
+        }
+        else if ((argv[arg][0] != '-' || strcmp(argv[arg], "-") == 0) && !editFile)
+            editFile = argv[arg];
+        else {
+            printf("Usage: TunePatch [-tune <bin>] [-map <n>] [-o <out>] [-32k] [-variants <n> <low%%> <high%%>]\n");
+            printf("                 [edit file]\n");
+            return 1;
+        }
+    }
+
+    if (!tune.open(tuneName))
+        return 1;
+
+    if (mapNumber < 0)
+        mapNumber = tune.defaultFuelMap();
+
+    if (mapNumber >= FUEL_MAP_COUNT || variants < 0 || (variants > 0 && (mapNumber == 0 || low < 0.0))) {
+        printf("The map must be 0 to 5, and 1 to 5 for variants (map 0 has no multiplier)\n");
+        return 1;
+    }
+
+    if (out.empty()) {
+        out = tune.name();
+        size_t dot = out.find_last_of('.');
+        out = out.substr(0, dot) + "_patched.bin";
+    }
+
+    TunePatcher patcher(tune);
+    FuelGrid grid;
+    std::vector<UINT32> original;
+
+    printf("Using %s (tune %04X), fuel map %d, checksum $%02X%s\n\n", tune.name(), tune.tuneNumber(),
+      mapNumber, patcher.checksum(), patcher.checksumOk() ? "" : " (fails the PROM test)");
+
+    makeGrid(grid);
+    fuelSurface(tune, mapNumber, grid, original);
+
+    if (editFile && !applyEdits(patcher, editFile))
+        return 1;
+
+    size_t edits = patcher.patchCount();
+
+    patcher.fixChecksum();
+
+    printf("%u bytes patched\n\n", (unsigned)edits);
+    printCheckHeader();
+
+    ImageCheck c = checkImage(patcher, mapNumber, grid, original);
+    bool failed = !c.checksumOk;
+
+    printCheck(out.c_str(), patcher, c);
+
+    if (!patcher.write(out.c_str(), stacked))
+        return 1;
+
+    if (variants == 0)
+        return failed ? 2 : 0;
+
+    // candidates on top of the edits
+    UINT16 baseMultiplier = patcher.tune().mapMultiplier(mapNumber);
+    double checkSeconds = 0.0;
+
+    patcher.checkpoint();
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int n = 0; n < variants; n++) {
+
+        double percent = (variants > 1) ? low + (high - low) * n / (variants - 1) : low;
+        double m = floor(baseMultiplier * percent / 100.0 + 0.5);
+        std::string name = variantName(out, n);
+
+        patcher.setMapMultiplier(mapNumber, (UINT16)(m < 65535.0 ? m : 65535.0));
+        patcher.fixChecksum();
+
+        auto checkStart = std::chrono::steady_clock::now();
+        c = checkImage(patcher, mapNumber, grid, original);
+        checkSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - checkStart).count();
+
+        printCheck(name.c_str(), patcher, c);
+
+        if (!c.checksumOk)
+            failed = true;
+
+        if (!patcher.write(name.c_str(), stacked))
+            return 1;
+
+        patcher.revert();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("\n%d variants in %.3f s (%.0f per minute), %.3f s of it in the model checks\n", variants,
+      seconds, seconds ? variants * 60.0 / seconds : 0.0, checkSeconds);
+
+    return failed ? 2 : 0;
+}